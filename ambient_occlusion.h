@@ -0,0 +1,719 @@
+#ifndef ambient_occlusion_h
+#define ambient_occlusion_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "gpu_driven.h"
+#include "gpu_resources.h"
+#include "input.h"
+#include "scene.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OCCLUSION_SSE2 1
+#else
+#define OCCLUSION_SSE2 0
+#endif
+
+// Binary ambient occlusion files written by --bake-ao. Layout (little-endian, no padding):
+//   header:  "CAOC" | u32 version | u32 samples per texel | f32 radius | u32 record count | u32 word count
+//   record:  u64 key | u32 word offset, one per baked box
+//   words:   the OcclusionBuffer of fragmentShader.fs
+// A box's record is six words, width | height << 16 of each face's texel grid (faces numbered as boxFace() in
+// scene.h), followed by the texels of the faces in order, one byte each from 0 (fully occluded) to 255 (open), row by
+// row along the face's second axis.
+
+const uint32_t OCCLUSION_VERSION = 1;
+
+// shader storage binding point of OcclusionBuffer in fragmentShader.fs
+const GLuint OCCLUSION_SSBO_BINDING = 10;
+
+// world units covered by a texel, and the most texels along a side of a face
+const float OCCLUSION_TEXEL_SIZE = 0.1f;
+const int OCCLUSION_MAX_FACE_TEXELS = 64;
+
+// identifies a box by its model matrix, which the bake and the running scene build with the same code
+inline uint64_t occlusionKey(const glm::mat4& model)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (int column = 0; column < 4; column++)
+    {
+        for (int row = 0; row < 4; row++)
+        {
+            uint32_t bits;
+            memcpy(&bits, &model[column][row], sizeof(bits));
+            for (int b = 0; b < 4; b++)
+                hash = (hash ^ ((bits >> (8 * b)) & 0xff)) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+// width and height of the texel grid of a face of a box with this model matrix
+inline glm::ivec2 occlusionFaceSize(const glm::mat4& model, int face)
+{
+    int u, v;
+    boxFaceAxes(face, u, v);
+    glm::vec3 extent = CUBE_MAX - CUBE_MIN;
+    int width = (int)std::ceil(glm::length(glm::vec3(model[u])) * extent[u] / OCCLUSION_TEXEL_SIZE);
+    int height = (int)std::ceil(glm::length(glm::vec3(model[v])) * extent[v] / OCCLUSION_TEXEL_SIZE);
+    return glm::ivec2(glm::clamp(width, 1, OCCLUSION_MAX_FACE_TEXELS), glm::clamp(height, 1, OCCLUSION_MAX_FACE_TEXELS));
+}
+
+// words of the record of a box with this model matrix
+inline size_t occlusionRecordWords(const glm::mat4& model)
+{
+    size_t texels = 0;
+    for (int face = 0; face < BOX_FACE_COUNT; face++)
+    {
+        glm::ivec2 size = occlusionFaceSize(model, face);
+        texels += (size_t)size.x * size.y;
+    }
+    return BOX_FACE_COUNT + (texels + 3) / 4;
+}
+
+// Ambient occlusion baked by OcclusionBaker, read by fragmentShader.fs to darken the ambient light. Every baked box has
+// a record that is found through its model matrix: DrawLists get 1 + the record's offset in DrawItem::occlusion, and
+// meshes baked from them carry it per vertex (MeshBuilder::occlusion). Boxes without a record are not darkened, so a
+// missing or stale file only loses the occlusion.
+class BakedOcclusion
+{
+public:
+    // reads a file written by --bake-ao
+    bool load(const char* path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        char magic[4];
+        uint32_t version = 0, recordCount = 0, wordCount = 0;
+        if (!in.read(magic, 4) || memcmp(magic, "CAOC", 4) != 0 || !get(in, version) || version != OCCLUSION_VERSION
+            || !get(in, samples) || !get(in, radius) || !get(in, recordCount) || !get(in, wordCount))
+        {
+            std::cout << "ERROR::OCCLUSION::FILE_NOT_READ: " << path << std::endl;
+            return false;
+        }
+        records.clear();
+        records.reserve(recordCount);
+        for (uint32_t r = 0; r < recordCount; r++)
+        {
+            uint64_t key;
+            uint32_t offset;
+            if (!get(in, key) || !get(in, offset) || offset >= wordCount)
+            {
+                std::cout << "ERROR::OCCLUSION::FILE_TRUNCATED: " << path << std::endl;
+                records.clear();
+                return false;
+            }
+            records[key] = offset;
+        }
+        words.resize(wordCount);
+        if (!in.read((char*)words.data(), (std::streamsize)wordCount * sizeof(GLuint)))
+        {
+            std::cout << "ERROR::OCCLUSION::FILE_TRUNCATED: " << path << std::endl;
+            records.clear();
+            words.clear();
+            return false;
+        }
+        return true;
+    }
+
+    // uploads the records; without a loaded file the buffer holds a single unused word
+    void init()
+    {
+        if (words.empty())
+            words.push_back(0);
+        buffer.create("occlusion", "baked occlusion");
+        buffer.data(GL_SHADER_STORAGE_BUFFER, words.size() * sizeof(GLuint), words.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        bytes = words.size() * sizeof(GLuint);
+        std::vector<GLuint>().swap(words);
+    }
+
+    // 1 + the record offset of the box with this model matrix, 0 when it was not baked
+    GLuint record(const glm::mat4& model) const
+    {
+        std::unordered_map<uint64_t, GLuint>::const_iterator found = records.find(occlusionKey(model));
+        return found == records.end() ? 0 : found->second + 1;
+    }
+
+    // sets the occlusion of every item of list; safe on any thread once loaded
+    void assign(DrawList& list) const
+    {
+        if (records.empty())
+            return;
+        for (DrawItem& item : list.items)
+            item.occlusion = record(item.model);
+    }
+
+    void apply() const { glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OCCLUSION_SSBO_BINDING, buffer); }
+
+    void report(std::ostream& out) const
+    {
+        if (records.empty())
+            return;
+        out << "ambient occlusion: " << records.size() << " baked boxes in " << bytes / 1024 << " KB, " << samples
+            << " rays per texel within " << radius << std::endl;
+    }
+
+    void destroy()
+    {
+        buffer.reset();
+    }
+
+private:
+    std::unordered_map<uint64_t, GLuint> records;
+    std::vector<GLuint> words;
+    GpuBuffer buffer;
+    size_t bytes = 0;
+    uint32_t samples = 0;
+    float radius = 0.0f;
+
+    template <typename T>
+    static bool get(std::istream& in, T& value) { return (bool)in.read((char*)&value, sizeof(T)); }
+};
+
+// four floats of a ray packet, one ray per lane; comparisons give a mask with all bits of the passing lanes set
+#if OCCLUSION_SSE2
+struct Float4
+{
+    __m128 v;
+    Float4() {}
+    Float4(__m128 lanes) : v(lanes) {}
+    explicit Float4(float s) : v(_mm_set1_ps(s)) {}
+    Float4(float a, float b, float c, float d) : v(_mm_setr_ps(a, b, c, d)) {}
+};
+inline Float4 operator+(Float4 a, Float4 b) { return _mm_add_ps(a.v, b.v); }
+inline Float4 operator-(Float4 a, Float4 b) { return _mm_sub_ps(a.v, b.v); }
+inline Float4 operator*(Float4 a, Float4 b) { return _mm_mul_ps(a.v, b.v); }
+inline Float4 operator/(Float4 a, Float4 b) { return _mm_div_ps(a.v, b.v); }
+inline Float4 operator<(Float4 a, Float4 b) { return _mm_cmplt_ps(a.v, b.v); }
+inline Float4 operator<=(Float4 a, Float4 b) { return _mm_cmple_ps(a.v, b.v); }
+inline Float4 operator>(Float4 a, Float4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+inline Float4 operator>=(Float4 a, Float4 b) { return _mm_cmpge_ps(a.v, b.v); }
+inline Float4 operator&(Float4 a, Float4 b) { return _mm_and_ps(a.v, b.v); }
+inline Float4 min4(Float4 a, Float4 b) { return _mm_min_ps(a.v, b.v); }
+inline Float4 max4(Float4 a, Float4 b) { return _mm_max_ps(a.v, b.v); }
+inline int laneMask(Float4 mask) { return _mm_movemask_ps(mask.v); }
+#else
+struct Float4
+{
+    float v[4];
+    Float4() {}
+    explicit Float4(float s) { v[0] = v[1] = v[2] = v[3] = s; }
+    Float4(float a, float b, float c, float d) { v[0] = a; v[1] = b; v[2] = c; v[3] = d; }
+};
+#define FLOAT4_LANES(expression) { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = expression; return r; }
+inline Float4 lanesFromBools(bool a, bool b, bool c, bool d)
+{
+    Float4 r;
+    uint32_t bits[4] = { a ? ~0u : 0u, b ? ~0u : 0u, c ? ~0u : 0u, d ? ~0u : 0u };
+    memcpy(r.v, bits, sizeof(bits));
+    return r;
+}
+inline Float4 operator+(Float4 a, Float4 b) FLOAT4_LANES(a.v[i] + b.v[i])
+inline Float4 operator-(Float4 a, Float4 b) FLOAT4_LANES(a.v[i] - b.v[i])
+inline Float4 operator*(Float4 a, Float4 b) FLOAT4_LANES(a.v[i] * b.v[i])
+inline Float4 operator/(Float4 a, Float4 b) FLOAT4_LANES(a.v[i] / b.v[i])
+inline Float4 min4(Float4 a, Float4 b) FLOAT4_LANES(b.v[i] < a.v[i] ? b.v[i] : a.v[i])
+inline Float4 max4(Float4 a, Float4 b) FLOAT4_LANES(b.v[i] > a.v[i] ? b.v[i] : a.v[i])
+#undef FLOAT4_LANES
+inline Float4 operator<(Float4 a, Float4 b) { return lanesFromBools(a.v[0] < b.v[0], a.v[1] < b.v[1], a.v[2] < b.v[2], a.v[3] < b.v[3]); }
+inline Float4 operator<=(Float4 a, Float4 b) { return lanesFromBools(a.v[0] <= b.v[0], a.v[1] <= b.v[1], a.v[2] <= b.v[2], a.v[3] <= b.v[3]); }
+inline Float4 operator>(Float4 a, Float4 b) { return b < a; }
+inline Float4 operator>=(Float4 a, Float4 b) { return b <= a; }
+inline Float4 operator&(Float4 a, Float4 b)
+{
+    uint32_t x[4], y[4];
+    memcpy(x, a.v, sizeof(x));
+    memcpy(y, b.v, sizeof(y));
+    for (int i = 0; i < 4; i++)
+        x[i] &= y[i];
+    Float4 r;
+    memcpy(r.v, x, sizeof(x));
+    return r;
+}
+inline int laneMask(Float4 mask)
+{
+    uint32_t bits[4];
+    memcpy(bits, mask.v, sizeof(bits));
+    return (int)(bits[0] >> 31 | (bits[1] >> 31) << 1 | (bits[2] >> 31) << 2 | (bits[3] >> 31) << 3);
+}
+#endif
+
+// Bakes the ambient occlusion of boxes by ray tracing the scene on the CPU. The triangles of every receiver and
+// occluder go into a BVH built with the binned surface area heuristic; every texel of every face then casts cosine
+// distributed rays over its hemisphere, four at a time as a packet that shares the texel's origin, and stores the
+// fraction that escapes within the radius. Packets walk the BVH together, testing a node's box and a leaf's triangles
+// for all four rays at once, and retire as soon as every ray is blocked. Boxes are handed out to the threads one at a
+// time and every texel uses its own fixed sample pattern, so the result does not depend on the thread count.
+class OcclusionBaker
+{
+public:
+    static constexpr int PACKET = 4;
+
+    // the scene's boxes of the shared box mesh, which are baked and occlude
+    void addReceivers(const DrawList& list, const float* boxVertices, const GLuint* boxIndices)
+    {
+        for (const DrawItem& item : list.items)
+        {
+            uint64_t key = occlusionKey(item.model);
+            if (!receiverKeys.insert(std::make_pair(key, (uint32_t)receivers.size())).second)
+                continue;
+            Receiver receiver;
+            receiver.key = key;
+            receiver.model = item.model;
+            receivers.push_back(receiver);
+            geometry.addBox(boxVertices, boxIndices, item.model, item.material);
+        }
+    }
+
+    // geometry that only occludes, such as the instances of the gpu-driven desks
+    void addOccluder(const MeshBuilder& mesh, const glm::mat4& model)
+    {
+        GLuint base = (GLuint)(geometry.vertices.size() / BOX_VERTEX_FLOATS);
+        for (size_t v = 0; v < mesh.vertices.size(); v += BOX_VERTEX_FLOATS)
+        {
+            glm::vec3 p = glm::vec3(model * glm::vec4(mesh.vertices[v], mesh.vertices[v + 1], mesh.vertices[v + 2], 1.0f));
+            float out[BOX_VERTEX_FLOATS] = { p.x, p.y, p.z, 0.0f, 0.0f, 0.0f };
+            geometry.vertices.insert(geometry.vertices.end(), out, out + BOX_VERTEX_FLOATS);
+        }
+        for (GLuint index : mesh.indices)
+            geometry.indices.push_back(base + index);
+    }
+
+    // rays per texel are rounded up to whole packets
+    void bake(int samplesPerTexel, float occlusionRadius, int threads)
+    {
+        samples = std::max(PACKET, (samplesPerTexel + PACKET - 1) / PACKET * PACKET);
+        radius = occlusionRadius;
+        threadCount = std::max(1, threads);
+
+        // Hammersley points mapped to a cosine distribution around +z; every texel turns them by its own angle
+        pattern.resize(samples);
+        for (int s = 0; s < samples; s++)
+        {
+            float e1 = ((float)s + 0.5f) / (float)samples;
+            float r = std::sqrt(e1), phi = 6.2831853f * radicalInverse((uint32_t)s);
+            pattern[s] = glm::vec3(r * std::cos(phi), r * std::sin(phi), std::sqrt(std::max(0.0f, 1.0f - e1)));
+        }
+
+        uint64_t start = inputClockNow();
+        buildTree();
+        uint64_t built = inputClockNow();
+
+        // records in receiver order
+        size_t wordCount = 0;
+        for (Receiver& receiver : receivers)
+        {
+            receiver.offset = (uint32_t)wordCount;
+            wordCount += occlusionRecordWords(receiver.model);
+        }
+        words.assign(wordCount, 0);
+        std::atomic<size_t> next(0);
+        std::vector<uint64_t> rays(threadCount, 0), texels(threadCount, 0);
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threadCount; t++)
+        {
+            workers.push_back(std::thread([this, t, &next, &rays, &texels] {
+                for (size_t r = next++; r < receivers.size(); r = next++)
+                    bakeReceiver(receivers[r], rays[t], texels[t]);
+            }));
+        }
+        for (std::thread& worker : workers)
+            worker.join();
+        uint64_t done = inputClockNow();
+
+        rayCount = texelCount = 0;
+        for (int t = 0; t < threadCount; t++)
+        {
+            rayCount += rays[t];
+            texelCount += texels[t];
+        }
+        buildMs = (double)(built - start) / 1.0e6;
+        traceMs = (double)(done - built) / 1.0e6;
+    }
+
+    bool save(const char* path) const
+    {
+        std::ofstream out(path, std::ios::binary);
+        if (!out)
+        {
+            std::cout << "ERROR::OCCLUSION::FILE_NOT_WRITTEN: " << path << std::endl;
+            return false;
+        }
+        out.write("CAOC", 4);
+        put(out, OCCLUSION_VERSION);
+        put(out, (uint32_t)samples);
+        put(out, radius);
+        put(out, (uint32_t)receivers.size());
+        put(out, (uint32_t)words.size());
+        for (const Receiver& receiver : receivers)
+        {
+            put(out, receiver.key);
+            put(out, receiver.offset);
+        }
+        out.write((const char*)words.data(), (std::streamsize)(words.size() * sizeof(GLuint)));
+        if (!out)
+        {
+            std::cout << "ERROR::OCCLUSION::FILE_NOT_WRITTEN: " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    void report(std::ostream& out) const
+    {
+        double seconds = traceMs / 1000.0;
+        out << std::fixed << std::setprecision(1) << "ambient occlusion bake: " << receivers.size() << " boxes, "
+            << texelCount << " texels, " << samples << " rays per texel within " << radius << std::endl
+            << "  " << triangles.size() << " triangles in " << nodes.size() << " BVH nodes built in " << buildMs
+            << " ms; " << rayCount << " rays traced in " << traceMs << " ms on " << threadCount << " threads, "
+            << (seconds > 0.0 ? (double)rayCount / seconds / 1.0e6 : 0.0) << " Mrays/s"
+            << (OCCLUSION_SSE2 ? " (sse2)" : " (scalar)") << std::endl;
+    }
+
+private:
+    static const int LEAF_SIZE = 4;
+    static const int BINS = 12;
+    // rays start this far above the surface, against self-intersection
+    static constexpr float ORIGIN_OFFSET = 1.0e-3f;
+
+    struct Receiver
+    {
+        uint64_t key;
+        glm::mat4 model;
+        uint32_t offset = 0;    // words
+    };
+
+    // vertex 0 and the edges to 1 and 2, as Moller-Trumbore wants them
+    struct Triangle
+    {
+        glm::vec3 v0, e1, e2;
+    };
+
+    // an inner node's children are first and first + 1; a leaf holds triangles [first, first + count)
+    struct Node
+    {
+        glm::vec3 boundsMin, boundsMax;
+        uint32_t first = 0;
+        uint32_t count = 0;
+    };
+
+    struct Bounds
+    {
+        glm::vec3 lo = glm::vec3(1e30f), hi = glm::vec3(-1e30f);
+        void grow(const glm::vec3& p) { lo = glm::min(lo, p); hi = glm::max(hi, p); }
+        void grow(const Bounds& b) { lo = glm::min(lo, b.lo); hi = glm::max(hi, b.hi); }
+        float area() const
+        {
+            glm::vec3 d = glm::max(hi - lo, glm::vec3(0.0f));
+            return d.x * d.y + d.y * d.z + d.z * d.x;
+        }
+    };
+
+    MeshBuilder geometry;
+    std::vector<Receiver> receivers;
+    std::unordered_map<uint64_t, uint32_t> receiverKeys;
+    std::vector<Triangle> triangles;
+    std::vector<Node> nodes;
+    std::vector<GLuint> words;
+    std::vector<glm::vec3> pattern;
+    int samples = 0;
+    float radius = 1.0f;
+    int threadCount = 1;
+    uint64_t rayCount = 0, texelCount = 0;
+    double buildMs = 0.0, traceMs = 0.0;
+
+    template <typename T>
+    static void put(std::ostream& out, const T& value) { out.write((const char*)&value, sizeof(T)); }
+
+    glm::vec3 vertex(GLuint index) const
+    {
+        const float* v = &geometry.vertices[(size_t)index * BOX_VERTEX_FLOATS];
+        return glm::vec3(v[0], v[1], v[2]);
+    }
+
+    void buildTree()
+    {
+        size_t count = geometry.indices.size() / 3;
+        std::vector<Bounds> bounds(count);
+        std::vector<glm::vec3> centroids(count);
+        std::vector<uint32_t> order(count);
+        for (size_t t = 0; t < count; t++)
+        {
+            for (int k = 0; k < 3; k++)
+                bounds[t].grow(vertex(geometry.indices[t * 3 + k]));
+            centroids[t] = (bounds[t].lo + bounds[t].hi) * 0.5f;
+            order[t] = (uint32_t)t;
+        }
+        nodes.clear();
+        nodes.reserve(count * 2 + 1);
+        nodes.push_back(Node());
+        subdivide(0, 0, (uint32_t)count, bounds, centroids, order);
+
+        triangles.resize(count);
+        for (size_t t = 0; t < count; t++)
+        {
+            glm::vec3 a = vertex(geometry.indices[order[t] * 3]);
+            glm::vec3 b = vertex(geometry.indices[order[t] * 3 + 1]);
+            glm::vec3 c = vertex(geometry.indices[order[t] * 3 + 2]);
+            triangles[t].v0 = a;
+            triangles[t].e1 = b - a;
+            triangles[t].e2 = c - a;
+        }
+        geometry = MeshBuilder();
+    }
+
+    void subdivide(uint32_t index, uint32_t first, uint32_t count, const std::vector<Bounds>& bounds,
+        const std::vector<glm::vec3>& centroids, std::vector<uint32_t>& order)
+    {
+        Bounds box, centroidBox;
+        for (uint32_t i = first; i < first + count; i++)
+        {
+            box.grow(bounds[order[i]]);
+            centroidBox.grow(centroids[order[i]]);
+        }
+        nodes[index].boundsMin = box.lo;
+        nodes[index].boundsMax = box.hi;
+        nodes[index].first = first;
+        nodes[index].count = count;
+        if (count <= LEAF_SIZE)
+            return;
+
+        // cheapest split over BINS centroid bins on every axis
+        float bestCost = (float)count * box.area();
+        int bestAxis = -1, bestSplit = 0;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float lo = centroidBox.lo[axis], extent = centroidBox.hi[axis] - lo;
+            if (extent <= 0.0f)
+                continue;
+            Bounds binBounds[BINS];
+            uint32_t binCounts[BINS] = {};
+            for (uint32_t i = first; i < first + count; i++)
+            {
+                int bin = std::min(BINS - 1, (int)((centroids[order[i]][axis] - lo) / extent * BINS));
+                binBounds[bin].grow(bounds[order[i]]);
+                binCounts[bin]++;
+            }
+            float rightArea[BINS];
+            uint32_t rightCount[BINS];
+            Bounds right;
+            uint32_t inRight = 0;
+            for (int b = BINS - 1; b > 0; b--)
+            {
+                right.grow(binBounds[b]);
+                inRight += binCounts[b];
+                rightArea[b] = right.area();
+                rightCount[b] = inRight;
+            }
+            Bounds left;
+            uint32_t inLeft = 0;
+            for (int b = 1; b < BINS; b++)
+            {
+                left.grow(binBounds[b - 1]);
+                inLeft += binCounts[b - 1];
+                if (inLeft == 0 || rightCount[b] == 0)
+                    continue;
+                float cost = (float)inLeft * left.area() + (float)rightCount[b] * rightArea[b];
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = b;
+                }
+            }
+        }
+
+        uint32_t middle;
+        if (bestAxis >= 0)
+        {
+            float lo = centroidBox.lo[bestAxis], extent = centroidBox.hi[bestAxis] - lo;
+            uint32_t* split = std::partition(order.data() + first, order.data() + first + count, [&](uint32_t t) {
+                return std::min(BINS - 1, (int)((centroids[t][bestAxis] - lo) / extent * BINS)) < bestSplit;
+            });
+            middle = (uint32_t)(split - order.data());
+        }
+        else
+        {
+            // no split beats a leaf; only very large leaves are halved anyway
+            if (count <= LEAF_SIZE * 4)
+                return;
+            middle = first + count / 2;
+        }
+
+        uint32_t left = (uint32_t)nodes.size();
+        nodes.push_back(Node());
+        nodes.push_back(Node());
+        nodes[index].first = left;
+        nodes[index].count = 0;
+        subdivide(left, first, middle - first, bounds, centroids, order);
+        subdivide(left + 1, middle, first + count - middle, bounds, centroids, order);
+    }
+
+    // lanes of the packet whose rays hit something closer than radius
+    int occludedLanes(const glm::vec3& origin, const Float4 direction[3]) const
+    {
+        Float4 inverse[3];
+        for (int k = 0; k < 3; k++)
+        {
+            // no exact zeros, so the slab test never computes 0 * infinity
+            Float4 tiny = Float4(1.0e-12f);
+            Float4 d = direction[k];
+#if OCCLUSION_SSE2
+            __m128 small = _mm_cmplt_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), d.v), tiny.v);
+            d = _mm_or_ps(_mm_and_ps(small, tiny.v), _mm_andnot_ps(small, d.v));
+#else
+            for (int i = 0; i < 4; i++)
+                d.v[i] = std::fabs(d.v[i]) < tiny.v[i] ? tiny.v[i] : d.v[i];
+#endif
+            inverse[k] = Float4(1.0f) / d;
+        }
+        Float4 zero(0.0f), far(radius);
+        int active = (1 << PACKET) - 1;
+        uint32_t stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0)
+        {
+            const Node& node = nodes[stack[--top]];
+            Float4 nearest = zero, farthest = far;
+            for (int k = 0; k < 3; k++)
+            {
+                Float4 t0 = (Float4(node.boundsMin[k]) - Float4(origin[k])) * inverse[k];
+                Float4 t1 = (Float4(node.boundsMax[k]) - Float4(origin[k])) * inverse[k];
+                nearest = max4(nearest, min4(t0, t1));
+                farthest = min4(farthest, max4(t0, t1));
+            }
+            if ((laneMask(nearest <= farthest) & active) == 0)
+                continue;
+            if (node.count == 0)
+            {
+                stack[top++] = node.first + 1;
+                stack[top++] = node.first;
+                continue;
+            }
+            for (uint32_t t = node.first; t < node.first + node.count; t++)
+            {
+                active &= ~hitLanes(triangles[t], origin, direction, far);
+                if (active == 0)
+                    return (1 << PACKET) - 1;
+            }
+        }
+        return ~active & ((1 << PACKET) - 1);
+    }
+
+    // Moller-Trumbore against four rays from one origin: the terms that only depend on the origin are computed once
+    static int hitLanes(const Triangle& tri, const glm::vec3& origin, const Float4 d[3], Float4 far)
+    {
+        Float4 e1x(tri.e1.x), e1y(tri.e1.y), e1z(tri.e1.z);
+        Float4 e2x(tri.e2.x), e2y(tri.e2.y), e2z(tri.e2.z);
+        Float4 px = d[1] * e2z - d[2] * e2y;
+        Float4 py = d[2] * e2x - d[0] * e2z;
+        Float4 pz = d[0] * e2y - d[1] * e2x;
+        Float4 det = e1x * px + e1y * py + e1z * pz;
+        Float4 inverseDet = Float4(1.0f) / det;
+        glm::vec3 s = origin - tri.v0;
+        glm::vec3 q = glm::cross(s, tri.e1);
+        Float4 u = (Float4(s.x) * px + Float4(s.y) * py + Float4(s.z) * pz) * inverseDet;
+        Float4 v = (d[0] * Float4(q.x) + d[1] * Float4(q.y) + d[2] * Float4(q.z)) * inverseDet;
+        Float4 t = Float4(glm::dot(tri.e2, q)) * inverseDet;
+        Float4 zero(0.0f);
+        Float4 hit = (det * det > Float4(1.0e-20f)) & (u >= zero) & (v >= zero) & (u + v <= Float4(1.0f)) & (t > zero) & (t < far);
+        return laneMask(hit);
+    }
+
+    static float radicalInverse(uint32_t bits)
+    {
+        bits = (bits << 16) | (bits >> 16);
+        bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+        bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+        bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+        bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+        return (float)bits * 2.3283064365386963e-10f;
+    }
+
+    static uint32_t hash(uint32_t x)
+    {
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    void bakeReceiver(const Receiver& receiver, uint64_t& rays, uint64_t& texels)
+    {
+        glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(receiver.model)));
+        unsigned char* out = (unsigned char*)&words[receiver.offset + BOX_FACE_COUNT];
+        for (int face = 0; face < BOX_FACE_COUNT; face++)
+        {
+            glm::ivec2 size = occlusionFaceSize(receiver.model, face);
+            words[receiver.offset + face] = (GLuint)size.x | (GLuint)size.y << 16;
+            int axis = face / 2, u, v;
+            boxFaceAxes(face, u, v);
+            glm::vec3 localNormal(0.0f);
+            localNormal[axis] = face & 1 ? 1.0f : -1.0f;
+            glm::vec3 n = glm::normalize(normalMatrix * localNormal);
+            // orthonormal basis around n (Duff et al. 2017)
+            float sign = n.z >= 0.0f ? 1.0f : -1.0f;
+            float a = -1.0f / (sign + n.z);
+            float b = n.x * n.y * a;
+            glm::vec3 tangent(1.0f + sign * n.x * n.x * a, sign * b, -sign * n.x);
+            glm::vec3 bitangent(b, sign + n.y * n.y * a, -n.y);
+            for (int j = 0; j < size.y; j++)
+            {
+                for (int i = 0; i < size.x; i++)
+                {
+                    glm::vec3 local;
+                    local[axis] = face & 1 ? CUBE_MAX[axis] : CUBE_MIN[axis];
+                    local[u] = glm::mix(CUBE_MIN[u], CUBE_MAX[u], ((float)i + 0.5f) / (float)size.x);
+                    local[v] = glm::mix(CUBE_MIN[v], CUBE_MAX[v], ((float)j + 0.5f) / (float)size.y);
+                    glm::vec3 origin = glm::vec3(receiver.model * glm::vec4(local, 1.0f)) + n * ORIGIN_OFFSET;
+                    // the pattern turned around n by an angle of its own, so neighbouring texels do not band
+                    uint32_t seed = hash((uint32_t)receiver.offset * 2654435761u ^ hash((uint32_t)(face * 4096 + j * 64 + i)));
+                    float angle = (float)seed * (6.2831853f / 4294967296.0f);
+                    glm::vec3 x = tangent * std::cos(angle) + bitangent * std::sin(angle);
+                    glm::vec3 y = glm::cross(n, x);
+                    int open = 0;
+                    for (int s = 0; s < samples; s += PACKET)
+                    {
+                        float lane[3][PACKET];
+                        for (int l = 0; l < PACKET; l++)
+                        {
+                            const glm::vec3& p = pattern[s + l];
+                            glm::vec3 d = x * p.x + y * p.y + n * p.z;
+                            lane[0][l] = d.x;
+                            lane[1][l] = d.y;
+                            lane[2][l] = d.z;
+                        }
+                        Float4 direction[3];
+                        for (int k = 0; k < 3; k++)
+                            direction[k] = Float4(lane[k][0], lane[k][1], lane[k][2], lane[k][3]);
+                        int blocked = occludedLanes(origin, direction);
+                        for (int l = 0; l < PACKET; l++)
+                            open += (blocked >> l & 1) ? 0 : 1;
+                    }
+                    *out++ = (unsigned char)((open * 255 + samples / 2) / samples);
+                    rays += samples;
+                    texels++;
+                }
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,32 @@
+#version 430 core
+layout (location = 0) in vec3 aPos;
+
+// see GpuRigidPart in rigid_animation.h
+struct Part
+{
+    vec4 pivotPhase;
+    vec4 axisVelocity;
+};
+
+layout (std430, binding = 9) readonly buffer PartBuffer
+{
+    Part parts[];
+};
+
+uniform mat4 lightViewProjection;
+uniform float animationTime;
+
+// Rodrigues' rotation around a unit axis, as in animatedVertex.vs
+vec3 rotateAround(vec3 v, vec3 axis, float angle)
+{
+    float c = cos(angle);
+    float s = sin(angle);
+    return v * c + cross(axis, v) * s + axis * dot(axis, v) * (1.0f - c);
+}
+
+void main()
+{
+    Part part = parts[gl_InstanceID];
+    float angle = part.pivotPhase.w + part.axisVelocity.w * animationTime;
+    gl_Position = lightViewProjection * vec4(part.pivotPhase.xyz + rotateAround(aPos, part.axisVelocity.xyz, angle), 1.0f);
+}
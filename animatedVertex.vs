@@ -0,0 +1,57 @@
+#version 430 core
+layout (location = 0) in vec3 aPos;
+// baked meshes mix materials, so the slot in the material table comes with every vertex
+layout (location = 1) in uint aMaterial;
+layout (location = 2) in vec3 aNormal;
+
+// explicit locations so multiview.gs can sit between this stage and fragmentShader.fs
+layout (location = 0) flat out uint material;
+layout (location = 1) out vec3 worldPos;
+layout (location = 2) out vec3 normal;
+layout (location = 3) flat out uint occlusionFace;  // no baked ambient occlusion, see vertexShader.vs
+layout (location = 4) out vec2 occlusionUV;
+
+layout (std140) uniform CameraBlock
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+};
+
+// see GpuRigidPart in rigid_animation.h
+struct Part
+{
+    vec4 pivotPhase;
+    vec4 axisVelocity;
+};
+
+layout (std430, binding = 9) readonly buffer PartBuffer
+{
+    Part parts[];
+};
+
+uniform float animationTime;
+
+// the depth pre-pass and the shading pass must produce identical depths for GL_EQUAL
+invariant gl_Position;
+
+// Rodrigues' rotation around a unit axis, counter-clockwise as glm::rotate
+vec3 rotateAround(vec3 v, vec3 axis, float angle)
+{
+    float c = cos(angle);
+    float s = sin(angle);
+    return v * c + cross(axis, v) * s + axis * dot(axis, v) * (1.0f - c);
+}
+
+void main()
+{
+    Part part = parts[gl_InstanceID];
+    float angle = part.pivotPhase.w + part.axisVelocity.w * animationTime;
+    worldPos = part.pivotPhase.xyz + rotateAround(aPos, part.axisVelocity.xyz, angle);
+    gl_Position = viewProjection * vec4(worldPos, 1.0f);
+    normal = rotateAround(aNormal, part.axisVelocity.xyz, angle);
+    material = aMaterial;
+    occlusionFace = 0u;
+    occlusionUV = vec2(0.0f);
+}
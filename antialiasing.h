@@ -0,0 +1,328 @@
+#ifndef antialiasing_h
+#define antialiasing_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "gpu_resources.h"
+#include "render_graph.h"
+#include "shader.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// first texture unit of the post-process programs, clear of the shadow maps
+const GLuint ANTIALIASING_TEXTURE_UNIT = 1;
+
+enum Antialiasing_Mode {
+    AA_NONE,
+    AA_MSAA_2X,
+    AA_MSAA_4X,
+    AA_MSAA_8X,
+    AA_FXAA,
+    AA_TAA,
+    AA_MODES
+};
+
+// also the values of --aa
+inline const char* antialiasingModeName(Antialiasing_Mode mode)
+{
+    static const char* names[AA_MODES] = { "none", "msaa2", "msaa4", "msaa8", "fxaa", "taa" };
+    return names[mode];
+}
+
+inline bool parseAntialiasingMode(const std::string& name, Antialiasing_Mode& mode)
+{
+    for (int m = 0; m < AA_MODES; m++)
+    {
+        if (name == antialiasingModeName((Antialiasing_Mode)m))
+        {
+            mode = (Antialiasing_Mode)m;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline int antialiasingSamples(Antialiasing_Mode mode)
+{
+    return mode == AA_MSAA_2X ? 2 : (mode == AA_MSAA_4X ? 4 : (mode == AA_MSAA_8X ? 8 : 1));
+}
+
+// Anti-aliasing of the scene, which the passes then draw into an offscreen target of the render graph instead of the
+// output (window or headless target); bindScene() binds whichever it is.
+//  - MSAA renders into multisampled colour and depth and resolves with a blit.
+//  - FXAA renders single-sampled and filters the edges into the output with fxaa.fs.
+//  - TAA jitters the projection by a Halton (2, 3) sequence of eight sub-pixel offsets and accumulates the frames
+//    into a history reprojected with the depth (taa.fs). It needs a single camera, so with the monitor views the
+//    frame is presented without it.
+// Every mode labels the render graph's frames with its name, so the report can put the GPU frame time of each mode
+// next to the memory of its targets.
+class Antialiasing
+{
+public:
+    void init(Antialiasing_Mode initial)
+    {
+        GLint samples = 1;
+        glGetIntegerv(GL_MAX_SAMPLES, &samples);
+        maxSamples = samples;
+        sceneFramebuffer.create("antialiasing", "scene");
+        postFramebuffer.create("antialiasing", "post-process");
+        fullscreenVAO.create("antialiasing", "fullscreen triangle");
+        setMode(initial);
+    }
+
+    Antialiasing_Mode mode() const { return selected; }
+    // the mode of the current frame
+    const char* activeName() const { return antialiasingModeName(active); }
+
+    // MSAA sample counts the GL cannot do fall back to the next lower one
+    void setMode(Antialiasing_Mode mode)
+    {
+        while (antialiasingSamples(mode) > maxSamples)
+            mode = (Antialiasing_Mode)(mode - 1);
+        selected = mode;
+    }
+
+    void cycle()
+    {
+        Antialiasing_Mode next = (Antialiasing_Mode)((selected + 1) % AA_MODES);
+        while (antialiasingSamples(next) > maxSamples)
+            next = (Antialiasing_Mode)((next + 1) % AA_MODES);
+        selected = next;
+    }
+
+    // starts a frame presented into outputFramebuffer; returns the projection jitter for CameraUniformBuffer::setJitter
+    glm::vec2 beginFrame(GLuint outputFramebuffer, int outputWidth, int outputHeight, bool singleView)
+    {
+        output = outputFramebuffer;
+        if (outputWidth != width || outputHeight != height)
+            historyValid = false;
+        width = outputWidth;
+        height = outputHeight;
+        active = selected;
+        if ((active == AA_TAA && !singleView) || width <= 0 || height <= 0)
+            active = AA_NONE;
+        if (active != AA_TAA)
+        {
+            historyValid = false;
+            return glm::vec2(0.0f);
+        }
+        if (historyWidth != width || historyHeight != height)
+        {
+            for (int i = 0; i < 2; i++)
+            {
+                history[i].create("antialiasing", "taa history");
+                glBindTexture(GL_TEXTURE_2D, history[i]);
+                glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, width, height);
+                history[i].setBytes(historyBytes());
+            }
+            glBindTexture(GL_TEXTURE_2D, 0);
+            historyWidth = width;
+            historyHeight = height;
+        }
+        jitterIndex = jitterIndex % JITTER_PHASES + 1;
+        glm::vec2 offset(halton(jitterIndex, 2) - 0.5f, halton(jitterIndex, 3) - 0.5f);
+        return offset * 2.0f / glm::vec2((float)width, (float)height);
+    }
+
+    // declares the colour and depth the scene passes draw into and the pass that presents them into the output
+    void declare(RenderGraph& graph, RenderResource outputResource, const Shader& fxaaShader, const Shader& taaShader, RenderResource& sceneColor, RenderResource& sceneDepth)
+    {
+        attached = false;
+        ModeStats& stats = modeStats[active];
+        stats.frames++;
+        if (active == AA_NONE)
+        {
+            sceneColor = outputResource;
+            sceneDepth = graph.import("scene depth");
+            colorResource = depthResource = -1;
+            return;
+        }
+        int samples = antialiasingSamples(active);
+        TransientTextureDesc colorDesc = { GL_RGBA8, width, height, samples };
+        TransientTextureDesc depthDesc = { GL_DEPTH24_STENCIL8, width, height, samples };
+        colorResource = sceneColor = graph.createTexture(samples > 1 ? "msaa colour" : "scene colour", colorDesc);
+        depthResource = sceneDepth = graph.createTexture(samples > 1 ? "msaa depth" : "scene depth", depthDesc);
+        size_t bytes = colorDesc.bytes() + depthDesc.bytes();
+        if (samples > 1)
+        {
+            // multisampled to single-sampled needs identical formats, which the window's need not have
+            TransientTextureDesc resolvedDesc = { GL_RGBA8, width, height, 1 };
+            RenderResource resolved = graph.createTexture("msaa resolved colour", resolvedDesc);
+            bytes += resolvedDesc.bytes();
+            graph.addPass("msaa resolve", [this, &graph, resolved] {
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, postFramebuffer);
+                glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, graph.texture(resolved), 0);
+                blit(sceneFramebuffer, postFramebuffer);
+                present();
+            }).readsFinal(sceneColor).writes(resolved).writes(outputResource);
+        }
+        else if (active == AA_FXAA)
+        {
+            graph.addPass("fxaa", [this, &graph, &fxaaShader] {
+                glBindFramebuffer(GL_FRAMEBUFFER, output);
+                glViewport(0, 0, width, height);
+                fxaaShader.use();
+                bindTexture(fxaaShader, "sceneColor", 0, graph.texture(colorResource), GL_LINEAR);
+                fxaaShader.setVec2("texelSize", 1.0f / width, 1.0f / height);
+                drawFullscreen();
+            }).readsFinal(sceneColor).writes(outputResource);
+        }
+        else
+        {
+            RenderResource historyResource = graph.import("taa history");
+            bytes += 2 * historyBytes();
+            graph.addPass("taa resolve", [this, &graph, &taaShader] {
+                int next = 1 - historyIndex;
+                glBindFramebuffer(GL_FRAMEBUFFER, postFramebuffer);
+                glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, history[next], 0);
+                glViewport(0, 0, width, height);
+                taaShader.use();
+                bindTexture(taaShader, "currentColor", 0, graph.texture(colorResource), GL_NEAREST);
+                bindTexture(taaShader, "currentDepth", 1, graph.texture(depthResource), GL_NEAREST);
+                bindTexture(taaShader, "history", 2, history[historyIndex], GL_LINEAR);
+                taaShader.setBool("historyValid", historyValid);
+                taaShader.setVec2("texelSize", 1.0f / width, 1.0f / height);
+                drawFullscreen();
+                present();
+                historyIndex = next;
+                historyValid = true;
+            }).readsFinal(sceneColor).readsFinal(sceneDepth).reads(historyResource).writes(historyResource).writes(outputResource);
+        }
+        stats.bytes = std::max(stats.bytes, bytes);
+    }
+
+    // binds the target the scene passes draw into, with a viewport covering it
+    void bindScene(const RenderGraph& graph)
+    {
+        if (active == AA_NONE)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, output);
+            glViewport(0, 0, width, height);
+            return;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+        // the graph may hand out different textures every frame
+        if (!attached)
+        {
+            glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, graph.texture(colorResource), 0);
+            glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, graph.texture(depthResource), 0);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE && !incompleteReported)
+            {
+                std::cout << "ERROR::ANTIALIASING:: the " << activeName() << " scene target " << width << "x" << height << " is not complete" << std::endl;
+                incompleteReported = true;
+            }
+            attached = true;
+        }
+        glViewport(0, 0, width, height);
+    }
+
+    // memory of the targets and GPU frame time of every mode used
+    void report(std::ostream& out, RenderGraph& graph) const
+    {
+        out << "anti-aliasing:" << std::endl;
+        for (int m = 0; m < AA_MODES; m++)
+        {
+            const ModeStats& stats = modeStats[m];
+            if (!stats.frames)
+                continue;
+            out << std::fixed << std::setprecision(2) << "  " << antialiasingModeName((Antialiasing_Mode)m) << ": "
+                << stats.frames << " frames, " << stats.bytes / 1048576.0 << " MiB of targets";
+            SampleSeries* gpu = graph.frameGpuTimes(antialiasingModeName((Antialiasing_Mode)m));
+            if (gpu && gpu->count())
+                out << std::setprecision(3) << ", GPU frame mean " << gpu->mean() << " ms, p95 " << gpu->percentile(95.0) << " ms";
+            out << std::endl;
+        }
+    }
+
+    void destroy()
+    {
+        sceneFramebuffer.reset();
+        postFramebuffer.reset();
+        fullscreenVAO.reset();
+        history[0].reset();
+        history[1].reset();
+        historyWidth = historyHeight = 0;
+    }
+
+private:
+    struct ModeStats
+    {
+        unsigned long long frames = 0;
+        size_t bytes = 0;
+    };
+
+    static const int JITTER_PHASES = 8;
+
+    Antialiasing_Mode selected = AA_NONE;
+    Antialiasing_Mode active = AA_NONE;
+    int maxSamples = 1;
+    GLuint output = 0;
+    int width = 0;
+    int height = 0;
+    GpuFramebuffer sceneFramebuffer;
+    GpuFramebuffer postFramebuffer;     // the MSAA resolve or the TAA history being written
+    GpuVertexArray fullscreenVAO;
+    RenderResource colorResource = -1;
+    RenderResource depthResource = -1;
+    bool attached = false;
+    bool incompleteReported = false;
+    GpuTexture history[2];
+    int historyIndex = 0;
+    int historyWidth = 0;
+    int historyHeight = 0;
+    bool historyValid = false;
+    int jitterIndex = 0;
+    ModeStats modeStats[AA_MODES];
+
+    size_t historyBytes() const { return (size_t)width * height * textureFormatBytes(GL_RGBA16F); }
+
+    static float halton(int index, int base)
+    {
+        float fraction = 1.0f, result = 0.0f;
+        for (; index > 0; index /= base)
+        {
+            fraction /= (float)base;
+            result += fraction * (float)(index % base);
+        }
+        return result;
+    }
+
+    void blit(GLuint from, GLuint to) const
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, from);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, to);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+
+    // copies the post-process framebuffer into the output and leaves the output bound
+    void present() const
+    {
+        blit(postFramebuffer, output);
+        glBindFramebuffer(GL_FRAMEBUFFER, output);
+    }
+
+    void bindTexture(const Shader& shader, const char* name, GLuint unit, GLuint texture, GLenum filter) const
+    {
+        glActiveTexture(GL_TEXTURE0 + ANTIALIASING_TEXTURE_UNIT + unit);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        shader.setInt(name, (int)(ANTIALIASING_TEXTURE_UNIT + unit));
+    }
+
+    void drawFullscreen() const
+    {
+        glDisable(GL_DEPTH_TEST);
+        glBindVertexArray(fullscreenVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glEnable(GL_DEPTH_TEST);
+    }
+};
+
+#endif
@@ -0,0 +1,401 @@
+#ifndef assets_h
+#define assets_h
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "input.h"
+#include "shader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Fire-and-forget coroutine of one asset load. It starts on the calling thread, moves between threads by awaiting the
+// AssetPipeline's awaitables, and its frame is freed when it returns.
+struct AssetTask
+{
+    struct promise_type
+    {
+        AssetTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+// loads that belong together, e.g. the programs every frame needs; only touched on the main thread. A group is ready
+// once every load has finished, whether or not it succeeded
+struct AssetGroup
+{
+    int pending = 0;
+    int failures = 0;
+
+    bool ready() const { return pending == 0; }
+    bool failed() const { return failures > 0; }
+};
+
+// Loads assets in the background. Loads are coroutines that read and decode on a pool of worker threads, create GL
+// objects on an upload thread whose hidden window shares the main context, and finish on the main thread once a fence
+// shows the GPU has executed the upload. The main loop keeps running meanwhile and only has to call pump() once per
+// frame. Without a shared context the upload steps run on the main thread inside pump().
+class AssetPipeline
+{
+public:
+    static constexpr int MAX_WORKERS = 4;
+
+    void init(GLFWwindow* mainWindow)
+    {
+        startTime = inputClockNow();
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        uploadWindow = glfwCreateWindow(1, 1, "upload", NULL, mainWindow);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+        uploadShared = uploadWindow != NULL;
+        if (uploadWindow)
+            uploadThread = std::thread(&AssetPipeline::uploadLoop, this);
+        else
+            std::cout << "ERROR::ASSETS:: no shared upload context, uploading on the main thread" << std::endl;
+        workerCount = std::max(1, std::min<int>(MAX_WORKERS, (int)std::thread::hardware_concurrency() - 2));
+        for (int i = 0; i < workerCount; i++)
+            workers.emplace_back(&AssetPipeline::workerLoop, this);
+    }
+
+    // awaitables; loads hop between threads with them
+    struct Hop
+    {
+        AssetPipeline* pipeline;
+        int queue;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) const { pipeline->post(queue, handle); }
+        void await_resume() const noexcept {}
+    };
+
+    struct Fence
+    {
+        AssetPipeline* pipeline;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) const
+        {
+            GLsync sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            // the fence must reach the GPU before another context can wait for it
+            glFlush();
+            std::lock_guard<std::mutex> lock(pipeline->mutex);
+            pipeline->fences.push_back({ handle, sync });
+        }
+        void await_resume() const noexcept {}
+    };
+
+    // file IO and decoding, no GL calls
+    Hop onWorker() { return Hop{ this, WORKER_QUEUE }; }
+    // creating and filling shareable GL objects: buffers, textures, programs
+    Hop onUploadContext() { return Hop{ this, uploadWindow ? UPLOAD_QUEUE : MAIN_QUEUE }; }
+    // the next pump(); anything touching the main context's own state, such as vertex arrays
+    Hop onMainThread() { return Hop{ this, MAIN_QUEUE }; }
+    // awaited on the upload context: fences what was issued there and resumes on the main thread once it completed
+    Fence uploaded() { return Fence{ this }; }
+
+    // bookkeeping, called by the loads themselves
+    void started(AssetGroup& group)
+    {
+        group.pending++;
+        loadsStarted++;
+    }
+
+    void completed(AssetGroup& group)
+    {
+        group.pending--;
+        loadsCompleted++;
+        if (idle())
+            allLoadedTime = inputClockNow();
+    }
+
+    // a load that could not read or build its asset; what went wrong has been printed
+    void failed(AssetGroup& group, const char* name)
+    {
+        std::cout << "ERROR::ASSETS:: " << name << " failed to load" << std::endl;
+        group.pending--;
+        group.failures++;
+        loadsFailed++;
+        if (idle())
+            allLoadedTime = inputClockNow();
+    }
+
+    void addRead(size_t bytes) { bytesRead += bytes; }
+    void addUploaded(size_t bytes) { bytesUploaded += bytes; }
+
+    // runs the loads that are due on the main thread; call once per frame
+    void pump()
+    {
+        std::vector<std::coroutine_handle<>> due;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            due.assign(mainQueue.begin(), mainQueue.end());
+            mainQueue.clear();
+            for (size_t i = 0; i < fences.size();)
+            {
+                GLenum status = glClientWaitSync(fences[i].sync, 0, 0);
+                if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+                {
+                    glDeleteSync(fences[i].sync);
+                    due.push_back(fences[i].handle);
+                    fences.erase(fences.begin() + i);
+                }
+                else
+                {
+                    i++;
+                }
+            }
+        }
+        for (std::coroutine_handle<> handle : due)
+            handle.resume();
+    }
+
+    // blocks until every started load has completed; for modes that need the whole scene from the first frame
+    void finish()
+    {
+        while (!idle())
+        {
+            pump();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    bool idle() const { return loadsCompleted + loadsFailed == loadsStarted; }
+    float progress() const { return loadsStarted ? (float)(loadsCompleted + loadsFailed) / (float)loadsStarted : 1.0f; }
+
+    void framePresented()
+    {
+        if (!firstFrameTime)
+            firstFrameTime = inputClockNow();
+    }
+
+    void report(std::ostream& out) const
+    {
+        double loadMs = allLoadedTime ? (double)(allLoadedTime - startTime) / 1.0e6 : 0.0;
+        double megabytes = (double)(bytesRead + bytesUploaded) / (1024.0 * 1024.0);
+        out << std::fixed << std::setprecision(1) << "assets: " << loadsCompleted << "/" << loadsStarted << " loaded";
+        if (loadsFailed)
+            out << ", " << loadsFailed << " failed";
+        out << " on " << workerCount << " workers" << (uploadShared ? " and a shared upload context" : "") << ", "
+            << bytesRead / 1024 << " KB read, " << bytesUploaded / 1024 << " KB uploaded in " << loadMs << " ms ("
+            << (loadMs > 0.0 ? megabytes / (loadMs / 1000.0) : 0.0) << " MB/s), first frame after "
+            << (firstFrameTime ? (double)(firstFrameTime - startTime) / 1.0e6 : 0.0) << " ms" << std::endl;
+    }
+
+    // lets the threads drain their queues, then drops loads that can no longer complete
+    void shutdown()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        workerWake.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+        workers.clear();
+        uploadWake.notify_all();
+        if (uploadThread.joinable())
+            uploadThread.join();
+        for (std::coroutine_handle<> handle : workerQueue)
+            handle.destroy();
+        for (std::coroutine_handle<> handle : uploadQueue)
+            handle.destroy();
+        for (std::coroutine_handle<> handle : mainQueue)
+            handle.destroy();
+        for (const PendingFence& fence : fences)
+        {
+            glDeleteSync(fence.sync);
+            fence.handle.destroy();
+        }
+        workerQueue.clear();
+        uploadQueue.clear();
+        mainQueue.clear();
+        fences.clear();
+        if (uploadWindow)
+            glfwDestroyWindow(uploadWindow);
+        uploadWindow = NULL;
+    }
+
+private:
+    static const int WORKER_QUEUE = 0;
+    static const int UPLOAD_QUEUE = 1;
+    static const int MAIN_QUEUE = 2;
+
+    struct PendingFence
+    {
+        std::coroutine_handle<> handle;
+        GLsync sync;
+    };
+
+    GLFWwindow* uploadWindow = NULL;
+    bool uploadShared = false;
+    int workerCount = 0;
+    std::thread uploadThread;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable workerWake;
+    std::condition_variable uploadWake;
+    std::deque<std::coroutine_handle<>> workerQueue;
+    std::deque<std::coroutine_handle<>> uploadQueue;
+    std::deque<std::coroutine_handle<>> mainQueue;
+    std::vector<PendingFence> fences;
+    bool stopping = false;
+
+    // main thread only
+    int loadsStarted = 0;
+    int loadsCompleted = 0;
+    int loadsFailed = 0;
+    uint64_t startTime = 0;
+    uint64_t allLoadedTime = 0;
+    uint64_t firstFrameTime = 0;
+    std::atomic<size_t> bytesRead{ 0 };
+    std::atomic<size_t> bytesUploaded{ 0 };
+
+    void post(int queue, std::coroutine_handle<> handle)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (queue == WORKER_QUEUE)
+                workerQueue.push_back(handle);
+            else if (queue == UPLOAD_QUEUE)
+                uploadQueue.push_back(handle);
+            else
+                mainQueue.push_back(handle);
+        }
+        if (queue == WORKER_QUEUE)
+            workerWake.notify_one();
+        else if (queue == UPLOAD_QUEUE)
+            uploadWake.notify_one();
+    }
+
+    void workerLoop() { drain(workerQueue, workerWake); }
+
+    void uploadLoop()
+    {
+        glfwMakeContextCurrent(uploadWindow);
+        drain(uploadQueue, uploadWake);
+        glfwMakeContextCurrent(NULL);
+    }
+
+    // resumes the queue's loads until shutdown() finds it empty
+    void drain(std::deque<std::coroutine_handle<>>& queue, std::condition_variable& wake)
+    {
+        for (;;)
+        {
+            std::coroutine_handle<> handle;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || !queue.empty(); });
+                if (queue.empty())
+                    return;
+                handle = queue.front();
+                queue.pop_front();
+            }
+            handle.resume();
+        }
+    }
+};
+
+// Reads both stages on a worker, compiles and links on the upload context and hands the program to target on the
+// main thread once the driver has finished it. A stage that cannot be read or a program that does not build fails the
+// load, and target is left as it was. The paths must outlive the load.
+inline AssetTask loadProgram(AssetPipeline& assets, AssetGroup& group, Shader& target, const char* vertexPath, const char* fragmentPath, GLuint cameraBinding)
+{
+    assets.started(group);
+    co_await assets.onWorker();
+    std::string vertexCode = Shader::readSource(vertexPath);
+    std::string fragmentCode = Shader::readSource(fragmentPath);
+    assets.addRead(vertexCode.size() + fragmentCode.size());
+    if (vertexCode.empty() || fragmentCode.empty())
+    {
+        co_await assets.onMainThread();
+        assets.failed(group, fragmentPath);
+        co_return;
+    }
+    co_await assets.onUploadContext();
+    Shader program;
+    if (!program.compile(vertexCode, fragmentCode, fragmentPath))
+    {
+        program.destroy();
+        co_await assets.onMainThread();
+        assets.failed(group, fragmentPath);
+        co_return;
+    }
+    program.setBlockBinding("CameraBlock", cameraBinding);
+    co_await assets.uploaded();
+    target = std::move(program);
+    assets.completed(group);
+}
+
+// as loadProgram, with a geometry shader between the two stages
+inline AssetTask loadProgram(AssetPipeline& assets, AssetGroup& group, Shader& target, const char* vertexPath, const char* geometryPath, const char* fragmentPath, GLuint cameraBinding)
+{
+    assets.started(group);
+    co_await assets.onWorker();
+    std::string vertexCode = Shader::readSource(vertexPath);
+    std::string geometryCode = Shader::readSource(geometryPath);
+    std::string fragmentCode = Shader::readSource(fragmentPath);
+    assets.addRead(vertexCode.size() + geometryCode.size() + fragmentCode.size());
+    // an empty geometry stage would silently build a program without it
+    if (vertexCode.empty() || geometryCode.empty() || fragmentCode.empty())
+    {
+        co_await assets.onMainThread();
+        assets.failed(group, geometryPath);
+        co_return;
+    }
+    co_await assets.onUploadContext();
+    Shader program;
+    if (!program.compile(vertexCode, geometryCode, fragmentCode, geometryPath))
+    {
+        program.destroy();
+        co_await assets.onMainThread();
+        assets.failed(group, geometryPath);
+        co_return;
+    }
+    program.setBlockBinding("CameraBlock", cameraBinding);
+    co_await assets.uploaded();
+    target = std::move(program);
+    assets.completed(group);
+}
+
+inline AssetTask loadComputeProgram(AssetPipeline& assets, AssetGroup& group, Shader& target, const char* computePath)
+{
+    assets.started(group);
+    co_await assets.onWorker();
+    std::string computeCode = Shader::readSource(computePath);
+    assets.addRead(computeCode.size());
+    if (computeCode.empty())
+    {
+        co_await assets.onMainThread();
+        assets.failed(group, computePath);
+        co_return;
+    }
+    co_await assets.onUploadContext();
+    Shader program;
+    if (!program.compileCompute(computeCode, computePath))
+    {
+        program.destroy();
+        co_await assets.onMainThread();
+        assets.failed(group, computePath);
+        co_return;
+    }
+    co_await assets.uploaded();
+    target = std::move(program);
+    assets.completed(group);
+}
+
+#endif
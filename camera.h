@@ -11,8 +11,9 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 
-#include <vector>
+#include "frustum.h"
 
 // Defines several possible options for camera movement. Used as abstraction to stay away from window-system specific input methods
 enum Camera_Movement {
@@ -30,6 +31,13 @@ enum Camera_Movement {
     R_RIGHT
 };
 
+// How accumulated input is turned into a pose
+enum Camera_Mode {
+    FREE_FLY,   // move and rotate freely
+    ORBIT,      // rotate around Target at Distance, forward/backward dolly in and out
+    LOOK_AT     // move freely while always facing Target
+};
+
 // Default camera values
 const float YAW = -90.0f;
 const float PITCH = 0.0f;
@@ -37,154 +45,336 @@ const float ROLL = 0.0f;
 const float SPEED = 2.5f;
 const float SENSITIVITY = 0.1f;
 const float ZOOM = 45.0f;
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
 
 
-// An abstract camera class that processes input and calculates the corresponding Euler Angles, Vectors and Matrices for use in OpenGL
+// A single camera component: quaternion orientation, free-fly/orbit/look-at modes, input accumulated and applied once per
+// frame in Update(), and view/projection/view-projection/frustum cached behind dirty flags
 class Camera
 {
 public:
-    // camera Attributes
-    glm::vec3 Position;
-    glm::vec3 Front;
-    glm::vec3 Up;
-    glm::vec3 Right;
-    glm::vec3 WorldUp;
-    glm::vec3 Target;
-    float Distance;    
-    float Theta;      
-    float Phi;
-    // euler Angles
-    float Yaw;
-    float Pitch;
-    float Roll;
     // camera options
     float MovementSpeed;
     float MouseSensitivity;
-    float Zoom;
 
     // constructor with vectors
-    Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f), float yaw = YAW, float pitch = PITCH, float roll = ROLL ) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM)
+    Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f), float yaw = YAW, float pitch = PITCH, float roll = ROLL) : MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY)
     {
-        Position = position;
-        WorldUp = up;
-        Yaw = yaw;
-        Pitch = pitch;
-        Roll = roll;
-        updateCameraVectors();
+        init(position, up, yaw, pitch, roll);
     }
     // constructor with scalar values
-    Camera(float posX, float posY, float posZ, float upX, float upY, float upZ, float yaw, float pitch) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM)
+    Camera(float posX, float posY, float posZ, float upX, float upY, float upZ, float yaw, float pitch) : MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY)
     {
-        Position = glm::vec3(posX, posY, posZ);
-        WorldUp = glm::vec3(upX, upY, upZ);
-        Yaw = yaw;
-        Pitch = pitch;
-        updateCameraVectors();
+        init(glm::vec3(posX, posY, posZ), glm::vec3(upX, upY, upZ), yaw, pitch, ROLL);
     }
-    void Orbit(float dTheta, float dPhi) {
-        Target = GetViewMatrix()[3];
-        Distance = glm::distance(Target, Position);
-        Theta += dTheta;
-        Phi = glm::clamp(Phi + dPhi, 0.1f, glm::radians(179.9f));  // Avoids gimbal lock
-    }
-    // returns the view matrix calculated using Euler Angles and the LookAt Matrix
-    glm::mat4 GetViewMatrix()
+
+    // processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
+    // the movement is only recorded here; it is applied in Update()
+    void ProcessKeyboard(Camera_Movement direction)
     {
-        return glm::lookAt(Position, Position + Front, Up);
+        pendingMovement |= 1u << direction;
     }
-    glm::vec3 GetPosition() const {
-        float x = Distance * sin(Phi) * cos(Theta);
-        float y = Distance * sin(Phi) * sin(Theta);
-        float z = Distance * cos(Phi);
-        return Target + glm::vec3(x, y, z);
+
+    // processes input received from a mouse input system. Expects the offset value in both the x and y direction.
+    void ProcessMouseMovement(float xoffset, float yoffset, GLboolean constrainPitch = true)
+    {
+        pendingYaw += xoffset * MouseSensitivity;
+        pendingPitch += yoffset * MouseSensitivity;
+        pendingConstrainPitch = pendingConstrainPitch && constrainPitch;
     }
-    glm::mat4 GetViewMatrixOrbit() const {
-        return glm::lookAt(GetPosition(), Target, glm::vec3(0.0f, 1.0f, 0.0f));
+
+    // processes input received from a mouse scroll-wheel event. Only requires input on the vertical wheel-axis
+    void ProcessMouseScroll(float yoffset)
+    {
+        pendingZoom -= yoffset;
     }
 
-    // processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
-    void ProcessKeyboard(Camera_Movement direction, float deltaTime)
+    // applies everything accumulated since the last call in one step; does nothing (and keeps the cache) when there was no input
+    void Update(float deltaTime)
     {
         float velocity = MovementSpeed * deltaTime;
-        if (direction == FORWARD)
-            Position += Front * velocity;
-        if (direction == BACKWARD)
-            Position -= Front * velocity;
-        if (direction == LEFT)
-            Position -= Right * velocity;
-        if (direction == RIGHT)
-            Position += Right * velocity;
-        if (direction == UP)
-            Position += Up * velocity;
-        if (direction == DOWN)
-            Position -= Up * velocity;
-        if (direction == P_UP)
-            Pitch += velocity * 10;
-        if (direction == P_DOWN)
-            Pitch -= velocity * 10;
-        if (direction == Y_LEFT)
-            Yaw += velocity * 10;
-        if (direction == Y_RIGHT)
-            Yaw -= velocity * 10;
-        if (direction == R_LEFT)
-            Roll += velocity * 10;
-        if (direction == R_RIGHT)
-            Roll -= velocity * 10;
+        float yawDelta = pendingYaw;
+        float pitchDelta = pendingPitch;
+        float rollDelta = 0.0f;
+        glm::vec3 move(0.0f);
+
+        if (pendingMovement & (1u << FORWARD))
+            move += Front;
+        if (pendingMovement & (1u << BACKWARD))
+            move -= Front;
+        if (pendingMovement & (1u << LEFT))
+            move -= Right;
+        if (pendingMovement & (1u << RIGHT))
+            move += Right;
+        if (pendingMovement & (1u << UP))
+            move += Up;
+        if (pendingMovement & (1u << DOWN))
+            move -= Up;
+        if (pendingMovement & (1u << P_UP))
+            pitchDelta += velocity * 10;
+        if (pendingMovement & (1u << P_DOWN))
+            pitchDelta -= velocity * 10;
+        if (pendingMovement & (1u << Y_LEFT))
+            yawDelta += velocity * 10;
+        if (pendingMovement & (1u << Y_RIGHT))
+            yawDelta -= velocity * 10;
+        if (pendingMovement & (1u << R_LEFT))
+            rollDelta += velocity * 10;
+        if (pendingMovement & (1u << R_RIGHT))
+            rollDelta -= velocity * 10;
+
+        // make sure that when pitch is out of bounds, screen doesn't get flipped
+        if (pendingConstrainPitch)
+            pitchDelta = glm::clamp(Pitch + pitchDelta, -89.0f, 89.0f) - Pitch;
+
+        bool rotated = yawDelta != 0.0f || pitchDelta != 0.0f || rollDelta != 0.0f;
+        bool moved = move != glm::vec3(0.0f);
+        float zoom = glm::clamp(Zoom + pendingZoom, 1.0f, 45.0f);
+
+        pendingMovement = 0;
+        pendingYaw = pendingPitch = pendingZoom = 0.0f;
+        pendingConstrainPitch = true;
+
+        if (zoom != Zoom)
+        {
+            Zoom = zoom;
+            projectionDirty = true;
+            revision++;
+        }
+        if (!rotated && !moved)
+            return;
+
+        switch (Mode)
+        {
+        case FREE_FLY:
+            Position += move * velocity;
+            rotate(yawDelta, pitchDelta, rollDelta);
+            break;
+        case ORBIT:
+            // forward/backward dolly towards the target, everything else orbits around it
+            Distance = glm::max(Distance - glm::dot(move, Front) * velocity, 0.1f);
+            rotate(yawDelta, pitchDelta, rollDelta);
+            Position = Target - Front * Distance;
+            break;
+        case LOOK_AT:
+            Position += move * velocity;
+            faceTarget();
+            break;
+        }
+        viewDirty = true;
+        revision++;
+    }
+
+    // switches modes keeping the current position; orbit and look-at turn to face the target
+    void SetMode(Camera_Mode mode)
+    {
+        if (mode == Mode)
+            return;
+        Mode = mode;
+        if (Mode != FREE_FLY)
+        {
+            Distance = glm::max(glm::distance(Position, Target), 0.1f);
+            faceTarget();
+            viewDirty = true;
+            revision++;
+        }
+    }
+
+    void SetTarget(const glm::vec3& target)
+    {
+        Target = target;
+        if (Mode != FREE_FLY)
+        {
+            Distance = glm::max(glm::distance(Position, Target), 0.1f);
+            faceTarget();
+            viewDirty = true;
+            revision++;
+        }
+    }
+
+    // places the camera at an explicit pose regardless of mode
+    void SetPose(const glm::vec3& position, const glm::quat& orientation)
+    {
+        Position = position;
+        Orientation = glm::normalize(orientation);
         updateCameraVectors();
+        Pitch = glm::degrees(asin(glm::clamp(Front.y, -1.0f, 1.0f)));
+        viewDirty = true;
+        revision++;
     }
 
-    // processes input received from a mouse input system. Expects the offset value in both the x and y direction.
-    void ProcessMouseMovement(float xoffset, float yoffset, GLboolean constrainPitch = true)
+    void SetZoom(float zoom)
     {
-        xoffset *= MouseSensitivity;
-        yoffset *= MouseSensitivity;
+        Zoom = glm::clamp(zoom, 1.0f, 45.0f);
+        projectionDirty = true;
+        revision++;
+    }
 
-        Yaw += xoffset;
-        Pitch += yoffset;
+    void SetAspectRatio(float aspectRatio)
+    {
+        if (aspectRatio == AspectRatio)
+            return;
+        AspectRatio = aspectRatio;
+        projectionDirty = true;
+        revision++;
+    }
 
-        // make sure that when pitch is out of bounds, screen doesn't get flipped
-        if (constrainPitch)
+    void SetClipPlanes(float nearPlane, float farPlane)
+    {
+        NearPlane = nearPlane;
+        FarPlane = farPlane;
+        projectionDirty = true;
+        revision++;
+    }
+
+    // returns the view matrix calculated from the orientation quaternion; only rebuilt after the pose changed
+    const glm::mat4& GetViewMatrix()
+    {
+        if (viewDirty)
         {
-            if (Pitch > 89.0f)
-                Pitch = 89.0f;
-            if (Pitch < -89.0f)
-                Pitch = -89.0f;
+            view = glm::mat4_cast(glm::conjugate(Orientation)) * glm::translate(glm::mat4(1.0f), -Position);
+            viewDirty = false;
+            viewProjectionDirty = true;
         }
+        return view;
+    }
 
-        // update Front, Right and Up Vectors using the updated Euler angles
-        updateCameraVectors();
+    const glm::mat4& GetProjectionMatrix()
+    {
+        if (projectionDirty)
+        {
+            projection = glm::perspective(glm::radians(Zoom), AspectRatio, NearPlane, FarPlane);
+            projectionDirty = false;
+            viewProjectionDirty = true;
+        }
+        return projection;
     }
 
-    // processes input received from a mouse scroll-wheel event. Only requires input on the vertical wheel-axis
-    void ProcessMouseScroll(float yoffset)
+    const glm::mat4& GetViewProjectionMatrix()
+    {
+        GetViewMatrix();
+        GetProjectionMatrix();
+        if (viewProjectionDirty)
+        {
+            viewProjection = projection * view;
+            frustum.extract(viewProjection);
+            viewProjectionDirty = false;
+        }
+        return viewProjection;
+    }
+
+    const Frustum& GetFrustum()
     {
-        Zoom -= (float)yoffset;
-        if (Zoom < 1.0f)
-            Zoom = 1.0f;
-        if (Zoom > 45.0f)
-            Zoom = 45.0f;
+        GetViewProjectionMatrix();
+        return frustum;
     }
 
+    // bumped whenever any cached matrix changes, so consumers can skip work when the camera is still
+    unsigned int GetRevision() const { return revision; }
+
+    const glm::vec3& GetPosition() const { return Position; }
+    const glm::quat& GetOrientation() const { return Orientation; }
+    const glm::vec3& GetFront() const { return Front; }
+    const glm::vec3& GetUp() const { return Up; }
+    const glm::vec3& GetRight() const { return Right; }
+    const glm::vec3& GetTarget() const { return Target; }
+    Camera_Mode GetMode() const { return Mode; }
+    float GetZoom() const { return Zoom; }
+    float GetAspectRatio() const { return AspectRatio; }
+    float GetNearPlane() const { return NearPlane; }
+    float GetFarPlane() const { return FarPlane; }
+
 private:
-    // calculates the front vector from the Camera's (updated) Euler Angles
+    // camera Attributes
+    glm::vec3 Position;
+    glm::quat Orientation;
+    glm::vec3 Front;
+    glm::vec3 Up;
+    glm::vec3 Right;
+    glm::vec3 WorldUp;
+    glm::vec3 Target;
+    float Distance;
+    float Pitch;    // tracked only to constrain mouse look
+    Camera_Mode Mode;
+    float Zoom;
+    float AspectRatio;
+    float NearPlane;
+    float FarPlane;
+
+    // input accumulated since the last Update()
+    unsigned int pendingMovement;
+    float pendingYaw;
+    float pendingPitch;
+    float pendingZoom;
+    bool pendingConstrainPitch;
+
+    // cached matrices
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    Frustum frustum;
+    bool viewDirty;
+    bool projectionDirty;
+    bool viewProjectionDirty;
+    unsigned int revision;
+
+    void init(glm::vec3 position, glm::vec3 up, float yaw, float pitch, float roll)
+    {
+        Position = position;
+        WorldUp = glm::normalize(up);
+        Target = glm::vec3(0.0f);
+        Distance = glm::max(glm::length(position), 0.1f);
+        Pitch = 0.0f;
+        Mode = FREE_FLY;
+        Zoom = ZOOM;
+        AspectRatio = 4.0f / 3.0f;
+        NearPlane = NEAR_PLANE;
+        FarPlane = FAR_PLANE;
+        pendingMovement = 0;
+        pendingYaw = pendingPitch = pendingZoom = 0.0f;
+        pendingConstrainPitch = true;
+        viewDirty = projectionDirty = viewProjectionDirty = true;
+        revision = 0;
+
+        // identity orientation looks down -Z, which is what the default yaw of -90 degrees means
+        Orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+        updateCameraVectors();
+        rotate(yaw - YAW, pitch, roll);
+    }
+
+    // yaw turns around the world up axis, pitch and roll around the camera's own right and front axes (all in degrees)
+    void rotate(float yawDelta, float pitchDelta, float rollDelta)
+    {
+        if (yawDelta == 0.0f && pitchDelta == 0.0f && rollDelta == 0.0f)
+            return;
+        glm::quat yaw = glm::angleAxis(glm::radians(-yawDelta), WorldUp);
+        glm::quat pitch = glm::angleAxis(glm::radians(pitchDelta), glm::vec3(1.0f, 0.0f, 0.0f));
+        glm::quat roll = glm::angleAxis(glm::radians(-rollDelta), glm::vec3(0.0f, 0.0f, 1.0f));
+        Orientation = glm::normalize(yaw * Orientation * pitch * roll);
+        Pitch += pitchDelta;
+        updateCameraVectors();
+    }
+
+    void faceTarget()
+    {
+        glm::vec3 direction = Target - Position;
+        if (glm::length(direction) < 1e-4f)
+            return;
+        direction = glm::normalize(direction);
+        // keep the up vector well defined when looking straight up or down
+        glm::vec3 up = fabs(glm::dot(direction, WorldUp)) > 0.999f ? Up : WorldUp;
+        Orientation = glm::normalize(glm::quatLookAt(direction, up));
+        updateCameraVectors();
+        Pitch = glm::degrees(asin(glm::clamp(Front.y, -1.0f, 1.0f)));
+    }
+
+    // derives the Front, Right and Up vectors from the orientation; no trigonometry involved
     void updateCameraVectors()
     {
-        // calculate the new Front vector
-        glm::vec3 front;
-        glm::mat4 rotationMatrix;
-        front.x = cos(glm::radians(Yaw)) * cos(glm::radians(Pitch));
-        front.y = sin(glm::radians(Pitch));
-        front.z = sin(glm::radians(Yaw)) * cos(glm::radians(Pitch));
-        Front = glm::normalize(front);
-        // also re-calculate the Right and Up vector
-        Right = glm::normalize(glm::cross(Front, WorldUp));  // normalize the vectors, because their length gets closer to 0 the more you look up or down which results in slower movement.
-        Up = glm::normalize(glm::cross(Right, Front));
-        if (Roll != 0.0f) {
-            rotationMatrix = glm::rotate(glm::mat4(1.0f), glm::radians(Roll), Front);
-            Up = glm::normalize(glm::vec3(rotationMatrix * glm::vec4(Up, 0.0f)));
-            Right = glm::normalize(glm::cross(Front, Up));
-        }
+        Front = Orientation * glm::vec3(0.0f, 0.0f, -1.0f);
+        Right = Orientation * glm::vec3(1.0f, 0.0f, 0.0f);
+        Up = Orientation * glm::vec3(0.0f, 1.0f, 0.0f);
     }
 };
 #endif
-#pragma once
@@ -0,0 +1,152 @@
+#ifndef camera_ubo_h
+#define camera_ubo_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "camera.h"
+#include "gpu_resources.h"
+
+#include <cstring>
+
+// binding point of the CameraBlock uniform block in every program
+const GLuint CAMERA_UBO_BINDING = 0;
+
+// std140 layout of CameraBlock in the shaders. Most declare only the members up to position; the reprojection of
+// taa.fs also needs the last two
+struct CameraBlockData
+{
+    glm::mat4 view;
+    glm::mat4 projection;       // jittered when setJitter() was given an offset
+    glm::mat4 viewProjection;
+    glm::vec4 position;
+    glm::mat4 inverseViewProjection;
+    glm::mat4 previousViewProjection;   // without jitter, of the frame latched before
+};
+
+// Per-frame camera uniforms in a persistently mapped ring of slots. Every frame latches its pose before its draws are
+// issued. Because the mapping is coherent, the matrices can then be written again after all draws have been issued and
+// just before the swap: the GPU reads them when it executes the draws, so the image uses the freshest pose instead of
+// the one sampled at the start of the frame. Draws the driver already started see the earlier latch of the same
+// frame, never a slot left over from SLOTS frames ago. Without GL 4.4 / ARB_buffer_storage the buffer falls back to
+// glBufferSubData, which must happen before the draws.
+class CameraUniformBuffer
+{
+public:
+    static const int SLOTS = 3;
+
+    void init()
+    {
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        slotSize = ((GLsizeiptr)sizeof(CameraBlockData) + alignment - 1) / alignment * alignment;
+        persistent = GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage;
+
+        buffer.create("camera", "camera block ring");
+        if (persistent)
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            buffer.storage(GL_UNIFORM_BUFFER, slotSize * SLOTS, NULL, flags);
+            mapped = (char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, slotSize * SLOTS, flags);
+            persistent = mapped != NULL;
+        }
+        if (!persistent)
+            buffer.data(GL_UNIFORM_BUFFER, slotSize * SLOTS, NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        for (int i = 0; i < SLOTS; i++)
+        {
+            fences[i] = 0;
+            slotRevision[i] = ~0u;
+        }
+    }
+
+    // true when latch() may be called after the draws of the frame have been issued
+    bool canLateLatch() const { return persistent; }
+
+    // picks this frame's slot, waiting for the GPU only if it is still reading it from SLOTS frames ago
+    void beginFrame()
+    {
+        slot = (slot + 1) % SLOTS;
+        if (fences[slot])
+        {
+            glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+            glDeleteSync(fences[slot]);
+            fences[slot] = 0;
+        }
+        glBindBufferRange(GL_UNIFORM_BUFFER, CAMERA_UBO_BINDING, buffer, slot * slotSize, sizeof(CameraBlockData));
+        previousViewProjection = latchedViewProjection;
+    }
+
+    // sub-pixel offset of the projection in NDC for the following latches, (0, 0) for none
+    void setJitter(const glm::vec2& offset)
+    {
+        jitter = offset;
+    }
+
+    // writes the camera matrices into the current slot unless it already holds this camera revision; with jitter
+    // every frame's matrices differ. May be called again in the same frame to overwrite the pose
+    void latch(Camera& camera)
+    {
+        if (slotRevision[slot] == camera.GetRevision() && jitter == glm::vec2(0.0f))
+            return;
+        slotRevision[slot] = jitter == glm::vec2(0.0f) ? camera.GetRevision() : ~0u;
+        CameraBlockData data;
+        data.view = camera.GetViewMatrix();
+        data.projection = camera.GetProjectionMatrix();
+        data.projection[2][0] += jitter.x;
+        data.projection[2][1] += jitter.y;
+        data.viewProjection = data.projection * data.view;
+        data.position = glm::vec4(camera.GetPosition(), 1.0f);
+        data.inverseViewProjection = glm::inverse(data.viewProjection);
+        data.previousViewProjection = previousViewProjection;
+        latchedViewProjection = camera.GetViewProjectionMatrix();
+        if (persistent)
+        {
+            memcpy(mapped + slot * slotSize, &data, sizeof(data));
+        }
+        else
+        {
+            glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+            glBufferSubData(GL_UNIFORM_BUFFER, slot * slotSize, sizeof(data), &data);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        }
+    }
+
+    // fences the slot so it is not overwritten while the GPU may still read it
+    void endFrame()
+    {
+        fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    void destroy()
+    {
+        for (int i = 0; i < SLOTS; i++)
+        {
+            if (fences[i])
+                glDeleteSync(fences[i]);
+            fences[i] = 0;
+        }
+        if (persistent)
+        {
+            glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        }
+        buffer.reset();
+    }
+
+private:
+    GpuBuffer buffer;
+    GLsizeiptr slotSize = 0;
+    char* mapped = NULL;
+    bool persistent = false;
+    int slot = 0;
+    GLsync fences[SLOTS];
+    unsigned int slotRevision[SLOTS];
+    glm::vec2 jitter = glm::vec2(0.0f);
+    glm::mat4 latchedViewProjection = glm::mat4(1.0f);
+    glm::mat4 previousViewProjection = glm::mat4(1.0f);     // the last latch of the frame before
+};
+
+#endif
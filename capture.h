@@ -0,0 +1,351 @@
+#ifndef capture_h
+#define capture_h
+
+#include <glad/glad.h>
+
+#include "gpu_resources.h"
+#include "image.h"
+#include "input.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CAPTURE_SSE2 1
+#else
+#define CAPTURE_SSE2 0
+#endif
+
+// BT.601 studio-range RGB -> YCbCr of rows of RGBA8 pixels, with SSE2 where available. Chroma is taken from the
+// average of each 2x2 block; both paths round identically, so the output does not depend on the instruction set.
+namespace yuv
+{
+    inline unsigned char luma(int r, int g, int b) { return (unsigned char)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16); }
+
+    // r, g, b are sums of two pixels
+    inline unsigned char chromaU(int r, int g, int b) { return (unsigned char)(((-38 * r - 74 * g + 112 * b + 256) >> 9) + 128); }
+    inline unsigned char chromaV(int r, int g, int b) { return (unsigned char)(((112 * r - 94 * g - 18 * b + 256) >> 9) + 128); }
+
+    inline void lumaRow(const unsigned char* rgba, unsigned char* y, int width)
+    {
+        int x = 0;
+#if CAPTURE_SSE2
+        const __m128i coefficients = _mm_setr_epi16(66, 129, 25, 0, 66, 129, 25, 0);
+        const __m128i bias = _mm_set1_epi32(128 + (16 << 8));
+        const __m128i zero = _mm_setzero_si128();
+        for (; x + 4 <= width; x += 4)
+        {
+            __m128i pixels = _mm_loadu_si128((const __m128i*)(rgba + x * 4));
+            // per pixel: 66r + 129g in one lane and 25b in the next, folded into the even lanes
+            __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), coefficients);
+            __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), coefficients);
+            lo = _mm_add_epi32(lo, _mm_srli_epi64(lo, 32));
+            hi = _mm_add_epi32(hi, _mm_srli_epi64(hi, 32));
+            __m128i sums = _mm_unpacklo_epi64(_mm_shuffle_epi32(lo, _MM_SHUFFLE(3, 3, 2, 0)), _mm_shuffle_epi32(hi, _MM_SHUFFLE(3, 3, 2, 0)));
+            sums = _mm_srai_epi32(_mm_add_epi32(sums, bias), 8);
+            __m128i packed = _mm_packus_epi16(_mm_packs_epi32(sums, sums), zero);
+            int four = _mm_cvtsi128_si32(packed);
+            memcpy(y + x, &four, 4);
+        }
+#endif
+        for (; x < width; x++)
+            y[x] = luma(rgba[x * 4], rgba[x * 4 + 1], rgba[x * 4 + 2]);
+    }
+
+    // one row of chroma from two rows of pixels; an odd last column is paired with itself
+    inline void chromaRow(const unsigned char* rgba0, const unsigned char* rgba1, unsigned char* u, unsigned char* v, int width)
+    {
+        int x = 0;
+#if CAPTURE_SSE2
+        const __m128i uCoefficients = _mm_setr_epi16(-38, -74, 112, 0, -38, -74, 112, 0);
+        const __m128i vCoefficients = _mm_setr_epi16(112, -94, -18, 0, 112, -94, -18, 0);
+        const __m128i bias = _mm_set1_epi32(256 + (128 << 9));
+        const __m128i zero = _mm_setzero_si128();
+        for (; x + 4 <= width; x += 4)
+        {
+            // vertical average with rounding, then the horizontal pairs summed: two chroma samples of 16-bit r, g, b, a
+            __m128i rows = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(rgba0 + x * 4)), _mm_loadu_si128((const __m128i*)(rgba1 + x * 4)));
+            __m128i lo = _mm_unpacklo_epi8(rows, zero);
+            __m128i hi = _mm_unpackhi_epi8(rows, zero);
+            __m128i pairs = _mm_unpacklo_epi64(_mm_add_epi16(lo, _mm_srli_si128(lo, 8)), _mm_add_epi16(hi, _mm_srli_si128(hi, 8)));
+            __m128i us = _mm_madd_epi16(pairs, uCoefficients);
+            __m128i vs = _mm_madd_epi16(pairs, vCoefficients);
+            us = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(us, _mm_srli_epi64(us, 32)), bias), 9);
+            vs = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(vs, _mm_srli_epi64(vs, 32)), bias), 9);
+            __m128i samples = _mm_unpacklo_epi64(_mm_shuffle_epi32(us, _MM_SHUFFLE(3, 3, 2, 0)), _mm_shuffle_epi32(vs, _MM_SHUFFLE(3, 3, 2, 0)));
+            __m128i packed = _mm_packus_epi16(_mm_packs_epi32(samples, samples), zero);
+            int four = _mm_cvtsi128_si32(packed);    // u0 u1 v0 v1
+            memcpy(u + x / 2, &four, 2);
+            memcpy(v + x / 2, (const char*)&four + 2, 2);
+        }
+#endif
+        for (; x < width; x += 2)
+        {
+            int x1 = std::min(x + 1, width - 1);
+            int sum[3];
+            for (int c = 0; c < 3; c++)
+                sum[c] = ((rgba0[x * 4 + c] + rgba1[x * 4 + c] + 1) >> 1) + ((rgba0[x1 * 4 + c] + rgba1[x1 * 4 + c] + 1) >> 1);
+            u[x / 2] = chromaU(sum[0], sum[1], sum[2]);
+            v[x / 2] = chromaV(sum[0], sum[1], sum[2]);
+        }
+    }
+}
+
+// Records the rendered frames without stalling the GPU. capture() starts an asynchronous glReadPixels into the next
+// pixel pack buffer of a ring and fences it; the buffer is mapped only once its fence has signalled, a few frames
+// later, and the pixels are handed to an encoder thread that writes a Y4M stream (4:2:0) or a PPM sequence. When every
+// buffer of the ring is still in flight the frame waits for the oldest readback, up to a second; a readback the
+// encoder has no room for, QUEUE_LIMIT frames behind, stays in the ring instead. A frame that still finds the ring full
+// is not captured: it is counted as dropped and missing from the output, rather than stalling the render thread.
+class FrameCapture
+{
+public:
+    static const int RING = 4;
+    static const int QUEUE_LIMIT = 8;
+
+    // a path ending in .y4m is one raw video stream, anything else the prefix of numbered PPM images
+    bool open(const std::string& path, int w, int h, int framesPerSecond)
+    {
+        width = w;
+        height = h;
+        frameBytes = (size_t)width * height * 4;
+        y4m = path.size() >= 4 && path.compare(path.size() - 4, 4, ".y4m") == 0;
+        prefix = path;
+        if (y4m)
+        {
+            out.open(path, std::ios::binary);
+            if (!out)
+            {
+                std::cout << "ERROR::CAPTURE:: cannot write " << path << std::endl;
+                return false;
+            }
+            // C420jpeg is the default chroma siting; the samples are studio range
+            out << "YUV4MPEG2 W" << width << " H" << height << " F" << framesPerSecond << ":1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n";
+        }
+        for (int i = 0; i < RING; i++)
+        {
+            pbo[i].create("capture", "readback");
+            pbo[i].data(GL_PIXEL_PACK_BUFFER, frameBytes, NULL, GL_STREAM_READ);
+            fences[i] = 0;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        running = true;
+        encoder = std::thread(&FrameCapture::encodeLoop, this);
+        return true;
+    }
+
+    bool isOpen() const { return running; }
+
+    // queues a readback of the colour buffer of framebuffer (0 for the window's back buffer) after the frame's draws
+    void capture(GLuint framebuffer)
+    {
+        if (!running)
+            return;
+        collect(false);
+        if (fences[head] && encoderHasRoom())
+        {
+            // the ring is full: wait for the oldest readback, which the next ones are queued behind anyway
+            stalls++;
+            collect(true);
+        }
+        if (fences[head])
+        {
+            dropped++;
+            return;
+        }
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        if (framebuffer == 0)
+            glReadBuffer(GL_BACK);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[head]);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        fences[head] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        head = (head + 1) % RING;
+        inFlight++;
+    }
+
+    // drains the ring and the encoder and closes the output
+    void close()
+    {
+        if (!running)
+            return;
+        while (inFlight > 0)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                drained.wait(lock, [this] { return queue.size() < QUEUE_LIMIT; });
+            }
+            collect(true);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        wake.notify_all();
+        encoder.join();
+        out.close();
+        for (int i = 0; i < RING; i++)
+            pbo[i].reset();
+    }
+
+    void report(std::ostream& out) const
+    {
+        out << std::fixed << std::setprecision(3) << "capture: " << written << " frames of " << width << "x" << height
+            << (y4m ? " to " : " as ") << prefix << (y4m ? "" : "_*.ppm") << ", " << stalls << " readback waits, "
+            << dropped << " frames dropped, " << (copied ? copyMs / copied : 0.0) << " ms mean copy out of the ring" << std::endl;
+    }
+
+private:
+    int width = 0;
+    int height = 0;
+    size_t frameBytes = 0;
+    bool y4m = false;
+    std::string prefix;
+    std::ofstream out;
+
+    GpuBuffer pbo[RING];
+    GLsync fences[RING];
+    int head = 0;       // next buffer to read into
+    int inFlight = 0;   // buffers with a pending readback, oldest at head - inFlight
+
+    std::thread encoder;
+    std::mutex mutex;
+    std::condition_variable wake;       // frames queued or the capture closed
+    std::condition_variable drained;    // the encoder took a frame
+    std::deque<std::vector<unsigned char>> queue;
+    std::vector<std::vector<unsigned char>> spare;
+    bool running = false;
+
+    unsigned int stalls = 0;
+    unsigned int dropped = 0;
+    unsigned int copied = 0;
+    double copyMs = 0.0;
+    unsigned int written = 0;
+
+    bool encoderHasRoom()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return queue.size() < QUEUE_LIMIT;
+    }
+
+    // moves finished readbacks to the encoder, oldest first, while it has room; with wait, blocks until the oldest one
+    // has finished or a second has passed
+    void collect(bool wait)
+    {
+        while (inFlight > 0 && encoderHasRoom())
+        {
+            int oldest = (head - inFlight + RING) % RING;
+            GLenum status = glClientWaitSync(fences[oldest], wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000ull : 0);
+            if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED)
+                return;
+            glDeleteSync(fences[oldest]);
+            fences[oldest] = 0;
+            inFlight--;
+            wait = false;
+
+            uint64_t start = inputClockNow();
+            std::vector<unsigned char> frame;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!spare.empty())
+                {
+                    frame.swap(spare.back());
+                    spare.pop_back();
+                }
+            }
+            frame.resize(frameBytes);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[oldest]);
+            const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameBytes, GL_MAP_READ_BIT);
+            if (pixels)
+                memcpy(frame.data(), pixels, frameBytes);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            copyMs += (double)(inputClockNow() - start) / 1.0e6;
+            copied++;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                queue.push_back(std::move(frame));
+            }
+            wake.notify_one();
+        }
+    }
+
+    void encodeLoop()
+    {
+        std::vector<unsigned char> planes((size_t)width * height + 2 * (size_t)((width + 1) / 2) * ((height + 1) / 2));
+        RgbImage image;
+        unsigned int index = 0;
+        for (;;)
+        {
+            std::vector<unsigned char> frame;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return !queue.empty() || !running; });
+                if (queue.empty())
+                    return;
+                frame.swap(queue.front());
+                queue.pop_front();
+            }
+            drained.notify_one();
+            if (y4m)
+                writeY4M(frame, planes);
+            else
+                writePPM(frame, image, index);
+            index++;
+            written++;
+            std::lock_guard<std::mutex> lock(mutex);
+            spare.push_back(std::move(frame));
+        }
+    }
+
+    // the rows come bottom first from OpenGL; the planes are written top first
+    void writeY4M(const std::vector<unsigned char>& rgba, std::vector<unsigned char>& planes)
+    {
+        int chromaWidth = (width + 1) / 2;
+        int chromaHeight = (height + 1) / 2;
+        unsigned char* yPlane = planes.data();
+        unsigned char* uPlane = yPlane + (size_t)width * height;
+        unsigned char* vPlane = uPlane + (size_t)chromaWidth * chromaHeight;
+        size_t stride = (size_t)width * 4;
+        for (int row = 0; row < height; row++)
+            yuv::lumaRow(&rgba[(height - 1 - row) * stride], yPlane + (size_t)row * width, width);
+        for (int row = 0; row < chromaHeight; row++)
+        {
+            int top = height - 1 - 2 * row;
+            int bottom = std::max(top - 1, 0);
+            yuv::chromaRow(&rgba[top * stride], &rgba[bottom * stride], uPlane + (size_t)row * chromaWidth, vPlane + (size_t)row * chromaWidth, width);
+        }
+        out << "FRAME\n";
+        out.write((const char*)planes.data(), planes.size());
+    }
+
+    void writePPM(const std::vector<unsigned char>& rgba, RgbImage& image, unsigned int index)
+    {
+        image.resize(width, height);
+        for (int row = 0; row < height; row++)
+        {
+            const unsigned char* source = &rgba[(size_t)(height - 1 - row) * width * 4];
+            for (int x = 0; x < width; x++)
+                memcpy(image.at(x, row), source + x * 4, 3);
+        }
+        char name[32];
+        snprintf(name, sizeof(name), "_%05u.ppm", index);
+        image.savePPM(prefix + name);
+    }
+};
+
+#endif
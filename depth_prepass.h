@@ -0,0 +1,235 @@
+#ifndef depth_prepass_h
+#define depth_prepass_h
+
+#include <glad/glad.h>
+
+#include "gpu_resources.h"
+#include "render_graph.h"
+#include "shader.h"
+#include "stats.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// image unit overdraw.fs counts fragments into
+const GLuint OVERDRAW_IMAGE_UNIT = 0;
+
+// Depth-only pre-pass. Between begin() and shade() the visible geometry is drawn with colour writes off to lay down
+// the final depth; the shading pass then runs with GL_EQUAL and depth writes off, so every pixel is shaded once.
+// vertexShader.vs declares gl_Position invariant, which makes the depths of both passes bit-identical.
+class DepthPrepass
+{
+public:
+    bool enabled = false;
+
+    void begin() const
+    {
+        if (!enabled)
+            return;
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    }
+
+    void shade() const
+    {
+        if (!enabled)
+            return;
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+    }
+
+    void end() const
+    {
+        if (!enabled)
+            return;
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+    }
+};
+
+// Per-pixel count of shaded fragments. The scene is drawn with overdraw.fs, which tests depth early and atomically
+// increments an r32ui image for every fragment that survives, then resolve() maps the counts to a heat map: black for
+// none, then blue, green, yellow and red at five or more. The counts are a transient texture of the render graph
+// (render_graph.h) with the size of the viewport.
+class OverdrawCounter
+{
+public:
+    void init()
+    {
+        clearFramebuffer.create("overdraw", "counter clear");
+        fullscreenVAO.create("overdraw", "fullscreen triangle");
+    }
+
+    // format and size of the counts for a viewport
+    static TransientTextureDesc countsDesc(int width, int height)
+    {
+        TransientTextureDesc desc = { GL_R32UI, width, height, 1 };
+        return desc;
+    }
+
+    // clears the counters and binds the image for overdraw.fs
+    void begin(GLuint counts)
+    {
+        GLint previousFramebuffer = 0;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, clearFramebuffer);
+        glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, counts, 0);
+        const GLuint zero[4] = { 0, 0, 0, 0 };
+        glClearBufferuiv(GL_COLOR, 0, zero);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousFramebuffer);
+        glBindImageTexture(OVERDRAW_IMAGE_UNIT, counts, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+    }
+
+    // draws the heat map over the whole viewport with the resolve program
+    void resolve(const Shader& resolveShader) const
+    {
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        resolveShader.use();
+        glDisable(GL_DEPTH_TEST);
+        glBindVertexArray(fullscreenVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    // mean shaded fragments per covered pixel and the maximum, read back synchronously
+    void measure(GLuint counts, int width, int height, double& mean, unsigned int& maximum) const
+    {
+        glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+        std::vector<GLuint> values((size_t)width * height);
+        glBindTexture(GL_TEXTURE_2D, counts);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, values.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+        size_t covered = 0;
+        double total = 0.0;
+        maximum = 0;
+        for (GLuint v : values)
+        {
+            if (v == 0)
+                continue;
+            covered++;
+            total += v;
+            maximum = std::max(maximum, (unsigned int)v);
+        }
+        mean = covered ? total / (double)covered : 0.0;
+    }
+
+    void destroy()
+    {
+        clearFramebuffer.reset();
+        fullscreenVAO.reset();
+    }
+
+private:
+    GpuFramebuffer clearFramebuffer;
+    GpuVertexArray fullscreenVAO;
+};
+
+// Decides whether the pre-pass pays off for the current scene and view: renders alternating frames with and without
+// it, times them with GL_TIME_ELAPSED queries read back without stalling, and recommends the pre-pass when its median
+// GPU frame time is lower by more than the noise margin. Only the normal single-view scene pass is timed, so a mode that
+// renders something else (multi-view, the overdraw heat map) ends the measurement as undecided, which keeps it off.
+class PrepassAdvisor
+{
+public:
+    static const int SAMPLES = 60;          // per mode
+    static constexpr double MARGIN = 0.03;  // the pre-pass must win by 3% to be worth its extra draw calls
+
+    void init()
+    {
+        for (GpuQuery& query : queries)
+            query.create("prepass", "a/b frame time");
+    }
+
+    void start()
+    {
+        running = true;
+        undecidedMode = nullptr;
+        frame = 0;
+        resolved = 0;
+        withPrepass.clear();
+        withoutPrepass.clear();
+    }
+
+    bool active() const { return running; }
+
+    // stops a measurement that cannot finish because the frames are rendered in mode
+    void abandon(const char* mode)
+    {
+        running = false;
+        undecidedMode = mode;
+    }
+
+    // the mode to render the current frame with while evaluating
+    bool frameUsesPrepass() const { return frame % 2 == 1; }
+
+    void gpuBegin()
+    {
+        queryUsesPrepass[frame % QUERIES] = frameUsesPrepass();
+        glBeginQuery(GL_TIME_ELAPSED, queries[frame % QUERIES]);
+    }
+
+    void gpuEnd()
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        frame++;
+    }
+
+    // collects finished queries; returns true once, when both modes have enough samples
+    bool endFrame()
+    {
+        while (resolved < frame)
+        {
+            GLuint query = queries[resolved % QUERIES];
+            GLint available = 0;
+            glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+            // never let the ring wrap over unread queries
+            if (!available && frame - resolved < QUERIES)
+                break;
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+            (queryUsesPrepass[resolved % QUERIES] ? withPrepass : withoutPrepass).add((double)elapsed / 1.0e6);
+            resolved++;
+        }
+        if (withPrepass.count() < SAMPLES || withoutPrepass.count() < SAMPLES)
+            return false;
+        running = false;
+        return true;
+    }
+
+    bool recommendsPrepass() { return !undecidedMode && withPrepass.percentile(50.0) < withoutPrepass.percentile(50.0) * (1.0 - MARGIN); }
+
+    void report(std::ostream& out)
+    {
+        if (undecidedMode)
+        {
+            out << "depth pre-pass: undecided (" << undecidedMode << " is not measured) -> disabled, F9 measures again"
+                << std::endl;
+            return;
+        }
+        out << std::fixed << std::setprecision(3) << "depth pre-pass: gpu median " << withPrepass.percentile(50.0)
+            << " ms with, " << withoutPrepass.percentile(50.0) << " ms without -> "
+            << (recommendsPrepass() ? "enabled" : "disabled") << " for this scene" << std::endl;
+    }
+
+    void destroy()
+    {
+        for (GpuQuery& query : queries)
+            query.reset();
+    }
+
+private:
+    static const int QUERIES = 8;
+
+    GpuQuery queries[QUERIES];
+    bool queryUsesPrepass[QUERIES] = {};
+    bool running = false;
+    const char* undecidedMode = nullptr;
+    unsigned int frame = 0;
+    unsigned int resolved = 0;
+    SampleSeries withPrepass;
+    SampleSeries withoutPrepass;
+};
+
+#endif
@@ -0,0 +1,234 @@
+#ifndef dynamic_resolution_h
+#define dynamic_resolution_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "gpu_resources.h"
+#include "render_graph.h"
+#include "shader.h"
+#include "stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// texture unit of upscale.fs, clear of the shadow maps and the anti-aliasing inputs
+const GLuint UPSCALE_TEXTURE_UNIT = 4;
+
+// Renders the scene at a fraction of the output resolution that follows the GPU frame time. Every frame's GPU work is
+// bracketed with a GL_TIME_ELAPSED query read back without stalling; once ADJUST_FRAMES frames at the current scale
+// have been measured, their median is compared with the target and, outside the hysteresis band, the scale moves by
+// the square root of the ratio since the cost is roughly proportional to the pixel count. Growth is capped per step
+// so a cheap view does not overshoot, and scales are quantized so the sizes repeat.
+// The scene is drawn into the lower left part of a target allocated once for the largest scale, so a change of scale
+// costs nothing, and the "upscale" pass stretches that part over the output with a bilinear tap and a clamped unsharp
+// mask (upscale.fs) that restores some of the contrast the lower resolution lost.
+class DynamicResolution
+{
+public:
+    // targetMs 0 disables the scaling; scales are per axis
+    void init(float targetMs, float minScale, float maxScale, float hysteresis, float sharpness)
+    {
+        frameTargetMs = targetMs;
+        lowest = glm::clamp(minScale, 0.25f, 1.0f);
+        highest = glm::clamp(maxScale, lowest, 2.0f);
+        band = glm::clamp(hysteresis, 0.0f, 0.5f);
+        sharpen = glm::clamp(sharpness, 0.0f, 1.0f);
+        scale = quantize(glm::clamp(1.0f, lowest, highest));
+        if (!enabled())
+            return;
+        for (GpuQuery& query : queries)
+            query.create("dynamic resolution", "frame time");
+        framebuffer.create("dynamic resolution", "scaled frame");
+        fullscreenVAO.create("dynamic resolution", "fullscreen triangle");
+    }
+
+    bool enabled() const { return frameTargetMs > 0.0f; }
+
+    // adjusts the scale from the measured frames and sizes the target for an output of this size
+    void beginFrame(int outputWidth, int outputHeight)
+    {
+        collectGpuTimes();
+        adjust();
+        int capacityWidth = std::max(1, (int)std::ceil(outputWidth * highest));
+        int capacityHeight = std::max(1, (int)std::ceil(outputHeight * highest));
+        if (capacityWidth != targetWidth || capacityHeight != targetHeight)
+        {
+            targetWidth = capacityWidth;
+            targetHeight = capacityHeight;
+            color.create("dynamic resolution", "scaled colour");
+            glBindTexture(GL_TEXTURE_2D, color);
+            glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, targetWidth, targetHeight);
+            color.setBytes((size_t)targetWidth * targetHeight * 4);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            depth.create("dynamic resolution", "scaled depth");
+            glBindRenderbuffer(GL_RENDERBUFFER, depth);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, targetWidth, targetHeight);
+            depth.setBytes((size_t)targetWidth * targetHeight * 4);
+            glBindRenderbuffer(GL_RENDERBUFFER, 0);
+            GLint previousFramebuffer = 0;
+            glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, color, 0);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                std::cout << "ERROR::DYNAMIC_RESOLUTION:: scaled target " << targetWidth << "x" << targetHeight << " is not complete" << std::endl;
+            glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+        }
+        sceneWidth = std::max(1, std::min(targetWidth, (int)std::lround(outputWidth * scale)));
+        sceneHeight = std::max(1, std::min(targetHeight, (int)std::lround(outputHeight * scale)));
+        frames++;
+        scaleSum += scale;
+    }
+
+    // size of this frame's scene, drawn into the lower left of scaledFramebuffer()
+    int width() const { return sceneWidth; }
+    int height() const { return sceneHeight; }
+    GLuint scaledFramebuffer() const { return framebuffer; }
+    float currentScale() const { return scale; }
+
+    // declares the pass that stretches the scaled frame over the output framebuffer of the given size
+    void declare(RenderGraph& graph, RenderResource scaledFrame, RenderResource outputResource, GLuint outputFramebuffer, int outputWidth, int outputHeight, const Shader& upscaleShader)
+    {
+        graph.addPass("upscale", [this, outputFramebuffer, outputWidth, outputHeight, &upscaleShader] {
+            glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+            glViewport(0, 0, outputWidth, outputHeight);
+            upscaleShader.use();
+            glActiveTexture(GL_TEXTURE0 + UPSCALE_TEXTURE_UNIT);
+            glBindTexture(GL_TEXTURE_2D, color);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            upscaleShader.setInt("frame", (int)UPSCALE_TEXTURE_UNIT);
+            upscaleShader.setVec2("uvScale", (float)sceneWidth / targetWidth, (float)sceneHeight / targetHeight);
+            upscaleShader.setVec2("texelSize", 1.0f / targetWidth, 1.0f / targetHeight);
+            upscaleShader.setFloat("sharpness", sharpen);
+            glDisable(GL_DEPTH_TEST);
+            glBindVertexArray(fullscreenVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glEnable(GL_DEPTH_TEST);
+        }).readsFinal(scaledFrame).writes(outputResource);
+    }
+
+    // bracket the frame's GPU work; frames that are not bracketed keep the scale, e.g. while another
+    // GL_TIME_ELAPSED query is active
+    void gpuBegin()
+    {
+        // the ring is full of unread queries: skip this frame rather than wait for the GPU
+        if (issued - resolved >= QUERY_FRAMES)
+            return;
+        glBeginQuery(GL_TIME_ELAPSED, queries[issued % QUERY_FRAMES]);
+        queryScale[issued % QUERY_FRAMES] = scale;
+        measuring = true;
+    }
+
+    void gpuEnd()
+    {
+        if (!measuring)
+            return;
+        glEndQuery(GL_TIME_ELAPSED);
+        issued++;
+        measuring = false;
+    }
+
+    void report(std::ostream& out)
+    {
+        if (!enabled())
+            return;
+        out << std::fixed << std::setprecision(3) << "dynamic resolution: target " << frameTargetMs << " ms, scale "
+            << lowest << " to " << highest << " (mean " << (frames ? scaleSum / frames : scale) << ", last " << scale
+            << "), " << changes << " changes, " << overTarget << " of " << gpuMs.count() << " measured frames over target" << std::endl;
+        gpuMs.report(out, "scaled frame gpu");
+    }
+
+    void destroy()
+    {
+        for (GpuQuery& query : queries)
+            query.reset();
+        framebuffer.reset();
+        color.reset();
+        depth.reset();
+        fullscreenVAO.reset();
+        targetWidth = targetHeight = 0;
+    }
+
+private:
+    static const int QUERY_FRAMES = 8;
+    static const size_t ADJUST_FRAMES = 8;
+    // per axis: the largest step up, and the grid scales are rounded to
+    constexpr static float MAX_GROWTH = 1.1f;
+    constexpr static float SCALE_STEP = 1.0f / 32.0f;
+
+    float frameTargetMs = 0.0f;
+    float lowest = 1.0f;
+    float highest = 1.0f;
+    float band = 0.1f;
+    float sharpen = 0.0f;
+    float scale = 1.0f;
+    GpuQuery queries[QUERY_FRAMES];
+    float queryScale[QUERY_FRAMES] = {};
+    unsigned long long issued = 0;
+    unsigned long long resolved = 0;
+    bool measuring = false;
+    std::vector<double> window;     // GPU times measured at the current scale since it was set
+    GpuFramebuffer framebuffer;
+    GpuTexture color;
+    GpuRenderbuffer depth;
+    GpuVertexArray fullscreenVAO;
+    int targetWidth = 0;
+    int targetHeight = 0;
+    int sceneWidth = 0;
+    int sceneHeight = 0;
+    SampleSeries gpuMs;
+    unsigned long long frames = 0;
+    unsigned long long changes = 0;
+    unsigned long long overTarget = 0;
+    double scaleSum = 0.0;
+
+    static float quantize(float s) { return std::round(s / SCALE_STEP) * SCALE_STEP; }
+
+    void collectGpuTimes()
+    {
+        while (resolved < issued)
+        {
+            GLuint query = queries[resolved % QUERY_FRAMES];
+            GLint available = 0;
+            glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                return;
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+            double ms = (double)elapsed / 1.0e6;
+            gpuMs.add(ms);
+            overTarget += ms > frameTargetMs ? 1 : 0;
+            // frames still in flight when the scale changed say nothing about the new one
+            if (queryScale[resolved % QUERY_FRAMES] == scale)
+                window.push_back(ms);
+            resolved++;
+        }
+    }
+
+    void adjust()
+    {
+        if (window.size() < ADJUST_FRAMES)
+            return;
+        std::nth_element(window.begin(), window.begin() + window.size() / 2, window.end());
+        double median = window[window.size() / 2];
+        window.clear();
+        if (median <= frameTargetMs * (1.0 + band) && median >= frameTargetMs * (1.0 - band))
+            return;
+        float next = scale * (float)std::sqrt(frameTargetMs / std::max(median, 1.0e-3));
+        next = quantize(glm::clamp(std::min(next, scale * MAX_GROWTH), lowest, highest));
+        if (next != scale)
+        {
+            scale = next;
+            changes++;
+        }
+    }
+};
+
+#endif
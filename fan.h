@@ -2,6 +2,10 @@
 #define fan_h
 
 #include "shader.h"
+#include "materials.h"
+#include "gpu_driven.h"
+#include "scene.h"
+#include "frame_arena.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -13,7 +17,8 @@
 class Fan {
 
 public:
-	std::vector<glm::mat4> modelMatrices;
+	// scratch of blades(); in the frame arena when built during a frame
+	FrameVector<glm::mat4> modelMatrices;
 	float tox, toy, toz;
 	Fan(float x = 0, float y = 0, float z = 0) {
 		tox = x;
@@ -35,8 +40,10 @@ public:
 		return model;
 	}
 
-	Shader local_rotation(Shader ourShader, unsigned int VAOF3,  float angle = 0) {
+	// the four blades at rest in modelMatrices, and the point on the fan axis they turn around
+	glm::vec3 blades() {
 		glm::mat4 model;
+		modelMatrices.clear();
 		float rotateAngle_X = 0;
 		float rotateAngle_Y = 0;
 		float rotateAngle_Z = 0;
@@ -51,13 +58,18 @@ public:
 		model = transforamtion(2.125, 2.35, -5.625, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -2, .05, -.5);
 		modelMatrices.push_back(model);
 
-		unsigned int vertex_array[] = { VAOF3, VAOF3, VAOF3, VAOF3 };
 		glm::vec3 averagePosition(0.0f);
 		for (const glm::mat4& model : modelMatrices) {
 			averagePosition += glm::vec3(model[3]);
 		}
 		
 		averagePosition /= modelMatrices.size();
+		return averagePosition;
+	}
+
+	// appends the four blades rotated by angle degrees around the fan axis
+	void local_rotation(DrawList& list, unsigned int boxVAO, float angle = 0) {
+		glm::vec3 averagePosition = blades();
 
 		glm::mat4 moveToOrigin = glm::translate(glm::mat4(1.0f), -averagePosition);
 
@@ -67,49 +79,21 @@ public:
 
 		glm::mat4 groupTransform = moveToOriginalPosition * rotation * moveToOrigin;
 
-		int i = 0;
 		for (glm::mat4& model : modelMatrices) {
 
 			model = groupTransform * model;
-			ourShader.setMat4("model", model);
-			glBindVertexArray(vertex_array[i]);
-			glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-			i++;
+			list.add(boxVAO, MATERIAL_FAN_BLADE, model);
 		}
-		return ourShader;
 	}
 
-	Shader ret_shader(Shader ourShader, unsigned int VAOF2, unsigned int VAOF3) {
-		glm::mat4 model;
-		float rotateAngle_X = 0;
-		float rotateAngle_Y = 0;
-		float rotateAngle_Z = 0;
-
-		//model = transforamtion(2.125, 2.25, -5.875, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, .5, .75, .5);
-		//ourShader.setMat4("model", model);
-		//glBindVertexArray(VAOF2);
-		//glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-		model = transforamtion(2.125, 2.35, -5.625, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, .5, .05, 2);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAOF3);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-		model = transforamtion(2.375, 2.35, -5.875, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -.5, .05, -2);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAOF3);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-		model = transforamtion(2.375, 2.35, -5.875, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 2, .05, .5);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAOF3);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-		model = transforamtion(2.125, 2.35, -5.625, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -2, .05, -.5);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAOF3);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-		return ourShader;
+	// Bakes the blades around their axis for RigidAnimation and returns the axis point, the part's pivot: the
+	// vertex shader turns them, so nothing is rebuilt per frame
+	glm::vec3 bake(MeshBuilder& mesh, const float* boxVertices, const GLuint* boxIndices) {
+		glm::vec3 pivot = blades();
+		glm::mat4 moveToOrigin = glm::translate(glm::mat4(1.0f), -pivot);
+		for (const glm::mat4& model : modelMatrices)
+			mesh.addBox(boxVertices, boxIndices, moveToOrigin * model, MATERIAL_FAN_BLADE);
+		return pivot;
 	}
 };
 
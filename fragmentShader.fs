@@ -1,9 +1,155 @@
-#version 330 core
-in vec4 color;
+#version 430 core
+// matched by location, see vertexShader.vs and multiview.gs
+layout (location = 0) flat in uint material;
+layout (location = 1) in vec3 worldPos;
+layout (location = 2) in vec3 normal;
+layout (location = 3) flat in uint occlusionFace;
+layout (location = 4) in vec2 occlusionUV;
 
 out vec4 FragColor;
 
+layout (std140) uniform CameraBlock
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+};
+
+// see GpuLight in lighting.h
+struct Light
+{
+    vec4 positionRange;
+    vec4 colorCosInner;
+    vec4 directionCosOuter;
+    vec4 shadow;
+};
+
+layout (std430, binding = 1) readonly buffer LightBuffer
+{
+    Light lights[];
+};
+
+// offset into lightIndices and light count of every froxel
+layout (std430, binding = 2) readonly buffer ClusterBuffer
+{
+    uvec2 clusters[];
+};
+
+layout (std430, binding = 3) readonly buffer LightIndexBuffer
+{
+    uint lightIndices[];
+};
+
+// see GpuMaterial in materials.h
+struct Material
+{
+    vec4 baseColor;
+    vec4 surface;   // x: roughness, y: specular strength
+};
+
+layout (std430, binding = 8) readonly buffer MaterialBuffer
+{
+    Material materials[];
+};
+
+// baked ambient occlusion, see BakedOcclusion in ambient_occlusion.h: per box six face sizes, then one byte per texel
+layout (std430, binding = 10) readonly buffer OcclusionBuffer
+{
+    uint occlusionWords[];
+};
+
+uniform ivec3 clusterCount;
+uniform vec2 clusterDepth;      // near and far plane of the clustered frustum
+uniform mat4 clusterView;       // camera the lights were assigned with, which may differ from the latched one
+uniform mat4 clusterProjection;
+uniform vec3 ambientLight;
+
+// see shadows.h; must match MAX_SHADOW_LIGHTS
+uniform sampler2DArrayShadow shadowMaps;
+uniform mat4 shadowMatrices[4];
+
+// fraction of the light reaching position, with 2x2 PCF from the hardware comparison
+float shadowFactor(int layer, vec3 position, vec3 N)
+{
+    if (layer < 0)
+        return 1.0f;
+    // offset along the normal against acne on surfaces at grazing angles
+    vec4 p = shadowMatrices[layer] * vec4(position + N * 0.02f, 1.0f);
+    p.xyz = p.xyz / p.w * 0.5f + 0.5f;
+    if (p.z > 1.0f || any(lessThan(p.xy, vec2(0.0f))) || any(greaterThan(p.xy, vec2(1.0f))))
+        return 1.0f;
+    return texture(shadowMaps, vec4(p.xy, float(layer), p.z));
+}
+
+float occlusionTexel(uint byteIndex)
+{
+    return float((occlusionWords[byteIndex >> 2] >> ((byteIndex & 3u) * 8u)) & 0xffu) / 255.0f;
+}
+
+// bilinear lookup in the texel grid of the face, 1 without baked occlusion
+float bakedOcclusion()
+{
+    if (occlusionFace == 0u)
+        return 1.0f;
+    uint record = (occlusionFace >> 3) - 1u;
+    uint face = occlusionFace & 7u;
+    uint first = (record + 6u) * 4u;
+    for (uint f = 0u; f < face; f++)
+        first += (occlusionWords[record + f] & 0xffffu) * (occlusionWords[record + f] >> 16);
+    uint packedSize = occlusionWords[record + face];
+    ivec2 size = ivec2(packedSize & 0xffffu, packedSize >> 16);
+    vec2 p = clamp(occlusionUV * vec2(size) - 0.5f, vec2(0.0f), vec2(size - 1));
+    ivec2 a = ivec2(p);
+    ivec2 b = min(a + 1, size - 1);
+    vec2 t = p - vec2(a);
+    float bottom = mix(occlusionTexel(first + uint(a.y * size.x + a.x)), occlusionTexel(first + uint(a.y * size.x + b.x)), t.x);
+    float top = mix(occlusionTexel(first + uint(b.y * size.x + a.x)), occlusionTexel(first + uint(b.y * size.x + b.x)), t.x);
+    return mix(bottom, top, t.y);
+}
+
+uint clusterIndex(vec3 position)
+{
+    vec4 viewPos = clusterView * vec4(position, 1.0f);
+    vec4 clip = clusterProjection * viewPos;
+    ivec2 tile = clamp(ivec2((clip.xy / clip.w * 0.5f + 0.5f) * vec2(clusterCount.xy)), ivec2(0), clusterCount.xy - 1);
+    float depth = max(-viewPos.z, clusterDepth.x);
+    int slice = int(log(depth / clusterDepth.x) / log(clusterDepth.y / clusterDepth.x) * float(clusterCount.z));
+    slice = clamp(slice, 0, clusterCount.z - 1);
+    return uint(tile.x + clusterCount.x * (tile.y + clusterCount.y * slice));
+}
+
 void main()
 {
-    FragColor = color;
+    vec3 N = normalize(normal);
+    vec3 V = normalize(cameraPosition.xyz - worldPos);
+    Material surface = materials[material];
+    vec3 albedo = surface.baseColor.rgb;
+    // Blinn-Phong exponent with roughly the highlight width of a GGX lobe of this roughness
+    float roughness4 = pow(max(surface.surface.x, 0.05f), 4.0f);
+    float shininess = 2.0f / roughness4 - 2.0f;
+    vec3 lit = ambientLight * albedo * bakedOcclusion();
+
+    uvec2 cluster = clusters[clusterIndex(worldPos)];
+    for (uint i = 0u; i < cluster.y; i++)
+    {
+        Light light = lights[lightIndices[cluster.x + i]];
+        vec3 L = light.positionRange.xyz - worldPos;
+        float lightDistance = length(L);
+        float range = light.positionRange.w;
+        if (lightDistance >= range)
+            continue;
+        L /= lightDistance;
+
+        // inverse square falloff windowed to reach zero at the range
+        float window = clamp(1.0f - pow(lightDistance / range, 4.0f), 0.0f, 1.0f);
+        float attenuation = window * window / (lightDistance * lightDistance + 1.0f);
+        float cone = smoothstep(light.directionCosOuter.w, light.colorCosInner.w, dot(-L, light.directionCosOuter.xyz));
+
+        float diffuse = max(dot(N, L), 0.0f);
+        float specular = diffuse > 0.0f ? pow(max(dot(N, normalize(L + V)), 0.0f), shininess) * surface.surface.y : 0.0f;
+        float shadow = cone > 0.0f ? shadowFactor(int(light.shadow.x), worldPos, N) : 0.0f;
+        lit += light.colorCosInner.rgb * (albedo * diffuse + specular) * attenuation * cone * shadow;
+    }
+    FragColor = vec4(lit, surface.baseColor.a);
 }
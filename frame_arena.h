@@ -0,0 +1,207 @@
+#ifndef frame_arena_h
+#define frame_arena_h
+
+#include "stats.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// every operator new of the process, counted by the replacement in main.cpp; it stays 0 unless the build defines
+// COUNT_HEAP_ALLOCATIONS
+inline std::atomic<uint64_t>& heapAllocations()
+{
+    static std::atomic<uint64_t> count(0);
+    return count;
+}
+
+// Bump allocator for data that lives one frame: draw lists, render graph passes and the like. It has two halves and
+// beginFrame() switches between them, resetting the one the frame before the last used, so what a frame allocates
+// stays valid until the end of the frame after it. Allocation is a pointer bump and freeing is a no-op. A frame that
+// outgrows its half takes the rest from the heap, and the half grows to what that frame needed when it is next reset,
+// so the steady state allocates nothing from the heap. Only the render thread allocates from it, after init(); see
+// FrameAllocator.
+class FrameArena
+{
+public:
+    void init(size_t bytesPerFrame)
+    {
+        for (Half& half : halves)
+            grow(half, bytesPerFrame);
+        owner = std::this_thread::get_id();
+        active = true;
+        heapMark = heapAllocations().load(std::memory_order_relaxed);
+    }
+
+    bool ownedByThisThread() const { return active && std::this_thread::get_id() == owner; }
+
+    void beginFrame()
+    {
+        uint64_t heap = heapAllocations().load(std::memory_order_relaxed);
+        if (frames > 0)
+        {
+            heapPerFrame.add((double)(heap - heapMark));
+            if (heap != heapMark)
+            {
+                allocatingFrames++;
+                lastAllocatingFrame = frames;
+            }
+        }
+        current ^= 1;
+        Half& half = halves[current];
+        size_t needed = half.used + half.overflowBytes;
+        for (void* block : half.overflow)
+            std::free(block);
+        half.overflow.clear();
+        if (needed > half.capacity)
+            grow(half, needed + needed / 2);
+        half.used = 0;
+        half.overflowBytes = 0;
+        frames++;
+        // what the bookkeeping above allocated is not the frame's
+        heapMark = heapAllocations().load(std::memory_order_relaxed);
+    }
+
+    // alignment up to alignof(std::max_align_t)
+    void* allocate(size_t bytes, size_t alignment)
+    {
+        Half& half = halves[current];
+        size_t offset = (half.used + alignment - 1) & ~(alignment - 1);
+        if (offset + bytes <= half.capacity)
+        {
+            half.used = offset + bytes;
+            peakBytes = std::max(peakBytes, half.used + half.overflowBytes);
+            return half.memory + offset;
+        }
+        void* block = std::malloc(bytes ? bytes : 1);
+        if (!block)
+            throw std::bad_alloc();
+        half.overflow.push_back(block);
+        half.overflowBytes += bytes;
+        peakBytes = std::max(peakBytes, half.used + half.overflowBytes);
+        overflowAllocations++;
+        return block;
+    }
+
+    void report(std::ostream& out)
+    {
+        if (!active)
+            return;
+        out << std::fixed << std::setprecision(1) << "frame arena: " << frames << " frames, peak " << peakBytes / 1024.0
+            << " KiB of " << std::max(halves[0].capacity, halves[1].capacity) / 1024.0 << " KiB per frame, "
+            << overflowAllocations << " allocations overflowed to the heap" << std::endl;
+#ifdef COUNT_HEAP_ALLOCATIONS
+        // loading and the first use of each feature allocate; the frames after the last one that did are the steady state
+        heapPerFrame.report(out, "heap allocations per frame", "");
+        out << allocatingFrames << " frames allocated from the heap, the last was frame " << lastAllocatingFrame << std::endl;
+#endif
+    }
+
+    void destroy()
+    {
+        for (Half& half : halves)
+        {
+            for (void* block : half.overflow)
+                std::free(block);
+            half.overflow.clear();
+            std::free(half.memory);
+            half = Half();
+        }
+        active = false;
+    }
+
+private:
+    struct Half
+    {
+        char* memory = NULL;
+        size_t capacity = 0;
+        size_t used = 0;
+        std::vector<void*> overflow;
+        size_t overflowBytes = 0;
+    };
+
+    Half halves[2];
+    int current = 0;
+    std::thread::id owner;
+    bool active = false;
+    unsigned long long frames = 0;
+    unsigned long long overflowAllocations = 0;
+    size_t peakBytes = 0;
+    uint64_t heapMark = 0;
+    SampleSeries heapPerFrame;
+    unsigned long long allocatingFrames = 0;
+    unsigned long long lastAllocatingFrame = 0;
+
+    static void grow(Half& half, size_t bytes)
+    {
+        std::free(half.memory);
+        half.memory = (char*)std::malloc(bytes);
+        half.capacity = half.memory ? bytes : 0;
+    }
+};
+
+inline FrameArena& frameArena()
+{
+    static FrameArena arena;
+    return arena;
+}
+
+// STL allocator over the frame arena, for containers that are rebuilt every frame. It takes the arena when it is
+// created on the render thread after FrameArena::init() and the heap anywhere else, e.g. on the streaming workers, so
+// the same types work in both. A container holding arena memory must not outlive the frame after the one it was
+// filled in, and clearing it is not enough to keep it: its capacity would point into reused memory.
+template <typename T>
+class FrameAllocator
+{
+public:
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    FrameAllocator() : arena(frameArena().ownedByThisThread() ? &frameArena() : NULL) {}
+
+    template <typename U>
+    FrameAllocator(const FrameAllocator<U>& other) : arena(other.arena) {}
+
+    // a copied container allocates where its copy is made
+    FrameAllocator select_on_container_copy_construction() const { return FrameAllocator(); }
+
+    T* allocate(size_t n)
+    {
+        if (arena)
+            return (T*)arena->allocate(n * sizeof(T), alignof(T));
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* memory, size_t n)
+    {
+        if (!arena)
+            std::allocator<T>().deallocate(memory, n);
+    }
+
+    template <typename U>
+    bool operator==(const FrameAllocator<U>& other) const { return arena == other.arena; }
+
+    template <typename U>
+    bool operator!=(const FrameAllocator<U>& other) const { return arena != other.arena; }
+
+private:
+    template <typename U>
+    friend class FrameAllocator;
+
+    FrameArena* arena;  // NULL for the heap
+};
+
+template <typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+#endif
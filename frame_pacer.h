@@ -0,0 +1,230 @@
+#ifndef frame_pacer_h
+#define frame_pacer_h
+
+#include <glad/glad.h>
+
+#include "gpu_resources.h"
+#include "input.h"
+#include "stats.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+
+// Delays the start of CPU work so that a frame finishes just before the next vsync instead of right after the
+// previous one. The frame cost is predicted from recent CPU submit times and GPU times measured with GL_TIMESTAMP queries; a
+// missed vsync grows the safety margin, which then decays slowly while frames land on time. Vsyncs are estimated from
+// the swap timestamps, and nothing waits for the GPU: a fence per frame is only polled, a frame or more later, to see
+// how far behind it runs, so CPU and GPU keep overlapping.
+class FramePacer
+{
+public:
+    bool enabled = true;
+
+    void init(double refreshRateHz)
+    {
+        refreshInterval = (uint64_t)(1.0e9 / (refreshRateHz > 0.0 ? refreshRateHz : 60.0));
+        for (GpuQuery& query : queries)
+            query.create("pacing", "frame timestamp");
+        lastSwap = inputClockNow();
+    }
+
+    // sleeps until the predicted start of the next frame
+    void waitForFrameStart()
+    {
+        uint64_t now = inputClockNow();
+        if (enabled && vsync != 0)
+        {
+            uint64_t predicted = predictedFrameCost() + safetyMargin;
+            uint64_t start = vsync + refreshInterval;
+            start = predicted < start ? start - predicted : 0;
+            if (start > now)
+            {
+                // sleep coarsely, then yield-spin the last stretch since OS sleeps overshoot
+                if (start - now > 2000000ull)
+                    std::this_thread::sleep_for(std::chrono::nanoseconds(start - now - 1500000ull));
+                while (inputClockNow() < start)
+                    std::this_thread::yield();
+                waitMs.add((double)(inputClockNow() - now) / 1.0e6);
+                now = inputClockNow();
+            }
+        }
+        frameStart = now;
+    }
+
+    // brackets the GL work of the frame with timestamp queries
+    void gpuBegin()
+    {
+        glQueryCounter(queries[(frame % QUERY_FRAMES) * 2], GL_TIMESTAMP);
+    }
+
+    void gpuEnd()
+    {
+        glQueryCounter(queries[(frame % QUERY_FRAMES) * 2 + 1], GL_TIMESTAMP);
+        cpuCost[frame % HISTORY] = inputClockNow() - frameStart;
+    }
+
+    // call right after glfwSwapBuffers; places the swap on the vsync grid the next frame is scheduled against
+    void frameSwapped()
+    {
+        uint64_t now = inputClockNow();
+
+        if (advanceVsync(now) > 1)
+        {
+            missedFrames++;
+            safetyMargin = std::min<uint64_t>(safetyMargin + 1000000ull, refreshInterval / 2);
+        }
+        else if (safetyMargin > MIN_SAFETY_MARGIN)
+        {
+            safetyMargin -= (safetyMargin - MIN_SAFETY_MARGIN) / 100;
+        }
+        frameIntervalMs.add((double)(now - lastSwap) / 1.0e6);
+        lastSwap = now;
+
+        pollFences();
+        if (enabled)
+        {
+            queuedFrames.add((double)(fencesIssued - fencesResolved));
+            if (fencesIssued - fencesResolved < (uint64_t)FENCE_FRAMES)
+                fences[fencesIssued++ % FENCE_FRAMES] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+
+        collectGpuTimes();
+        frame++;
+    }
+
+    void report(std::ostream& out)
+    {
+        out << "frame pacing " << (enabled ? "on" : "off") << ", missed vsyncs: " << missedFrames << std::endl;
+        frameIntervalMs.report(out, "frame interval");
+        gpuMs.report(out, "gpu frame time");
+        waitMs.report(out, "pacing wait");
+        queuedFrames.report(out, "frames the gpu was behind", "");
+    }
+
+    // calls visit(ms) with every GPU frame time read back since the last call or reset(), whether or not pacing is
+    // enabled; call it every frame, since only the last HISTORY are kept
+    template <typename Visit>
+    void visitNewGpuTimes(Visit visit)
+    {
+        for (; gpuVisited < gpuResolved; gpuVisited++)
+            visit((double)gpuCost[gpuVisited % HISTORY] / 1.0e6);
+    }
+
+    // GPU time of the latest frame read back, 0 before the first
+    double lastGpuMs() const { return gpuResolved ? (double)gpuCost[(gpuResolved - 1) % HISTORY] / 1.0e6 : 0.0; }
+
+    void reset()
+    {
+        missedFrames = 0;
+        frameIntervalMs.clear();
+        gpuMs.clear();
+        waitMs.clear();
+        queuedFrames.clear();
+        gpuVisited = gpuResolved;
+    }
+
+    void destroy()
+    {
+        for (GpuQuery& query : queries)
+            query.reset();
+        for (; fencesResolved < fencesIssued; fencesResolved++)
+            glDeleteSync(fences[fencesResolved % FENCE_FRAMES]);
+    }
+
+private:
+    static const int QUERY_FRAMES = 4;
+    static const int FENCE_FRAMES = 4;
+    static const int HISTORY = 16;
+    static const uint64_t MIN_SAFETY_MARGIN = 500000ull; // 0.5 ms
+
+    GpuQuery queries[QUERY_FRAMES * 2];
+    uint64_t gpuCost[HISTORY] = {};
+    uint64_t cpuCost[HISTORY] = {};
+    uint64_t refreshInterval = 16666667ull;
+    uint64_t safetyMargin = 2000000ull;
+    uint64_t frameStart = 0;
+    uint64_t lastSwap = 0;
+    uint64_t vsync = 0;     // estimated vsync that took the latest frame
+    uint64_t frame = 0;
+    uint64_t gpuResolved = 0;
+    uint64_t gpuVisited = 0;
+    unsigned int missedFrames = 0;
+    GLsync fences[FENCE_FRAMES] = {};
+    uint64_t fencesIssued = 0;
+    uint64_t fencesResolved = 0;
+    SampleSeries frameIntervalMs;
+    SampleSeries gpuMs;
+    SampleSeries waitMs;
+    SampleSeries queuedFrames;
+
+    // the worst CPU submit time plus the worst GPU time seen recently; CPU and GPU overlap, so this is conservative
+    uint64_t predictedFrameCost() const
+    {
+        uint64_t cpu = 0, gpu = 0;
+        for (int i = 0; i < HISTORY; i++)
+        {
+            cpu = std::max(cpu, cpuCost[i]);
+            gpu = std::max(gpu, gpuCost[i]);
+        }
+        return cpu + gpu;
+    }
+
+    // A swap returns at, or shortly after, the vsync that took its frame, so the swap timestamps folded onto the refresh
+    // interval give the vsync grid. A swap up to a quarter interval either side of a grid line moves the grid an eighth of
+    // the way toward it, which follows drift without following jitter; later swaps are late frames and leave it alone.
+    // Returns the vsyncs since the previous swap, more than one after a miss.
+    uint64_t advanceVsync(uint64_t swap)
+    {
+        if (vsync == 0 || swap < vsync)
+        {
+            vsync = swap;
+            return 1;
+        }
+        uint64_t periods = (swap - vsync + refreshInterval / 4) / refreshInterval;
+        vsync += periods * refreshInterval;
+        int64_t error = (int64_t)swap - (int64_t)vsync;
+        if (error > -(int64_t)(refreshInterval / 4) && error < (int64_t)(refreshInterval / 4))
+            vsync = (uint64_t)((int64_t)vsync + error / 8);
+        return periods;
+    }
+
+    // releases the fences of the frames the GPU has finished, without waiting for the others
+    void pollFences()
+    {
+        while (fencesResolved < fencesIssued)
+        {
+            GLsync fence = fences[fencesResolved % FENCE_FRAMES];
+            if (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED)
+                return;
+            glDeleteSync(fence);
+            fencesResolved++;
+        }
+    }
+
+    // reads back finished query pairs without stalling
+    void collectGpuTimes()
+    {
+        while (gpuResolved <= frame)
+        {
+            GLuint end = queries[(gpuResolved % QUERY_FRAMES) * 2 + 1];
+            GLint available = 0;
+            glGetQueryObjectiv(end, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+            {
+                // never let the ring wrap over unread queries
+                if (frame - gpuResolved + 1 < QUERY_FRAMES)
+                    return;
+            }
+            GLuint64 begin = 0, finish = 0;
+            glGetQueryObjectui64v(queries[(gpuResolved % QUERY_FRAMES) * 2], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(end, GL_QUERY_RESULT, &finish);
+            gpuCost[gpuResolved % HISTORY] = finish - begin;
+            gpuMs.add((double)(finish - begin) / 1.0e6);
+            gpuResolved++;
+        }
+    }
+};
+
+#endif
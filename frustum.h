@@ -0,0 +1,58 @@
+#ifndef frustum_h
+#define frustum_h
+
+#include <glm/glm.hpp>
+
+// View frustum as six inward-facing planes (xyz = normal, w = distance), extracted from a view-projection matrix
+struct Frustum
+{
+    enum { FRUSTUM_LEFT, FRUSTUM_RIGHT, FRUSTUM_BOTTOM, FRUSTUM_TOP, FRUSTUM_NEAR, FRUSTUM_FAR, FRUSTUM_PLANES };
+
+    glm::vec4 Planes[FRUSTUM_PLANES];
+
+    // Gribb/Hartmann plane extraction; planes are normalized so distances are in world units
+    void extract(const glm::mat4& viewProjection)
+    {
+        glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+        glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+        glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+        glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+        Planes[FRUSTUM_LEFT] = row3 + row0;
+        Planes[FRUSTUM_RIGHT] = row3 - row0;
+        Planes[FRUSTUM_BOTTOM] = row3 + row1;
+        Planes[FRUSTUM_TOP] = row3 - row1;
+        Planes[FRUSTUM_NEAR] = row3 + row2;
+        Planes[FRUSTUM_FAR] = row3 - row2;
+
+        for (int i = 0; i < FRUSTUM_PLANES; i++)
+            Planes[i] /= glm::length(glm::vec3(Planes[i]));
+    }
+
+    // true if the box is at least partially inside; margin pushes every plane outwards by that many world units
+    bool intersectsAABB(const glm::vec3& boxMin, const glm::vec3& boxMax, float margin = 0.0f) const
+    {
+        for (int i = 0; i < FRUSTUM_PLANES; i++)
+        {
+            // test the box corner furthest along the plane normal
+            glm::vec3 positive(Planes[i].x >= 0.0f ? boxMax.x : boxMin.x,
+                               Planes[i].y >= 0.0f ? boxMax.y : boxMin.y,
+                               Planes[i].z >= 0.0f ? boxMax.z : boxMin.z);
+            if (glm::dot(glm::vec3(Planes[i]), positive) + Planes[i].w < -margin)
+                return false;
+        }
+        return true;
+    }
+
+    bool intersectsSphere(const glm::vec3& center, float radius) const
+    {
+        for (int i = 0; i < FRUSTUM_PLANES; i++)
+        {
+            if (glm::dot(glm::vec3(Planes[i]), center) + Planes[i].w < -radius)
+                return false;
+        }
+        return true;
+    }
+};
+
+#endif
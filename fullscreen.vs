@@ -0,0 +1,10 @@
+#version 430 core
+// one triangle covering the viewport, generated from gl_VertexID without vertex buffers
+out vec2 texCoord;
+
+void main()
+{
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    texCoord = position;
+    gl_Position = vec4(position * 2.0f - 1.0f, 0.0f, 1.0f);
+}
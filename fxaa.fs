@@ -0,0 +1,110 @@
+#version 430 core
+// FXAA in one pass over the finished image: a pixel whose neighbourhood has enough luma contrast is on an edge, which
+// is walked along in both directions until the contrast ends. The pixel is then sampled across the edge by how far it
+// is from the nearer end, which turns stair steps into gradients, and at least by how much it differs from its
+// neighbours, which softens features thinner than a pixel.
+in vec2 texCoord;
+
+out vec4 FragColor;
+
+uniform sampler2D sceneColor;   // bilinear
+uniform vec2 texelSize;
+
+const float EDGE_THRESHOLD = 0.125f;
+const float EDGE_THRESHOLD_MIN = 0.0312f;
+const float SUBPIXEL_QUALITY = 0.75f;
+const int SEARCH_STEPS = 10;
+const float SEARCH_STEP_SIZES[SEARCH_STEPS] = float[SEARCH_STEPS](1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.5f, 2.0f, 2.0f, 4.0f, 8.0f);
+
+float luma(vec2 uv)
+{
+    return dot(texture(sceneColor, uv).rgb, vec3(0.299f, 0.587f, 0.114f));
+}
+
+void main()
+{
+    vec3 color = texture(sceneColor, texCoord).rgb;
+    float center = dot(color, vec3(0.299f, 0.587f, 0.114f));
+    float down = luma(texCoord + vec2(0.0f, -texelSize.y));
+    float up = luma(texCoord + vec2(0.0f, texelSize.y));
+    float left = luma(texCoord + vec2(-texelSize.x, 0.0f));
+    float right = luma(texCoord + vec2(texelSize.x, 0.0f));
+    float lumaMin = min(center, min(min(down, up), min(left, right)));
+    float lumaMax = max(center, max(max(down, up), max(left, right)));
+    float range = lumaMax - lumaMin;
+    if (range < max(EDGE_THRESHOLD_MIN, lumaMax * EDGE_THRESHOLD))
+    {
+        FragColor = vec4(color, 1.0f);
+        return;
+    }
+
+    float downLeft = luma(texCoord - texelSize);
+    float upRight = luma(texCoord + texelSize);
+    float upLeft = luma(texCoord + vec2(-texelSize.x, texelSize.y));
+    float downRight = luma(texCoord + vec2(texelSize.x, -texelSize.y));
+    float downUp = down + up;
+    float leftRight = left + right;
+    float leftCorners = downLeft + upLeft;
+    float downCorners = downLeft + downRight;
+    float rightCorners = downRight + upRight;
+    float upCorners = upRight + upLeft;
+
+    // the edge runs along the direction with the smaller second derivative
+    float horizontalEdge = abs(-2.0f * left + leftCorners) + abs(-2.0f * center + downUp) * 2.0f + abs(-2.0f * right + rightCorners);
+    float verticalEdge = abs(-2.0f * up + upCorners) + abs(-2.0f * center + leftRight) * 2.0f + abs(-2.0f * down + downCorners);
+    bool horizontal = horizontalEdge >= verticalEdge;
+
+    // the side of the pixel the edge is on
+    float luma1 = horizontal ? down : left;
+    float luma2 = horizontal ? up : right;
+    float gradient1 = luma1 - center;
+    float gradient2 = luma2 - center;
+    bool side1 = abs(gradient1) >= abs(gradient2);
+    float gradientScaled = 0.25f * max(abs(gradient1), abs(gradient2));
+    float stepLength = horizontal ? texelSize.y : texelSize.x;
+    float localAverage = 0.5f * ((side1 ? luma1 : luma2) + center);
+    if (side1)
+        stepLength = -stepLength;
+
+    // walk along the edge, half a pixel towards its side, until the luma leaves the edge's
+    vec2 edgeUV = texCoord + (horizontal ? vec2(0.0f, 0.5f * stepLength) : vec2(0.5f * stepLength, 0.0f));
+    vec2 along = horizontal ? vec2(texelSize.x, 0.0f) : vec2(0.0f, texelSize.y);
+    vec2 uv1 = edgeUV - along * SEARCH_STEP_SIZES[0];
+    vec2 uv2 = edgeUV + along * SEARCH_STEP_SIZES[0];
+    float end1 = luma(uv1) - localAverage;
+    float end2 = luma(uv2) - localAverage;
+    bool reached1 = abs(end1) >= gradientScaled;
+    bool reached2 = abs(end2) >= gradientScaled;
+    for (int i = 1; i < SEARCH_STEPS && !(reached1 && reached2); i++)
+    {
+        if (!reached1)
+        {
+            uv1 -= along * SEARCH_STEP_SIZES[i];
+            end1 = luma(uv1) - localAverage;
+            reached1 = abs(end1) >= gradientScaled;
+        }
+        if (!reached2)
+        {
+            uv2 += along * SEARCH_STEP_SIZES[i];
+            end2 = luma(uv2) - localAverage;
+            reached2 = abs(end2) >= gradientScaled;
+        }
+    }
+
+    float distance1 = horizontal ? texCoord.x - uv1.x : texCoord.y - uv1.y;
+    float distance2 = horizontal ? uv2.x - texCoord.x : uv2.y - texCoord.y;
+    bool nearer1 = distance1 < distance2;
+    float pixelOffset = 0.5f - min(distance1, distance2) / (distance1 + distance2);
+    // only blend when the nearer end turns the same way the centre does
+    bool centerSmaller = center < localAverage;
+    bool consistent = ((nearer1 ? end1 : end2) < 0.0f) != centerSmaller;
+    float offset = consistent ? pixelOffset : 0.0f;
+
+    float average = (2.0f * (downUp + leftRight) + leftCorners + rightCorners) / 12.0f;
+    float subpixel = clamp(abs(average - center) / range, 0.0f, 1.0f);
+    subpixel = (-2.0f * subpixel + 3.0f) * subpixel * subpixel;
+    offset = max(offset, subpixel * subpixel * SUBPIXEL_QUALITY);
+
+    vec2 uv = texCoord + (horizontal ? vec2(0.0f, offset * stepLength) : vec2(offset * stepLength, 0.0f));
+    FragColor = vec4(texture(sceneColor, uv).rgb, 1.0f);
+}
@@ -0,0 +1,295 @@
+#ifndef gpu_driven_h
+#define gpu_driven_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "frustum.h"
+#include "gpu_resources.h"
+#include "input.h"
+#include "scene.h"
+#include "shader.h"
+#include "stats.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// shader storage binding points used by cullInstances.comp and instancedVertex.vs
+const GLuint INSTANCE_SSBO_BINDING = 4;
+const GLuint MESH_BOUNDS_SSBO_BINDING = 5;
+const GLuint DRAW_COMMAND_SSBO_BINDING = 6;
+const GLuint VISIBLE_INSTANCE_SSBO_BINDING = 7;
+
+// vertex attribute holding 0, 1, 2, ... with divisor 1; together with a command's baseInstance it is the instance's
+// slot in the compacted visible list
+const GLuint INSTANCE_SLOT_ATTRIBUTE = 3;
+
+// per-vertex material slot of the baked meshes, which mix several materials
+const GLuint MATERIAL_ATTRIBUTE = 1;
+
+// per-vertex baked ambient occlusion of meshes drawn with vertexShader.vs, see occlusionRecord
+const GLuint OCCLUSION_ATTRIBUTE = 4;
+
+// Several boxes baked into one mesh in the lit vertex layout, in the mesh's own space, with the material of every vertex
+struct MeshBuilder
+{
+    std::vector<float> vertices;
+    std::vector<GLuint> materials;
+    std::vector<GLuint> occlusion;  // (1 + record offset) << 5 | face corner, 0 for none; see ambient_occlusion.h
+    std::vector<GLuint> indices;
+    glm::vec3 boundsMin = glm::vec3(1e30f);
+    glm::vec3 boundsMax = glm::vec3(-1e30f);
+
+    // boxVertices are the 24 vertices of the shared box in the lit layout, boxIndices their 36 indices; occlusionRecord
+    // is the box's DrawItem::occlusion
+    void addBox(const float* boxVertices, const GLuint* boxIndices, const glm::mat4& model, GLuint material, GLuint occlusionRecord = 0)
+    {
+        glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+        GLuint base = (GLuint)(vertices.size() / BOX_VERTEX_FLOATS);
+        for (int v = 0; v < 24; v++)
+        {
+            const float* src = &boxVertices[v * BOX_VERTEX_FLOATS];
+            glm::vec3 position = glm::vec3(model * glm::vec4(src[0], src[1], src[2], 1.0f));
+            glm::vec3 normal = glm::normalize(normalMatrix * glm::vec3(src[3], src[4], src[5]));
+            boundsMin = glm::min(boundsMin, position);
+            boundsMax = glm::max(boundsMax, position);
+            float out[BOX_VERTEX_FLOATS] = { position.x, position.y, position.z, normal.x, normal.y, normal.z };
+            vertices.insert(vertices.end(), out, out + BOX_VERTEX_FLOATS);
+            materials.push_back(material);
+            occlusion.push_back(occlusionRecord ? occlusionRecord << 5 | boxFaceCorner(src) : 0);
+        }
+        for (int i = 0; i < CUBE_INDEX_COUNT; i++)
+            indices.push_back(base + boxIndices[i]);
+    }
+};
+
+// std430 layouts shared with the shaders
+struct GpuInstance
+{
+    glm::vec4 positionYaw;  // translation, rotation around +Y in radians
+    GLuint mesh;
+    GLuint padding[3];
+};
+
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;   // reset to 0 each frame, then counted up atomically by the culling shader
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;    // start of the mesh's range in the visible list
+};
+
+// Instances of a few baked meshes that are culled and drawn entirely on the GPU. A compute pass tests every instance's
+// bounding sphere against the frustum and appends the survivors to their mesh's range of a visible list, counting them
+// in the instanceCount of that mesh's indirect command. The frame then draws everything with one
+// glMultiDrawElementsIndirect, so the CPU cost per frame does not depend on the number of instances.
+class GpuDrivenScene
+{
+public:
+    // returns the mesh index for addInstance; all meshes must be added before upload()
+    unsigned int addMesh(const MeshBuilder& mesh)
+    {
+        MeshRange range;
+        range.firstIndex = (GLuint)indices.size();
+        range.indexCount = (GLuint)mesh.indices.size();
+        range.baseVertex = (GLint)(vertices.size() / BOX_VERTEX_FLOATS);
+        glm::vec3 center = (mesh.boundsMin + mesh.boundsMax) * 0.5f;
+        range.bounds = glm::vec4(center, glm::length(mesh.boundsMax - mesh.boundsMin) * 0.5f);
+        vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+        materials.insert(materials.end(), mesh.materials.begin(), mesh.materials.end());
+        indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end());
+        meshes.push_back(range);
+        return (unsigned int)meshes.size() - 1;
+    }
+
+    void addInstance(unsigned int mesh, const glm::vec3& position, float yawRadians)
+    {
+        GpuInstance instance = {};
+        instance.positionYaw = glm::vec4(position, yawRadians);
+        instance.mesh = mesh;
+        instances.push_back(instance);
+        meshes[mesh].instances++;
+    }
+
+    size_t instanceCount() const { return instances.size(); }
+
+    // creates the GPU buffers and the vertex array on the current context
+    void upload()
+    {
+        uploadBuffers();
+        createVertexArray();
+    }
+
+    // creates the GPU buffers; buffers are shared between contexts, so this may run on a background upload context.
+    // The CPU copies of vertices and instances are released afterwards. Returns the number of bytes uploaded.
+    size_t uploadBuffers()
+    {
+        vbo.create("desks", "vertices");
+        materialBuffer.create("desks", "vertex materials");
+        ebo.create("desks", "indices");
+        slotBuffer.create("desks", "instance slots");
+        vbo.data(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+        materialBuffer.data(GL_ARRAY_BUFFER, materials.size() * sizeof(GLuint), materials.data(), GL_STATIC_DRAW);
+        // the element binding belongs to a vertex array, which the upload context does not have
+        ebo.data(GL_COPY_WRITE_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        std::vector<GLuint> slots(std::max<size_t>(instances.size(), 1));
+        for (size_t i = 0; i < slots.size(); i++)
+            slots[i] = (GLuint)i;
+        slotBuffer.data(GL_ARRAY_BUFFER, slots.size() * sizeof(GLuint), slots.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        // command template with zero instance counts, copied over the live commands before every cull
+        std::vector<DrawElementsIndirectCommand> commands(meshes.size());
+        std::vector<glm::vec4> bounds(meshes.size());
+        GLuint visibleOffset = 0;
+        for (size_t m = 0; m < meshes.size(); m++)
+        {
+            commands[m].count = meshes[m].indexCount;
+            commands[m].instanceCount = 0;
+            commands[m].firstIndex = meshes[m].firstIndex;
+            commands[m].baseVertex = meshes[m].baseVertex;
+            commands[m].baseInstance = visibleOffset;
+            visibleOffset += meshes[m].instances;
+            bounds[m] = meshes[m].bounds;
+        }
+        commandBytes = commands.size() * sizeof(DrawElementsIndirectCommand);
+        instanceTotal = (GLuint)instances.size();
+
+        instanceBuffer.create("desks", "instances");
+        boundsBuffer.create("desks", "mesh bounds");
+        commandTemplate.create("desks", "command template");
+        commandBuffer.create("desks", "draw commands");
+        visibleBuffer.create("desks", "visible instances");
+        instanceBuffer.data(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(instances.size(), 1) * sizeof(GpuInstance), instances.data(), GL_STATIC_DRAW);
+        boundsBuffer.data(GL_SHADER_STORAGE_BUFFER, bounds.size() * sizeof(glm::vec4), bounds.data(), GL_STATIC_DRAW);
+        commandTemplate.data(GL_COPY_READ_BUFFER, commandBytes, commands.data(), GL_STATIC_DRAW);
+        commandBuffer.data(GL_SHADER_STORAGE_BUFFER, commandBytes, commands.data(), GL_DYNAMIC_COPY);
+        visibleBuffer.data(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(instances.size(), 1) * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+        size_t bytes = (vertices.size() * sizeof(float) + (materials.size() + indices.size()) * sizeof(GLuint)
+            + instances.size() * (sizeof(GpuInstance) + 2 * sizeof(GLuint)) + 2 * commandBytes + bounds.size() * sizeof(glm::vec4));
+        std::cout << "gpu-driven scene: " << instances.size() << " instances of " << meshes.size() << " meshes, "
+            << bytes / (1024 * 1024) << " MB" << std::endl;
+        std::vector<float>().swap(vertices);
+        std::vector<GLuint>().swap(materials);
+        std::vector<GLuint>().swap(indices);
+        std::vector<GpuInstance>().swap(instances);
+        return bytes;
+    }
+
+    // vertex arrays are not shared between contexts: this must run on the context that draws, after the buffers
+    // from uploadBuffers() are complete
+    void createVertexArray()
+    {
+        vao.create("desks", "baked meshes");
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, BOX_VERTEX_STRIDE, (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, BOX_VERTEX_STRIDE, (void*)BOX_NORMAL_OFFSET);
+        glEnableVertexAttribArray(2);
+        glBindBuffer(GL_ARRAY_BUFFER, materialBuffer);
+        glVertexAttribIPointer(MATERIAL_ATTRIBUTE, 1, GL_UNSIGNED_INT, 0, (void*)0);
+        glEnableVertexAttribArray(MATERIAL_ATTRIBUTE);
+        glBindBuffer(GL_ARRAY_BUFFER, slotBuffer);
+        glVertexAttribIPointer(INSTANCE_SLOT_ATTRIBUTE, 1, GL_UNSIGNED_INT, 0, (void*)0);
+        glVertexAttribDivisor(INSTANCE_SLOT_ATTRIBUTE, 1);
+        glEnableVertexAttribArray(INSTANCE_SLOT_ATTRIBUTE);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // true once the buffers and the vertex array exist
+    bool ready() const { return vao != 0; }
+
+    // resets the commands and runs the culling compute pass; margin grows every bounding sphere, as in DrawList::cull
+    void cull(const Shader& cullShader, const Frustum& frustum, float margin, RenderStats& stats)
+    {
+        uint64_t start = inputClockNow();
+        glBindBuffer(GL_COPY_READ_BUFFER, commandTemplate);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, commandBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, commandBytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        bindBuffers();
+        cullShader.use();
+        cullShader.setVec4Array("frustumPlanes", frustum.Planes, Frustum::FRUSTUM_PLANES);
+        cullShader.setInt("instanceCount", (int)instanceTotal);
+        cullShader.setFloat("cullMargin", margin);
+        glDispatchCompute((instanceTotal + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+        stats.submitted += instanceTotal;
+        cullMs.add((double)(inputClockNow() - start) / 1.0e6);
+    }
+
+    // draws the surviving instances with a program built on instancedVertex.vs; the program must be in use
+    void draw(RenderStats& stats) const
+    {
+        if (instanceTotal == 0)
+            return;
+        bindBuffers();
+        glBindVertexArray(vao);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, (GLsizei)meshes.size(), 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        stats.drawCalls++;
+    }
+
+    void report(std::ostream& out)
+    {
+        out << "gpu-driven scene: " << instanceTotal << " instances" << std::endl;
+        cullMs.report(out, "gpu cull submit");
+    }
+
+    void destroy()
+    {
+        GpuBuffer* buffers[] = { &vbo, &materialBuffer, &ebo, &slotBuffer, &instanceBuffer, &boundsBuffer, &commandTemplate, &commandBuffer, &visibleBuffer };
+        for (GpuBuffer* buffer : buffers)
+            buffer->reset();
+        vao.reset();
+    }
+
+private:
+    static const GLuint CULL_GROUP_SIZE = 256; // local_size_x of cullInstances.comp
+
+    struct MeshRange
+    {
+        GLuint firstIndex;
+        GLuint indexCount;
+        GLint baseVertex;
+        glm::vec4 bounds;   // local bounding sphere
+        GLuint instances = 0;
+    };
+
+    std::vector<float> vertices;
+    std::vector<GLuint> materials;
+    std::vector<GLuint> indices;
+    std::vector<GpuInstance> instances;
+    std::vector<MeshRange> meshes;
+    GLuint instanceTotal = 0;
+    GLsizeiptr commandBytes = 0;
+    GpuVertexArray vao;
+    GpuBuffer vbo, materialBuffer, ebo, slotBuffer;
+    GpuBuffer instanceBuffer, boundsBuffer, commandTemplate, commandBuffer, visibleBuffer;
+    SampleSeries cullMs;
+
+    void bindBuffers() const
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_SSBO_BINDING, instanceBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESH_BOUNDS_SSBO_BINDING, boundsBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_COMMAND_SSBO_BINDING, commandBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBLE_INSTANCE_SSBO_BINDING, visibleBuffer);
+    }
+};
+
+#endif
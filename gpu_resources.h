@@ -0,0 +1,329 @@
+#ifndef gpu_resources_h
+#define gpu_resources_h
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+enum Gpu_Resource_Kind {
+    GPU_BUFFER,
+    GPU_VERTEX_ARRAY,
+    GPU_TEXTURE,
+    GPU_RENDERBUFFER,
+    GPU_FRAMEBUFFER,
+    GPU_QUERY,
+    GPU_PROGRAM,
+    GPU_RESOURCE_KINDS
+};
+
+inline const char* gpuResourceKindName(Gpu_Resource_Kind kind)
+{
+    static const char* names[GPU_RESOURCE_KINDS] = { "buffer", "vertex array", "texture", "renderbuffer", "framebuffer", "query", "program" };
+    return names[kind];
+}
+
+// Every GL object the renderer owns, with the subsystem it belongs to and, for buffers and images, its size. Objects
+// register themselves through the GpuObject wrappers below, from any thread. Budgets are checked as sizes change.
+class GpuResourceRegistry
+{
+public:
+    struct Entry
+    {
+        Gpu_Resource_Kind kind;
+        GLuint id;
+        std::string category;   // owning subsystem: "scene", "lighting", "shadows", ...
+        std::string name;
+        size_t bytes;
+        GLenum usage;           // glBufferData usage hint, 0 for images
+    };
+
+    void add(Gpu_Resource_Kind kind, GLuint id, const std::string& category, const std::string& name)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry entry = { kind, id, category, name, 0, 0 };
+        entries[key(kind, id)] = entry;
+    }
+
+    void remove(Gpu_Resource_Kind kind, GLuint id)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(key(kind, id));
+        if (it == entries.end())
+            return;
+        total -= it->second.bytes;
+        entries.erase(it);
+    }
+
+    void setSize(Gpu_Resource_Kind kind, GLuint id, size_t bytes, GLenum usage)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(key(kind, id));
+        if (it == entries.end())
+            return;
+        total += bytes - it->second.bytes;
+        it->second.bytes = bytes;
+        it->second.usage = usage;
+        peak = total > peak ? total : peak;
+        checkBudgets(it->second.category);
+    }
+
+    // 0 removes the budget; "" is the budget of all categories together
+    void setBudget(const std::string& category, size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        budgets[category] = bytes;
+    }
+
+    size_t totalBytes() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return total;
+    }
+
+    size_t peakBytes() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return peak;
+    }
+
+    size_t categoryBytes(const std::string& category) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return bytesOf(category);
+    }
+
+    size_t kindBytes(Gpu_Resource_Kind kind) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t bytes = 0;
+        for (const auto& e : entries)
+        {
+            if (e.second.kind == kind)
+                bytes += e.second.bytes;
+        }
+        return bytes;
+    }
+
+    size_t liveCount() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.size();
+    }
+
+    // live memory per category and object counts per kind
+    void report(std::ostream& out) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::map<std::string, size_t> byCategory;
+        size_t count[GPU_RESOURCE_KINDS] = {};
+        for (const auto& e : entries)
+        {
+            byCategory[e.second.category] += e.second.bytes;
+            count[e.second.kind]++;
+        }
+        out << std::fixed << std::setprecision(2) << "gpu memory: " << megabytes(total) << " MB live, "
+            << megabytes(peak) << " MB peak";
+        auto budget = budgets.find("");
+        if (budget != budgets.end() && budget->second)
+            out << ", budget " << megabytes(budget->second) << " MB";
+        out << std::endl;
+        for (const auto& c : byCategory)
+            out << "  " << std::setw(10) << c.first << std::setw(10) << megabytes(c.second) << " MB" << std::endl;
+        out << " ";
+        for (int k = 0; k < GPU_RESOURCE_KINDS; k++)
+            out << " " << count[k] << " " << gpuResourceKindName((Gpu_Resource_Kind)k) << (count[k] == 1 ? "" : "s");
+        out << std::endl;
+    }
+
+    // Call with the context still current, after every owner has released its objects: whatever is still registered
+    // leaked. Afterwards wrappers destroyed later only forget their handles, the context being gone.
+    bool reportLeaks(std::ostream& out)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        contextLive = false;
+        if (entries.empty())
+            return true;
+        out << "ERROR::GPU_RESOURCES::LEAKED " << entries.size() << " objects, " << megabytes(total) << " MB:" << std::endl;
+        for (const auto& e : entries)
+        {
+            out << "  " << gpuResourceKindName(e.second.kind) << " " << e.second.id << " " << e.second.category << "/"
+                << e.second.name << " " << e.second.bytes << " bytes" << usageName(e.second.usage) << std::endl;
+        }
+        return false;
+    }
+
+    bool contextAlive() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return contextLive;
+    }
+
+private:
+    std::unordered_map<uint64_t, Entry> entries;
+    std::map<std::string, size_t> budgets;
+    std::map<std::string, bool> overBudget;
+    size_t total = 0;
+    size_t peak = 0;
+    bool contextLive = true;
+    mutable std::mutex mutex;
+
+    static uint64_t key(Gpu_Resource_Kind kind, GLuint id) { return ((uint64_t)kind << 32) | id; }
+    static double megabytes(size_t bytes) { return (double)bytes / (1024.0 * 1024.0); }
+
+    static const char* usageName(GLenum usage)
+    {
+        switch (usage)
+        {
+        case GL_STATIC_DRAW: return " static";
+        case GL_DYNAMIC_DRAW: return " dynamic";
+        case GL_STREAM_DRAW: return " stream";
+        case GL_DYNAMIC_COPY: return " dynamic copy";
+        case GL_MAP_PERSISTENT_BIT: return " persistent";
+        default: return "";
+        }
+    }
+
+    size_t bytesOf(const std::string& category) const
+    {
+        size_t bytes = 0;
+        for (const auto& e : entries)
+        {
+            if (e.second.category == category)
+                bytes += e.second.bytes;
+        }
+        return bytes;
+    }
+
+    // warns once each time a budget is crossed upwards
+    void checkBudgets(const std::string& category)
+    {
+        const std::string scopes[2] = { category, "" };
+        for (const std::string& scope : scopes)
+        {
+            auto budget = budgets.find(scope);
+            if (budget == budgets.end() || !budget->second)
+                continue;
+            size_t used = scope.empty() ? total : bytesOf(scope);
+            bool over = used > budget->second;
+            if (over && !overBudget[scope])
+            {
+                std::cout << "ERROR::GPU_RESOURCES::BUDGET_EXCEEDED " << (scope.empty() ? "total" : scope) << ": "
+                    << megabytes(used) << " MB of " << megabytes(budget->second) << " MB" << std::endl;
+            }
+            overBudget[scope] = over;
+        }
+    }
+};
+
+inline GpuResourceRegistry& gpuResources()
+{
+    static GpuResourceRegistry registry;
+    return registry;
+}
+
+// Move-only owner of one GL object, registered for as long as it lives. Converts to its GLuint, so it drops into the
+// existing gl* calls. create() needs a current context; objects of the shareable kinds may be created on the upload
+// context.
+template <Gpu_Resource_Kind Kind>
+class GpuObject
+{
+public:
+    GpuObject() {}
+    GpuObject(const GpuObject&) = delete;
+    GpuObject& operator=(const GpuObject&) = delete;
+
+    GpuObject(GpuObject&& other) noexcept : handle(other.handle) { other.handle = 0; }
+
+    GpuObject& operator=(GpuObject&& other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            handle = other.handle;
+            other.handle = 0;
+        }
+        return *this;
+    }
+
+    ~GpuObject() { reset(); }
+
+    void create(const std::string& category, const std::string& name)
+    {
+        reset();
+        handle = generate();
+        gpuResources().add(Kind, handle, category, name);
+    }
+
+    void reset()
+    {
+        if (!handle)
+            return;
+        if (gpuResources().contextAlive())
+            release(handle);
+        gpuResources().remove(Kind, handle);
+        handle = 0;
+    }
+
+    // records the memory behind the object
+    void setBytes(size_t bytes, GLenum usage = 0) const { gpuResources().setSize(Kind, handle, bytes, usage); }
+
+    GLuint id() const { return handle; }
+    operator GLuint() const { return handle; }
+
+private:
+    GLuint handle = 0;
+
+    static GLuint generate();
+    static void release(GLuint handle);
+};
+
+template <> inline GLuint GpuObject<GPU_BUFFER>::generate() { GLuint h; glGenBuffers(1, &h); return h; }
+template <> inline void GpuObject<GPU_BUFFER>::release(GLuint h) { glDeleteBuffers(1, &h); }
+template <> inline GLuint GpuObject<GPU_VERTEX_ARRAY>::generate() { GLuint h; glGenVertexArrays(1, &h); return h; }
+template <> inline void GpuObject<GPU_VERTEX_ARRAY>::release(GLuint h) { glDeleteVertexArrays(1, &h); }
+template <> inline GLuint GpuObject<GPU_TEXTURE>::generate() { GLuint h; glGenTextures(1, &h); return h; }
+template <> inline void GpuObject<GPU_TEXTURE>::release(GLuint h) { glDeleteTextures(1, &h); }
+template <> inline GLuint GpuObject<GPU_RENDERBUFFER>::generate() { GLuint h; glGenRenderbuffers(1, &h); return h; }
+template <> inline void GpuObject<GPU_RENDERBUFFER>::release(GLuint h) { glDeleteRenderbuffers(1, &h); }
+template <> inline GLuint GpuObject<GPU_FRAMEBUFFER>::generate() { GLuint h; glGenFramebuffers(1, &h); return h; }
+template <> inline void GpuObject<GPU_FRAMEBUFFER>::release(GLuint h) { glDeleteFramebuffers(1, &h); }
+template <> inline GLuint GpuObject<GPU_QUERY>::generate() { GLuint h; glGenQueries(1, &h); return h; }
+template <> inline void GpuObject<GPU_QUERY>::release(GLuint h) { glDeleteQueries(1, &h); }
+template <> inline GLuint GpuObject<GPU_PROGRAM>::generate() { return glCreateProgram(); }
+template <> inline void GpuObject<GPU_PROGRAM>::release(GLuint h) { glDeleteProgram(h); }
+
+typedef GpuObject<GPU_VERTEX_ARRAY> GpuVertexArray;
+typedef GpuObject<GPU_TEXTURE> GpuTexture;
+typedef GpuObject<GPU_RENDERBUFFER> GpuRenderbuffer;
+typedef GpuObject<GPU_FRAMEBUFFER> GpuFramebuffer;
+typedef GpuObject<GPU_QUERY> GpuQuery;
+typedef GpuObject<GPU_PROGRAM> GpuProgram;
+
+// a buffer that records its size and usage whenever its storage is (re)allocated
+class GpuBuffer : public GpuObject<GPU_BUFFER>
+{
+public:
+    // binds the buffer to target and allocates it
+    void data(GLenum target, size_t bytes, const void* data, GLenum usage) const
+    {
+        glBindBuffer(target, id());
+        glBufferData(target, (GLsizeiptr)bytes, data, usage);
+        setBytes(bytes, usage);
+    }
+
+    // immutable storage, e.g. for persistent mapping
+    void storage(GLenum target, size_t bytes, const void* data, GLbitfield flags) const
+    {
+        glBindBuffer(target, id());
+        glBufferStorage(target, (GLsizeiptr)bytes, data, flags);
+        setBytes(bytes, (flags & GL_MAP_PERSISTENT_BIT) ? GL_MAP_PERSISTENT_BIT : GL_STATIC_DRAW);
+    }
+};
+
+#endif
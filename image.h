@@ -0,0 +1,62 @@
+#ifndef image_h
+#define image_h
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// 8-bit RGB image stored top row first, read from and written to binary PPM (P6) files
+struct RgbImage
+{
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels;
+
+    void resize(int w, int h)
+    {
+        width = w;
+        height = h;
+        pixels.assign((size_t)w * h * 3, 0);
+    }
+
+    unsigned char* at(int x, int y) { return &pixels[((size_t)y * width + x) * 3]; }
+    const unsigned char* at(int x, int y) const { return &pixels[((size_t)y * width + x) * 3]; }
+
+    // from tightly packed rows stored bottom row first, as returned by glReadPixels
+    void fromGL(int w, int h, const std::vector<unsigned char>& rgb)
+    {
+        resize(w, h);
+        size_t row = (size_t)w * 3;
+        for (int y = 0; y < h; y++)
+            std::copy(rgb.begin() + (h - 1 - y) * row, rgb.begin() + (h - y) * row, pixels.begin() + y * row);
+    }
+
+    bool savePPM(const std::string& path) const
+    {
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+        {
+            std::cout << "ERROR::IMAGE:: cannot write " << path << std::endl;
+            return false;
+        }
+        file << "P6\n" << width << " " << height << "\n255\n";
+        file.write((const char*)pixels.data(), pixels.size());
+        return (bool)file;
+    }
+
+    bool loadPPM(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::string magic;
+        int maxValue = 0;
+        if (!(file >> magic >> width >> height >> maxValue) || magic != "P6" || maxValue != 255 || width <= 0 || height <= 0)
+            return false;
+        file.get(); // the single whitespace byte after the header
+        pixels.resize((size_t)width * height * 3);
+        return (bool)file.read((char*)pixels.data(), pixels.size());
+    }
+};
+
+#endif
@@ -0,0 +1,393 @@
+#ifndef input_h
+#define input_h
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include "gpu_resources.h"
+#include "stats.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// Monotonic high-resolution clock shared by input, latency and frame timing (nanoseconds)
+inline uint64_t inputClockNow()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+enum InputEventType {
+    KEY_EVENT,
+    MOUSE_BUTTON_EVENT,
+    MOUSE_MOVE_EVENT,
+    SCROLL_EVENT
+};
+
+struct InputEvent
+{
+    InputEventType type;
+    int code;           // GLFW key or mouse button
+    int action;         // GLFW_PRESS / GLFW_RELEASE / GLFW_REPEAT
+    double x, y;        // cursor position or scroll offset
+    uint64_t timestamp; // inputClockNow() when the callback fired
+};
+
+// Bounded single-producer/single-consumer ring; push and pop never block or allocate
+template <typename T, unsigned int Capacity>
+class SpscQueue
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+public:
+    bool push(const T& item)
+    {
+        unsigned int head = this->head.load(std::memory_order_relaxed);
+        if (head - tail.load(std::memory_order_acquire) == Capacity)
+            return false;
+        items[head & (Capacity - 1)] = item;
+        this->head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item)
+    {
+        unsigned int tail = this->tail.load(std::memory_order_relaxed);
+        if (tail == head.load(std::memory_order_acquire))
+            return false;
+        item = items[tail & (Capacity - 1)];
+        this->tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::atomic<unsigned int> head{ 0 };
+    std::atomic<unsigned int> tail{ 0 };
+    T items[Capacity];
+};
+
+// Logical actions the application reacts to; keys are bound to them through the action map
+enum Input_Action {
+    ACTION_QUIT,
+    ACTION_MOVE_FORWARD,
+    ACTION_MOVE_BACKWARD,
+    ACTION_MOVE_LEFT,
+    ACTION_MOVE_RIGHT,
+    ACTION_MOVE_UP,
+    ACTION_MOVE_DOWN,
+    ACTION_PITCH_UP,
+    ACTION_PITCH_DOWN,
+    ACTION_YAW_LEFT,
+    ACTION_YAW_RIGHT,
+    ACTION_ROLL_LEFT,
+    ACTION_ROLL_RIGHT,
+    ACTION_TOGGLE_FAN,
+    ACTION_TOGGLE_ROTATE_AROUND,
+    ACTION_MODE_FREE_FLY,
+    ACTION_MODE_ORBIT,
+    ACTION_MODE_LOOK_AT,
+    ACTION_TOGGLE_LATE_LATCH,
+    ACTION_TOGGLE_PACING,
+    ACTION_TOGGLE_PREPASS,
+    ACTION_TOGGLE_OVERDRAW,
+    ACTION_EVALUATE_PREPASS,
+    ACTION_CYCLE_MATERIAL,
+    ACTION_TOGGLE_CELL_OVERLAY,
+    ACTION_TOGGLE_MULTIVIEW,
+    ACTION_CYCLE_ANTIALIASING,
+    ACTION_COUNT
+};
+
+static_assert(ACTION_COUNT <= 32, "FrameInput stores actions in 32-bit masks");
+
+// Everything one camera update consumes, as plain data so it can be recorded and replayed
+struct FrameInput
+{
+    uint32_t held = 0;      // bit per Input_Action
+    uint32_t pressed = 0;
+    glm::vec2 mouse = glm::vec2(0.0f);
+    float scroll = 0.0f;
+
+    bool isDown(Input_Action action) const { return (held >> action) & 1u; }
+    bool wasPressed(Input_Action action) const { return (pressed >> action) & 1u; }
+
+    // folds a later sample of the same frame into this one
+    void merge(const FrameInput& later)
+    {
+        held |= later.held;
+        pressed |= later.pressed;
+        mouse += later.mouse;
+        scroll += later.scroll;
+    }
+};
+
+// Event-driven input: GLFW callbacks enqueue timestamped events, beginFrame() drains them once per frame into
+// held/pressed/released action state and mouse deltas, and presented frames are timed on the GPU to measure
+// how long an event takes to reach the screen
+class InputSystem
+{
+public:
+    InputSystem()
+    {
+        for (int i = 0; i <= GLFW_KEY_LAST; i++)
+            keyDown[i] = keyTapped[i] = false;
+        for (int i = 0; i < ACTION_COUNT; i++)
+        {
+            actionDown[i] = actionPressed[i] = actionReleased[i] = false;
+            actionKey[i] = GLFW_KEY_UNKNOWN;
+        }
+        bind(ACTION_QUIT, GLFW_KEY_ESCAPE);
+        bind(ACTION_MOVE_FORWARD, GLFW_KEY_W);
+        bind(ACTION_MOVE_BACKWARD, GLFW_KEY_S);
+        bind(ACTION_MOVE_LEFT, GLFW_KEY_A);
+        bind(ACTION_MOVE_RIGHT, GLFW_KEY_D);
+        bind(ACTION_MOVE_UP, GLFW_KEY_E);
+        bind(ACTION_MOVE_DOWN, GLFW_KEY_R);
+        bind(ACTION_PITCH_UP, GLFW_KEY_X);
+        bind(ACTION_PITCH_DOWN, GLFW_KEY_C);
+        bind(ACTION_YAW_LEFT, GLFW_KEY_Y);
+        bind(ACTION_YAW_RIGHT, GLFW_KEY_V);
+        bind(ACTION_ROLL_LEFT, GLFW_KEY_Z);
+        bind(ACTION_ROLL_RIGHT, GLFW_KEY_Q);
+        bind(ACTION_TOGGLE_FAN, GLFW_KEY_G);
+        bind(ACTION_TOGGLE_ROTATE_AROUND, GLFW_KEY_F);
+        bind(ACTION_MODE_FREE_FLY, GLFW_KEY_1);
+        bind(ACTION_MODE_ORBIT, GLFW_KEY_2);
+        bind(ACTION_MODE_LOOK_AT, GLFW_KEY_3);
+        bind(ACTION_TOGGLE_LATE_LATCH, GLFW_KEY_F5);
+        bind(ACTION_TOGGLE_PACING, GLFW_KEY_F6);
+        bind(ACTION_TOGGLE_PREPASS, GLFW_KEY_F7);
+        bind(ACTION_TOGGLE_OVERDRAW, GLFW_KEY_F8);
+        bind(ACTION_EVALUATE_PREPASS, GLFW_KEY_F9);
+        bind(ACTION_CYCLE_MATERIAL, GLFW_KEY_F10);
+        bind(ACTION_TOGGLE_CELL_OVERLAY, GLFW_KEY_F11);
+        bind(ACTION_TOGGLE_MULTIVIEW, GLFW_KEY_F12);
+        bind(ACTION_CYCLE_ANTIALIASING, GLFW_KEY_F4);
+        // one beginFrame() drains at most a full queue, and late latching makes two a frame
+        frameEvents.reserve(2 * EVENT_QUEUE);
+        for (PendingFrame& frame : pendingFrames)
+            frame.eventTimestamps.reserve(2 * EVENT_QUEUE);
+    }
+
+    void bind(Input_Action action, int key)
+    {
+        actionKey[action] = key;
+    }
+
+    // producer side, called from the GLFW callbacks
+    void pushKey(int key, int action)
+    {
+        if (action == GLFW_REPEAT)
+            return;
+        enqueue(KEY_EVENT, key, action, 0.0, 0.0);
+    }
+    void pushMouseButton(int button, int action) { enqueue(MOUSE_BUTTON_EVENT, button, action, 0.0, 0.0); }
+    void pushMouseMove(double x, double y) { enqueue(MOUSE_MOVE_EVENT, 0, 0, x, y); }
+    void pushScroll(double xoffset, double yoffset) { enqueue(SCROLL_EVENT, 0, 0, xoffset, yoffset); }
+
+    // consumer side: applies all queued events and computes this frame's edges
+    void beginFrame()
+    {
+        for (int i = 0; i < ACTION_COUNT; i++)
+            actionPressed[i] = actionReleased[i] = false;
+        for (int i = 0; i <= GLFW_KEY_LAST; i++)
+            keyTapped[i] = false;
+        mouseDelta = glm::vec2(0.0f);
+        scrollDelta = 0.0f;
+
+        InputEvent event;
+        while (queue.pop(event))
+        {
+            switch (event.type)
+            {
+            case KEY_EVENT:
+                if (event.code < 0 || event.code > GLFW_KEY_LAST)
+                    continue;
+                keyDown[event.code] = event.action == GLFW_PRESS;
+                // remember presses even if the key is released again before the frame starts
+                if (event.action == GLFW_PRESS)
+                    keyTapped[event.code] = true;
+                break;
+            case MOUSE_BUTTON_EVENT:
+                continue;
+            case MOUSE_MOVE_EVENT:
+                if (firstMouse)
+                {
+                    lastX = event.x;
+                    lastY = event.y;
+                    firstMouse = false;
+                }
+                mouseDelta.x += (float)(event.x - lastX);
+                mouseDelta.y += (float)(lastY - event.y); // reversed since y-coordinates go from bottom to top
+                lastX = event.x;
+                lastY = event.y;
+                break;
+            case SCROLL_EVENT:
+                scrollDelta += (float)event.y;
+                break;
+            }
+            frameEvents.push_back(event.timestamp);
+        }
+
+        for (int i = 0; i < ACTION_COUNT; i++)
+        {
+            if (actionKey[i] == GLFW_KEY_UNKNOWN)
+                continue;
+            bool down = keyDown[actionKey[i]];
+            actionPressed[i] = (down && !actionDown[i]) || keyTapped[actionKey[i]];
+            actionReleased[i] = !down && actionDown[i];
+            actionDown[i] = down;
+        }
+    }
+
+    bool isDown(Input_Action action) const { return actionDown[action]; }
+    bool wasPressed(Input_Action action) const { return actionPressed[action]; }
+    bool wasReleased(Input_Action action) const { return actionReleased[action]; }
+    glm::vec2 getMouseDelta() const { return mouseDelta; }
+    float getScrollDelta() const { return scrollDelta; }
+
+    // the state computed by the last beginFrame()
+    FrameInput sample() const
+    {
+        FrameInput frame;
+        for (int i = 0; i < ACTION_COUNT; i++)
+        {
+            if (actionDown[i])
+                frame.held |= 1u << i;
+            if (actionPressed[i])
+                frame.pressed |= 1u << i;
+        }
+        frame.mouse = mouseDelta;
+        frame.scroll = scrollDelta;
+        return frame;
+    }
+
+    // call right after glfwSwapBuffers: the events consumed this frame become visible once the GPU has finished the
+    // frame, which is timestamped with a GL_TIMESTAMP query and mapped back onto the CPU clock. The frames in flight
+    // live in a fixed ring whose slots keep their query and timestamp storage; the queries are all created by the
+    // first call, and no later call allocates
+    void framePresented()
+    {
+        collectPresentedFrames(false);
+        if (frameEvents.empty())
+            return;
+        // the ring is full of frames the GPU has not finished: leave this one unmeasured rather than wait
+        if (issued - resolved >= PENDING_FRAMES)
+        {
+            frameEvents.clear();
+            return;
+        }
+        if (nextCalibration <= inputClockNow())
+            calibrate();
+
+        if (!pendingFrames[0].query)
+        {
+            for (PendingFrame& pending : pendingFrames)
+                pending.query.create("input", "present timestamp");
+        }
+        PendingFrame& frame = pendingFrames[issued % PENDING_FRAMES];
+        glQueryCounter(frame.query, GL_TIMESTAMP);
+        frame.eventTimestamps.assign(frameEvents.begin(), frameEvents.end());
+        frameEvents.clear();
+        issued++;
+    }
+
+    // the most recent event consumed by the current frame, or 0 if none
+    uint64_t latestEventTimestamp() const { return frameEvents.empty() ? 0 : frameEvents.back(); }
+
+    SampleSeries& latency() { return latencyMs; }
+    unsigned int droppedEvents() const { return dropped.load(std::memory_order_relaxed); }
+
+    void report(std::ostream& out)
+    {
+        collectPresentedFrames(true);
+        latencyMs.report(out, "input-to-present latency");
+        if (droppedEvents() > 0)
+            out << "input events dropped (queue full): " << droppedEvents() << std::endl;
+    }
+
+    // releases the GL queries; must run while the context is still current
+    void shutdown()
+    {
+        collectPresentedFrames(true);
+        for (PendingFrame& frame : pendingFrames)
+            frame.query.reset();
+    }
+
+private:
+    static const unsigned int EVENT_QUEUE = 1024;
+    static const int PENDING_FRAMES = 8;
+
+    struct PendingFrame
+    {
+        GpuQuery query;
+        std::vector<uint64_t> eventTimestamps;
+    };
+
+    SpscQueue<InputEvent, EVENT_QUEUE> queue;
+    std::atomic<unsigned int> dropped{ 0 };
+
+    bool keyDown[GLFW_KEY_LAST + 1];
+    bool keyTapped[GLFW_KEY_LAST + 1];
+    int actionKey[ACTION_COUNT];
+    bool actionDown[ACTION_COUNT];
+    bool actionPressed[ACTION_COUNT];
+    bool actionReleased[ACTION_COUNT];
+
+    bool firstMouse = true;
+    double lastX = 0.0, lastY = 0.0;
+    glm::vec2 mouseDelta = glm::vec2(0.0f);
+    float scrollDelta = 0.0f;
+
+    std::vector<uint64_t> frameEvents;
+    PendingFrame pendingFrames[PENDING_FRAMES];
+    unsigned long long issued = 0;
+    unsigned long long resolved = 0;
+    int64_t gpuToCpuOffset = 0;
+    uint64_t nextCalibration = 0;
+    SampleSeries latencyMs;
+
+    void enqueue(InputEventType type, int code, int action, double x, double y)
+    {
+        InputEvent event;
+        event.type = type;
+        event.code = code;
+        event.action = action;
+        event.x = x;
+        event.y = y;
+        event.timestamp = inputClockNow();
+        if (!queue.push(event))
+            dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // GPU and CPU clocks have different epochs; re-measure the offset once a second to follow drift
+    void calibrate()
+    {
+        GLint64 gpuNow = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+        gpuToCpuOffset = (int64_t)inputClockNow() - (int64_t)gpuNow;
+        nextCalibration = inputClockNow() + 1000000000ull;
+    }
+
+    void collectPresentedFrames(bool wait)
+    {
+        while (resolved < issued)
+        {
+            PendingFrame& frame = pendingFrames[resolved % PENDING_FRAMES];
+            GLint available = 0;
+            glGetQueryObjectiv(frame.query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available && !wait)
+                return;
+            GLuint64 gpuTime = 0;
+            glGetQueryObjectui64v(frame.query, GL_QUERY_RESULT, &gpuTime);
+            int64_t presented = (int64_t)gpuTime + gpuToCpuOffset;
+            for (uint64_t timestamp : frame.eventTimestamps)
+                latencyMs.add((double)(presented - (int64_t)timestamp) / 1.0e6);
+            resolved++;
+        }
+    }
+};
+
+#endif
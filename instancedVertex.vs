@@ -0,0 +1,59 @@
+#version 430 core
+layout (location = 0) in vec3 aPos;
+// baked meshes mix materials, so the slot in the material table comes with every vertex
+layout (location = 1) in uint aMaterial;
+layout (location = 2) in vec3 aNormal;
+// 0, 1, 2, ... per instance, offset by the draw command's baseInstance: the slot in the visible list
+layout (location = 3) in uint aInstanceSlot;
+
+// explicit locations so multiview.gs can sit between this stage and fragmentShader.fs
+layout (location = 0) flat out uint material;
+layout (location = 1) out vec3 worldPos;
+layout (location = 2) out vec3 normal;
+layout (location = 3) flat out uint occlusionFace;  // no baked ambient occlusion, see vertexShader.vs
+layout (location = 4) out vec2 occlusionUV;
+
+layout (std140) uniform CameraBlock
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+};
+
+// see GpuInstance in gpu_driven.h
+struct Instance
+{
+    vec4 positionYaw;
+    uvec4 mesh;
+};
+
+layout (std430, binding = 4) readonly buffer InstanceBuffer
+{
+    Instance instances[];
+};
+
+layout (std430, binding = 7) readonly buffer VisibleBuffer
+{
+    uint visibleInstances[];
+};
+
+// the depth pre-pass and the shading pass must produce identical depths for GL_EQUAL
+invariant gl_Position;
+
+void main()
+{
+    vec4 positionYaw = instances[visibleInstances[aInstanceSlot]].positionYaw;
+    float c = cos(positionYaw.w);
+    float s = sin(positionYaw.w);
+    // rotation around +Y, as glm::rotate
+    mat3 rotation = mat3(c, 0.0f, -s,
+                         0.0f, 1.0f, 0.0f,
+                         s, 0.0f, c);
+    worldPos = rotation * aPos + positionYaw.xyz;
+    gl_Position = viewProjection * vec4(worldPos, 1.0f);
+    normal = rotation * aNormal;
+    material = aMaterial;
+    occlusionFace = 0u;
+    occlusionUV = vec2(0.0f);
+}
@@ -0,0 +1,181 @@
+#ifndef light_benchmark_h
+#define light_benchmark_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "camera.h"
+#include "gpu_resources.h"
+#include "lighting.h"
+#include "stats.h"
+
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Renders the classroom from a fixed viewpoint with 4 to 1024 random lights, once with the clustered grid and once
+// with a single cluster (every fragment loops over every light), and reports the CPU assignment and GPU frame times.
+// It sweeps the counts twice. In the first sweep the light range shrinks with the cube root of the count, keeping the
+// total lit volume, and so the light density a fragment sees, constant: clustered frame time should stay flat while
+// the naive loop grows linearly, but only because the work per cluster is held fixed. The second keeps the range of
+// the classroom's own lights, so the lights per cluster grow with the count too; that is the load that separates the
+// two paths.
+class LightBenchmark
+{
+public:
+    static const int WARMUP_FRAMES = 5;
+    static const int MEASURED_FRAMES = 30;
+
+    void begin(ClusteredLighting& lighting)
+    {
+        savedLights = lighting.getLights();
+        savedGrid = lighting.getGrid();
+        running = true;
+        step = 0;
+        frame = 0;
+        results.clear();
+        query.create("benchmark", "frame time");
+        configure(lighting);
+    }
+
+    bool active() const { return running; }
+    bool finished() const { return step >= STEPS; }
+
+    // fixed viewpoint from the back of the room over all desks; forces the light assignment to be rebuilt so its cost
+    // is measured every frame
+    void beginFrame(Camera& camera, ClusteredLighting& lighting)
+    {
+        glm::vec3 position(2.5f, 2.0f, 2.0f);
+        camera.SetMode(FREE_FLY);
+        camera.SetZoom(ZOOM);
+        camera.SetPose(position, glm::quatLookAt(glm::normalize(glm::vec3(2.5f, 0.0f, -8.0f) - position), glm::vec3(0.0f, 1.0f, 0.0f)));
+        lighting.invalidate();
+    }
+
+    void gpuBegin() { glBeginQuery(GL_TIME_ELAPSED, query); }
+    void gpuEnd() { glEndQuery(GL_TIME_ELAPSED); }
+
+    void endFrame(ClusteredLighting& lighting)
+    {
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+        if (frame >= WARMUP_FRAMES)
+        {
+            buildMs.add(lighting.lastBuildMs());
+            gpuMs.add((double)elapsed / 1.0e6);
+        }
+        if (++frame < WARMUP_FRAMES + MEASURED_FRAMES)
+            return;
+
+        Result result;
+        result.lights = lightCount();
+        result.range = lightRange();
+        result.fixedRange = fixedRange();
+        result.clustered = clustered();
+        result.buildMs = buildMs.percentile(50.0);
+        result.gpuMs = gpuMs.percentile(50.0);
+        result.indices = lighting.lightIndexCount();
+        result.maxPerCluster = lighting.maxClusterLights();
+        results.push_back(result);
+        buildMs.clear();
+        gpuMs.clear();
+        frame = 0;
+        step++;
+        if (finished())
+        {
+            lighting.setLights(savedLights);
+            lighting.setGrid(savedGrid.x, savedGrid.y, savedGrid.z);
+        }
+        else
+        {
+            configure(lighting);
+        }
+    }
+
+    void report(std::ostream& out) const
+    {
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const Result& r = results[i];
+            if (i % (COUNTS * 2) == 0)
+            {
+                if (r.fixedRange)
+                    out << "fixed range " << FIXED_RANGE << " m: the lights per cluster grow with the count" << std::endl;
+                else
+                    out << "constant light density, range 6 * cbrt(4 / lights) m: the lights per cluster stay about the same"
+                        << std::endl;
+                out << std::fixed << std::setprecision(3)
+                    << std::setw(7) << "lights" << std::setw(9) << "range m" << std::setw(11) << "grid" << std::setw(12) << "assign ms"
+                    << std::setw(10) << "gpu ms" << std::setw(10) << "indices" << std::setw(13) << "max/cluster" << std::endl;
+            }
+            out << std::setw(7) << r.lights << std::setw(9) << r.range << std::setw(11) << (r.clustered ? "clustered" : "naive")
+                << std::setw(12) << r.buildMs << std::setw(10) << r.gpuMs
+                << std::setw(10) << r.indices << std::setw(13) << r.maxPerCluster << std::endl;
+        }
+    }
+
+    void destroy()
+    {
+        query.reset();
+        running = false;
+    }
+
+private:
+    static const int COUNTS = 5;
+    static const int STEPS = COUNTS * 2 * 2;
+    static constexpr float FIXED_RANGE = 6.0f;  // the ceiling lights'
+
+    struct Result
+    {
+        int lights;
+        float range;
+        bool fixedRange;
+        bool clustered;
+        double buildMs, gpuMs;
+        unsigned int indices, maxPerCluster;
+    };
+
+    bool running = false;
+    int step = 0;
+    int frame = 0;
+    GpuQuery query;
+    std::vector<Light> savedLights;
+    glm::ivec3 savedGrid;
+    SampleSeries buildMs{ SampleSeries::ALL };
+    SampleSeries gpuMs{ SampleSeries::ALL };
+    std::vector<Result> results;
+
+    int lightCount() const { return 4 << (2 * (step % (COUNTS * 2) / 2)); } // 4, 16, 64, 256, 1024
+    bool clustered() const { return step % 2 == 0; }
+    bool fixedRange() const { return step >= COUNTS * 2; }
+    float lightRange() const { return fixedRange() ? FIXED_RANGE : 6.0f * std::cbrt(4.0f / (float)lightCount()); }
+
+    void configure(ClusteredLighting& lighting)
+    {
+        int count = lightCount();
+        std::mt19937 random(1234u + count);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        float range = lightRange();
+        std::vector<Light> lights;
+        for (int i = 0; i < count; i++)
+        {
+            // inside the room: x in [-2.5, 7.5], y in [-0.7, 2.7], z in [-9, 3]
+            glm::vec3 position(-2.5f + 10.0f * unit(random), -0.7f + 3.4f * unit(random), -9.0f + 12.0f * unit(random));
+            glm::vec3 color(0.4f + 0.6f * unit(random), 0.4f + 0.6f * unit(random), 0.4f + 0.6f * unit(random));
+            if (i % 4 == 3)
+                lights.push_back(Light::spot(position, glm::vec3(unit(random) - 0.5f, -1.0f, unit(random) - 0.5f), color, 2.0f, range, 25.0f, 40.0f));
+            else
+                lights.push_back(Light::point(position, color, 2.0f, range));
+        }
+        lighting.setLights(lights);
+        if (clustered())
+            lighting.setGrid(ClusteredLighting::GRID_X, ClusteredLighting::GRID_Y, ClusteredLighting::GRID_Z);
+        else
+            lighting.setGrid(1, 1, 1);
+    }
+};
+
+#endif
@@ -0,0 +1,303 @@
+#ifndef lighting_h
+#define lighting_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "gpu_resources.h"
+#include "input.h"
+#include "shader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// shader storage binding points used by fragmentShader.fs
+const GLuint LIGHT_SSBO_BINDING = 1;
+const GLuint CLUSTER_SSBO_BINDING = 2;
+const GLuint LIGHT_INDEX_SSBO_BINDING = 3;
+
+// spot lights that cast shadows get a layer of the shadow map array, in light order, up to this many
+const int MAX_SHADOW_LIGHTS = 4;
+
+enum Light_Type {
+    POINT_LIGHT,
+    SPOT_LIGHT
+};
+
+struct Light
+{
+    Light_Type type = POINT_LIGHT;
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 color = glm::vec3(1.0f);
+    float intensity = 1.0f;
+    float range = 5.0f;                                 // the light has no effect beyond this distance
+    glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f); // spot lights only
+    float innerAngle = 20.0f;                           // degrees, full intensity inside
+    float outerAngle = 30.0f;                           // degrees, no light outside
+    bool castsShadows = false;                          // spot lights only
+
+    static Light point(const glm::vec3& position, const glm::vec3& color, float intensity, float range)
+    {
+        Light light;
+        light.position = position;
+        light.color = color;
+        light.intensity = intensity;
+        light.range = range;
+        return light;
+    }
+
+    static Light spot(const glm::vec3& position, const glm::vec3& direction, const glm::vec3& color, float intensity, float range, float innerAngle, float outerAngle)
+    {
+        Light light = point(position, color, intensity, range);
+        light.type = SPOT_LIGHT;
+        light.direction = glm::normalize(direction);
+        light.innerAngle = innerAngle;
+        light.outerAngle = outerAngle;
+        return light;
+    }
+};
+
+// std430 layout of one light in the shaders. Point lights get cone cosines no direction can fall below, so the shader
+// needs no branch on the type.
+struct GpuLight
+{
+    glm::vec4 positionRange;
+    glm::vec4 colorCosInner;     // colour premultiplied by intensity
+    glm::vec4 directionCosOuter;
+    glm::vec4 shadow;            // x: shadow map layer, -1 without
+};
+
+// shadow map layer of every light, -1 for lights without one
+inline std::vector<int> shadowLayers(const std::vector<Light>& lights)
+{
+    std::vector<int> layers(lights.size(), -1);
+    int next = 0;
+    for (size_t i = 0; i < lights.size() && next < MAX_SHADOW_LIGHTS; i++)
+    {
+        if (lights[i].type == SPOT_LIGHT && lights[i].castsShadows)
+            layers[i] = next++;
+    }
+    return layers;
+}
+
+// Clustered forward lighting. The view frustum is split into a grid of froxels, screen tiles in x/y and exponential
+// depth slices in z; every frame the lights' bounding spheres are assigned to the froxels they overlap on the CPU. The
+// fragment shader finds its froxel and only walks that froxel's light list, so shading cost follows the local light
+// density instead of the total light count. A 1x1x1 grid degenerates to the naive loop over every light.
+class ClusteredLighting
+{
+public:
+    static const int GRID_X = 16;
+    static const int GRID_Y = 9;
+    static const int GRID_Z = 24;
+
+    glm::vec3 ambient = glm::vec3(0.25f);
+
+    void init()
+    {
+        lightBuffer.create("lighting", "lights");
+        clusterBuffer.create("lighting", "clusters");
+        indexBuffer.create("lighting", "light indices");
+        setGrid(GRID_X, GRID_Y, GRID_Z);
+    }
+
+    void setGrid(int x, int y, int z)
+    {
+        grid = glm::ivec3(x, y, z);
+        dirty = true;
+    }
+
+    void setLights(const std::vector<Light>& newLights)
+    {
+        lights = newLights;
+        lightsDirty = true;
+        dirty = true;
+        lightsRevision++;
+    }
+
+    const std::vector<Light>& getLights() const { return lights; }
+    // changes whenever the lights are replaced, so dependent caches such as shadow maps can tell they are stale
+    unsigned int getLightsRevision() const { return lightsRevision; }
+    const glm::ivec3& getGrid() const { return grid; }
+
+    // the assignment only changes with the clustering camera, the lights or the grid
+    bool needsUpdate() const { return dirty; }
+    void invalidate() { dirty = true; }
+
+    // assigns the lights to froxels of the frustum given by view and projection and uploads the lists; the shader
+    // locates fragments with the same matrices, so the camera may still be re-latched afterwards
+    void update(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix, float nearPlane, float farPlane)
+    {
+        uint64_t start = inputClockNow();
+        view = viewMatrix;
+        projection = projectionMatrix;
+        depthRange = glm::vec2(nearPlane, farPlane);
+
+        size_t clusterCount = (size_t)grid.x * grid.y * grid.z;
+        clusters.assign(clusterCount * 2, 0);
+        ranges.clear();
+        float sliceScale = (float)grid.z / std::log(farPlane / nearPlane);
+        for (unsigned int i = 0; i < lights.size(); i++)
+        {
+            ClusterRange r;
+            if (!lightClusterRange(lights[i], nearPlane, farPlane, sliceScale, r))
+                continue;
+            r.light = i;
+            ranges.push_back(r);
+            forEachCluster(r, [&](size_t cluster) { clusters[cluster * 2 + 1]++; });
+        }
+
+        // offsets by prefix sum, then fill the index list in a second pass
+        GLuint total = 0;
+        maxLightsPerCluster = 0;
+        for (size_t c = 0; c < clusterCount; c++)
+        {
+            clusters[c * 2] = total;
+            total += clusters[c * 2 + 1];
+            maxLightsPerCluster = std::max(maxLightsPerCluster, (unsigned int)clusters[c * 2 + 1]);
+            clusters[c * 2 + 1] = 0;
+        }
+        indices.resize(std::max<GLuint>(total, 1));
+        for (const ClusterRange& r : ranges)
+        {
+            forEachCluster(r, [&](size_t cluster) {
+                indices[clusters[cluster * 2] + clusters[cluster * 2 + 1]++] = r.light;
+            });
+        }
+        indexCount = total;
+
+        if (lightsDirty)
+        {
+            uploadLights();
+            lightsDirty = false;
+        }
+        clusterBuffer.data(GL_SHADER_STORAGE_BUFFER, clusters.size() * sizeof(GLuint), clusters.data(), GL_STREAM_DRAW);
+        indexBuffer.data(GL_SHADER_STORAGE_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        dirty = false;
+        buildMs = (double)(inputClockNow() - start) / 1.0e6;
+    }
+
+    // binds the buffers and sets the clustering uniforms of a program that uses them
+    void apply(const Shader& shader) const
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_SSBO_BINDING, lightBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_SSBO_BINDING, clusterBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_INDEX_SSBO_BINDING, indexBuffer);
+        shader.setIVec3("clusterCount", grid);
+        shader.setVec2("clusterDepth", depthRange);
+        shader.setMat4("clusterView", view);
+        shader.setMat4("clusterProjection", projection);
+        shader.setVec3("ambientLight", ambient);
+    }
+
+    double lastBuildMs() const { return buildMs; }
+    unsigned int lightIndexCount() const { return indexCount; }
+    unsigned int maxClusterLights() const { return maxLightsPerCluster; }
+
+    void destroy()
+    {
+        lightBuffer.reset();
+        clusterBuffer.reset();
+        indexBuffer.reset();
+    }
+
+private:
+    struct ClusterRange
+    {
+        unsigned int light;
+        glm::ivec3 min, max;
+    };
+
+    GpuBuffer lightBuffer;
+    GpuBuffer clusterBuffer;
+    GpuBuffer indexBuffer;
+    glm::ivec3 grid = glm::ivec3(GRID_X, GRID_Y, GRID_Z);
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+    glm::vec2 depthRange = glm::vec2(0.1f, 100.0f);
+    std::vector<Light> lights;
+    std::vector<ClusterRange> ranges;
+    std::vector<GLuint> clusters;   // offset, count per froxel
+    std::vector<GLuint> indices;
+    bool dirty = true;
+    bool lightsDirty = true;
+    unsigned int lightsRevision = 0;
+    double buildMs = 0.0;
+    unsigned int indexCount = 0;
+    unsigned int maxLightsPerCluster = 0;
+
+    template <typename F>
+    void forEachCluster(const ClusterRange& r, F f) const
+    {
+        for (int z = r.min.z; z <= r.max.z; z++)
+            for (int y = r.min.y; y <= r.max.y; y++)
+                for (int x = r.min.x; x <= r.max.x; x++)
+                    f((size_t)x + (size_t)grid.x * ((size_t)y + (size_t)grid.y * z));
+    }
+
+    int slice(float depth, float nearPlane, float sliceScale) const
+    {
+        return glm::clamp((int)(std::log(depth / nearPlane) * sliceScale), 0, grid.z - 1);
+    }
+
+    // conservative froxel range of the light's bounding sphere; false when it is outside the frustum
+    bool lightClusterRange(const Light& light, float nearPlane, float farPlane, float sliceScale, ClusterRange& r) const
+    {
+        glm::vec3 center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+        float radius = light.range;
+        float closest = -center.z - radius;
+        float farthest = -center.z + radius;
+        if (farthest < nearPlane || closest > farPlane)
+            return false;
+        r.min.z = slice(glm::max(closest, nearPlane), nearPlane, sliceScale);
+        r.max.z = slice(glm::min(farthest, farPlane), nearPlane, sliceScale);
+        r.min.x = r.min.y = 0;
+        r.max.x = grid.x - 1;
+        r.max.y = grid.y - 1;
+        if (closest <= nearPlane)
+            return true; // the sphere reaches behind the near plane, its projection is unbounded
+
+        // project the corners of the sphere's view-space box; all are in front of the eye
+        glm::vec2 ndcMin(1.0f), ndcMax(-1.0f);
+        for (int corner = 0; corner < 8; corner++)
+        {
+            glm::vec3 offset((corner & 1) ? radius : -radius, (corner & 2) ? radius : -radius, (corner & 4) ? radius : -radius);
+            glm::vec4 clip = projection * glm::vec4(center + offset, 1.0f);
+            glm::vec2 ndc = glm::vec2(clip) / clip.w;
+            ndcMin = glm::min(ndcMin, ndc);
+            ndcMax = glm::max(ndcMax, ndc);
+        }
+        if (ndcMax.x < -1.0f || ndcMax.y < -1.0f || ndcMin.x > 1.0f || ndcMin.y > 1.0f)
+            return false;
+        glm::vec2 tiles = glm::vec2(grid.x, grid.y);
+        glm::ivec2 first = glm::ivec2(glm::floor((glm::clamp(ndcMin, -1.0f, 1.0f) * 0.5f + 0.5f) * tiles));
+        glm::ivec2 last = glm::ivec2(glm::floor((glm::clamp(ndcMax, -1.0f, 1.0f) * 0.5f + 0.5f) * tiles));
+        r.min.x = glm::clamp(first.x, 0, grid.x - 1);
+        r.min.y = glm::clamp(first.y, 0, grid.y - 1);
+        r.max.x = glm::clamp(last.x, 0, grid.x - 1);
+        r.max.y = glm::clamp(last.y, 0, grid.y - 1);
+        return true;
+    }
+
+    void uploadLights()
+    {
+        std::vector<GpuLight> gpu(std::max<size_t>(lights.size(), 1));
+        std::vector<int> layers = shadowLayers(lights);
+        for (size_t i = 0; i < lights.size(); i++)
+        {
+            const Light& l = lights[i];
+            bool spot = l.type == SPOT_LIGHT;
+            gpu[i].positionRange = glm::vec4(l.position, l.range);
+            gpu[i].colorCosInner = glm::vec4(l.color * l.intensity, spot ? std::cos(glm::radians(l.innerAngle)) : -1.0f);
+            gpu[i].directionCosOuter = glm::vec4(l.direction, spot ? std::cos(glm::radians(l.outerAngle)) : -2.0f);
+            gpu[i].shadow = glm::vec4((float)layers[i], 0.0f, 0.0f, 0.0f);
+        }
+        lightBuffer.data(GL_SHADER_STORAGE_BUFFER, gpu.size() * sizeof(GpuLight), gpu.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+};
+
+#endif
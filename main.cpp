@@ -14,21 +14,78 @@
 
 #include "shader.h"
 #include "camera.h"
-#include "basic_camera.h"
+#include "input.h"
+#include "scene.h"
+#include "shadows.h"
+#include "softraster.h"
+#include "ambient_occlusion.h"
+#include "antialiasing.h"
+#include "dynamic_resolution.h"
+#include "telemetry.h"
+#include "assets.h"
+#include "camera_ubo.h"
+#include "capture.h"
+#include "depth_prepass.h"
+#include "frame_arena.h"
+#include "frame_pacer.h"
+#include "gpu_driven.h"
+#include "lighting.h"
+#include "light_benchmark.h"
+#include "materials.h"
+#include "multiview.h"
+#include "portals.h"
+#include "primitives.h"
+#include "regression.h"
+#include "render_graph.h"
+#include "render_target.h"
+#include "rigid_animation.h"
+#include "session.h"
+#include "streaming.h"
 #include "table_chair.h"
 #include "fan.h"
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
 
 using namespace std;
 
+#ifdef COUNT_HEAP_ALLOCATIONS
+// every heap allocation is counted, so the frame arena's report shows whether the frame loop still makes any; a
+// diagnostic build only (Debug, or -DCOUNT_HEAP_ALLOCATIONS=ON), the shipped binary keeps the default allocator
+void* operator new(size_t bytes)
+{
+	heapAllocations().fetch_add(1, std::memory_order_relaxed);
+	if (void* memory = std::malloc(bytes ? bytes : 1))
+		return memory;
+	throw std::bad_alloc();
+}
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+#endif
+
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
-void processInput(GLFWwindow* window);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
+void processInput(GLFWwindow* window, const FrameInput& frameInput);
+void updateCamera(GLFWwindow* window);
+AssetTask streamDesks(AssetPipeline& assets, AssetGroup& group, GpuDrivenScene& desks, MeshBuilder deskMesh, int count);
+MeshBuilder buildDeskMesh();
+glm::vec3 deskGridPosition(int desk, int count);
+void addClassroom(DrawList& scene, unsigned int boxVAO, float dx, bool doorway, bool furniture, bool fanGrid);
+void addCorridor(DrawList& scene, unsigned int boxVAO, float dx, bool firstSegment, bool lastSegment);
+void addDoorWall(DrawList& scene, unsigned int boxVAO, float dx, float z, unsigned int material);
+void applyViewLayout(int width, int height);
+std::vector<Light> classroomLightList(int rooms);
+std::vector<Material> classroomMaterialList();
+int runSoftwareRenderer(const char* directory, int threads);
+int runOcclusionBake(const char* path, int samples, int threads);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+const char* const WINDOW_TITLE = "CSE 4208: Computer Graphics Laboratory";
 
 // modelling transform
 float rotateAngle_X = 0;
@@ -44,21 +101,131 @@ float scale_X = 1.0;
 float scale_Y = 1.0;
 float scale_Z = 1.0;
 bool fan_turn = false;
+// the fans' blades spin in the vertex shader; fan_time only advances while they turn (G)
+const float FAN_SPEED = glm::radians(300.0f);	// 5 degrees a frame at 60 Hz
+float fan_time = 0.0f;
 bool rotate_around = false;
 // camera
 Camera camera(glm::vec3(0.0f, 2.5f, 3.0f));
-float lastX = SCR_WIDTH / 2.0f;
-float lastY = SCR_HEIGHT / 2.0f;
-bool firstMouse = true;
 
-float eyeX = 0.0, eyeY = 1.0, eyeZ = 3.0;
-float lookAtX = 0.0, lookAtY = 0.0, lookAtZ = 0.0;
-glm::vec3 V = glm::vec3(0.0f, 1.0f, 0.0f);
-BasicCamera basic_camera(eyeX, eyeY, eyeZ, lookAtX, lookAtY, lookAtZ, V);
+// input
+InputSystem input;
+
+// centre of the classroom, used as the orbit and look-at target
+const glm::vec3 ROOM_CENTER = glm::vec3(2.5f, 0.5f, -3.0f);
+
+// late latching: the camera is re-sampled right before the swap, so culling uses a frustum widened by this many
+// degrees to keep objects the final pose may have turned towards
+const float LATE_LATCH_FOV_MARGIN = 10.0f;
+bool late_latch = true;
+CameraUniformBuffer cameraUBO;
+FramePacer pacer;
+// the frame's passes, culled, ordered and timed by the render graph
+RenderGraph renderGraph;
+
+// depth pre-pass, the overdraw heat map (F8) and the A/B measurement that picks the pre-pass per scene (F9)
+DepthPrepass depthPrepass;
+PrepassAdvisor prepassAdvisor;
+OverdrawCounter overdraw;
+bool overdraw_view = false;
+bool overdraw_measure = false;	// set when leaving the heat map, which then measures its last frame
+
+// colours and surfaces of every mesh, editable while running (F10 cycles the desk tops)
+MaterialTable materials;
+const glm::vec3 DESK_TOP_COLORS[] = {
+	glm::vec3(0.59f, 0.19f, 0.0f),
+	glm::vec3(0.76f, 0.6f, 0.42f),
+	glm::vec3(0.33f, 0.21f, 0.12f),
+	glm::vec3(0.55f, 0.55f, 0.55f),
+};
+int desk_top_color = 0;
+
+// a floor of classrooms side by side along x, sharing no walls, with the corridor behind their back walls; the
+// doorways are at these room-relative x and top y. F11 shows the cells the portals let the camera see
+const float CLASSROOM_SPACING = 10.1f;
+const float DOOR_LEFT = 5.0f;
+const float DOOR_RIGHT = 6.5f;
+const float DOOR_TOP = 1.45f;
+const int MAX_ROOMS = 256;
+// --fan-grid: a fan on every ceiling tile, offset from the classroom's own fan
+const glm::vec2 FAN_TILE_OFFSETS[] = {
+	glm::vec2(0.0f, 0.0f), glm::vec2(-3.5f, 0.0f), glm::vec2(3.5f, 0.0f),
+	glm::vec2(-3.5f, 3.5f), glm::vec2(0.0f, 3.5f), glm::vec2(3.5f, 3.5f),
+	glm::vec2(-3.5f, 7.0f), glm::vec2(0.0f, 7.0f), glm::vec2(3.5f, 7.0f),
+};
+bool cell_overlay = false;
+
+// the fly camera with the front, back and overhead monitors of the first classroom beside it, all drawn in one pass (F12)
+const MonitorView CLASSROOM_MONITORS[] = {
+	{ glm::vec3(2.5f, 2.3f, -8.5f), glm::vec3(2.5f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f), 60.0f },
+	{ glm::vec3(2.5f, 2.3f, 2.5f), glm::vec3(2.5f, 0.5f, -8.0f), glm::vec3(0.0f, 1.0f, 0.0f), 60.0f },
+	{ glm::vec3(2.5f, 2.6f, -3.0f), glm::vec3(2.5f, -0.8f, -3.0f), glm::vec3(0.0f, 0.0f, -1.0f), 110.0f },
+};
+MultiView multiview;
+bool multi_view = false;
+
+// anti-aliasing of the scene, cycled with F4; the report compares the GPU time and memory of the modes used
+Antialiasing antialiasing;
+
+// scene resolution that follows the GPU frame time (--dynamic-res); the single view only, the monitor layout is fixed
+DynamicResolution dynamicResolution;
+
+// live frame numbers in shared memory for monitoring (--telemetry)
+TelemetryPublisher telemetry;
+
+// command line: session recording and replay
+struct AppOptions {
+	const char* recordPath = NULL;	// --record <file>
+	const char* replayPath = NULL;	// --replay <file>
+	const char* reportPath = NULL;	// --report <file.csv>, per-frame replay measurements
+	bool replayPoses = false;		// --replay-poses: follow the recorded camera poses instead of re-simulating input
+	bool headless = false;			// --headless: hidden window, render offscreen
+	float fixedDelta = 1.0f / 60.0f;	// --fixed-dt <seconds>: camera and fan step of every recorded frame; a replay takes it from its file
+	const char* regressPath = NULL;	// --regress <dir>: render the canonical viewpoints and compare with the golden images in dir
+	bool regressUpdate = false;		// --regress-update: write the golden images instead of comparing
+	bool lightBench = false;		// --light-bench: clustered vs naive lighting with 4 to 1024 lights, at constant density and at a fixed range
+	std::string prepass = "auto";	// --prepass on|off|auto; auto measures both at startup, and means off when measuring
+	bool gpuDriven = false;			// --gpu-driven: desks are culled in a compute shader and drawn with one indirect call
+	int desks = 16;					// --desks <n>: desk count of the gpu-driven scene, laid out in a square grid
+	int rooms = 1;					// --rooms <n>: classrooms along a corridor, drawn through portal/cell visibility
+	float roomCpuBudget = 32.0f;	// --room-cpu-budget <MB>: baked rooms kept in memory, 0 for no limit
+	float roomGpuBudget = 16.0f;	// --room-gpu-budget <MB>: rooms resident on the GPU, 0 for no limit
+	const char* softRenderPath = NULL;	// --soft-render <dir>: render the regression viewpoints on the CPU, without a GPU
+	int softThreads = 0;			// --soft-threads <n>: threads of the software renderer, 0 for every core
+	const char* capturePath = NULL;	// --capture <file.y4m | prefix>: record the frames as video or numbered PPM images
+	bool multiView = false;			// --multiview: start with the monitor views beside the fly camera
+	bool fanGrid = false;			// --fan-grid: a spinning fan on every ceiling tile of every classroom
+	float gpuBudget = 0.0f;			// --gpu-budget <MB>: warn when the GPU memory owned by the renderer exceeds it
+	Antialiasing_Mode antialiasing = AA_NONE;	// --aa none|msaa2|msaa4|msaa8|fxaa|taa
+	float dynamicResTarget = 0.0f;	// --dynamic-res <ms>: scale the scene resolution to hold this GPU frame time
+	float resolutionMin = 0.5f;		// --res-min <scale>: smallest scale per axis
+	float resolutionMax = 1.0f;		// --res-max <scale>: largest scale per axis, above 1 supersamples
+	float resolutionHysteresis = 0.1f;	// --res-hysteresis <fraction>: frame times this close to the target keep the scale
+	float sharpness = 0.3f;			// --sharpness <0..1>: sharpening of the upscaled frame
+	const char* telemetryName = NULL;	// --telemetry <name>: publish every frame's numbers into shared memory
+	const char* telemetryWatch = NULL;	// --telemetry-watch <name>: print the frames a running renderer publishes
+	const char* telemetryStats = NULL;	// --telemetry-stats <name>: aggregate them over --telemetry-seconds
+	double telemetrySeconds = 10.0;	// --telemetry-seconds <s>
+	const char* occlusionPath = NULL;	// --ao <file>: ambient occlusion baked by --bake-ao for the same scene options
+	const char* bakePath = NULL;	// --bake-ao <file>: ray trace the ambient occlusion of the scene and exit
+	int aoSamples = 64;				// --ao-samples <n>: rays per texel of the bake
+	int bakeThreads = 0;			// --bake-threads <n>: threads of the bake, 0 for every core
+};
+AppOptions options;
+SessionRecorder recorder;
+FrameCapture capture;
+FrameInput recordedInput;	// input of all camera updates of the current frame
 
 // timing
 float deltaTime = 0.0f;    // time between current frame and last frame
 float lastFrame = 0.0f;
+float lastCameraUpdate = 0.0f;
+
+// one box shared by every draw, generated at compile time in the lit layout; colours come from the material table
+constexpr primitives::Mesh<24, CUBE_INDEX_COUNT> cube_mesh = primitives::box({ 0.0f, 0.0f, 0.0f }, { 0.5f, 0.5f, 0.5f });
+const float* const cube_vertices = cube_mesh.vertices.data();
+const unsigned int* const cube_indices = cube_mesh.indices.data();
+static_assert(primitives::VERTEX_FLOATS == BOX_VERTEX_FLOATS, "primitives.h must generate the lit box layout");
 
 glm::mat4 transforamtion(float tx, float ty, float tz, float rx, float ry, float rz, float sx, float sy, float sz) {
 	glm::mat4 identityMatrix = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
@@ -72,22 +239,155 @@ glm::mat4 transforamtion(float tx, float ty, float tz, float rx, float ry, float
 	return model;
 }
 
-int main()
+int main(int argc, char** argv)
 {
+	for (int arg = 1; arg < argc; arg++) {
+		std::string name = argv[arg];
+		bool hasValue = arg + 1 < argc;
+		if (name == "--record" && hasValue)
+			options.recordPath = argv[++arg];
+		else if (name == "--replay" && hasValue)
+			options.replayPath = argv[++arg];
+		else if (name == "--report" && hasValue)
+			options.reportPath = argv[++arg];
+		else if (name == "--fixed-dt" && hasValue) {
+			options.fixedDelta = (float)atof(argv[++arg]);
+			if (!(options.fixedDelta > 0.0f)) {
+				std::cout << "--fixed-dt needs a positive number of seconds, not " << argv[arg] << std::endl;
+				return -1;
+			}
+		}
+		else if (name == "--replay-poses")
+			options.replayPoses = true;
+		else if (name == "--headless")
+			options.headless = true;
+		else if (name == "--regress" && hasValue)
+			options.regressPath = argv[++arg];
+		else if (name == "--regress-update")
+			options.regressUpdate = true;
+		else if (name == "--light-bench")
+			options.lightBench = true;
+		else if (name == "--prepass" && hasValue)
+			options.prepass = argv[++arg];
+		else if (name == "--gpu-driven")
+			options.gpuDriven = true;
+		else if (name == "--desks" && hasValue) {
+			options.desks = glm::max(1, atoi(argv[++arg]));
+			options.gpuDriven = true;
+		}
+		else if (name == "--rooms" && hasValue)
+			options.rooms = glm::clamp(atoi(argv[++arg]), 1, MAX_ROOMS);
+		else if (name == "--room-cpu-budget" && hasValue)
+			options.roomCpuBudget = (float)atof(argv[++arg]);
+		else if (name == "--room-gpu-budget" && hasValue)
+			options.roomGpuBudget = (float)atof(argv[++arg]);
+		else if (name == "--soft-render" && hasValue)
+			options.softRenderPath = argv[++arg];
+		else if (name == "--soft-threads" && hasValue)
+			options.softThreads = glm::max(0, atoi(argv[++arg]));
+		else if (name == "--capture" && hasValue)
+			options.capturePath = argv[++arg];
+		else if (name == "--multiview")
+			options.multiView = true;
+		else if (name == "--fan-grid")
+			options.fanGrid = true;
+		else if (name == "--gpu-budget" && hasValue)
+			options.gpuBudget = (float)atof(argv[++arg]);
+		else if (name == "--ao" && hasValue)
+			options.occlusionPath = argv[++arg];
+		else if (name == "--bake-ao" && hasValue)
+			options.bakePath = argv[++arg];
+		else if (name == "--ao-samples" && hasValue)
+			options.aoSamples = glm::max(1, atoi(argv[++arg]));
+		else if (name == "--bake-threads" && hasValue)
+			options.bakeThreads = glm::max(0, atoi(argv[++arg]));
+		else if (name == "--aa" && hasValue) {
+			if (!parseAntialiasingMode(argv[++arg], options.antialiasing)) {
+				std::cout << "unknown anti-aliasing mode " << argv[arg] << std::endl;
+				return -1;
+			}
+		}
+		else if (name == "--dynamic-res" && hasValue)
+			options.dynamicResTarget = (float)atof(argv[++arg]);
+		else if (name == "--res-min" && hasValue)
+			options.resolutionMin = (float)atof(argv[++arg]);
+		else if (name == "--res-max" && hasValue)
+			options.resolutionMax = (float)atof(argv[++arg]);
+		else if (name == "--res-hysteresis" && hasValue)
+			options.resolutionHysteresis = (float)atof(argv[++arg]);
+		else if (name == "--sharpness" && hasValue)
+			options.sharpness = (float)atof(argv[++arg]);
+		else if (name == "--telemetry" && hasValue)
+			options.telemetryName = argv[++arg];
+		else if (name == "--telemetry-watch" && hasValue)
+			options.telemetryWatch = argv[++arg];
+		else if (name == "--telemetry-stats" && hasValue)
+			options.telemetryStats = argv[++arg];
+		else if (name == "--telemetry-seconds" && hasValue)
+			options.telemetrySeconds = atof(argv[++arg]);
+		else {
+			std::cout << "unknown option " << name << std::endl;
+			return -1;
+		}
+	}
+	if (options.softRenderPath)
+		return runSoftwareRenderer(options.softRenderPath, options.softThreads);
+	if (options.bakePath)
+		return runOcclusionBake(options.bakePath, options.aoSamples, options.bakeThreads);
+	if (options.telemetryWatch)
+		return runTelemetryWatch(options.telemetryWatch);
+	if (options.telemetryStats)
+		return runTelemetryStats(options.telemetryStats, options.telemetrySeconds);
+	if (options.gpuBudget > 0.0f)
+		gpuResources().setBudget("", (size_t)(options.gpuBudget * 1024.0f * 1024.0f));
+	SessionPlayer player;
+	bool replaying = options.replayPath != NULL;
+	if (replaying && !player.open(options.replayPath))
+		return -1;
+	// a replay steps by the delta it was recorded with, whatever --fixed-dt says
+	if (replaying)
+		options.fixedDelta = player.header.fixedDelta;
+
+	// regression runs are offscreen on Mesa's llvmpipe so golden images match on machines without a GPU, and on one
+	// rasteriser thread, the configuration the time budgets are measured in; an explicitly set driver environment is
+	// left alone
+	RegressionRunner regression;
+	LightBenchmark lightBench;
+	if (options.lightBench)
+		options.headless = true;
+	if (options.regressPath) {
+		options.headless = true;
+#ifdef _WIN32
+		if (!getenv("GALLIUM_DRIVER"))
+			_putenv_s("GALLIUM_DRIVER", "llvmpipe");
+		if (!getenv("LIBGL_ALWAYS_SOFTWARE"))
+			_putenv_s("LIBGL_ALWAYS_SOFTWARE", "1");
+		if (!getenv("LP_NUM_THREADS"))
+			_putenv_s("LP_NUM_THREADS", "1");
+#else
+		setenv("GALLIUM_DRIVER", "llvmpipe", 0);
+		setenv("LIBGL_ALWAYS_SOFTWARE", "1", 0);
+		setenv("LP_NUM_THREADS", "1", 0);
+#endif
+	}
+
 	// glfw: initialize and configure
 	// ------------------------------
 	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	// 4.3 for the shader storage buffers of the clustered lighting
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
 #ifdef __APPLE__
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
+	if (options.headless)
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
 	// glfw window creation
 	// --------------------
-	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "CSE 4208: Computer Graphics Laboratory", NULL, NULL);
+	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, WINDOW_TITLE, NULL, NULL);
 	if (window == NULL)
 	{
 		std::cout << "Failed to create GLFW window" << std::endl;
@@ -98,9 +398,15 @@ int main()
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 	glfwSetCursorPosCallback(window, mouse_callback);
 	glfwSetScrollCallback(window, scroll_callback);
+	glfwSetKeyCallback(window, key_callback);
+	glfwSetMouseButtonCallback(window, mouse_button_callback);
+
+	camera.SetAspectRatio((float)SCR_WIDTH / (float)SCR_HEIGHT);
+	camera.SetTarget(ROOM_CENTER);
 
 	// tell GLFW to capture our mouse
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	if (!options.headless)
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
 	// glad: load all OpenGL function pointers
 	// ---------------------------------------
@@ -113,1009 +419,973 @@ int main()
 	// configure global opengl state
 	// -----------------------------
 	glEnable(GL_DEPTH_TEST);
+	glfwSwapInterval(1);
 
-	// build and compile our shader zprogram
+	// build and compile our shader programs in the background; the first frames only clear until they have arrived
 	// ------------------------------------
-	Shader ourShader("vertexShader.vs", "fragmentShader.fs");
-	//0.59f, 0.19f, 0.0f,
-	float table_top[] = {
-		0.0f, 0.0f, 0.0f, 0.59f, 0.19f, 0.0f,
-		0.5f, 0.0f, 0.0f, 0.59f, 0.19f, 0.0f,
-		0.5f, 0.5f, 0.0f, 0.59f, 0.19f, 0.0f,
-		0.0f, 0.5f, 0.0f, 0.59f, 0.19f, 0.0f,
-
-		0.5f, 0.0f, 0.0f, 0.59f, 0.19f, 0.0f,
-		0.5f, 0.5f, 0.0f, 0.59f, 0.19f, 0.0f,
-		0.5f, 0.0f, 0.5f, 0.59f, 0.19f, 0.0f,
-		0.5f, 0.5f, 0.5f, 0.59f, 0.19f, 0.0f,
-
-		0.0f, 0.0f, 0.5f, 0.59f, 0.19f, 0.0f,
-		0.5f, 0.0f, 0.5f, 0.59f, 0.19f, 0.0f,
-		0.5f, 0.5f, 0.5f, 0.59f, 0.19f, 0.0f,
-		0.0f, 0.5f, 0.5f, 0.59f, 0.19f, 0.0f,
-
-		0.0f, 0.0f, 0.5f, 0.59f, 0.19f, 0.0f,
-		0.0f, 0.5f, 0.5f, 0.59f, 0.19f, 0.0f,
-		0.0f, 0.5f, 0.0f, 0.59f, 0.19f, 0.0f,
-		0.0f, 0.0f, 0.0f, 0.59f, 0.19f, 0.0f,
-
-		0.5f, 0.5f, 0.5f, 0.59f, 0.19f, 0.0f,
-		0.5f, 0.5f, 0.0f, 0.59f, 0.19f, 0.0f,
-		0.0f, 0.5f, 0.0f, 0.59f, 0.19f, 0.0f,
-		0.0f, 0.5f, 0.5f, 0.59f, 0.19f, 0.0f,
-
-		0.0f, 0.0f, 0.0f, 0.59f, 0.19f, 0.0f,
-		0.5f, 0.0f, 0.0f, 0.59f, 0.19f, 0.0f,
-		0.5f, 0.0f, 0.5f, 0.59f, 0.19f, 0.0f,
-		0.0f, 0.0f, 0.5f, 0.59f, 0.19f, 0.0f
-	};
-	//0.80f, 0.59f, 0.0f,
-	float table_leg[] = {
-		0.0f, 0.0f, 0.0f, 0.80f, 0.59f, 0.0f,
-		0.5f, 0.0f, 0.0f, 0.80f, 0.59f, 0.0f,
-		0.5f, 0.5f, 0.0f, 0.80f, 0.59f, 0.0f,
-		0.0f, 0.5f, 0.0f, 0.80f, 0.59f, 0.0f,
-
-		0.5f, 0.0f, 0.0f, 0.80f, 0.59f, 0.0f,
-		0.5f, 0.5f, 0.0f, 0.80f, 0.59f, 0.0f,
-		0.5f, 0.0f, 0.5f, 0.80f, 0.59f, 0.0f,
-		0.5f, 0.5f, 0.5f, 0.80f, 0.59f, 0.0f,
-
-		0.0f, 0.0f, 0.5f, 0.80f, 0.59f, 0.0f,
-		0.5f, 0.0f, 0.5f, 0.80f, 0.59f, 0.0f,
-		0.5f, 0.5f, 0.5f, 0.80f, 0.59f, 0.0f,
-		0.0f, 0.5f, 0.5f, 0.80f, 0.59f, 0.0f,
-
-		0.0f, 0.0f, 0.5f, 0.80f, 0.59f, 0.0f,
-		0.0f, 0.5f, 0.5f, 0.80f, 0.59f, 0.0f,
-		0.0f, 0.5f, 0.0f, 0.80f, 0.59f, 0.0f,
-		0.0f, 0.0f, 0.0f, 0.80f, 0.59f, 0.0f,
-
-		0.5f, 0.5f, 0.5f, 0.80f, 0.59f, 0.0f,
-		0.5f, 0.5f, 0.0f, 0.80f, 0.59f, 0.0f,
-		0.0f, 0.5f, 0.0f, 0.80f, 0.59f, 0.0f,
-		0.0f, 0.5f, 0.5f, 0.80f, 0.59f, 0.0f,
-
-		0.0f, 0.0f, 0.0f, 0.80f, 0.59f, 0.0f,
-		0.5f, 0.0f, 0.0f, 0.80f, 0.59f, 0.0f,
-		0.5f, 0.0f, 0.5f, 0.80f, 0.59f, 0.0f,
-		0.0f, 0.0f, 0.5f, 0.80f, 0.59f, 0.0f
-	};
-	//0.39f, 0.3f, 0.0f,
-	float chair_leg[] = {
-		0.0f, 0.0f, 0.0f, 0.39f, 0.3f, 0.0f,
-		0.5f, 0.0f, 0.0f, 0.39f, 0.3f, 0.0f,
-		0.5f, 0.5f, 0.0f, 0.39f, 0.3f, 0.0f,
-		0.0f, 0.5f, 0.0f, 0.39f, 0.3f, 0.0f,
-
-		0.5f, 0.0f, 0.0f, 0.39f, 0.3f, 0.0f,
-		0.5f, 0.5f, 0.0f, 0.39f, 0.3f, 0.0f,
-		0.5f, 0.0f, 0.5f, 0.39f, 0.3f, 0.0f,
-		0.5f, 0.5f, 0.5f, 0.39f, 0.3f, 0.0f,
-
-		0.0f, 0.0f, 0.5f, 0.39f, 0.3f, 0.0f,
-		0.5f, 0.0f, 0.5f, 0.39f, 0.3f, 0.0f,
-		0.5f, 0.5f, 0.5f, 0.39f, 0.3f, 0.0f,
-		0.0f, 0.5f, 0.5f, 0.39f, 0.3f, 0.0f,
-
-		0.0f, 0.0f, 0.5f, 0.39f, 0.3f, 0.0f,
-		0.0f, 0.5f, 0.5f, 0.39f, 0.3f, 0.0f,
-		0.0f, 0.5f, 0.0f, 0.39f, 0.3f, 0.0f,
-		0.0f, 0.0f, 0.0f, 0.39f, 0.3f, 0.0f,
-
-		0.5f, 0.5f, 0.5f, 0.39f, 0.3f, 0.0f,
-		0.5f, 0.5f, 0.0f, 0.39f, 0.3f, 0.0f,
-		0.0f, 0.5f, 0.0f, 0.39f, 0.3f, 0.0f,
-		0.0f, 0.5f, 0.5f, 0.39f, 0.3f, 0.0f,
-
-		0.0f, 0.0f, 0.0f, 0.39f, 0.3f, 0.0f,
-		0.5f, 0.0f, 0.0f, 0.39f, 0.3f, 0.0f,
-		0.5f, 0.0f, 0.5f, 0.39f, 0.3f, 0.0f,
-		0.0f, 0.0f, 0.5f, 0.39f, 0.3f, 0.0f
-	};
-	//.2f, .2f, .02f,
-	float chair_pillar[] = {
-		0.0f, 0.0f, 0.0f, .2f, .2f, .02f,
-		0.5f, 0.0f, 0.0f, .2f, .2f, .02f,
-		0.5f, 0.5f, 0.0f, .2f, .2f, .02f,
-		0.0f, 0.5f, 0.0f, .2f, .2f, .02f,
-
-		0.5f, 0.0f, 0.0f, .2f, .2f, .02f,
-		0.5f, 0.5f, 0.0f, .2f, .2f, .02f,
-		0.5f, 0.0f, 0.5f, .2f, .2f, .02f,
-		0.5f, 0.5f, 0.5f, .2f, .2f, .02f,
-
-		0.0f, 0.0f, 0.5f, .2f, .2f, .02f,
-		0.5f, 0.0f, 0.5f, .2f, .2f, .02f,
-		0.5f, 0.5f, 0.5f, .2f, .2f, .02f,
-		0.0f, 0.5f, 0.5f, .2f, .2f, .02f,
-
-		0.0f, 0.0f, 0.5f, .2f, .2f, .02f,
-		0.0f, 0.5f, 0.5f, .2f, .2f, .02f,
-		0.0f, 0.5f, 0.0f, .2f, .2f, .02f,
-		0.0f, 0.0f, 0.0f, .2f, .2f, .02f,
-
-		0.5f, 0.5f, 0.5f, .2f, .2f, .02f,
-		0.5f, 0.5f, 0.0f, .2f, .2f, .02f,
-		0.0f, 0.5f, 0.0f, .2f, .2f, .02f,
-		0.0f, 0.5f, 0.5f, .2f, .2f, .02f,
-
-		0.0f, 0.0f, 0.0f, .2f, .2f, .02f,
-		0.5f, 0.0f, 0.0f, .2f, .2f, .02f,
-		0.5f, 0.0f, 0.5f, .2f, .2f, .02f,
-		0.0f, 0.0f, 0.5f, .2f, .2f, .02f
-	};
-	//0.9f, 0.9f, 0.0f,
-	float chair_back[] = {
-		0.0f, 0.0f, 0.0f, 0.9f, 0.9f, 0.0f,
-		0.5f, 0.0f, 0.0f, 0.9f, 0.9f, 0.0f,
-		0.5f, 0.5f, 0.0f, 0.9f, 0.9f, 0.0f,
-		0.0f, 0.5f, 0.0f, 0.9f, 0.9f, 0.0f,
-
-		0.5f, 0.0f, 0.0f, 0.9f, 0.9f, 0.0f,
-		0.5f, 0.5f, 0.0f, 0.9f, 0.9f, 0.0f,
-		0.5f, 0.0f, 0.5f, 0.9f, 0.9f, 0.0f,
-		0.5f, 0.5f, 0.5f, 0.9f, 0.9f, 0.0f,
-
-		0.0f, 0.0f, 0.5f, 0.9f, 0.9f, 0.0f,
-		0.5f, 0.0f, 0.5f, 0.9f, 0.9f, 0.0f,
-		0.5f, 0.5f, 0.5f, 0.9f, 0.9f, 0.0f,
-		0.0f, 0.5f, 0.5f, 0.9f, 0.9f, 0.0f,
-
-		0.0f, 0.0f, 0.5f, 0.9f, 0.9f, 0.0f,
-		0.0f, 0.5f, 0.5f, 0.9f, 0.9f, 0.0f,
-		0.0f, 0.5f, 0.0f, 0.9f, 0.9f, 0.0f,
-		0.0f, 0.0f, 0.0f, 0.9f, 0.9f, 0.0f,
-
-		0.5f, 0.5f, 0.5f, 0.9f, 0.9f, 0.0f,
-		0.5f, 0.5f, 0.0f, 0.9f, 0.9f, 0.0f,
-		0.0f, 0.5f, 0.0f, 0.9f, 0.9f, 0.0f,
-		0.0f, 0.5f, 0.5f, 0.9f, 0.9f, 0.0f,
-
-		0.0f, 0.0f, 0.0f, 0.9f, 0.9f, 0.0f,
-		0.5f, 0.0f, 0.0f, 0.9f, 0.9f, 0.0f,
-		0.5f, 0.0f, 0.5f, 0.9f, 0.9f, 0.0f,
-		0.0f, 0.0f, 0.5f, 0.9f, 0.9f, 0.0f
-	};
-	//0.69f, 0.69f, 0.69f,
-	float floor[] = {
-		0.0f, 0.0f, 0.0f, 0.69f, 0.69f, 0.69f,
-		0.5f, 0.0f, 0.0f, 0.69f, 0.69f, 0.69f,
-		0.5f, 0.5f, 0.0f, 0.69f, 0.69f, 0.69f,
-		0.0f, 0.5f, 0.0f, 0.69f, 0.69f, 0.69f,
-
-		0.5f, 0.0f, 0.0f, 0.69f, 0.69f, 0.69f,
-		0.5f, 0.5f, 0.0f, 0.69f, 0.69f, 0.69f,
-		0.5f, 0.0f, 0.5f, 0.69f, 0.69f, 0.69f,
-		0.5f, 0.5f, 0.5f, 0.69f, 0.69f, 0.69f,
-
-		0.0f, 0.0f, 0.5f, 0.69f, 0.69f, 0.69f,
-		0.5f, 0.0f, 0.5f, 0.69f, 0.69f, 0.69f,
-		0.5f, 0.5f, 0.5f, 0.69f, 0.69f, 0.69f,
-		0.0f, 0.5f, 0.5f, 0.69f, 0.69f, 0.69f,
-
-		0.0f, 0.0f, 0.5f, 0.69f, 0.69f, 0.69f,
-		0.0f, 0.5f, 0.5f, 0.69f, 0.69f, 0.69f,
-		0.0f, 0.5f, 0.0f, 0.69f, 0.69f, 0.69f,
-		0.0f, 0.0f, 0.0f, 0.69f, 0.69f, 0.69f,
-
-		0.5f, 0.5f, 0.5f, 0.69f, 0.69f, 0.69f,
-		0.5f, 0.5f, 0.0f, 0.69f, 0.69f, 0.69f,
-		0.0f, 0.5f, 0.0f, 0.69f, 0.69f, 0.69f,
-		0.0f, 0.5f, 0.5f, 0.69f, 0.69f, 0.69f,
-
-		0.0f, 0.0f, 0.0f, 0.69f, 0.69f, 0.69f,
-		0.5f, 0.0f, 0.0f, 0.69f, 0.69f, 0.69f,
-		0.5f, 0.0f, 0.5f, 0.69f, 0.69f, 0.69f,
-		0.0f, 0.0f, 0.5f, 0.69f, 0.69f, 0.69f
-	};
-	//0.92f, 0.91f, 0.83f,
-	float wall1[] = {
-		0.0f, 0.0f, 0.0f, 0.92f, 0.91f, 0.83f,
-		0.5f, 0.0f, 0.0f, 0.92f, 0.91f, 0.83f,
-		0.5f, 0.5f, 0.0f, 0.92f, 0.91f, 0.83f,
-		0.0f, 0.5f, 0.0f, 0.92f, 0.91f, 0.83f,
-
-		0.5f, 0.0f, 0.0f, 0.92f, 0.91f, 0.83f,
-		0.5f, 0.5f, 0.0f, 0.92f, 0.91f, 0.83f,
-		0.5f, 0.0f, 0.5f, 0.92f, 0.91f, 0.83f,
-		0.5f, 0.5f, 0.5f, 0.92f, 0.91f, 0.83f,
-
-		0.0f, 0.0f, 0.5f, 0.92f, 0.91f, 0.83f,
-		0.5f, 0.0f, 0.5f, 0.92f, 0.91f, 0.83f,
-		0.5f, 0.5f, 0.5f, 0.92f, 0.91f, 0.83f,
-		0.0f, 0.5f, 0.5f, 0.92f, 0.91f, 0.83f,
-
-		0.0f, 0.0f, 0.5f, 0.92f, 0.91f, 0.83f,
-		0.0f, 0.5f, 0.5f, 0.92f, 0.91f, 0.83f,
-		0.0f, 0.5f, 0.0f, 0.92f, 0.91f, 0.83f,
-		0.0f, 0.0f, 0.0f, 0.92f, 0.91f, 0.83f,
-
-		0.5f, 0.5f, 0.5f, 0.92f, 0.91f, 0.83f,
-		0.5f, 0.5f, 0.0f, 0.92f, 0.91f, 0.83f,
-		0.0f, 0.5f, 0.0f, 0.92f, 0.91f, 0.83f,
-		0.0f, 0.5f, 0.5f, 0.92f, 0.91f, 0.83f,
-
-		0.0f, 0.0f, 0.0f, 0.92f, 0.91f, 0.83f,
-		0.5f, 0.0f, 0.0f, 0.92f, 0.91f, 0.83f,
-		0.5f, 0.0f, 0.5f, 0.92f, 0.91f, 0.83f,
-		0.0f, 0.0f, 0.5f, 0.92f, 0.91f, 0.83f
-	};
-
-	//0.99f, 0.84f, 0.70f,
-	float wall2[] = {
-		0.0f, 0.0f, 0.0f, 0.99f, 0.84f, 0.70f,
-		0.5f, 0.0f, 0.0f, 0.99f, 0.84f, 0.70f,
-		0.5f, 0.5f, 0.0f, 0.99f, 0.84f, 0.70f,
-		0.0f, 0.5f, 0.0f, 0.99f, 0.84f, 0.70f,
-
-		0.5f, 0.0f, 0.0f, 0.99f, 0.84f, 0.70f,
-		0.5f, 0.5f, 0.0f, 0.99f, 0.84f, 0.70f,
-		0.5f, 0.0f, 0.5f, 0.99f, 0.84f, 0.70f,
-		0.5f, 0.5f, 0.5f, 0.99f, 0.84f, 0.70f,
-
-		0.0f, 0.0f, 0.5f, 0.99f, 0.84f, 0.70f,
-		0.5f, 0.0f, 0.5f, 0.99f, 0.84f, 0.70f,
-		0.5f, 0.5f, 0.5f, 0.99f, 0.84f, 0.70f,
-		0.0f, 0.5f, 0.5f, 0.99f, 0.84f, 0.70f,
-
-		0.0f, 0.0f, 0.5f, 0.99f, 0.84f, 0.70f,
-		0.0f, 0.5f, 0.5f, 0.99f, 0.84f, 0.70f,
-		0.0f, 0.5f, 0.0f, 0.99f, 0.84f, 0.70f,
-		0.0f, 0.0f, 0.0f, 0.99f, 0.84f, 0.70f,
-
-		0.5f, 0.5f, 0.5f, 0.99f, 0.84f, 0.70f,
-		0.5f, 0.5f, 0.0f, 0.99f, 0.84f, 0.70f,
-		0.0f, 0.5f, 0.0f, 0.99f, 0.84f, 0.70f,
-		0.0f, 0.5f, 0.5f, 0.99f, 0.84f, 0.70f,
-
-		0.0f, 0.0f, 0.0f, 0.99f, 0.84f, 0.70f,
-		0.5f, 0.0f, 0.0f, 0.99f, 0.84f, 0.70f,
-		0.5f, 0.0f, 0.5f, 0.99f, 0.84f, 0.70f,
-		0.0f, 0.0f, 0.5f, 0.99f, 0.84f, 0.70f
-	};
-
-
-
-	//0f, 0f, 0f,
-	float blackboard[] = {
-		0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f,
-		0.5f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f,
-		0.5f, 0.5f, 0.0f, 0.0f, 0.0f, 0.0f,
-		0.0f, 0.5f, 0.0f, 0.0f, 0.0f, 0.0f,
-
-		0.5f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f,
-		0.5f, 0.5f, 0.0f, 0.0f, 0.0f, 0.0f,
-		0.5f, 0.0f, 0.5f, 0.0f, 0.0f, 0.0f,
-		0.5f, 0.5f, 0.5f, 0.0f, 0.0f, 0.0f,
-
-		0.0f, 0.0f, 0.5f, 0.0f, 0.0f, 0.0f,
-		0.5f, 0.0f, 0.5f, 0.0f, 0.0f, 0.0f,
-		0.5f, 0.5f, 0.5f, 0.0f, 0.0f, 0.0f,
-		0.0f, 0.5f, 0.5f, 0.0f, 0.0f, 0.0f,
-
-		0.0f, 0.0f, 0.5f, 0.0f, 0.0f, 0.0f,
-		0.0f, 0.5f, 0.5f, 0.0f, 0.0f, 0.0f,
-		0.0f, 0.5f, 0.0f, 0.0f, 0.0f, 0.0f,
-		0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f,
-
-		0.5f, 0.5f, 0.5f, 0.0f, 0.0f, 0.0f,
-		0.5f, 0.5f, 0.0f, 0.0f, 0.0f, 0.0f,
-		0.0f, 0.5f, 0.0f, 0.0f, 0.0f, 0.0f,
-		0.0f, 0.5f, 0.5f, 0.0f, 0.0f, 0.0f,
-
-		0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f,
-		0.5f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f,
-		0.5f, 0.0f, 0.5f, 0.0f, 0.0f, 0.0f,
-		0.0f, 0.0f, 0.5f, 0.0f, 0.0f, 0.0f
-	};
-
-	//0.29f, 0.0f, 0.29f,
-	float cabinate[] = {
-		0.0f, 0.0f, 0.0f, 0.29f, 0.0f, 0.29f,
-		0.5f, 0.0f, 0.0f, 0.29f, 0.0f, 0.29f,
-		0.5f, 0.5f, 0.0f, 0.29f, 0.0f, 0.29f,
-		0.0f, 0.5f, 0.0f, 0.29f, 0.0f, 0.29f,
-
-		0.5f, 0.0f, 0.0f, 0.29f, 0.0f, 0.29f,
-		0.5f, 0.5f, 0.0f, 0.29f, 0.0f, 0.29f,
-		0.5f, 0.0f, 0.5f, 0.29f, 0.0f, 0.29f,
-		0.5f, 0.5f, 0.5f, 0.29f, 0.0f, 0.29f,
-
-		0.0f, 0.0f, 0.5f, 0.29f, 0.0f, 0.29f,
-		0.5f, 0.0f, 0.5f, 0.29f, 0.0f, 0.29f,
-		0.5f, 0.5f, 0.5f, 0.29f, 0.0f, 0.29f,
-		0.0f, 0.5f, 0.5f, 0.29f, 0.0f, 0.29f,
-
-		0.0f, 0.0f, 0.5f, 0.29f, 0.0f, 0.29f,
-		0.0f, 0.5f, 0.5f, 0.29f, 0.0f, 0.29f,
-		0.0f, 0.5f, 0.0f, 0.29f, 0.0f, 0.29f,
-		0.0f, 0.0f, 0.0f, 0.29f, 0.0f, 0.29f,
-
-		0.5f, 0.5f, 0.5f, 0.29f, 0.0f, 0.29f,
-		0.5f, 0.5f, 0.0f, 0.29f, 0.0f, 0.29f,
-		0.0f, 0.5f, 0.0f, 0.29f, 0.0f, 0.29f,
-		0.0f, 0.5f, 0.5f, 0.29f, 0.0f, 0.29f,
-
-		0.0f, 0.0f, 0.0f, 0.29f, 0.0f, 0.29f,
-		0.5f, 0.0f, 0.0f, 0.29f, 0.0f, 0.29f,
-		0.5f, 0.0f, 0.5f, 0.29f, 0.0f, 0.29f,
-		0.0f, 0.0f, 0.5f, 0.29f, 0.0f, 0.29f
-	};
-	//0.95f, 0.95f, 0.95f,
-	float ceiling[] = {
-		0.0f, 0.0f, 0.0f, 0.95f, 0.95f, 0.95f,
-		0.5f, 0.0f, 0.0f, 0.95f, 0.95f, 0.95f,
-		0.5f, 0.5f, 0.0f, 0.95f, 0.95f, 0.95f,
-		0.0f, 0.5f, 0.0f, 0.95f, 0.95f, 0.95f,
-
-		0.5f, 0.0f, 0.0f, 0.95f, 0.95f, 0.95f,
-		0.5f, 0.5f, 0.0f, 0.95f, 0.95f, 0.95f,
-		0.5f, 0.0f, 0.5f, 0.95f, 0.95f, 0.95f,
-		0.5f, 0.5f, 0.5f, 0.95f, 0.95f, 0.95f,
-
-		0.0f, 0.0f, 0.5f, 0.95f, 0.95f, 0.95f,
-		0.5f, 0.0f, 0.5f, 0.95f, 0.95f, 0.95f,
-		0.5f, 0.5f, 0.5f, 0.95f, 0.95f, 0.95f,
-		0.0f, 0.5f, 0.5f, 0.95f, 0.95f, 0.95f,
-
-		0.0f, 0.0f, 0.5f, 0.95f, 0.95f, 0.95f,
-		0.0f, 0.5f, 0.5f, 0.95f, 0.95f, 0.95f,
-		0.0f, 0.5f, 0.0f, 0.95f, 0.95f, 0.95f,
-		0.0f, 0.0f, 0.0f, 0.95f, 0.95f, 0.95f,
-
-		0.5f, 0.5f, 0.5f, 0.95f, 0.95f, 0.95f,
-		0.5f, 0.5f, 0.0f, 0.95f, 0.95f, 0.95f,
-		0.0f, 0.5f, 0.0f, 0.95f, 0.95f, 0.95f,
-		0.0f, 0.5f, 0.5f, 0.95f, 0.95f, 0.95f,
-
-		0.0f, 0.0f, 0.0f, 0.95f, 0.95f, 0.95f,
-		0.5f, 0.0f, 0.0f, 0.95f, 0.95f, 0.95f,
-		0.5f, 0.0f, 0.5f, 0.95f, 0.95f, 0.95f,
-		0.0f, 0.0f, 0.5f, 0.95f, 0.95f, 0.95f
-	};
-
-	//1.0f, 1.0f, 1.0f,
-	float fan_holder[] = {
-		0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
-		0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
-		0.5f, 0.5f, 0.0f, 1.0f, 1.0f, 1.0f,
-		0.0f, 0.5f, 0.0f, 1.0f, 1.0f, 1.0f,
-
-		0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
-		0.5f, 0.5f, 0.0f, 1.0f, 1.0f, 1.0f,
-		0.5f, 0.0f, 0.5f, 1.0f, 1.0f, 1.0f,
-		0.5f, 0.5f, 0.5f, 1.0f, 1.0f, 1.0f,
-
-		0.0f, 0.0f, 0.5f, 1.0f, 1.0f, 1.0f,
-		0.5f, 0.0f, 0.5f, 1.0f, 1.0f, 1.0f,
-		0.5f, 0.5f, 0.5f, 1.0f, 1.0f, 1.0f,
-		0.0f, 0.5f, 0.5f, 1.0f, 1.0f, 1.0f,
-
-		0.0f, 0.0f, 0.5f, 1.0f, 1.0f, 1.0f,
-		0.0f, 0.5f, 0.5f, 1.0f, 1.0f, 1.0f,
-		0.0f, 0.5f, 0.0f, 1.0f, 1.0f, 1.0f,
-		0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
-
-		0.5f, 0.5f, 0.5f, 1.0f, 1.0f, 1.0f,
-		0.5f, 0.5f, 0.0f, 1.0f, 1.0f, 1.0f,
-		0.0f, 0.5f, 0.0f, 1.0f, 1.0f, 1.0f,
-		0.0f, 0.5f, 0.5f, 1.0f, 1.0f, 1.0f,
-
-		0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
-		0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
-		0.5f, 0.0f, 0.5f, 1.0f, 1.0f, 1.0f,
-		0.0f, 0.0f, 0.5f, 1.0f, 1.0f, 1.0f
-	};
-	//.44f, .22f, .05f,
-	float fan_pivot[] = {
-		0.0f, 0.0f, 0.0f, .44f, .22f, .05f,
-		0.5f, 0.0f, 0.0f, .44f, .22f, .05f,
-		0.5f, 0.5f, 0.0f, .44f, .22f, .05f,
-		0.0f, 0.5f, 0.0f, .44f, .22f, .05f,
-
-		0.5f, 0.0f, 0.0f, .44f, .22f, .05f,
-		0.5f, 0.5f, 0.0f, .44f, .22f, .05f,
-		0.5f, 0.0f, 0.5f, .44f, .22f, .05f,
-		0.5f, 0.5f, 0.5f, .44f, .22f, .05f,
-
-		0.0f, 0.0f, 0.5f, .44f, .22f, .05f,
-		0.5f, 0.0f, 0.5f, .44f, .22f, .05f,
-		0.5f, 0.5f, 0.5f, .44f, .22f, .05f,
-		0.0f, 0.5f, 0.5f, .44f, .22f, .05f,
-
-		0.0f, 0.0f, 0.5f, .44f, .22f, .05f,
-		0.0f, 0.5f, 0.5f, .44f, .22f, .05f,
-		0.0f, 0.5f, 0.0f, .44f, .22f, .05f,
-		0.0f, 0.0f, 0.0f, .44f, .22f, .05f,
-
-		0.5f, 0.5f, 0.5f, .44f, .22f, .05f,
-		0.5f, 0.5f, 0.0f, .44f, .22f, .05f,
-		0.0f, 0.5f, 0.0f, .44f, .22f, .05f,
-		0.0f, 0.5f, 0.5f, .44f, .22f, .05f,
-
-		0.0f, 0.0f, 0.0f, .44f, .22f, .05f,
-		0.5f, 0.0f, 0.0f, .44f, .22f, .05f,
-		0.5f, 0.0f, 0.5f, .44f, .22f, .05f,
-		0.0f, 0.0f, 0.5f, .44f, .22f, .05f
-	};
-	//.0f, .0f, .42f,
-	float fan_blade[] = {
-		0.0f, 0.0f, 0.0f, .0f, .0f, .42f,
-		0.5f, 0.0f, 0.0f, .0f, .0f, .42f,
-		0.5f, 0.5f, 0.0f, .0f, .0f, .42f,
-		0.0f, 0.5f, 0.0f, .0f, .0f, .42f,
-
-		0.5f, 0.0f, 0.0f, .0f, .0f, .42f,
-		0.5f, 0.5f, 0.0f, .0f, .0f, .42f,
-		0.5f, 0.0f, 0.5f, .0f, .0f, .42f,
-		0.5f, 0.5f, 0.5f, .0f, .0f, .42f,
-
-		0.0f, 0.0f, 0.5f, .0f, .0f, .42f,
-		0.5f, 0.0f, 0.5f, .0f, .0f, .42f,
-		0.5f, 0.5f, 0.5f, .0f, .0f, .42f,
-		0.0f, 0.5f, 0.5f, .0f, .0f, .42f,
-
-		0.0f, 0.0f, 0.5f, .0f, .0f, .42f,
-		0.0f, 0.5f, 0.5f, .0f, .0f, .42f,
-		0.0f, 0.5f, 0.0f, .0f, .0f, .42f,
-		0.0f, 0.0f, 0.0f, .0f, .0f, .42f,
-
-		0.5f, 0.5f, 0.5f, .0f, .0f, .42f,
-		0.5f, 0.5f, 0.0f, .0f, .0f, .42f,
-		0.0f, 0.5f, 0.0f, .0f, .0f, .42f,
-		0.0f, 0.5f, 0.5f, .0f, .0f, .42f,
-
-		0.0f, 0.0f, 0.0f, .0f, .0f, .42f,
-		0.5f, 0.0f, 0.0f, .0f, .0f, .42f,
-		0.5f, 0.0f, 0.5f, .0f, .0f, .42f,
-		0.0f, 0.0f, 0.5f, .0f, .0f, .42f
-	};
-	
-	unsigned int cube_indices[] = {
-		0, 3, 2,
-		2, 1, 0,
-
-		4, 5, 7,
-		7, 6, 4,
-
-		8, 9, 10,
-		10, 11, 8,
-
-		12, 13, 14,
-		14, 15, 12,
-
-		16, 17, 18,
-		18, 19, 16,
-
-		20, 21, 22,
-		22, 23, 20
-	};
-
-	float border[] = {
-		0.0f, 0.0f, 0.0f, .0f, .0f, .0f,
-		0.5f, 0.0f, 0.0f, .0f, .0f, .0f,
-		0.5f, 0.5f, 0.0f, .0f, .0f, .0f,
-		0.0f, 0.5f, 0.0f, .0f, .0f, .0f,
-
-		0.5f, 0.0f, 0.0f, .0f, .0f, .0f,
-		0.5f, 0.5f, 0.0f, .0f, .0f, .0f,
-		0.5f, 0.0f, 0.5f, .0f, .0f, .0f,
-		0.5f, 0.5f, 0.5f, .0f, .0f, .0f,
-
-		0.0f, 0.0f, 0.5f, .0f, .0f, .0f,
-		0.5f, 0.0f, 0.5f, .0f, .0f, .0f,
-		0.5f, 0.5f, 0.5f, .0f, .0f, .0f,
-		0.0f, 0.5f, 0.5f, .0f, .0f, .0f,
-
-		0.0f, 0.0f, 0.5f, .0f, .0f, .0f,
-		0.0f, 0.5f, 0.5f, .0f, .0f, .0f,
-		0.0f, 0.5f, 0.0f, .0f, .0f, .0f,
-		0.0f, 0.0f, 0.0f, .0f, .0f, .0f,
-
-		0.5f, 0.5f, 0.5f, .0f, .0f, .0f,
-		0.5f, 0.5f, 0.0f, .0f, .0f, .0f,
-		0.0f, 0.5f, 0.0f, .0f, .0f, .0f,
-		0.0f, 0.5f, 0.5f, .0f, .0f, .0f,
-
-		0.0f, 0.0f, 0.0f, .0f, .0f, .0f,
-		0.5f, 0.0f, 0.0f, .0f, .0f, .0f,
-		0.5f, 0.0f, 0.5f, .0f, .0f, .0f,
-		0.0f, 0.0f, 0.5f, .0f, .0f, .0f
-	};
-	unsigned int VBOL, VAOL, EBOL;
-	glGenVertexArrays(1, &VAOL);
-	glGenBuffers(1, &VBOL);
-	glGenBuffers(1, &EBOL);
-	glBindVertexArray(VAOL);
-	glBindBuffer(GL_ARRAY_BUFFER, VBOL);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(border), border, GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOL);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
-
-	// position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	//color attribute
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-	glEnableVertexAttribArray(1);
-
-	unsigned int VBO, VAO, EBO;
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	glGenBuffers(1, &EBO);
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(table_top), table_top, GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
-	// position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	//color attribute
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-	glEnableVertexAttribArray(1);
-
-	unsigned int VBO2, VAO2, EBO2;
-	glGenVertexArrays(1, &VAO2);
-	glGenBuffers(1, &VBO2);
-	glGenBuffers(1, &EBO2);
-	glBindVertexArray(VAO2);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO2);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(table_leg), table_leg, GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO2);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
-	// position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	//color attribute
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-	glEnableVertexAttribArray(1);
-
-	unsigned int VBO3, VAO3, EBO3;
-	glGenVertexArrays(1, &VAO3);
-	glGenBuffers(1, &VBO3);
-	glGenBuffers(1, &EBO3);
-	glBindVertexArray(VAO3);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO3);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(chair_leg), chair_leg, GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO3);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
-	// position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	//color attribute
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-	glEnableVertexAttribArray(1);
-
-	unsigned int VBO4, VAO4, EBO4;
-	glGenVertexArrays(1, &VAO4);
-	glGenBuffers(1, &VBO4);
-	glGenBuffers(1, &EBO4);
-	glBindVertexArray(VAO4);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO4);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(chair_pillar), chair_pillar, GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO4);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
-	// position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	//color attribute
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-	glEnableVertexAttribArray(1);
-
-	unsigned int VBO5, VAO5, EBO5;
-	glGenVertexArrays(1, &VAO5);
-	glGenBuffers(1, &VBO5);
-	glGenBuffers(1, &EBO5);
-	glBindVertexArray(VAO5);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO5);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(chair_back), chair_back, GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO5);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
-	// position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	//color attribute
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-	glEnableVertexAttribArray(1);
-
-	unsigned int VBOG, VAOG, EBOG;
-	glGenVertexArrays(1, &VAOG);
-	glGenBuffers(1, &VBOG);
-	glGenBuffers(1, &EBOG);
-	glBindVertexArray(VAOG);
-	glBindBuffer(GL_ARRAY_BUFFER, VBOG);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(floor), floor, GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOG);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
-	// position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	//color attribute
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-	glEnableVertexAttribArray(1);
-
-	unsigned int VBOW1, VAOW1, EBOW1;
-	glGenVertexArrays(1, &VAOW1);
-	glGenBuffers(1, &VBOW1);
-	glGenBuffers(1, &EBOW1);
-	glBindVertexArray(VAOW1);
-	glBindBuffer(GL_ARRAY_BUFFER, VBOW1);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(wall1), wall1, GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOW1);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
-	// position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	//color attribute
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-	glEnableVertexAttribArray(1);
-
-	unsigned int VBOW2, VAOW2, EBOW2;
-	glGenVertexArrays(1, &VAOW2);
-	glGenBuffers(1, &VBOW2);
-	glGenBuffers(1, &EBOW2);
-	glBindVertexArray(VAOW2);
-	glBindBuffer(GL_ARRAY_BUFFER, VBOW2);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(wall2), wall2, GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOW2);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
-	// position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	//color attribute
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-	glEnableVertexAttribArray(1);
-
-	unsigned int VBOB, VAOB, EBOB;
-	glGenVertexArrays(1, &VAOB);
-	glGenBuffers(1, &VBOB);
-	glGenBuffers(1, &EBOB);
-	glBindVertexArray(VAOB);
-	glBindBuffer(GL_ARRAY_BUFFER, VBOB);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(blackboard), blackboard, GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOB);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
-	// position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	//color attribute
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-	glEnableVertexAttribArray(1);
-
-	unsigned int VBOC, VAOC, EBOC;
-	glGenVertexArrays(1, &VAOC);
-	glGenBuffers(1, &VBOC);
-	glGenBuffers(1, &EBOC);
-	glBindVertexArray(VAOC);
-	glBindBuffer(GL_ARRAY_BUFFER, VBOC);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(cabinate), cabinate, GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOC);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
-	// position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	//color attribute
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-	glEnableVertexAttribArray(1);
-
-	unsigned int VBOT, VAOT, EBOT;
-	glGenVertexArrays(1, &VAOT);
-	glGenBuffers(1, &VBOT);
-	glGenBuffers(1, &EBOT);
-	glBindVertexArray(VAOT);
-	glBindBuffer(GL_ARRAY_BUFFER, VBOT);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(ceiling), ceiling, GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOT);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
+	AssetPipeline assets;
+	assets.init(window);
+	AssetGroup programs;
+	Shader ourShader, shadowShader, prepassShader, overdrawShader, overdrawResolveShader;
+	Shader cullShader, instancedShader, instancedPrepassShader, instancedOverdrawShader;
+	Shader animatedShader, animatedPrepassShader, animatedOverdrawShader, animatedShadowShader;
+	Shader multiviewShader, multiviewInstancedShader, multiviewAnimatedShader;
+	Shader fxaaShader, taaShader, upscaleShader;
+	loadProgram(assets, programs, ourShader, "vertexShader.vs", "fragmentShader.fs", CAMERA_UBO_BINDING);
+	loadProgram(assets, programs, shadowShader, "shadowDepth.vs", "depthOnly.fs", CAMERA_UBO_BINDING);
+	loadProgram(assets, programs, prepassShader, "vertexShader.vs", "depthOnly.fs", CAMERA_UBO_BINDING);
+	loadProgram(assets, programs, overdrawShader, "vertexShader.vs", "overdraw.fs", CAMERA_UBO_BINDING);
+	loadProgram(assets, programs, overdrawResolveShader, "fullscreen.vs", "overdrawResolve.fs", CAMERA_UBO_BINDING);
+	loadProgram(assets, programs, fxaaShader, "fullscreen.vs", "fxaa.fs", CAMERA_UBO_BINDING);
+	loadProgram(assets, programs, taaShader, "fullscreen.vs", "taa.fs", CAMERA_UBO_BINDING);
+	loadProgram(assets, programs, upscaleShader, "fullscreen.vs", "upscale.fs", CAMERA_UBO_BINDING);
+	loadProgram(assets, programs, animatedShader, "animatedVertex.vs", "fragmentShader.fs", CAMERA_UBO_BINDING);
+	loadProgram(assets, programs, animatedPrepassShader, "animatedVertex.vs", "depthOnly.fs", CAMERA_UBO_BINDING);
+	loadProgram(assets, programs, animatedOverdrawShader, "animatedVertex.vs", "overdraw.fs", CAMERA_UBO_BINDING);
+	loadProgram(assets, programs, animatedShadowShader, "animatedShadowDepth.vs", "depthOnly.fs", CAMERA_UBO_BINDING);
+	loadProgram(assets, programs, multiviewShader, "vertexShader.vs", "multiview.gs", "fragmentShader.fs", CAMERA_UBO_BINDING);
+	loadProgram(assets, programs, multiviewAnimatedShader, "animatedVertex.vs", "multiview.gs", "fragmentShader.fs", CAMERA_UBO_BINDING);
+	if (options.gpuDriven) {
+		loadComputeProgram(assets, programs, cullShader, "cullInstances.comp");
+		loadProgram(assets, programs, instancedShader, "instancedVertex.vs", "fragmentShader.fs", CAMERA_UBO_BINDING);
+		loadProgram(assets, programs, instancedPrepassShader, "instancedVertex.vs", "depthOnly.fs", CAMERA_UBO_BINDING);
+		loadProgram(assets, programs, instancedOverdrawShader, "instancedVertex.vs", "overdraw.fs", CAMERA_UBO_BINDING);
+		loadProgram(assets, programs, multiviewInstancedShader, "instancedVertex.vs", "multiview.gs", "fragmentShader.fs", CAMERA_UBO_BINDING);
+	}
+	cameraUBO.init();
+	late_latch = cameraUBO.canLateLatch();
+	multiview.init(std::vector<MonitorView>(std::begin(CLASSROOM_MONITORS), std::end(CLASSROOM_MONITORS)));
+	// measured runs keep the single view their results were recorded with
+	multi_view = options.multiView && !replaying && !options.regressPath && !options.lightBench;
+	int framebufferWidth, framebufferHeight;
+	glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+	applyViewLayout(framebufferWidth, framebufferHeight);
+	const GLFWvidmode* videoMode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+	pacer.init(videoMode ? videoMode->refreshRate : 60.0);
+
+	ClusteredLighting lighting;
+	lighting.init();
+	lighting.setLights(classroomLightList(options.rooms));
+	overdraw.init();
+	renderGraph.init();
+	antialiasing.init(options.antialiasing);
+	// the golden images and the light benchmark are taken at a fixed resolution
+	dynamicResolution.init(regression.active() || lightBench.active() ? 0.0f : options.dynamicResTarget,
+		options.resolutionMin, options.resolutionMax, options.resolutionHysteresis, options.sharpness);
+	prepassAdvisor.init();
+	// without the shared memory the renderer still runs, unmonitored
+	if (options.telemetryName)
+		telemetry.open(options.telemetryName);
+	ShadowMaps shadows;
+	shadows.init();
+
+	// replay runs as fast as possible with a single, deterministic camera update per frame
+	RenderTarget offscreen;
+	if (replaying) {
+		late_latch = false;
+		pacer.enabled = false;
+		glfwSwapInterval(0);
+		fan_turn = (player.header.flags & SESSION_FLAG_FAN_TURN) != 0;
+		rotate_around = (player.header.flags & SESSION_FLAG_ROTATE_AROUND) != 0;
+		player.header.camera.apply(camera);
+	}
+	if (options.headless && !offscreen.init(SCR_WIDTH, SCR_HEIGHT))
+		return -1;
+	if (options.regressPath) {
+		const char* renderer = (const char*)glGetString(GL_RENDERER);
+		if (!renderer || !strstr(renderer, "llvmpipe"))
+			std::cout << "warning: golden images are rendered with llvmpipe, running on " << (renderer ? renderer : "unknown renderer") << std::endl;
+		late_latch = false;
+		pacer.enabled = false;
+		fan_turn = false;
+		rotate_around = false;
+		glfwSwapInterval(0);
+		regression.begin(options.regressPath, options.regressUpdate);
+	}
+	if (options.lightBench) {
+		late_latch = false;
+		pacer.enabled = false;
+		fan_turn = false;
+		rotate_around = false;
+		glfwSwapInterval(0);
+		lightBench.begin(lighting);
+	}
+	// a recording steps the camera once per frame by the fixed delta, as its replay will, so the replay retraces it
+	if (options.recordPath) {
+		late_latch = false;
+		SessionHeader header;
+		header.fixedDelta = options.fixedDelta;
+		header.flags = (fan_turn ? SESSION_FLAG_FAN_TURN : 0) | (rotate_around ? SESSION_FLAG_ROTATE_AROUND : 0);
+		header.camera = SessionCameraState::capture(camera);
+		if (!recorder.open(options.recordPath, header))
+			return -1;
+	}
+	// a replay is captured at its own rate, so a recorded walkthrough becomes a video of the same length
+	if (options.capturePath) {
+		int captureWidth = offscreen.width, captureHeight = offscreen.height;
+		if (!options.headless)
+			glfwGetFramebufferSize(window, &captureWidth, &captureHeight);
+		int framesPerSecond = replaying ? (int)(1.0f / options.fixedDelta + 0.5f) : (videoMode ? videoMode->refreshRate : 60);
+		if (!capture.open(options.capturePath, captureWidth, captureHeight, framesPerSecond))
+			return -1;
+	}
+	// replays, regression runs and benchmarks need a fixed pipeline, so only interactive sessions measure
+	depthPrepass.enabled = options.prepass == "on";
+	if (options.prepass == "auto" && !replaying && !regression.active() && !lightBench.active())
+		prepassAdvisor.start();
+	ReplayReport replayReport;
+	uint64_t previousFrameStart = 0;
+	GpuVertexArray boxVAO;
+	GpuBuffer boxVBO, boxEBO;
+	boxVAO.create("scene", "box");
+	boxVBO.create("scene", "box vertices");
+	boxEBO.create("scene", "box indices");
+	glBindVertexArray(boxVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, boxVBO);
+	boxVBO.data(GL_ARRAY_BUFFER, sizeof(cube_mesh.vertices), cube_vertices, GL_STATIC_DRAW);
+	boxEBO.data(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_mesh.indices), cube_indices, GL_STATIC_DRAW);
 	// position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, BOX_VERTEX_STRIDE, (void*)0);
 	glEnableVertexAttribArray(0);
-	//color attribute
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-	glEnableVertexAttribArray(1);
+	//normal attribute
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, BOX_VERTEX_STRIDE, (void*)BOX_NORMAL_OFFSET);
+	glEnableVertexAttribArray(2);
+
+	materials.init(classroomMaterialList());
+	BakedOcclusion occlusion;
+	if (options.occlusionPath)
+		occlusion.load(options.occlusionPath);
+	occlusion.init();
+
+	// static scene: built once, only culled and drawn per frame. Each classroom is a cell; with several rooms a
+	// corridor runs behind them, one cell per room, joined to it by a doorway and to its neighbours by open portals
+	// ---------------------------------------------------------------------------------------------------------
+	CellGraph building;
+	for (int room = 0; room < options.rooms; room++) {
+		float dx = CLASSROOM_SPACING * room;
+		building.addCell("classroom " + std::to_string(room), glm::vec3(dx - 2.5f, -0.8f, -9.0f), glm::vec3(dx + 7.6f, 2.85f, 3.1f));
+	}
+	if (options.rooms > 1) {
+		for (int room = 0; room < options.rooms; room++) {
+			float dx = CLASSROOM_SPACING * room;
+			int corridor = building.addCell("corridor " + std::to_string(room), glm::vec3(dx - 2.5f, -0.8f, 3.1f), glm::vec3(dx + 7.6f, 2.85f, 6.2f));
+			building.addPortal(room, corridor, glm::vec3(dx + DOOR_LEFT, -0.75f, 3.1f), glm::vec3(dx + DOOR_RIGHT, DOOR_TOP, 3.1f));
+			if (room > 0)
+				building.addPortal(corridor - 1, corridor, glm::vec3(dx - 2.5f, -0.75f, 3.2f), glm::vec3(dx - 2.5f, 2.75f, 6.1f));
+		}
+	}
+	DrawList& staticScene = building.cell(0).scene;
+	//Table_Chair
+	GpuDrivenScene desks;
+	AssetGroup deskAssets;
+	if (options.gpuDriven) {
+		// one desk baked into a single mesh, instanced over a square grid continuing the classroom's layout
+		streamDesks(assets, deskAssets, desks, buildDeskMesh(), options.desks);
+	}
+	addClassroom(staticScene, boxVAO, 0.0f, options.rooms > 1, !options.gpuDriven, options.fanGrid);
+	occlusion.assign(staticScene);
+	// every other cell is streamed in as the camera approaches it
+	RoomStreamer streamer;
+	if (options.rooms > 1) {
+		unsigned int box = boxVAO;
+		int rooms = options.rooms;
+		bool furniture = !options.gpuDriven;
+		bool fanGrid = options.fanGrid;
+		const BakedOcclusion* baked = &occlusion;
+		streamer.init(assets, building, [box, rooms, furniture, fanGrid, baked](int cell, DrawList& scene) {
+			int room = cell % rooms;
+			if (cell < rooms)
+				addClassroom(scene, box, CLASSROOM_SPACING * room, true, furniture, fanGrid);
+			else
+				addCorridor(scene, box, CLASSROOM_SPACING * room, room == 0, room == rooms - 1);
+			baked->assign(scene);
+		}, cube_vertices, cube_indices, 1);
+		streamer.setBudgets((size_t)(options.roomCpuBudget * 1024.0f * 1024.0f), (size_t)(options.roomGpuBudget * 1024.0f * 1024.0f));
+	}
 
-	//Fan
-	unsigned int VBOF1, VAOF1, EBOF1;
-	glGenVertexArrays(1, &VAOF1);
-	glGenBuffers(1, &VBOF1);
-	glGenBuffers(1, &EBOF1);
-	glBindVertexArray(VAOF1);
-	glBindBuffer(GL_ARRAY_BUFFER, VBOF1);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(fan_holder), fan_holder, GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOF1);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
-	// position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	//color attribute
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-	glEnableVertexAttribArray(1);
-
-	unsigned int VBOF2, VAOF2, EBOF2;
-	glGenVertexArrays(1, &VAOF2);
-	glGenBuffers(1, &VBOF2);
-	glGenBuffers(1, &EBOF2);
-	glBindVertexArray(VAOF2);
-	glBindBuffer(GL_ARRAY_BUFFER, VBOF2);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(fan_pivot), fan_pivot, GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOF2);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
-	// position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	//color attribute
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-	glEnableVertexAttribArray(1);
-
-	unsigned int VBOF3, VAOF3, EBOF3;
-	glGenVertexArrays(1, &VAOF3);
-	glGenBuffers(1, &VBOF3);
-	glGenBuffers(1, &EBOF3);
-	glBindVertexArray(VAOF3);
-	glBindBuffer(GL_ARRAY_BUFFER, VBOF3);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(fan_blade), fan_blade, GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOF3);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
-	// position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	//color attribute
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-	glEnableVertexAttribArray(1);
-	int i = 0;
-	Table_Chair table_chair[16];
+	// every fan's blades: one baked mesh, one part per fan, all spun by the vertex shader in one draw
+	RigidAnimation fans;
+	MeshBuilder bladeMesh;
+	Fan fan;
+	glm::vec3 fanPivot = fan.bake(bladeMesh, cube_vertices, cube_indices);
+	fans.setMesh(bladeMesh);
+	int fansPerRoom = options.fanGrid ? (int)(sizeof(FAN_TILE_OFFSETS) / sizeof(FAN_TILE_OFFSETS[0])) : 1;
+	for (int room = 0; room < options.rooms; room++) {
+		for (int tile = 0; tile < fansPerRoom; tile++) {
+			RigidPart part;
+			part.pivot = fanPivot + glm::vec3(CLASSROOM_SPACING * room + FAN_TILE_OFFSETS[tile].x, 0.0f, FAN_TILE_OFFSETS[tile].y);
+			part.axis = glm::vec3(0.0f, 1.0f, 0.0f);
+			part.angularVelocity = FAN_SPEED;
+			// the classroom's own fan starts at rest; the others are out of step so they do not turn in unison
+			part.phase = 0.7f * (float)(room * fansPerRoom + tile);
+			fans.add(part);
+		}
+	}
+	fans.upload();
+	shadows.setAnimatedCasters(fans, animatedShadowShader);
+
+	DrawList dynamicScene;
+	std::vector<unsigned int> visibleDynamic;
+	RenderStats frameStats;
+	Frustum cullFrustum;
+	glm::mat4 cullView, cullProjection;
+	unsigned int cullFrustumRevision = ~0u;
+	// measured and reproducible runs start with everything loaded
+	if (replaying || options.regressPath || options.lightBench || options.recordPath || options.headless) {
+		if (options.rooms > 1)
+			streamer.prefetchAll();
+		assets.finish();
+	}
+	bool assetsReported = false;
+	bool assetsFailed = false;
+	lastCameraUpdate = static_cast<float>(glfwGetTime());
+	// transient data of the frames; it grows to what the largest frame needs
+	frameArena().init(256 * 1024);
 	while (!glfwWindowShouldClose(window))
 	{
+		// wait until just late enough that the frame still finishes before vsync
+		pacer.waitForFrameStart();
+		frameArena().beginFrame();
+
 		// per-frame time logic
 		// --------------------
 		float currentFrame = static_cast<float>(glfwGetTime());
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
+		uint64_t frameStart = inputClockNow();
+
+		// finish loads that are due; until the programs have arrived the frame only clears and shows the progress
+		// -------------------------------------------------------------------------------------------------------
+		assets.pump();
+		if (!programs.ready()) {
+			glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			std::string title = std::string(WINDOW_TITLE) + " - loading " + std::to_string((int)(assets.progress() * 100.0f)) + "%";
+			glfwSetWindowTitle(window, title.c_str());
+			glfwSwapBuffers(window);
+			assets.framePresented();
+			glfwPollEvents();
+			continue;
+		}
+		// every pass draws with these programs, so a frame without one of them would render nothing
+		if (programs.failed()) {
+			std::cout << "ERROR::ASSETS:: " << programs.failures << " programs failed to load, is the working directory the one with the shaders?" << std::endl;
+			assets.report(std::cout);
+			assetsFailed = true;
+			break;
+		}
+		if (!assetsReported && assets.idle()) {
+			glfwSetWindowTitle(window, WINDOW_TITLE);
+			assets.report(std::cout);
+			assetsReported = true;
+		}
 
 		// input
 		// -----
-		processInput(window);
-
-		// render
-		// ------
-		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-
-		// activate shader
-		ourShader.use();
-		glm::mat4 model;
-		// pass projection matrix to shader (note that in this case it could change every frame)
-		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-		//glm::mat4 projection = glm::ortho(-2.0f, +2.0f, -1.5f, +1.5f, 0.1f, 100.0f);
-		ourShader.setMat4("projection", projection);
-
-		// camera/view transformation
-		float degree = 0;
-		glm::mat4 view = camera.GetViewMatrix();
-		float r = glm::length(camera.Position-glm::vec3(view[3]));
-		//std::cout << "Vector: (" << camera.Position.x << ", " << camera.Position.y << ", " << camera.Position.z << ")" << std::endl;
-		//std::cout << "Vector: (" << -glm::vec3(view[2]).x << ", " << -glm::vec3(view[2]).y << ", " << -glm::vec3(view[2]).z << ")" << std::endl;
-		//glm::mat4 view = basic_camera.createViewMatrix();
-		ourShader.setMat4("view", view);
-		/*glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);*/
-		//Table_Chair
-		float shiftx = -2, shiftz = 0;
-		for (int i = 0; i < 4; i++) {
-			for (int j = 0; j < 4; j++) {
-				table_chair[i + j].tox = shiftx;
-				table_chair[i + j].toz = shiftz;
-				ourShader = table_chair[i + j].ret_shader(ourShader, VAO, VAO2, VAO3, VAO4, VAO5);
-				shiftz -= 2;
+		float replayDrift = 0.0f;
+		if (replaying) {
+			input.beginFrame();
+			if (input.wasPressed(ACTION_QUIT) || player.finished()) {
+				glfwSetWindowShouldClose(window, true);
+				break;
 			}
-			shiftz = 0;
-			shiftx += 2;
+			const SessionFrame& frame = player.advance();
+			processInput(window, frame.input);
+			camera.Update(options.fixedDelta);
+			if (options.replayPoses)
+				frame.camera.apply(camera);
+			replayDrift = glm::distance(camera.GetPosition(), frame.camera.position);
+		}
+		else if (regression.active()) {
+			input.beginFrame();
+			if (input.wasPressed(ACTION_QUIT) || regression.finished()) {
+				glfwSetWindowShouldClose(window, true);
+				break;
+			}
+			regression.beginFrame(camera);
+		}
+		else if (lightBench.active()) {
+			input.beginFrame();
+			if (input.wasPressed(ACTION_QUIT) || lightBench.finished()) {
+				glfwSetWindowShouldClose(window, true);
+				break;
+			}
+			lightBench.beginFrame(camera, lighting);
+		}
+		else {
+			updateCamera(window);
+		}
+		if (options.headless)
+			offscreen.bind();
+		int outputWidth = offscreen.width, outputHeight = offscreen.height;
+		if (!options.headless)
+			glfwGetFramebufferSize(window, &outputWidth, &outputHeight);
+		GLuint outputFramebuffer = options.headless ? (GLuint)offscreen.framebuffer : 0;
+		// the scene is drawn at the dynamic resolution and upscaled into the output, or straight into the output
+		bool scaled = dynamicResolution.enabled() && !multi_view;
+		GLuint sceneFramebuffer = outputFramebuffer;
+		int sceneWidth = outputWidth, sceneHeight = outputHeight;
+		if (scaled) {
+			dynamicResolution.beginFrame(outputWidth, outputHeight);
+			sceneFramebuffer = dynamicResolution.scaledFramebuffer();
+			sceneWidth = dynamicResolution.width();
+			sceneHeight = dynamicResolution.height();
 		}
+		cameraUBO.setJitter(antialiasing.beginFrame(sceneFramebuffer, sceneWidth, sceneHeight, !multi_view));
+
+		cameraUBO.beginFrame();
+		pacer.gpuBegin();
+		if (regression.active())
+			regression.gpuBegin();
+		if (lightBench.active())
+			lightBench.gpuBegin();
+		// the slot holds the pose of SLOTS frames ago until written, so this frame's pose goes in before any draw; the
+		// late latch below only overwrites it with a fresher one
+		cameraUBO.latch(camera);
+
+		// animated parts are rebuilt every frame; the fans only need their time
+		dynamicScene.clear();
 		Table_Chair tc;
 		tc.tox = 5;
 		tc.toz = -8.5;
-		ourShader = tc.local_rotation(ourShader, VAO, VAO2, VAO3, VAO4, VAO5, 135);
-		//Floor
-		model = transforamtion(-2.5, -.8, -9, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 20, 0.1, 24);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAOG);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-		//Wall1
-		model = transforamtion(-2.5, -.75, -9, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 20, 7, 0.2);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAOW1);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-		model = transforamtion(-2.5, -.75, 3, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 20, 7, 0.2);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAOW1);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-		//Wall2
-		model = transforamtion(-2.5, -.75, -9, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, .2, 7, 24);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAOW2);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-		model = transforamtion(7.5, -.75, -9, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, .2, 7, 24);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAOW2);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-		//BlackBoard
-		model = transforamtion(-.5, 0.5, -8.9, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 12, 3, 0.2);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAOB);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-		model = transforamtion(-.6, 0.4, -8.95, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 12.5, 3.5, 0.2);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAO4);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-		//Cabinate
-		model = transforamtion(6.75, -.75, -6, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 1.5, 4, 3);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAOC);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-		//Ceiling
-		model = transforamtion(-2.5, 2.75, -9, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 20, 0.1, 24);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAOT);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-		//Fan
-		model = transforamtion(2, 2.5, -6, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 1, .5, 1);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAOF1);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-		model = transforamtion(2.125, 2.25, -5.875, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, .5, .75, .5);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAOF2);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-		for (int i = 0; i < 4; i++) {
-			model = transforamtion(-.4+2*i, -.75, -9, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, .01, .01, 24);
-			ourShader.setMat4("model", model);
-			glBindVertexArray(VAOL);
-			glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+		tc.local_rotation(dynamicScene, boxVAO, 135);
+		occlusion.assign(dynamicScene);
+		fans.setTime(fan_time);
+
+		if (fan_turn)
+			fan_time += replaying || options.recordPath ? options.fixedDelta : deltaTime;
+
+		// cull against the camera frustum, widened when the pose is latched again after culling
+		if (camera.GetRevision() != cullFrustumRevision) {
+			cullView = camera.GetViewMatrix();
+			if (late_latch) {
+				cullProjection = glm::perspective(glm::radians(glm::min(camera.GetZoom() + LATE_LATCH_FOV_MARGIN, 170.0f)),
+					camera.GetAspectRatio(), camera.GetNearPlane(), camera.GetFarPlane());
+				cullFrustum.extract(cullProjection * cullView);
+			}
+			else {
+				cullProjection = camera.GetProjectionMatrix();
+				cullFrustum = camera.GetFrustum();
+			}
+			cullFrustumRevision = camera.GetRevision();
+			lighting.invalidate();
 		}
 
-		for (int i = 0; i < 5; i++) {
-			model = transforamtion(-2.4, -.75, -7 + 2 * i, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 24, .01, .01);
-			ourShader.setMat4("model", model);
-			glBindVertexArray(VAOL);
-			glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+		materials.apply();
+		occlusion.apply();
+		float cullMargin = late_latch ? camera.MovementSpeed * 2.0f * deltaTime : 0.0f;
+		frameStats.reset();
+		visibleDynamic.clear();
+		// static draws of the cells seen through the portals; the animated parts and the desks are in the first classroom.
+		// With several views the cells' draws are counted by the views' culling instead
+		RenderStats portalStats;
+		portalStats.reset();
+		building.cull(cullFrustum, cullProjection * cullView, camera.GetPosition(), cullMargin, multi_view ? portalStats : frameStats);
+		if (options.rooms > 1)
+			streamer.update(camera.GetPosition(), deltaTime);
+		const Frustum* deskFrustum = NULL;
+		float deskMargin = cullMargin;
+		if (multi_view) {
+			// the portals only know the fly camera, so every view culls the cells' draws itself; the streamed rooms
+			// are left to the portals and only drawn into the fly camera's view
+			multiview.beginCull(cullFrustum);
+			for (size_t c = 0; c < building.cellCount(); c++)
+				multiview.cull(building.cell((int)c).scene, cullMargin, frameStats);
+			multiview.cull(dynamicScene, cullMargin, frameStats);
+			deskFrustum = &multiview.unboundedFrustum();
+			deskMargin = 0.0f;
+		}
+		else {
+			deskFrustum = building.visibleFrustum(0);
+			if (deskFrustum)
+				dynamicScene.cull(*deskFrustum, cullMargin, visibleDynamic, frameStats);
+		}
+		bool desksVisible = desks.ready() && deskFrustum;
+		if (prepassAdvisor.active() && (multi_view || overdraw_view)) {
+			prepassAdvisor.abandon(multi_view ? "multi-view" : "overdraw heat map");
+			prepassAdvisor.report(std::cout);
+			depthPrepass.enabled = prepassAdvisor.recommendsPrepass();
+		}
+		if (prepassAdvisor.active())
+			depthPrepass.enabled = prepassAdvisor.frameUsesPrepass();
+
+		// render: the frame's GPU work as passes of the render graph, which drops the ones nothing reads (the shadows
+		// and lights under the heat map) and orders the rest by what they read and write
+		// ---------------------------------------------------------------------------------------------------------
+		renderGraph.beginFrame(antialiasing.activeName());
+		RenderResource frameOutput = renderGraph.import("frame", true);
+		RenderResource sceneOutput = frameOutput;
+		if (scaled) {
+			sceneOutput = renderGraph.import("scaled frame");
+			dynamicResolution.declare(renderGraph, sceneOutput, frameOutput, outputFramebuffer, outputWidth, outputHeight, upscaleShader);
+		}
+		RenderResource sceneColor, sceneDepth;
+		antialiasing.declare(renderGraph, sceneOutput, fxaaShader, taaShader, sceneColor, sceneDepth);
+		RenderResource shadowMaps = renderGraph.import("shadow maps");
+		RenderResource lightGrid = renderGraph.import("light grid");
+		RenderResource deskCommands = renderGraph.import("desk draw commands");
+		// the passes run in execute() below, so everything they capture lives at this scope
+		bool heatMap = overdraw_view && !multi_view;
+		RenderResource overdrawCounts = -1;
+		renderGraph.addPass("clear", [&] {
+			antialiasing.bindScene(renderGraph);
+			glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		}).writes(sceneColor).writes(sceneDepth);
+		// shadow maps: cached static casters, dynamic ones redrawn only when they moved
+		renderGraph.addPass("shadows", [&] {
+			shadows.update(shadowShader, lighting, staticScene, dynamicScene);
+		}).writes(shadowMaps);
+		// lights are assigned to froxels of the same, possibly widened, frustum
+		renderGraph.addPass("light assignment", [&] {
+			if (lighting.needsUpdate())
+				lighting.update(cullView, cullProjection, camera.GetNearPlane(), camera.GetFarPlane());
+		}).writes(lightGrid);
+		if (desksVisible) {
+			renderGraph.addPass("desk cull", [&] {
+				desks.cull(cullShader, *deskFrustum, deskMargin, frameStats);
+			}).writes(deskCommands);
+		}
+		if (multi_view) {
+			// every view in one pass: the draws are submitted once and multiview.gs fans them out to the viewports
+			renderGraph.addPass("multi-view scene", [&] {
+				antialiasing.bindScene(renderGraph);
+				multiview.begin();
+				const Shader* multiviewShaders[] = { &multiviewShader, &multiviewInstancedShader, &multiviewAnimatedShader };
+				for (const Shader* shader : multiviewShaders) {
+					if (!shader->ID)
+						continue;
+					shader->use();
+					lighting.apply(*shader);
+					shadows.apply(*shader);
+					shader->setInt("viewMask", multiview.allViews());
+				}
+				multiviewShader.use();
+				multiview.draw(multiviewShader, frameStats);
+				multiviewShader.setInt("viewMask", 1);
+				streamer.draw(multiviewShader, frameStats);
+				if (desksVisible) {
+					multiviewInstancedShader.use();
+					desks.draw(frameStats);
+				}
+				multiviewAnimatedShader.use();
+				fans.draw(multiviewAnimatedShader, frameStats);
+				multiview.end();
+			}).reads(shadowMaps).reads(lightGrid).reads(deskCommands).writes(sceneColor).writes(sceneDepth);
+		}
+		else {
+			// optional depth pre-pass, then shade (or count shaded fragments for the heat map) at equal depth; the
+			// pre-pass A/B measurement times both
+			if (depthPrepass.enabled) {
+				renderGraph.addPass("depth prepass", [&] {
+					if (prepassAdvisor.active())
+						prepassAdvisor.gpuBegin();
+					antialiasing.bindScene(renderGraph);
+					prepassShader.use();
+					depthPrepass.begin();
+					building.draw(prepassShader, frameStats);
+					streamer.draw(prepassShader, frameStats);
+					dynamicScene.draw(prepassShader, visibleDynamic, frameStats);
+					if (desksVisible) {
+						instancedPrepassShader.use();
+						desks.draw(frameStats);
+					}
+					animatedPrepassShader.use();
+					fans.draw(animatedPrepassShader, frameStats);
+				}).reads(deskCommands).writes(sceneDepth);
+			}
+			if (heatMap)
+				overdrawCounts = renderGraph.createTexture("overdraw counts", OverdrawCounter::countsDesc(sceneWidth, sceneHeight));
+			RenderPassBuilder scenePass = renderGraph.addPass(heatMap ? "overdraw count" : "scene", [&] {
+				if (prepassAdvisor.active() && !depthPrepass.enabled)
+					prepassAdvisor.gpuBegin();
+				antialiasing.bindScene(renderGraph);
+				depthPrepass.shade();
+				if (heatMap)
+					overdraw.begin(renderGraph.texture(overdrawCounts));
+				const Shader& sceneShader = heatMap ? overdrawShader : ourShader;
+				sceneShader.use();
+				if (!heatMap) {
+					lighting.apply(ourShader);
+					shadows.apply(ourShader);
+				}
+				building.draw(sceneShader, frameStats);
+				streamer.draw(sceneShader, frameStats);
+				dynamicScene.draw(sceneShader, visibleDynamic, frameStats);
+				if (desksVisible) {
+					const Shader& deskShader = heatMap ? instancedOverdrawShader : instancedShader;
+					deskShader.use();
+					if (!heatMap) {
+						lighting.apply(deskShader);
+						shadows.apply(deskShader);
+					}
+					desks.draw(frameStats);
+				}
+				const Shader& fanShader = heatMap ? animatedOverdrawShader : animatedShader;
+				fanShader.use();
+				if (!heatMap) {
+					lighting.apply(fanShader);
+					shadows.apply(fanShader);
+				}
+				fans.draw(fanShader, frameStats);
+				depthPrepass.end();
+				if (prepassAdvisor.active())
+					prepassAdvisor.gpuEnd();
+			});
+			scenePass.reads(deskCommands).reads(sceneDepth).writes(sceneDepth);
+			if (heatMap) {
+				scenePass.writes(overdrawCounts);
+				renderGraph.addPass("overdraw resolve", [&] {
+					antialiasing.bindScene(renderGraph);
+					overdraw.resolve(overdrawResolveShader);
+				}).reads(overdrawCounts).writes(sceneColor);
+				// leaving the heat map reports the overdraw it showed
+				if (overdraw_measure) {
+					renderGraph.addPass("overdraw measure", [&] {
+						GLint viewport[4];
+						glGetIntegerv(GL_VIEWPORT, viewport);
+						double mean;
+						unsigned int maximum;
+						overdraw.measure(renderGraph.texture(overdrawCounts), viewport[2], viewport[3], mean, maximum);
+						std::cout << "overdraw with pre-pass " << (depthPrepass.enabled ? "on" : "off") << ": " << mean << " shaded fragments per covered pixel, max " << maximum << std::endl;
+						overdraw_view = false;
+						overdraw_measure = false;
+					}).reads(overdrawCounts).sideEffect();
+				}
+			}
+			else {
+				scenePass.reads(shadowMaps).reads(lightGrid).writes(sceneColor);
+			}
+			if (cell_overlay) {
+				renderGraph.addPass("cell overlay", [&] {
+					antialiasing.bindScene(renderGraph);
+					building.drawOverlay();
+				}).writes(sceneColor);
+			}
+		}
+		// GL_TIME_ELAPSED queries do not nest, so the scale holds while the prepass advisor measures
+		bool measureResolution = scaled && !prepassAdvisor.active();
+		if (measureResolution)
+			dynamicResolution.gpuBegin();
+		renderGraph.execute();
+		if (measureResolution)
+			dynamicResolution.gpuEnd();
+
+		// late latch: pick up input that arrived while the frame was being recorded and write the final pose over the
+		// one latched at the start of the frame, in the mapped uniform buffer the draws above read from
+		if (late_latch) {
+			glfwPollEvents();
+			updateCamera(window);
+			cameraUBO.latch(camera);
+		}
+		if (regression.active())
+			regression.gpuEnd();
+		if (lightBench.active())
+			lightBench.gpuEnd();
+		pacer.gpuEnd();
+		cameraUBO.endFrame();
+		// the readback is queued behind the frame; its pixels are collected a few frames later
+		if (capture.isOpen())
+			capture.capture(options.headless ? (GLuint)offscreen.framebuffer : 0);
+		if (regression.active())
+			regression.endFrame(offscreen, (double)(inputClockNow() - frameStart) / 1.0e6);
+		if (lightBench.active())
+			lightBench.endFrame(lighting);
+
+		if (recorder.isOpen()) {
+			recorder.write(deltaTime, recordedInput, camera);
+			recordedInput = FrameInput();
+		}
+		if (telemetry.isOpen()) {
+			TelemetryFrame& record = telemetry.frame();
+			record.timeNs = frameStart;
+			record.cpuMs = (float)((double)(inputClockNow() - frameStart) / 1.0e6);
+			record.resolutionScale = scaled ? dynamicResolution.currentScale() : 1.0f;
+			record.submitted = frameStats.submitted;
+			record.culled = frameStats.culled;
+			record.drawCalls = frameStats.drawCalls;
+			record.triangles = frameStats.triangles;
+			record.gpuBytes = gpuResources().totalBytes();
+			renderGraph.visitExecutedPasses([](const char* pass, double cpuMs, double gpuMs) {
+				telemetry.addPhase(pass, cpuMs, gpuMs);
+			});
+		}
+		if (replaying) {
+			if (previousFrameStart != 0)
+				replayReport.addFrame((double)(frameStart - previousFrameStart) / 1.0e6, frameStats.drawCalls, frameStats.culled, replayDrift);
+			previousFrameStart = frameStart;
 		}
-
-		model = transforamtion(6.74, -.76, -5.25, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, .01, 4, .01);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAOL);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-		Fan fan;
-		ourShader = fan.local_rotation(ourShader, VAOF3, i);
-
-		if(fan_turn)
-			i+=5;
-		if(rotate_around)
-			camera.ProcessKeyboard(Y_LEFT, deltaTime);
-		// render boxes
-		//for (unsigned int i = 0; i < 10; i++)
-		//{
-		//    // calculate the model matrix for each object and pass it to shader before drawing
-		//    glm::mat4 model = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
-		//    model = glm::translate(model, cubePositions[i]);
-		//    float angle = 20.0f * i;
-		//    model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-		//    ourShader.setMat4("model", model);
-
-		//    glDrawArrays(GL_TRIANGLES, 0, 36);
-		//}
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// -------------------------------------------------------------------------------
-		glfwSwapBuffers(window);
+		if (!options.headless)
+			glfwSwapBuffers(window);
+		input.framePresented();
+		assets.framePresented();
+		pacer.frameSwapped();
+		if (replaying)
+			pacer.visitNewGpuTimes([&](double ms) { replayReport.addGpuTime(ms); });
+		if (telemetry.isOpen()) {
+			telemetry.frame().gpuMs = (float)pacer.lastGpuMs();
+			telemetry.publish();
+		}
+		if (prepassAdvisor.active() && prepassAdvisor.endFrame()) {
+			prepassAdvisor.report(std::cout);
+			depthPrepass.enabled = prepassAdvisor.recommendsPrepass();
+		}
 		glfwPollEvents();
 	}
+	recorder.close();
+	if (capture.isOpen()) {
+		capture.close();
+		capture.report(std::cout);
+	}
+	assets.shutdown();
+	// a run that stopped at loading has nothing to report
+	if (replaying && !assetsFailed) {
+		replayReport.print(std::cout);
+		if (options.reportPath && !replayReport.writeCsv(options.reportPath))
+			std::cout << "ERROR::REPLAY:: cannot write " << options.reportPath << std::endl;
+	}
+	else if (!assetsFailed && !regression.active() && !lightBench.active()) {
+		input.report(std::cout);
+		pacer.report(std::cout);
+		shadows.report(std::cout);
+		renderGraph.report(std::cout);
+		antialiasing.report(std::cout, renderGraph);
+		dynamicResolution.report(std::cout);
+		telemetry.report(std::cout);
+		frameArena().report(std::cout);
+		materials.report(std::cout);
+		occlusion.report(std::cout);
+		assets.report(std::cout);
+		if (desks.ready())
+			desks.report(std::cout);
+		fans.report(std::cout);
+		multiview.report(std::cout);
+		if (building.cellCount() > 1) {
+			building.report(std::cout);
+			streamer.report(std::cout);
+		}
+		gpuResources().report(std::cout);
+	}
+	bool regressionPassed = !regression.active() || (!assetsFailed && regression.report(std::cout));
+	regression.destroy();
+	if (lightBench.active() && !assetsFailed)
+		lightBench.report(std::cout);
+	lightBench.destroy();
+	shadows.destroy();
+	lighting.destroy();
+	materials.destroy();
+	occlusion.destroy();
+	overdraw.destroy();
+	renderGraph.destroy();
+	frameArena().destroy();
+	antialiasing.destroy();
+	dynamicResolution.destroy();
+	telemetry.close();
+	streamer.destroy();
+	fans.destroy();
+	multiview.destroy();
+	prepassAdvisor.destroy();
+	if (options.gpuDriven)
+		desks.destroy();
+	if (options.headless)
+		offscreen.destroy();
+	input.shutdown();
+	pacer.destroy();
+	cameraUBO.destroy();
+
+	Shader* shaders[] = { &ourShader, &shadowShader, &prepassShader, &overdrawShader, &overdrawResolveShader,
+		&cullShader, &instancedShader, &instancedPrepassShader, &instancedOverdrawShader,
+		&animatedShader, &animatedPrepassShader, &animatedOverdrawShader, &animatedShadowShader,
+		&multiviewShader, &multiviewInstancedShader, &multiviewAnimatedShader, &fxaaShader, &taaShader, &upscaleShader };
+	for (Shader* shader : shaders)
+		shader->destroy();
 
 	// optional: de-allocate all resources once they've outlived their purpose:
 	// ------------------------------------------------------------------------
-	glDeleteVertexArrays(1, &VAO);
-	glDeleteBuffers(1, &VBO);
-	glDeleteBuffers(1, &EBO);
-	glDeleteVertexArrays(1, &VAO2);
-	glDeleteBuffers(1, &VBO2);
-	glDeleteBuffers(1, &EBO2);
-	glDeleteVertexArrays(1, &VAO3);
-	glDeleteBuffers(1, &VBO3);
-	glDeleteBuffers(1, &EBO3);
-	glDeleteVertexArrays(1, &VAO4);
-	glDeleteBuffers(1, &VBO4);
-	glDeleteBuffers(1, &EBO4);
-	glDeleteVertexArrays(1, &VAO5);
-	glDeleteBuffers(1, &VBO5);
-	glDeleteBuffers(1, &EBO5);
-	glDeleteVertexArrays(1, &VAOG);
-	glDeleteBuffers(1, &VBOG);
-	glDeleteBuffers(1, &EBOG);
-	glDeleteVertexArrays(1, &VAOW1);
-	glDeleteBuffers(1, &VBOW1);
-	glDeleteBuffers(1, &EBOW1);
-	glDeleteVertexArrays(1, &VAOW2);
-	glDeleteBuffers(1, &VBOW2);
-	glDeleteBuffers(1, &EBOW2);
+	boxVAO.reset();
+	boxVBO.reset();
+	boxEBO.reset();
+	// everything the renderer created must be gone by now
+	gpuResources().reportLeaks(std::cout);
 
 	// glfw: terminate, clearing all previously allocated GLFW resources.
 	// ------------------------------------------------------------------
 	glfwTerminate();
-	return 0;
+	return regressionPassed && !assetsFailed ? 0 : 1;
 }
 
-// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
+// lays the desks out on a worker, uploads them on the upload context and creates their vertex array once they are
+// complete; desks is not touched by the frame until desks.ready()
 // ---------------------------------------------------------------------------------------------------------
-void processInput(GLFWwindow* window)
+AssetTask streamDesks(AssetPipeline& assets, AssetGroup& group, GpuDrivenScene& desks, MeshBuilder deskMesh, int count)
 {
-	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-		glfwSetWindowShouldClose(window, true);
+	assets.started(group);
+	co_await assets.onWorker();
+	unsigned int deskMeshIndex = desks.addMesh(deskMesh);
+	for (int k = 0; k < count; k++)
+		desks.addInstance(deskMeshIndex, deskGridPosition(k, count), 0.0f);
+	co_await assets.onUploadContext();
+	assets.addUploaded(desks.uploadBuffers());
+	co_await assets.uploaded();
+	desks.createVertexArray();
+	assets.completed(group);
+}
+
+// one desk and its chair baked into a single mesh for the gpu-driven scene
+MeshBuilder buildDeskMesh()
+{
+	DrawList deskParts;
+	Table_Chair desk;
+	desk.append(deskParts, 0);
+	MeshBuilder deskMesh;
+	for (const DrawItem& part : deskParts.items)
+		deskMesh.addBox(cube_vertices, cube_indices, part.model, part.material);
+	return deskMesh;
+}
+
+// the gpu-driven desks fill a square grid continuing the classroom's layout
+glm::vec3 deskGridPosition(int desk, int count)
+{
+	int side = (int)ceil(sqrt((double)count));
+	return glm::vec3(-2.0f + 2.0f * (desk / side), 0.0f, -2.0f * (desk % side));
+}
 
-	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-		camera.ProcessKeyboard(FORWARD, deltaTime);
+// one classroom shifted dx along x: its furniture (unless the desks are gpu-driven), floor, walls, blackboard,
+// cabinet, ceiling and the fan's mount; with a corridor behind it the back wall has a doorway
+// ---------------------------------------------------------------------------------------------------------
+void addClassroom(DrawList& scene, unsigned int boxVAO, float dx, bool doorway, bool furniture, bool fanGrid)
+{
+	glm::mat4 model;
+	//Table_Chair
+	if (furniture) {
+		Table_Chair table_chair[16];
+		float shiftx = -2, shiftz = 0;
+		for (int i = 0; i < 4; i++) {
+			for (int j = 0; j < 4; j++) {
+				table_chair[i * 4 + j].tox = dx + shiftx;
+				table_chair[i * 4 + j].toz = shiftz;
+				table_chair[i * 4 + j].append(scene, boxVAO);
+				shiftz -= 2;
+			}
+			shiftz = 0;
+			shiftx += 2;
+		}
 	}
-	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-		camera.ProcessKeyboard(BACKWARD, deltaTime);
+
+	//Floor
+	model = transforamtion(dx - 2.5, -.8, -9, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 20, 0.1, 24);
+	scene.add(boxVAO, MATERIAL_FLOOR, model);
+
+	//Wall1
+	model = transforamtion(dx - 2.5, -.75, -9, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 20, 7, 0.2);
+	scene.add(boxVAO, MATERIAL_WALL1, model);
+
+	if (doorway)
+		addDoorWall(scene, boxVAO, dx, 3, MATERIAL_WALL1);
+	else {
+		model = transforamtion(dx - 2.5, -.75, 3, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 20, 7, 0.2);
+		scene.add(boxVAO, MATERIAL_WALL1, model);
 	}
-	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-		camera.ProcessKeyboard(LEFT, deltaTime);
+
+	//Wall2
+	model = transforamtion(dx - 2.5, -.75, -9, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, .2, 7, 24);
+	scene.add(boxVAO, MATERIAL_WALL2, model);
+
+	model = transforamtion(dx + 7.5, -.75, -9, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, .2, 7, 24);
+	scene.add(boxVAO, MATERIAL_WALL2, model);
+
+	//BlackBoard
+	model = transforamtion(dx - .5, 0.5, -8.9, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 12, 3, 0.2);
+	scene.add(boxVAO, MATERIAL_BLACKBOARD, model);
+	model = transforamtion(dx - .6, 0.4, -8.95, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 12.5, 3.5, 0.2);
+	scene.add(boxVAO, MATERIAL_CHAIR_PILLAR, model);
+
+	//Cabinate
+	model = transforamtion(dx + 6.75, -.75, -6, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 1.5, 4, 3);
+	scene.add(boxVAO, MATERIAL_CABINATE, model);
+
+	//Ceiling
+	model = transforamtion(dx - 2.5, 2.75, -9, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 20, 0.1, 24);
+	scene.add(boxVAO, MATERIAL_CEILING, model);
+
+	//Fan
+	model = transforamtion(dx + 2, 2.5, -6, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 1, .5, 1);
+	scene.add(boxVAO, MATERIAL_FAN_HOLDER, model);
+
+	model = transforamtion(dx + 2.125, 2.25, -5.875, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, .5, .75, .5);
+	scene.add(boxVAO, MATERIAL_FAN_PIVOT, model);
+
+	// mounts of the other ceiling tiles' fans
+	for (int tile = 1; fanGrid && tile < (int)(sizeof(FAN_TILE_OFFSETS) / sizeof(FAN_TILE_OFFSETS[0])); tile++) {
+		glm::vec2 o = FAN_TILE_OFFSETS[tile];
+		model = transforamtion(dx + 2 + o.x, 2.5, -6 + o.y, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 1, .5, 1);
+		scene.add(boxVAO, MATERIAL_FAN_HOLDER, model);
+		model = transforamtion(dx + 2.125 + o.x, 2.25, -5.875 + o.y, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, .5, .75, .5);
+		scene.add(boxVAO, MATERIAL_FAN_PIVOT, model);
+	}
+
+	for (int i = 0; i < 4; i++) {
+		model = transforamtion(dx + (-.4+2*i), -.75, -9, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, .01, .01, 24);
+		scene.add(boxVAO, MATERIAL_BORDER, model);
 	}
-	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-		camera.ProcessKeyboard(RIGHT, deltaTime);
+
+	for (int i = 0; i < 5; i++) {
+		model = transforamtion(dx - 2.4, -.75, -7 + 2 * i, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 24, .01, .01);
+		scene.add(boxVAO, MATERIAL_BORDER, model);
 	}
-	if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) {
-		camera.ProcessKeyboard(UP, deltaTime);
+
+	model = transforamtion(dx + 6.74, -.76, -5.25, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, .01, 4, .01);
+	scene.add(boxVAO, MATERIAL_BORDER, model);
+}
+
+// the corridor segment behind the classroom at dx; only the two ends of the corridor are closed
+// ---------------------------------------------------------------------------------------------------------
+void addCorridor(DrawList& scene, unsigned int boxVAO, float dx, bool firstSegment, bool lastSegment)
+{
+	glm::mat4 model;
+	model = transforamtion(dx - 2.5, -.8, 3.1, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 20.2, 0.1, 6.2);
+	scene.add(boxVAO, MATERIAL_FLOOR, model);
+	model = transforamtion(dx - 2.5, 2.75, 3.1, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 20.2, 0.1, 6.2);
+	scene.add(boxVAO, MATERIAL_CEILING, model);
+	addDoorWall(scene, boxVAO, dx, 3.1f, MATERIAL_WALL2);
+	model = transforamtion(dx - 2.5, -.75, 6.1, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 20.2, 7, 0.2);
+	scene.add(boxVAO, MATERIAL_WALL2, model);
+	if (firstSegment) {
+		model = transforamtion(dx - 2.5, -.75, 3.1, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, .2, 7, 6.2);
+		scene.add(boxVAO, MATERIAL_WALL1, model);
 	}
-	if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) {
-		camera.ProcessKeyboard(DOWN, deltaTime);
+	if (lastSegment) {
+		model = transforamtion(dx + 7.5, -.75, 3.1, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, .2, 7, 6.2);
+		scene.add(boxVAO, MATERIAL_WALL1, model);
 	}
-	if (glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS) {
-		camera.ProcessKeyboard(P_UP, deltaTime);
+}
+
+// a 0.1 thick wall along x at depth z, the width of a classroom, with the doorway between DOOR_LEFT and DOOR_RIGHT
+// ---------------------------------------------------------------------------------------------------------
+void addDoorWall(DrawList& scene, unsigned int boxVAO, float dx, float z, unsigned int material)
+{
+	glm::mat4 model;
+	model = transforamtion(dx - 2.5f, -.75f, z, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 2 * (DOOR_LEFT + 2.5f), 7, 0.2f);
+	scene.add(boxVAO, material, model);
+	model = transforamtion(dx + DOOR_RIGHT, -.75f, z, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 2 * (7.6f - DOOR_RIGHT), 7, 0.2f);
+	scene.add(boxVAO, material, model);
+	model = transforamtion(dx + DOOR_LEFT, DOOR_TOP, z, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 2 * (DOOR_RIGHT - DOOR_LEFT), 2 * (2.75f - DOOR_TOP), 0.2f);
+	scene.add(boxVAO, material, model);
+}
+
+// process all input: drain the events queued by the GLFW callbacks and react to the mapped actions
+// ---------------------------------------------------------------------------------------------------------
+void processInput(GLFWwindow* window, const FrameInput& frameInput)
+{
+	if (frameInput.wasPressed(ACTION_QUIT))
+		glfwSetWindowShouldClose(window, true);
+
+	const struct { Input_Action action; Camera_Movement movement; } movements[] = {
+		{ ACTION_MOVE_FORWARD, FORWARD },
+		{ ACTION_MOVE_BACKWARD, BACKWARD },
+		{ ACTION_MOVE_LEFT, LEFT },
+		{ ACTION_MOVE_RIGHT, RIGHT },
+		{ ACTION_MOVE_UP, UP },
+		{ ACTION_MOVE_DOWN, DOWN },
+		{ ACTION_PITCH_UP, P_UP },
+		{ ACTION_PITCH_DOWN, P_DOWN },
+		{ ACTION_YAW_LEFT, Y_LEFT },
+		{ ACTION_YAW_RIGHT, Y_RIGHT },
+		{ ACTION_ROLL_LEFT, R_LEFT },
+		{ ACTION_ROLL_RIGHT, R_RIGHT },
+	};
+	for (const auto& m : movements) {
+		if (frameInput.isDown(m.action))
+			camera.ProcessKeyboard(m.movement);
 	}
-	if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS) {
-		camera.ProcessKeyboard(P_DOWN, deltaTime);
+	if (rotate_around)
+		camera.ProcessKeyboard(Y_LEFT);
+
+	if (frameInput.mouse.x != 0.0f || frameInput.mouse.y != 0.0f)
+		camera.ProcessMouseMovement(frameInput.mouse.x, frameInput.mouse.y);
+	if (frameInput.scroll != 0.0f)
+		camera.ProcessMouseScroll(frameInput.scroll);
+
+	if (frameInput.wasPressed(ACTION_MODE_FREE_FLY))
+		camera.SetMode(FREE_FLY);
+	if (frameInput.wasPressed(ACTION_MODE_ORBIT))
+		camera.SetMode(ORBIT);
+	if (frameInput.wasPressed(ACTION_MODE_LOOK_AT))
+		camera.SetMode(LOOK_AT);
+
+	// toggles flip once per key press, not once per frame the key is held
+	if (frameInput.wasPressed(ACTION_TOGGLE_FAN))
+		fan_turn = !fan_turn;
+	if (frameInput.wasPressed(ACTION_TOGGLE_ROTATE_AROUND))
+		rotate_around = !rotate_around;
+
+	// F7 overrides the measured pre-pass decision; leaving the heat map reports the overdraw of its last frame
+	if (frameInput.wasPressed(ACTION_TOGGLE_PREPASS) && !prepassAdvisor.active()) {
+		depthPrepass.enabled = !depthPrepass.enabled;
+		std::cout << "depth pre-pass " << (depthPrepass.enabled ? "on" : "off") << std::endl;
 	}
-	if (glfwGetKey(window, GLFW_KEY_Y) == GLFW_PRESS) {
-		camera.ProcessKeyboard(Y_LEFT, deltaTime);
+	if (frameInput.wasPressed(ACTION_TOGGLE_OVERDRAW)) {
+		// the multi-view pass draws no heat map, so there is nothing to measure
+		overdraw_measure = overdraw_view && !multi_view;
+		overdraw_view = overdraw_measure || !overdraw_view;
 	}
-	if (glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS) {
-		camera.ProcessKeyboard(Y_RIGHT, deltaTime);
+	if (frameInput.wasPressed(ACTION_TOGGLE_CELL_OVERLAY))
+		cell_overlay = !cell_overlay;
+	if (frameInput.wasPressed(ACTION_CYCLE_ANTIALIASING)) {
+		antialiasing.cycle();
+		std::cout << "anti-aliasing " << antialiasingModeName(antialiasing.mode()) << std::endl;
 	}
-	if (glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS) {
-		camera.ProcessKeyboard(R_LEFT, deltaTime);
+	if (frameInput.wasPressed(ACTION_TOGGLE_MULTIVIEW) && !options.replayPath) {
+		multi_view = !multi_view;
+		int width, height;
+		glfwGetFramebufferSize(window, &width, &height);
+		applyViewLayout(width, height);
 	}
-	if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) {
-		camera.ProcessKeyboard(R_RIGHT, deltaTime);
+
+	// report the latency of the mode being left, so late latching and pacing can be compared; a replay keeps
+	// both off so its timings are comparable between runs
+	if (options.replayPath)
+		return;
+	if (frameInput.wasPressed(ACTION_EVALUATE_PREPASS) && !prepassAdvisor.active())
+		prepassAdvisor.start();
+	// one small buffer update, no mesh is touched
+	if (frameInput.wasPressed(ACTION_CYCLE_MATERIAL)) {
+		desk_top_color = (desk_top_color + 1) % (int)(sizeof(DESK_TOP_COLORS) / sizeof(DESK_TOP_COLORS[0]));
+		Material top = materials.get(MATERIAL_TABLE_TOP);
+		top.baseColor = glm::vec4(DESK_TOP_COLORS[desk_top_color], 1.0f);
+		materials.set(MATERIAL_TABLE_TOP, top);
 	}
-	if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS) {
-		if (!fan_turn) {
-			fan_turn = true;
-		}
-		else {
-			fan_turn = false;
-		}
+	if (frameInput.wasPressed(ACTION_TOGGLE_LATE_LATCH) && cameraUBO.canLateLatch() && !options.recordPath) {
+		std::cout << "late latch " << (late_latch ? "on" : "off") << ", pacing " << (pacer.enabled ? "on" : "off") << std::endl;
+		input.report(std::cout);
+		input.latency().clear();
+		late_latch = !late_latch;
 	}
-	if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS) {
-		if (!rotate_around) {
-			rotate_around = true;
-		}
-		else {
-			rotate_around = false;
-		}
+	if (frameInput.wasPressed(ACTION_TOGGLE_PACING)) {
+		std::cout << "late latch " << (late_latch ? "on" : "off") << ", pacing " << (pacer.enabled ? "on" : "off") << std::endl;
+		input.report(std::cout);
+		pacer.report(std::cout);
+		input.latency().clear();
+		pacer.reset();
+		pacer.enabled = !pacer.enabled;
 	}
+}
 
+// applies the input queued since the last call and advances the camera by the time elapsed since then, so
+// sampling twice in one frame (late latch) moves it no further than sampling once; while recording, by the fixed delta
+// ---------------------------------------------------------------------------------------------------------
+void updateCamera(GLFWwindow* window)
+{
+	float now = static_cast<float>(glfwGetTime());
+	input.beginFrame();
+	FrameInput frameInput = input.sample();
+	recordedInput.merge(frameInput);
+	processInput(window, frameInput);
+	camera.Update(options.recordPath ? options.fixedDelta : now - lastCameraUpdate);
+	lastCameraUpdate = now;
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -1125,6 +1395,16 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 	// make sure the viewport matches the new window dimensions; note that width and
 	// height will be significantly larger than specified on retina displays.
 	glViewport(0, 0, width, height);
+	applyViewLayout(width, height);
+}
+
+// splits the window between the views in multi-view mode and gives the fly camera the aspect of its viewport
+// ---------------------------------------------------------------------------------------------------------
+void applyViewLayout(int width, int height)
+{
+	multiview.resize(width, height);
+	if (height > 0)
+		camera.SetAspectRatio(multi_view ? multiview.mainAspect() : (float)width / (float)height);
 }
 
 
@@ -1132,28 +1412,181 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 // -------------------------------------------------------
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
 {
-	float xpos = static_cast<float>(xposIn);
-	float ypos = static_cast<float>(yposIn);
+	input.pushMouseMove(xposIn, yposIn);
+}
 
-	if (firstMouse)
-	{
-		lastX = xpos;
-		lastY = ypos;
-		firstMouse = false;
-	}
+// glfw: whenever the mouse scroll wheel scrolls, this callback is called
+// ----------------------------------------------------------------------
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
+{
+	input.pushScroll(xoffset, yoffset);
+}
 
-	float xoffset = xpos - lastX;
-	float yoffset = lastY - ypos; // reversed since y-coordinates go from bottom to top
+// glfw: whenever a key is pressed or released, this callback is called
+// --------------------------------------------------------------------
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+	input.pushKey(key, action);
+}
 
-	lastX = xpos;
-	lastY = ypos;
+// glfw: whenever a mouse button is pressed or released, this callback is called
+// ------------------------------------------------------------------------------
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
+{
+	input.pushMouseButton(button, action);
+}
 
-	camera.ProcessMouseMovement(xoffset, yoffset);
+// ceiling lights in three rows of four, a spot light on the blackboard and one over the desks; the spot lights cast
+// shadows
+// ---------------------------------------------------------------------------------------------------------
+std::vector<Light> classroomLightList(int rooms)
+{
+	std::vector<Light> classroomLights;
+	for (int row = 0; row < 3; row++) {
+		for (int column = 0; column < 4; column++)
+			classroomLights.push_back(Light::point(glm::vec3(-1.0f + 2.5f * column, 2.55f, -7.0f + 3.5f * row), glm::vec3(1.0f, 0.96f, 0.88f), 1.5f, 6.0f));
+	}
+	classroomLights.push_back(Light::spot(glm::vec3(2.5f, 2.6f, -5.5f), glm::vec3(0.0f, -0.5f, -1.0f), glm::vec3(1.0f), 3.0f, 8.0f, 25.0f, 35.0f));
+	classroomLights.back().castsShadows = true;
+	classroomLights.push_back(Light::spot(glm::vec3(2.5f, 2.7f, -3.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(1.0f, 0.95f, 0.85f), 2.5f, 6.0f, 40.0f, 60.0f));
+	classroomLights.back().castsShadows = true;
+	// the other rooms and the corridor get the ceiling lights only; the shadow maps stay in the first classroom
+	for (int room = 1; room < rooms; room++) {
+		for (int k = 0; k < 12; k++) {
+			Light light = classroomLights[k];
+			light.position.x += CLASSROOM_SPACING * room;
+			classroomLights.push_back(light);
+		}
+	}
+	if (rooms > 1) {
+		for (int room = 0; room < rooms; room++)
+			classroomLights.push_back(Light::point(glm::vec3(2.5f + CLASSROOM_SPACING * room, 2.55f, 4.65f), glm::vec3(1.0f, 0.96f, 0.88f), 1.5f, 6.0f));
+	}
+	return classroomLights;
 }
 
-// glfw: whenever the mouse scroll wheel scrolls, this callback is called
-// ----------------------------------------------------------------------
-void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
+// classroom materials, in Classroom_Material order; all share the default surface so the goldens still match
+// ---------------------------------------------------------------------------------------------------------
+std::vector<Material> classroomMaterialList()
+{
+	std::vector<Material> classroomMaterials(MATERIAL_COUNT);
+	classroomMaterials[MATERIAL_TABLE_TOP] = Material(glm::vec3(0.59f, 0.19f, 0.0f));
+	classroomMaterials[MATERIAL_TABLE_LEG] = Material(glm::vec3(0.8f, 0.59f, 0.0f));
+	classroomMaterials[MATERIAL_CHAIR_LEG] = Material(glm::vec3(0.39f, 0.3f, 0.0f));
+	classroomMaterials[MATERIAL_CHAIR_PILLAR] = Material(glm::vec3(0.2f, 0.2f, 0.02f));
+	classroomMaterials[MATERIAL_CHAIR_BACK] = Material(glm::vec3(0.9f, 0.9f, 0.0f));
+	classroomMaterials[MATERIAL_FLOOR] = Material(glm::vec3(0.69f, 0.69f, 0.69f));
+	classroomMaterials[MATERIAL_WALL1] = Material(glm::vec3(0.92f, 0.91f, 0.83f));
+	classroomMaterials[MATERIAL_WALL2] = Material(glm::vec3(0.99f, 0.84f, 0.7f));
+	classroomMaterials[MATERIAL_BLACKBOARD] = Material(glm::vec3(0.0f, 0.0f, 0.0f));
+	classroomMaterials[MATERIAL_CABINATE] = Material(glm::vec3(0.29f, 0.0f, 0.29f));
+	classroomMaterials[MATERIAL_CEILING] = Material(glm::vec3(0.95f, 0.95f, 0.95f));
+	classroomMaterials[MATERIAL_FAN_HOLDER] = Material(glm::vec3(1.0f, 1.0f, 1.0f));
+	classroomMaterials[MATERIAL_FAN_PIVOT] = Material(glm::vec3(0.44f, 0.22f, 0.05f));
+	classroomMaterials[MATERIAL_FAN_BLADE] = Material(glm::vec3(0.0f, 0.0f, 0.42f));
+	classroomMaterials[MATERIAL_BORDER] = Material(glm::vec3(0.0f, 0.0f, 0.0f));
+	return classroomMaterials;
+}
+
+// renders the regression viewpoints of the first classroom on the CPU, without a window or GL context. Each image is
+// written next to the goldens as <name>.soft.ppm and compared with the golden, which has shadows the software renderer
+// leaves out, and every viewpoint is rendered repeatedly to time it and to check that the images are bit-identical
+// ---------------------------------------------------------------------------------------------------------
+int runSoftwareRenderer(const char* directory, int threads)
+{
+	const unsigned int SOFT_BOX = 1, SOFT_BLADES = 2;
+	const int WARMUP = 2, MEASURED = 10;
+	SoftwareRenderer renderer;
+	renderer.init(SCR_WIDTH, SCR_HEIGHT, threads > 0 ? threads : (int)std::max(1u, std::thread::hardware_concurrency()));
+	SoftMesh box;
+	box.vertices.assign(cube_mesh.vertices.begin(), cube_mesh.vertices.end());
+	box.indices.assign(cube_mesh.indices.begin(), cube_mesh.indices.end());
+	renderer.setMesh(SOFT_BOX, box);
+	renderer.setMaterials(classroomMaterialList());
+	renderer.setLights(classroomLightList(1), ClusteredLighting().ambient);
+
+	// the scene of the goldens: one classroom, the turned desk and the fan at rest
+	DrawList scene;
+	addClassroom(scene, SOFT_BOX, 0.0f, false, true, false);
+	Table_Chair tc;
+	tc.tox = 5;
+	tc.toz = -8.5;
+	tc.local_rotation(scene, SOFT_BOX, 135);
+	MeshBuilder bladeMesh;
+	Fan fan;
+	glm::vec3 pivot = fan.bake(bladeMesh, cube_vertices, cube_indices);
+	SoftMesh blades;
+	blades.vertices = bladeMesh.vertices;
+	blades.indices.assign(bladeMesh.indices.begin(), bladeMesh.indices.end());
+	blades.materials.assign(bladeMesh.materials.begin(), bladeMesh.materials.end());
+	renderer.setMesh(SOFT_BLADES, blades);
+	DrawItem bladeItem;
+	bladeItem.vao = SOFT_BLADES;
+	bladeItem.material = MATERIAL_FAN_BLADE;
+	bladeItem.indexCount = (GLsizei)blades.indices.size();
+	bladeItem.model = glm::translate(glm::mat4(1.0f), pivot);
+	bladeItem.boundsMin = bladeMesh.boundsMin + pivot;
+	bladeItem.boundsMax = bladeMesh.boundsMax + pivot;
+	scene.items.push_back(bladeItem);
+	std::vector<const DrawList*> lists(1, &scene);
+
+	bool identical = true;
+	std::cout << std::fixed << std::setprecision(3);
+	for (const RegressionViewpoint& v : REGRESSION_VIEWPOINTS) {
+		Camera view(v.position);
+		view.SetMode(FREE_FLY);
+		view.SetZoom(ZOOM);
+		view.SetAspectRatio((float)SCR_WIDTH / (float)SCR_HEIGHT);
+		view.SetPose(v.position, glm::quatLookAt(glm::normalize(v.target - v.position), glm::vec3(0.0f, 1.0f, 0.0f)));
+		RgbImage first, image;
+		SampleSeries frameMs(SampleSeries::ALL);
+		for (int frame = 0; frame < WARMUP + MEASURED; frame++) {
+			uint64_t start = inputClockNow();
+			renderer.render(lists, view.GetViewProjectionMatrix(), v.position, frame == 0 ? first : image);
+			if (frame >= WARMUP)
+				frameMs.add((double)(inputClockNow() - start) / 1.0e6);
+		}
+		bool same = first.pixels == image.pixels;
+		identical = identical && same;
+		std::string base = std::string(directory) + "/" + v.name;
+		image.savePPM(base + ".soft.ppm");
+		std::cout << v.name << "  " << frameMs.percentile(50.0) << " ms";
+		RgbImage golden;
+		if (golden.loadPPM(base + ".ppm")) {
+			ImageDiff diff = compareImages(golden, image);
+			std::cout << "  vs golden " << diff.differingFraction * 100.0 << "% px differ, max dE " << diff.maxDeltaE;
+		}
+		std::cout << (same ? "  bit-identical" : "  NOT bit-identical") << std::endl;
+	}
+	renderer.report(std::cout);
+	renderer.shutdown();
+	return identical ? 0 : 1;
+}
+
+// --bake-ao: the ambient occlusion of the scene the other options describe, ray traced on the CPU. Every box of every
+// cell is baked; the gpu-driven desks only occlude, and the fan blades, which turn, are left out
+// ---------------------------------------------------------------------------------------------------------
+int runOcclusionBake(const char* path, int samples, int threads)
 {
-	camera.ProcessMouseScroll(static_cast<float>(yoffset));
+	const float OCCLUSION_RADIUS = 1.0f;
+	OcclusionBaker baker;
+	DrawList scene;
+	for (int room = 0; room < options.rooms; room++) {
+		addClassroom(scene, 0, CLASSROOM_SPACING * room, options.rooms > 1, !options.gpuDriven, options.fanGrid);
+		if (options.rooms > 1)
+			addCorridor(scene, 0, CLASSROOM_SPACING * room, room == 0, room == options.rooms - 1);
+	}
+	Table_Chair tc;
+	tc.tox = 5;
+	tc.toz = -8.5;
+	tc.local_rotation(scene, 0, 135);
+	baker.addReceivers(scene, cube_vertices, cube_indices);
+	if (options.gpuDriven) {
+		MeshBuilder deskMesh = buildDeskMesh();
+		for (int k = 0; k < options.desks; k++)
+			baker.addOccluder(deskMesh, glm::translate(glm::mat4(1.0f), deskGridPosition(k, options.desks)));
+	}
+	baker.bake(samples, OCCLUSION_RADIUS, threads > 0 ? threads : (int)std::max(1u, std::thread::hardware_concurrency()));
+	baker.report(std::cout);
+	return baker.save(path) ? 0 : -1;
 }
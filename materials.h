@@ -0,0 +1,115 @@
+#ifndef materials_h
+#define materials_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "gpu_resources.h"
+
+#include <iostream>
+#include <vector>
+
+// shader storage binding point of the material table used by fragmentShader.fs
+const GLuint MATERIAL_SSBO_BINDING = 8;
+
+// slots of the classroom's materials in the table; the meshes only carry these indices
+enum Classroom_Material {
+    MATERIAL_TABLE_TOP,
+    MATERIAL_TABLE_LEG,
+    MATERIAL_CHAIR_LEG,
+    MATERIAL_CHAIR_PILLAR,
+    MATERIAL_CHAIR_BACK,
+    MATERIAL_FLOOR,
+    MATERIAL_WALL1,
+    MATERIAL_WALL2,
+    MATERIAL_BLACKBOARD,
+    MATERIAL_CABINATE,
+    MATERIAL_CEILING,
+    MATERIAL_FAN_HOLDER,
+    MATERIAL_FAN_PIVOT,
+    MATERIAL_FAN_BLADE,
+    MATERIAL_BORDER,
+    MATERIAL_COUNT
+};
+
+struct Material
+{
+    glm::vec4 baseColor = glm::vec4(1.0f);
+    float roughness = 0.49f;    // mapped to a Blinn-Phong exponent of about 32 in the shader
+    float specular = 0.25f;     // strength of the highlight
+
+    Material() {}
+    Material(const glm::vec3& color, float roughness = 0.49f, float specular = 0.25f)
+        : baseColor(color, 1.0f), roughness(roughness), specular(specular) {}
+};
+
+// std430 layout of one material in the shaders
+struct GpuMaterial
+{
+    glm::vec4 baseColor;
+    glm::vec4 surface;  // x: roughness, y: specular strength
+};
+
+// Materials of every mesh in one shader storage buffer, indexed by a draw's material slot. Meshes carry no colour, so
+// one box can be shared by every draw, and editing a material rewrites its 32 bytes instead of re-uploading a mesh.
+class MaterialTable
+{
+public:
+    void init(const std::vector<Material>& initial)
+    {
+        materials = initial;
+        std::vector<GpuMaterial> gpu(materials.size());
+        for (size_t i = 0; i < materials.size(); i++)
+            gpu[i] = toGpu(materials[i]);
+        buffer.create("materials", "material table");
+        buffer.data(GL_SHADER_STORAGE_BUFFER, gpu.size() * sizeof(GpuMaterial), gpu.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    size_t size() const { return materials.size(); }
+    const Material& get(unsigned int index) const { return materials[index]; }
+
+    // replaces one material in place; the next draw sees it
+    void set(unsigned int index, const Material& material)
+    {
+        if (index >= materials.size())
+        {
+            std::cout << "ERROR::MATERIAL::INDEX_OUT_OF_RANGE: " << index << std::endl;
+            return;
+        }
+        materials[index] = material;
+        GpuMaterial gpu = toGpu(material);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, index * sizeof(GpuMaterial), sizeof(GpuMaterial), &gpu);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        edits++;
+    }
+
+    void apply() const { glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_SSBO_BINDING, buffer); }
+
+    void report(std::ostream& out) const
+    {
+        out << "materials: " << materials.size() << " in " << materials.size() * sizeof(GpuMaterial) << " bytes, "
+            << edits << " edits" << std::endl;
+    }
+
+    void destroy()
+    {
+        buffer.reset();
+    }
+
+private:
+    std::vector<Material> materials;
+    GpuBuffer buffer;
+    unsigned int edits = 0;
+
+    static GpuMaterial toGpu(const Material& material)
+    {
+        GpuMaterial gpu;
+        gpu.baseColor = material.baseColor;
+        gpu.surface = glm::vec4(material.roughness, material.specular, 0.0f, 0.0f);
+        return gpu;
+    }
+};
+
+#endif
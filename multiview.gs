@@ -0,0 +1,56 @@
+#version 430 core
+// One invocation per view of multiview.h: every triangle is submitted once and replicated here into each view whose
+// bit is set in viewMask, onto that view's viewport. Any vertex shader that writes worldPos, normal, material and the
+// occlusion face and coordinates at these locations can feed it; its own gl_Position is ignored.
+layout (triangles, invocations = 4) in;     // must match MAX_VIEWS
+layout (triangle_strip, max_vertices = 3) out;
+
+layout (location = 0) flat in uint vertexMaterial[];
+layout (location = 1) in vec3 vertexWorldPos[];
+layout (location = 2) in vec3 vertexNormal[];
+layout (location = 3) flat in uint vertexOcclusionFace[];
+layout (location = 4) in vec2 vertexOcclusionUV[];
+
+layout (location = 0) flat out uint material;
+layout (location = 1) out vec3 worldPos;
+layout (location = 2) out vec3 normal;
+layout (location = 3) flat out uint occlusionFace;
+layout (location = 4) out vec2 occlusionUV;
+
+layout (std140) uniform CameraBlock
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+};
+
+// see ViewBlockData in multiview.h; view 0 is the fly camera, which comes from the late-latched CameraBlock instead
+layout (std140, binding = 1) uniform ViewBlock
+{
+    mat4 viewProjections[4];
+    ivec4 viewCount;
+};
+
+// bit v set: the draw survived view v's frustum
+uniform int viewMask;
+
+void main()
+{
+    int v = gl_InvocationID;
+    if (v >= viewCount.x || (viewMask & (1 << v)) == 0)
+        return;
+    mat4 toClip = v == 0 ? viewProjection : viewProjections[v];
+    for (int k = 0; k < 3; k++)
+    {
+        gl_Position = toClip * vec4(vertexWorldPos[k], 1.0f);
+        gl_ViewportIndex = v;
+        material = vertexMaterial[k];
+        worldPos = vertexWorldPos[k];
+        normal = vertexNormal[k];
+        occlusionFace = vertexOcclusionFace[k];
+        occlusionUV = vertexOcclusionUV[k];
+        EmitVertex();
+    }
+    EndPrimitive();
+}
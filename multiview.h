@@ -0,0 +1,208 @@
+#ifndef multiview_h
+#define multiview_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "frustum.h"
+#include "gpu_resources.h"
+#include "scene.h"
+#include "shader.h"
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// binding point of the ViewBlock uniform block in multiview.gs
+const GLuint VIEW_UBO_BINDING = 1;
+
+// views drawn in one pass; must match the invocations of multiview.gs
+const int MAX_VIEWS = 4;
+
+// std140 layout of ViewBlock in multiview.gs
+struct ViewBlockData
+{
+    glm::mat4 viewProjection[MAX_VIEWS];
+    glm::ivec4 viewCount;
+};
+
+// a fixed camera watching the scene next to the fly camera
+struct MonitorView
+{
+    glm::vec3 eye;
+    glm::vec3 target;
+    glm::vec3 up;
+    float fov;  // vertical, degrees
+};
+
+// Several views rendered with one submission of the geometry. The window is split into the fly camera on the left two
+// thirds and the monitors stacked in the right third; each has its own viewport of the viewport array, and
+// multiview.gs replicates every triangle into the views that need it with one instance per view. The CPU culls each
+// draw against every view and keeps a bit per view, so a draw is submitted once if any view sees it and costs nothing
+// in the views that do not. View 0 reads the fly camera from CameraBlock and so stays late-latched.
+class MultiView
+{
+public:
+    void init(const std::vector<MonitorView>& monitorViews)
+    {
+        monitors = monitorViews;
+        if (monitors.size() > MAX_VIEWS - 1)
+            monitors.resize(MAX_VIEWS - 1);
+        viewCount = 1 + (int)monitors.size();
+        // keeps every desk: the compute cull of the gpu-driven desks tests a single frustum
+        unbounded.extract(glm::ortho(-1.0e4f, 1.0e4f, -1.0e4f, 1.0e4f, -1.0e4f, 1.0e4f));
+        buffer.create("multiview", "view block");
+        buffer.data(GL_UNIFORM_BUFFER, sizeof(ViewBlockData), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    int count() const { return viewCount; }
+    int allViews() const { return (1 << viewCount) - 1; }
+    const Frustum& unboundedFrustum() const { return unbounded; }
+
+    // lays the viewports out over a framebuffer of this size and updates the monitors' matrices for their aspect
+    void resize(int framebufferWidth, int framebufferHeight)
+    {
+        width = framebufferWidth;
+        height = framebufferHeight;
+        float mainWidth = floorf(width * 2.0f / 3.0f);
+        float monitorHeight = floorf(height / 3.0f);
+        viewports[0] = glm::vec4(0.0f, 0.0f, mainWidth, (float)height);
+        ViewBlockData data;
+        data.viewProjection[0] = glm::mat4(1.0f);
+        for (int v = 1; v < MAX_VIEWS; v++)
+        {
+            viewports[v] = glm::vec4(mainWidth, height - monitorHeight * v, width - mainWidth, monitorHeight);
+            data.viewProjection[v] = glm::mat4(1.0f);
+            if (v >= viewCount)
+                continue;
+            const MonitorView& monitor = monitors[v - 1];
+            glm::mat4 projection = glm::perspective(glm::radians(monitor.fov), viewports[v].z / glm::max(viewports[v].w, 1.0f), 0.1f, 100.0f);
+            data.viewProjection[v] = projection * glm::lookAt(monitor.eye, monitor.target, monitor.up);
+            frustums[v].extract(data.viewProjection[v]);
+        }
+        data.viewCount = glm::ivec4(viewCount, 0, 0, 0);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(data), &data);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    // aspect ratio the fly camera must use for its viewport
+    float mainAspect() const { return height > 0 ? viewports[0].z / viewports[0].w : 1.0f; }
+
+    // starts the frame's culling; view 0 is culled with the fly camera's (possibly widened) frustum
+    void beginCull(const Frustum& mainFrustum)
+    {
+        frustums[0] = mainFrustum;
+        used = 0;
+    }
+
+    // culls every item of list against all views; the list must outlive the frame's draw()
+    void cull(const DrawList& list, float margin, RenderStats& stats)
+    {
+        if (used == lists.size())
+            lists.push_back(ViewMaskedList());
+        ViewMaskedList& out = lists[used++];
+        out.list = &list;
+        out.visible.clear();
+        out.masks.clear();
+        for (unsigned int i = 0; i < list.items.size(); i++)
+        {
+            const DrawItem& item = list.items[i];
+            stats.submitted++;
+            int mask = 0;
+            for (int v = 0; v < viewCount; v++)
+            {
+                // the monitors are fixed, so only the fly camera needs the late latching margin
+                if (frustums[v].intersectsAABB(item.boundsMin, item.boundsMax, v == 0 ? margin : 0.0f))
+                    mask |= 1 << v;
+            }
+            if (mask == 0)
+            {
+                stats.culled++;
+                continue;
+            }
+            out.visible.push_back(i);
+            out.masks.push_back(mask);
+        }
+    }
+
+    // binds the views; draws until end() go to every viewport through a multiview.gs program
+    void begin() const
+    {
+        glBindBufferBase(GL_UNIFORM_BUFFER, VIEW_UBO_BINDING, buffer);
+        for (int v = 0; v < viewCount; v++)
+            glViewportIndexedf(v, viewports[v].x, viewports[v].y, viewports[v].z, viewports[v].w);
+    }
+
+    // draws the lists culled this frame with shader, which must be in use
+    void draw(const Shader& shader, RenderStats& stats)
+    {
+        for (size_t l = 0; l < used; l++)
+        {
+            const ViewMaskedList& culled = lists[l];
+            unsigned int boundVAO = 0;
+            for (size_t k = 0; k < culled.visible.size(); k++)
+            {
+                const DrawItem& item = culled.list->items[culled.visible[k]];
+                shader.setMat4("model", item.model);
+                shader.setInt("materialIndex", (int)item.material);
+                shader.setInt("occlusionRecord", (int)item.occlusion);
+                shader.setInt("viewMask", culled.masks[k]);
+                if (item.vao != boundVAO)
+                {
+                    glBindVertexArray(item.vao);
+                    boundVAO = item.vao;
+                }
+                glDrawElements(GL_TRIANGLES, item.indexCount, GL_UNSIGNED_INT, 0);
+                stats.drawCalls++;
+                stats.triangles += item.indexCount / 3;
+                drawCalls++;
+                for (int v = 0; v < viewCount; v++)
+                    viewDraws += (culled.masks[k] >> v) & 1;
+            }
+        }
+    }
+
+    // restores the single full-window viewport
+    void end() const
+    {
+        glViewport(0, 0, width, height);
+    }
+
+    void report(std::ostream& out) const
+    {
+        out << "multi-view: " << viewCount << " views, " << drawCalls << " draw calls submitted for "
+            << viewDraws << " draws into views" << std::endl;
+    }
+
+    void destroy()
+    {
+        buffer.reset();
+    }
+
+private:
+    // the items of one list that some view sees, and which views see them
+    struct ViewMaskedList
+    {
+        const DrawList* list = NULL;
+        std::vector<unsigned int> visible;
+        std::vector<int> masks;
+    };
+
+    std::vector<MonitorView> monitors;
+    int viewCount = 1;
+    int width = 0;
+    int height = 0;
+    glm::vec4 viewports[MAX_VIEWS];
+    Frustum frustums[MAX_VIEWS];
+    Frustum unbounded;
+    GpuBuffer buffer;
+    std::vector<ViewMaskedList> lists;
+    size_t used = 0;
+    unsigned long long drawCalls = 0;
+    unsigned long long viewDraws = 0;
+};
+
+#endif
@@ -0,0 +1,13 @@
+#version 430 core
+// depth test before the shader runs, so only fragments that would be shaded are counted
+layout (early_fragment_tests) in;
+
+layout (r32ui, binding = 0) uniform uimage2D overdrawCount;
+
+out vec4 FragColor;
+
+void main()
+{
+    imageAtomicAdd(overdrawCount, ivec2(gl_FragCoord.xy), 1u);
+    FragColor = vec4(0.0f);
+}
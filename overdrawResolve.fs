@@ -0,0 +1,17 @@
+#version 430 core
+layout (r32ui, binding = 0) uniform readonly uimage2D overdrawCount;
+
+out vec4 FragColor;
+
+void main()
+{
+    uint count = imageLoad(overdrawCount, ivec2(gl_FragCoord.xy)).r;
+    const vec3 heat[6] = vec3[6](
+        vec3(0.0f, 0.0f, 0.0f),
+        vec3(0.0f, 0.2f, 1.0f),
+        vec3(0.0f, 0.9f, 0.3f),
+        vec3(1.0f, 0.9f, 0.0f),
+        vec3(1.0f, 0.45f, 0.0f),
+        vec3(1.0f, 0.0f, 0.0f));
+    FragColor = vec4(heat[min(count, 5u)], 1.0f);
+}
@@ -0,0 +1,347 @@
+#ifndef portals_h
+#define portals_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "frustum.h"
+#include "scene.h"
+#include "stats.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Cell-and-portal visibility for buildings of several rooms. Rooms and corridor segments are cells, each an AABB that
+// owns the static draws inside it; doorways are portals, quads joining two cells. Every frame the camera's cell is
+// found and the view is recursively narrowed through the portals it can see: a portal's projection, clipped to the
+// near plane, is reduced to a screen rectangle and intersected with the rectangle it was seen through, and the cell
+// behind it is visited with what is left. Only visited cells are culled and drawn, each against the frustum of the
+// union of the rectangles it was reached through, so the cost follows what is visible rather than the building size.
+class CellGraph
+{
+public:
+    static const int MAX_DEPTH = 16;    // portals in a chain; deeper cells are too small on screen to matter
+
+    struct Cell
+    {
+        std::string name;
+        glm::vec3 boundsMin, boundsMax;
+        DrawList scene;                     // static draws inside the cell
+        std::vector<unsigned int> portals;
+        std::vector<unsigned int> visible;  // items of scene that survived culling this frame
+    };
+
+    struct Portal
+    {
+        glm::vec3 corners[4];   // in order around the opening
+        int cells[2];
+    };
+
+    // cells must all be added before their scenes are filled; the returned index stays valid
+    int addCell(const std::string& name, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+    {
+        Cell cell;
+        cell.name = name;
+        cell.boundsMin = boundsMin;
+        cell.boundsMax = boundsMax;
+        cells.push_back(cell);
+        state.push_back(CellState());
+        visited.reserve(cells.size());
+        return (int)cells.size() - 1;
+    }
+
+    // an axis-aligned opening between two cells; min and max must be equal on exactly one axis
+    void addPortal(int a, int b, const glm::vec3& openingMin, const glm::vec3& openingMax)
+    {
+        Portal portal;
+        portal.cells[0] = a;
+        portal.cells[1] = b;
+        glm::vec3 lo = openingMin, hi = openingMax;
+        if (lo.x == hi.x)
+        {
+            portal.corners[0] = glm::vec3(lo.x, lo.y, lo.z);
+            portal.corners[1] = glm::vec3(lo.x, hi.y, lo.z);
+            portal.corners[2] = glm::vec3(lo.x, hi.y, hi.z);
+            portal.corners[3] = glm::vec3(lo.x, lo.y, hi.z);
+        }
+        else if (lo.z == hi.z)
+        {
+            portal.corners[0] = glm::vec3(lo.x, lo.y, lo.z);
+            portal.corners[1] = glm::vec3(hi.x, lo.y, lo.z);
+            portal.corners[2] = glm::vec3(hi.x, hi.y, lo.z);
+            portal.corners[3] = glm::vec3(lo.x, hi.y, lo.z);
+        }
+        else
+        {
+            portal.corners[0] = glm::vec3(lo.x, lo.y, lo.z);
+            portal.corners[1] = glm::vec3(hi.x, lo.y, lo.z);
+            portal.corners[2] = glm::vec3(hi.x, lo.y, hi.z);
+            portal.corners[3] = glm::vec3(lo.x, lo.y, hi.z);
+        }
+        portals.push_back(portal);
+        cells[a].portals.push_back((unsigned int)portals.size() - 1);
+        cells[b].portals.push_back((unsigned int)portals.size() - 1);
+    }
+
+    Cell& cell(int index) { return cells[index]; }
+    size_t cellCount() const { return cells.size(); }
+
+    // Finds the visible cells and culls their scenes. frustum must have been extracted from viewProjection; it is
+    // used as is for cells seen without narrowing. A camera outside every cell sees all of them through the frustum.
+    void cull(const Frustum& frustum, const glm::mat4& viewProjection, const glm::vec3& eye, float margin, RenderStats& stats)
+    {
+        frame++;
+        visited.clear();
+        portalTests = 0;
+        rootFrustum = frustum;
+        this->viewProjection = viewProjection;
+        this->eye = eye;
+        cameraCell = locate(eye);
+        if (cameraCell >= 0)
+        {
+            state[cameraCell].onPath = true;
+            visit(cameraCell, Rect::full(), 0);
+            state[cameraCell].onPath = false;
+        }
+        else
+        {
+            for (size_t c = 0; c < cells.size(); c++)
+                visit((int)c, Rect::full(), MAX_DEPTH);
+        }
+        for (int c : visited)
+        {
+            Cell& cell = cells[c];
+            CellState& s = state[c];
+            s.frustum = rootFrustum;
+            if (!s.rect.isFull())
+                s.frustum.extract(s.rect.toFull() * viewProjection);
+            cell.visible.clear();
+            cell.scene.cull(s.frustum, margin, cell.visible, stats);
+        }
+        visitedCells.add((double)visited.size());
+        testedPortals.add((double)portalTests);
+    }
+
+    // the frustum a visited cell was seen through this frame, NULL if it was not visited
+    const Frustum* visibleFrustum(int c) const { return state[c].stamp == frame ? &state[c].frustum : NULL; }
+
+    void draw(const Shader& shader, RenderStats& stats) const
+    {
+        for (int c : visited)
+            cells[c].scene.draw(shader, cells[c].visible, stats);
+    }
+
+    // Top-down map of the building in the top-left corner of the bound framebuffer, drawn with scissored clears so
+    // it needs no program: visited cells green, the camera's cell yellow, hidden cells grey, portals white and the
+    // camera red.
+    void drawOverlay() const
+    {
+        if (cells.empty())
+            return;
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glm::vec3 lo = cells[0].boundsMin, hi = cells[0].boundsMax;
+        for (const Cell& cell : cells)
+        {
+            lo = glm::min(lo, cell.boundsMin);
+            hi = glm::max(hi, cell.boundsMax);
+        }
+        // fit the x/z extent into a third of the viewport, z pointing down the screen
+        float scale = std::min(viewport[2] / 3.0f / (hi.x - lo.x), viewport[3] / 3.0f / (hi.z - lo.z));
+        float left = viewport[0] + 8.0f;
+        float top = viewport[1] + viewport[3] - 8.0f;
+        auto fill = [&](glm::vec2 a, glm::vec2 b, float inset, const glm::vec3& color)
+        {
+            int x0 = (int)(left + (a.x - lo.x) * scale + inset);
+            int x1 = (int)(left + (b.x - lo.x) * scale - inset);
+            int y0 = (int)(top - (b.y - lo.z) * scale + inset);
+            int y1 = (int)(top - (a.y - lo.z) * scale - inset);
+            glScissor(x0, y0, std::max(x1 - x0, 2), std::max(y1 - y0, 2));
+            glClearColor(color.x, color.y, color.z, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+        };
+        glEnable(GL_SCISSOR_TEST);
+        for (size_t c = 0; c < cells.size(); c++)
+        {
+            glm::vec3 color = (int)c == cameraCell ? glm::vec3(0.9f, 0.8f, 0.1f)
+                : state[c].stamp == frame ? glm::vec3(0.2f, 0.7f, 0.3f) : glm::vec3(0.25f);
+            fill(glm::vec2(cells[c].boundsMin.x, cells[c].boundsMin.z), glm::vec2(cells[c].boundsMax.x, cells[c].boundsMax.z), 1.0f, color);
+        }
+        for (const Portal& portal : portals)
+        {
+            glm::vec3 a = glm::min(portal.corners[0], portal.corners[2]);
+            glm::vec3 b = glm::max(portal.corners[0], portal.corners[2]);
+            fill(glm::vec2(a.x, a.z), glm::vec2(b.x, b.z), -1.0f, glm::vec3(1.0f));
+        }
+        glm::vec2 camera(glm::clamp(eye.x, lo.x, hi.x), glm::clamp(eye.z, lo.z, hi.z));
+        fill(camera - glm::vec2(2.0f / scale), camera + glm::vec2(2.0f / scale), 0.0f, glm::vec3(1.0f, 0.1f, 0.1f));
+        glDisable(GL_SCISSOR_TEST);
+    }
+
+    void report(std::ostream& out)
+    {
+        out << "cells: " << cells.size() << " cells, " << portals.size() << " portals" << std::endl;
+        visitedCells.report(out, "visited cells", "per frame");
+        testedPortals.report(out, "portal tests", "per frame");
+    }
+
+private:
+    // screen rectangle in normalized device coordinates
+    struct Rect
+    {
+        float x0, y0, x1, y1;
+
+        static Rect full() { return { -1.0f, -1.0f, 1.0f, 1.0f }; }
+        bool empty() const { return x0 >= x1 || y0 >= y1; }
+        bool isFull() const { return x0 <= -1.0f && y0 <= -1.0f && x1 >= 1.0f && y1 >= 1.0f; }
+        Rect intersect(const Rect& o) const { return { std::max(x0, o.x0), std::max(y0, o.y0), std::min(x1, o.x1), std::min(y1, o.y1) }; }
+        Rect unite(const Rect& o) const { return { std::min(x0, o.x0), std::min(y0, o.y0), std::max(x1, o.x1), std::max(y1, o.y1) }; }
+
+        // maps the rectangle onto the whole of NDC; applied after a view-projection it gives the narrowed frustum
+        glm::mat4 toFull() const
+        {
+            glm::mat4 m(1.0f);
+            m[0][0] = 2.0f / (x1 - x0);
+            m[1][1] = 2.0f / (y1 - y0);
+            m[3][0] = -(x1 + x0) / (x1 - x0);
+            m[3][1] = -(y1 + y0) / (y1 - y0);
+            return m;
+        }
+    };
+
+    struct CellState
+    {
+        unsigned int stamp = 0;     // frame the cell was last visited in
+        bool onPath = false;        // on the current portal chain, so it is not entered again
+        Rect rect;
+        Frustum frustum;
+    };
+
+    // camera closer than this to a portal's plane and within its opening is standing in the doorway
+    static constexpr float DOORWAY_EPSILON = 0.15f;
+
+    std::vector<Cell> cells;
+    std::vector<Portal> portals;
+    std::vector<CellState> state;
+    std::vector<int> visited;
+    unsigned int frame = 0;
+    int cameraCell = -1;
+    unsigned int portalTests = 0;
+    Frustum rootFrustum;
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    glm::vec3 eye = glm::vec3(0.0f);
+    SampleSeries visitedCells;
+    SampleSeries testedPortals;
+
+    static bool inside(const glm::vec3& p, const glm::vec3& lo, const glm::vec3& hi)
+    {
+        return p.x >= lo.x && p.y >= lo.y && p.z >= lo.z && p.x <= hi.x && p.y <= hi.y && p.z <= hi.z;
+    }
+
+    static bool contains(const Cell& cell, const glm::vec3& p) { return inside(p, cell.boundsMin, cell.boundsMax); }
+
+    // the cell of the previous frame and its neighbours are tried first, so a walk costs no scan of the building
+    int locate(const glm::vec3& p) const
+    {
+        if (cameraCell >= 0)
+        {
+            if (contains(cells[cameraCell], p))
+                return cameraCell;
+            for (unsigned int index : cells[cameraCell].portals)
+            {
+                const Portal& portal = portals[index];
+                int next = portal.cells[0] == cameraCell ? portal.cells[1] : portal.cells[0];
+                if (contains(cells[next], p))
+                    return next;
+            }
+        }
+        for (size_t c = 0; c < cells.size(); c++)
+        {
+            if (contains(cells[c], p))
+                return (int)c;
+        }
+        return -1;
+    }
+
+    void visit(int c, const Rect& rect, int depth)
+    {
+        CellState& s = state[c];
+        if (s.stamp != frame)
+        {
+            s.stamp = frame;
+            s.rect = rect;
+            visited.push_back(c);
+        }
+        else
+        {
+            s.rect = s.rect.unite(rect);
+        }
+        if (depth >= MAX_DEPTH)
+            return;
+        for (unsigned int index : cells[c].portals)
+        {
+            const Portal& portal = portals[index];
+            int next = portal.cells[0] == c ? portal.cells[1] : portal.cells[0];
+            if (state[next].onPath)
+                continue;
+            portalTests++;
+            Rect seen;
+            if (!project(portal, seen))
+                continue;
+            seen = seen.intersect(rect);
+            if (seen.empty())
+                continue;
+            state[next].onPath = true;
+            visit(next, seen, depth + 1);
+            state[next].onPath = false;
+        }
+    }
+
+    // screen bounds of the portal, clipped to the near plane; false if it is entirely behind the camera
+    bool project(const Portal& portal, Rect& out) const
+    {
+        glm::vec3 lo = glm::min(portal.corners[0], portal.corners[2]);
+        glm::vec3 hi = glm::max(portal.corners[0], portal.corners[2]);
+        glm::vec3 grow(DOORWAY_EPSILON);
+        if (inside(eye, lo - grow, hi + grow))
+        {
+            // in the doorway the opening is seen edge-on: everything the parent sees may be behind it
+            out = Rect::full();
+            return true;
+        }
+        glm::vec4 clip[4];
+        for (int k = 0; k < 4; k++)
+            clip[k] = viewProjection * glm::vec4(portal.corners[k], 1.0f);
+        // Sutherland-Hodgman against the near plane, z >= -w
+        glm::vec4 clipped[8];
+        int count = 0;
+        for (int k = 0; k < 4; k++)
+        {
+            const glm::vec4& a = clip[k];
+            const glm::vec4& b = clip[(k + 1) % 4];
+            float da = a.z + a.w, db = b.z + b.w;
+            if (da >= 0.0f)
+                clipped[count++] = a;
+            if ((da >= 0.0f) != (db >= 0.0f))
+                clipped[count++] = a + (b - a) * (da / (da - db));
+        }
+        if (count == 0)
+            return false;
+        out = { 1.0f, 1.0f, -1.0f, -1.0f };
+        for (int k = 0; k < count; k++)
+        {
+            float w = std::max(clipped[k].w, 1e-6f);
+            glm::vec2 ndc(clipped[k].x / w, clipped[k].y / w);
+            out.x0 = std::min(out.x0, ndc.x);
+            out.y0 = std::min(out.y0, ndc.y);
+            out.x1 = std::max(out.x1, ndc.x);
+            out.y1 = std::max(out.y1, ndc.y);
+        }
+        return true;
+    }
+};
+
+#endif
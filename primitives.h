@@ -0,0 +1,274 @@
+#ifndef primitives_h
+#define primitives_h
+
+#include <array>
+#include <cstddef>
+
+// Meshes generated at compile time in the lit vertex layout of scene.h (position, normal) with their triangle indices.
+// Every generator is constexpr: a mesh declared constexpr is laid out by the compiler and costs nothing at startup.
+// Tessellation levels are template parameters because they size the arrays, so each use gets its own specialisation.
+// Triangles wind counter-clockwise seen from outside. The round shapes are centred on the origin with their axis
+// along +y.
+namespace primitives
+{
+    const int VERTEX_FLOATS = 6;    // BOX_VERTEX_FLOATS
+
+    struct Float3
+    {
+        float x, y, z;
+
+        constexpr float operator[](int i) const { return i == 0 ? x : (i == 1 ? y : z); }
+        constexpr float& operator[](int i) { return i == 0 ? x : (i == 1 ? y : z); }
+    };
+
+    template <size_t VERTICES, size_t INDICES>
+    struct Mesh
+    {
+        static constexpr size_t VERTEX_COUNT = VERTICES;
+        static constexpr size_t INDEX_COUNT = INDICES;
+        std::array<float, VERTICES * VERTEX_FLOATS> vertices{};
+        std::array<unsigned int, INDICES> indices{};
+    };
+
+    // <cmath> is not constexpr before C++26
+    namespace detail
+    {
+        constexpr double PI = 3.14159265358979323846;
+
+        constexpr double squareRoot(double x)
+        {
+            if (x <= 0.0)
+                return 0.0;
+            double r = x > 1.0 ? x : 1.0;
+            for (int i = 0; i < 64; i++)
+            {
+                double next = 0.5 * (r + x / r);
+                if (next == r)
+                    break;
+                r = next;
+            }
+            return r;
+        }
+
+        // Taylor series after reduction to [-pi, pi], within 1e-12
+        constexpr double sine(double x)
+        {
+            double turns = x / (2.0 * PI);
+            x -= (double)(long long)(turns + (turns >= 0.0 ? 0.5 : -0.5)) * 2.0 * PI;
+            double term = x, sum = x;
+            for (int n = 1; n < 13; n++)
+            {
+                term *= -x * x / (double)((2 * n) * (2 * n + 1));
+                sum += term;
+            }
+            return sum;
+        }
+
+        constexpr double cosine(double x) { return sine(x + 0.5 * PI); }
+
+        template <size_t V, size_t I>
+        constexpr void setVertex(Mesh<V, I>& mesh, size_t vertex, const Float3& position, const Float3& normal)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                mesh.vertices[vertex * VERTEX_FLOATS + k] = position[k];
+                mesh.vertices[vertex * VERTEX_FLOATS + 3 + k] = normal[k];
+            }
+        }
+
+        // two triangles per cell of a grid of (columns + 1) x (rows + 1) vertices stored row by row from firstVertex;
+        // columns must run along u and rows along v with u x v pointing out of the surface
+        template <size_t V, size_t I>
+        constexpr size_t addGrid(Mesh<V, I>& mesh, size_t index, unsigned int firstVertex, unsigned int columns, unsigned int rows)
+        {
+            for (unsigned int r = 0; r < rows; r++)
+            {
+                for (unsigned int c = 0; c < columns; c++)
+                {
+                    unsigned int a = firstVertex + r * (columns + 1) + c;
+                    unsigned int b = a + 1;
+                    unsigned int d = a + columns + 1;
+                    unsigned int e = d + 1;
+                    mesh.indices[index++] = a;
+                    mesh.indices[index++] = b;
+                    mesh.indices[index++] = e;
+                    mesh.indices[index++] = e;
+                    mesh.indices[index++] = d;
+                    mesh.indices[index++] = a;
+                }
+            }
+            return index;
+        }
+
+        // the axes along a face of a box, numbered 2 * axis + (side at the maximum) like boxFace() in scene.h, ordered
+        // so that first x second points out of the face
+        constexpr void faceAxes(int face, int& first, int& second)
+        {
+            int axis = face / 2;
+            int u = axis == 0 ? 1 : 0;
+            int v = axis == 2 ? 1 : 2;
+            // u x v is +x, -y and +z for the three axes
+            bool outward = (face & 1) != (axis == 1);
+            first = outward ? u : v;
+            second = outward ? v : u;
+        }
+
+        // unit vector of a sphere at this height angle (0 at the bottom pole, pi at the top) and turn around +y
+        constexpr Float3 spherical(double height, double turn)
+        {
+            double ring = sine(height);
+            return Float3{ (float)(ring * cosine(turn)), (float)-cosine(height), (float)(-ring * sine(turn)) };
+        }
+    }
+
+    // axis-aligned box from lo to hi: four vertices per face with its flat normal, faces in boxFace() order
+    constexpr Mesh<24, 36> box(const Float3& lo, const Float3& hi)
+    {
+        Mesh<24, 36> mesh;
+        size_t index = 0;
+        for (int face = 0; face < 6; face++)
+        {
+            int axis = face / 2, u = 0, v = 0;
+            detail::faceAxes(face, u, v);
+            Float3 normal{ 0.0f, 0.0f, 0.0f };
+            normal[axis] = face & 1 ? 1.0f : -1.0f;
+            for (int corner = 0; corner < 4; corner++)
+            {
+                Float3 p{ 0.0f, 0.0f, 0.0f };
+                p[axis] = face & 1 ? hi[axis] : lo[axis];
+                p[u] = (corner & 1) ? hi[u] : lo[u];
+                p[v] = (corner & 2) ? hi[v] : lo[v];
+                detail::setVertex(mesh, (size_t)face * 4 + corner, p, normal);
+            }
+            index = detail::addGrid(mesh, index, (unsigned int)face * 4, 1, 1);
+        }
+        return mesh;
+    }
+
+    // SEGMENTS around, from y = -height / 2 to height / 2, with flat caps
+    template <unsigned int SEGMENTS>
+    constexpr Mesh<4 * SEGMENTS + 4, 12 * SEGMENTS> cylinder(float radius, float height)
+    {
+        static_assert(SEGMENTS >= 3, "a cylinder needs at least three segments");
+        Mesh<4 * SEGMENTS + 4, 12 * SEGMENTS> mesh;
+        // the side: two rings with the seam vertex repeated
+        for (unsigned int row = 0; row < 2; row++)
+        {
+            for (unsigned int s = 0; s <= SEGMENTS; s++)
+            {
+                Float3 n = detail::spherical(0.5 * detail::PI, 2.0 * detail::PI * s / SEGMENTS);
+                Float3 p{ n.x * radius, (row ? 0.5f : -0.5f) * height, n.z * radius };
+                detail::setVertex(mesh, row * (SEGMENTS + 1) + s, p, n);
+            }
+        }
+        size_t index = detail::addGrid(mesh, 0, 0, SEGMENTS, 1);
+        // the caps: a centre and a ring each
+        for (unsigned int cap = 0; cap < 2; cap++)
+        {
+            unsigned int center = 2 * (SEGMENTS + 1) + cap * (SEGMENTS + 1);
+            float y = (cap ? 0.5f : -0.5f) * height;
+            Float3 normal{ 0.0f, cap ? 1.0f : -1.0f, 0.0f };
+            detail::setVertex(mesh, center, Float3{ 0.0f, y, 0.0f }, normal);
+            for (unsigned int s = 0; s < SEGMENTS; s++)
+            {
+                Float3 n = detail::spherical(0.5 * detail::PI, 2.0 * detail::PI * s / SEGMENTS);
+                detail::setVertex(mesh, center + 1 + s, Float3{ n.x * radius, y, n.z * radius }, normal);
+                unsigned int a = center + 1 + s, b = center + 1 + (s + 1) % SEGMENTS;
+                mesh.indices[index++] = center;
+                mesh.indices[index++] = cap ? a : b;
+                mesh.indices[index++] = cap ? b : a;
+            }
+        }
+        return mesh;
+    }
+
+    // SLICES around and STACKS from pole to pole; the poles are rows of coincident vertices
+    template <unsigned int SLICES, unsigned int STACKS>
+    constexpr Mesh<(SLICES + 1) * (STACKS + 1), SLICES * STACKS * 6> sphere(float radius)
+    {
+        static_assert(SLICES >= 3 && STACKS >= 2, "a sphere needs at least three slices and two stacks");
+        Mesh<(SLICES + 1) * (STACKS + 1), SLICES * STACKS * 6> mesh;
+        for (unsigned int row = 0; row <= STACKS; row++)
+        {
+            for (unsigned int s = 0; s <= SLICES; s++)
+            {
+                Float3 n = detail::spherical(detail::PI * row / STACKS, 2.0 * detail::PI * s / SLICES);
+                detail::setVertex(mesh, row * (SLICES + 1) + s, Float3{ n.x * radius, n.y * radius, n.z * radius }, n);
+            }
+        }
+        detail::addGrid(mesh, 0, 0, SLICES, STACKS);
+        return mesh;
+    }
+
+    // a cylinder of this height between two hemispheres of CAP_STACKS stacks each
+    template <unsigned int SLICES, unsigned int CAP_STACKS>
+    constexpr Mesh<(SLICES + 1) * 2 * (CAP_STACKS + 1), SLICES * (2 * CAP_STACKS + 1) * 6> capsule(float radius, float height)
+    {
+        static_assert(SLICES >= 3 && CAP_STACKS >= 1, "a capsule needs at least three slices and one stack per cap");
+        Mesh<(SLICES + 1) * 2 * (CAP_STACKS + 1), SLICES * (2 * CAP_STACKS + 1) * 6> mesh;
+        for (unsigned int row = 0; row < 2 * (CAP_STACKS + 1); row++)
+        {
+            // the two middle rows are both on the equator, one per hemisphere
+            bool top = row > CAP_STACKS;
+            unsigned int stack = top ? row - 1 : row;
+            float y = (top ? 0.5f : -0.5f) * height;
+            for (unsigned int s = 0; s <= SLICES; s++)
+            {
+                Float3 n = detail::spherical(0.5 * detail::PI * stack / CAP_STACKS, 2.0 * detail::PI * s / SLICES);
+                detail::setVertex(mesh, row * (SLICES + 1) + s, Float3{ n.x * radius, n.y * radius + y, n.z * radius }, n);
+            }
+        }
+        detail::addGrid(mesh, 0, 0, SLICES, 2 * CAP_STACKS + 1);
+        return mesh;
+    }
+
+    // box of this size centred on the origin whose edges and corners are rounded with a radius above 0. Every face is a
+    // grid whose LEVEL outer rows and columns bend halfway around the edges to meet the next face, so each quarter
+    // circle gets 2 * LEVEL segments and the normals are smooth
+    template <unsigned int LEVEL>
+    constexpr Mesh<6 * (2 * LEVEL + 2) * (2 * LEVEL + 2), 6 * (2 * LEVEL + 1) * (2 * LEVEL + 1) * 6> roundedBox(const Float3& size, float radius)
+    {
+        static_assert(LEVEL >= 1, "a rounded box needs at least one segment per quarter circle");
+        constexpr unsigned int CELLS = 2 * LEVEL + 1;
+        Mesh<6 * (CELLS + 1) * (CELLS + 1), 6 * CELLS * CELLS * 6> mesh;
+        Float3 half{ 0.5f * size.x, 0.5f * size.y, 0.5f * size.z };
+        Float3 inner{ half.x - radius, half.y - radius, half.z - radius };
+        size_t index = 0;
+        for (int face = 0; face < 6; face++)
+        {
+            int axis = face / 2, u = 0, v = 0;
+            detail::faceAxes(face, u, v);
+            unsigned int first = (unsigned int)face * (CELLS + 1) * (CELLS + 1);
+            for (unsigned int row = 0; row <= CELLS; row++)
+            {
+                for (unsigned int column = 0; column <= CELLS; column++)
+                {
+                    // a point of the unrounded face, spaced so the rounded band gets LEVEL cells on either side
+                    Float3 p{ 0.0f, 0.0f, 0.0f };
+                    p[axis] = face & 1 ? half[axis] : -half[axis];
+                    unsigned int steps[2] = { column, row };
+                    int axes[2] = { u, v };
+                    for (int k = 0; k < 2; k++)
+                    {
+                        int a = axes[k];
+                        p[a] = steps[k] <= LEVEL ? -half[a] + radius * steps[k] / LEVEL : half[a] - radius * (CELLS - steps[k]) / LEVEL;
+                    }
+                    // moved onto the sphere of radius around the nearest point of the inner box
+                    Float3 q{ 0.0f, 0.0f, 0.0f }, d{ 0.0f, 0.0f, 0.0f };
+                    for (int k = 0; k < 3; k++)
+                    {
+                        q[k] = p[k] < -inner[k] ? -inner[k] : (p[k] > inner[k] ? inner[k] : p[k]);
+                        d[k] = p[k] - q[k];
+                    }
+                    double length = detail::squareRoot((double)d.x * d.x + (double)d.y * d.y + (double)d.z * d.z);
+                    Float3 n{ (float)(d.x / length), (float)(d.y / length), (float)(d.z / length) };
+                    detail::setVertex(mesh, first + row * (CELLS + 1) + column, Float3{ q.x + n.x * radius, q.y + n.y * radius, q.z + n.z * radius }, n);
+                }
+            }
+            index = detail::addGrid(mesh, index, first, CELLS, CELLS);
+        }
+        return mesh;
+    }
+}
+
+#endif
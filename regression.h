@@ -0,0 +1,279 @@
+#ifndef regression_h
+#define regression_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "camera.h"
+#include "gpu_resources.h"
+#include "image.h"
+#include "render_target.h"
+#include "stats.h"
+
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// A canonical camera position with the time budgets a frame rendered from it must stay within. Budgets are for
+// 800x600 on Mesa llvmpipe, the renderer the golden images are produced with, with one rasteriser thread
+// (LP_NUM_THREADS=1, which --regress sets unless the environment already does): the CPU time is then the renderer's
+// own work and the GPU time the rasterisation. Each is about 1.75 times the viewpoint's median over seven runs of an
+// optimized build, so a frame that costs twice what it did fails.
+struct RegressionViewpoint
+{
+    const char* name;
+    glm::vec3 position;
+    glm::vec3 target;
+    float cpuBudgetMs;
+    float gpuBudgetMs;
+};
+
+const RegressionViewpoint REGRESSION_VIEWPOINTS[] = {
+    { "back_of_room",  glm::vec3(2.5f, 1.5f,  2.0f), glm::vec3(2.5f,  0.5f, -8.0f),  4.5f, 1150.0f },
+    { "blackboard",    glm::vec3(2.5f, 1.0f, -4.0f), glm::vec3(2.5f,  1.2f, -9.0f),  3.5f, 1000.0f },
+    { "desks_above",   glm::vec3(2.5f, 2.6f, -3.0f), glm::vec3(2.5f, -0.8f, -3.1f),  3.5f, 1150.0f },
+    { "fan",           glm::vec3(1.0f, 1.8f, -4.5f), glm::vec3(2.25f, 2.4f, -5.75f), 4.0f,  950.0f },
+    { "cabinet",       glm::vec3(0.0f, 1.5f, -1.0f), glm::vec3(7.0f,  0.5f, -5.25f), 4.5f, 1000.0f },
+};
+const int REGRESSION_VIEWPOINT_COUNT = sizeof(REGRESSION_VIEWPOINTS) / sizeof(REGRESSION_VIEWPOINTS[0]);
+
+// a pixel differs when its CIE76 colour difference exceeds a just noticeable difference, and an image fails when
+// more than a small fraction of its pixels differ, so rasterisation noise along edges does not fail a test
+const double REGRESSION_DELTA_E_THRESHOLD = 2.3;
+const double REGRESSION_MAX_DIFFERING_FRACTION = 0.001;
+
+struct ImageDiff
+{
+    size_t differing = 0;
+    double differingFraction = 0.0;
+    double maxDeltaE = 0.0;
+    bool sizeMismatch = false;
+};
+
+namespace image_diff
+{
+    inline double srgbToLinear(unsigned char c)
+    {
+        double v = c / 255.0;
+        return v <= 0.04045 ? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4);
+    }
+
+    inline double labF(double t)
+    {
+        return t > 216.0 / 24389.0 ? std::cbrt(t) : (24389.0 / 27.0 * t + 16.0) / 116.0;
+    }
+
+    // sRGB to CIE L*a*b* under D65
+    inline glm::dvec3 toLab(const unsigned char* rgb)
+    {
+        double r = srgbToLinear(rgb[0]), g = srgbToLinear(rgb[1]), b = srgbToLinear(rgb[2]);
+        double x = (0.4124 * r + 0.3576 * g + 0.1805 * b) / 0.95047;
+        double y = 0.2126 * r + 0.7152 * g + 0.0722 * b;
+        double z = (0.0193 * r + 0.1192 * g + 0.9505 * b) / 1.08883;
+        double fx = labF(x), fy = labF(y), fz = labF(z);
+        return glm::dvec3(116.0 * fy - 16.0, 500.0 * (fx - fy), 200.0 * (fy - fz));
+    }
+}
+
+// Compares two images perceptually. When diff is given it receives a dimmed grey copy of the expected image with the
+// differing pixels in red, brighter for larger differences.
+inline ImageDiff compareImages(const RgbImage& expected, const RgbImage& actual, RgbImage* diff = NULL)
+{
+    ImageDiff result;
+    if (expected.width != actual.width || expected.height != actual.height)
+    {
+        result.sizeMismatch = true;
+        result.differingFraction = 1.0;
+        return result;
+    }
+    if (diff)
+        diff->resize(expected.width, expected.height);
+    for (int y = 0; y < expected.height; y++)
+    {
+        for (int x = 0; x < expected.width; x++)
+        {
+            const unsigned char* e = expected.at(x, y);
+            const unsigned char* a = actual.at(x, y);
+            double deltaE = 0.0;
+            if (e[0] != a[0] || e[1] != a[1] || e[2] != a[2])
+                deltaE = glm::length(image_diff::toLab(e) - image_diff::toLab(a));
+            result.maxDeltaE = glm::max(result.maxDeltaE, deltaE);
+            bool differs = deltaE > REGRESSION_DELTA_E_THRESHOLD;
+            if (differs)
+                result.differing++;
+            if (diff)
+            {
+                unsigned char* d = diff->at(x, y);
+                if (differs)
+                {
+                    d[0] = (unsigned char)glm::min(255.0, 128.0 + deltaE * 4.0);
+                    d[1] = d[2] = 0;
+                }
+                else
+                {
+                    d[0] = d[1] = d[2] = (unsigned char)((e[0] * 77 + e[1] * 150 + e[2] * 29) >> 10);
+                }
+            }
+        }
+    }
+    result.differingFraction = (double)result.differing / ((double)expected.width * expected.height);
+    return result;
+}
+
+// Renders every canonical viewpoint for a number of frames, checks the median CPU and GPU frame times against the
+// viewpoint's budgets and compares the last frame with <directory>/<name>.ppm. Failures leave <name>.actual.ppm and
+// <name>.diff.ppm next to the golden image. With updateGoldens the captured frames replace the golden images.
+class RegressionRunner
+{
+public:
+    static const int WARMUP_FRAMES = 5;
+    static const int MEASURED_FRAMES = 20;
+
+    void begin(const std::string& goldenDirectory, bool updateGoldens)
+    {
+        directory = goldenDirectory;
+        update = updateGoldens;
+        running = true;
+        viewpoint = 0;
+        frame = 0;
+        results.clear();
+        query.create("regression", "frame time");
+    }
+
+    bool active() const { return running; }
+    bool finished() const { return viewpoint >= REGRESSION_VIEWPOINT_COUNT; }
+
+    // places the camera at the current viewpoint; call before the frame's camera uniforms are written
+    void beginFrame(Camera& camera)
+    {
+        const RegressionViewpoint& v = REGRESSION_VIEWPOINTS[viewpoint];
+        camera.SetMode(FREE_FLY);
+        camera.SetZoom(ZOOM);
+        camera.SetPose(v.position, glm::quatLookAt(glm::normalize(v.target - v.position), glm::vec3(0.0f, 1.0f, 0.0f)));
+    }
+
+    // brackets the frame's GL work with a GL_TIME_ELAPSED query
+    void gpuBegin() { glBeginQuery(GL_TIME_ELAPSED, query); }
+    void gpuEnd() { glEndQuery(GL_TIME_ELAPSED); }
+
+    // cpuMs is the time spent recording the frame; the query is read back synchronously, which only costs throughput
+    void endFrame(const RenderTarget& target, double cpuMs)
+    {
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+        if (frame >= WARMUP_FRAMES)
+        {
+            cpuMsSeries.add(cpuMs);
+            gpuMsSeries.add((double)elapsed / 1.0e6);
+        }
+        if (++frame < WARMUP_FRAMES + MEASURED_FRAMES)
+            return;
+
+        const RegressionViewpoint& v = REGRESSION_VIEWPOINTS[viewpoint];
+        Result result;
+        result.name = v.name;
+        result.cpuMs = cpuMsSeries.percentile(50.0);
+        result.gpuMs = gpuMsSeries.percentile(50.0);
+        result.cpuBudgetMs = v.cpuBudgetMs;
+        result.gpuBudgetMs = v.gpuBudgetMs;
+
+        std::vector<unsigned char> rgb;
+        target.readPixels(rgb);
+        RgbImage image;
+        image.fromGL(target.width, target.height, rgb);
+        std::string golden = directory + "/" + v.name + ".ppm";
+        if (update)
+        {
+            result.imagePassed = image.savePPM(golden);
+        }
+        else
+        {
+            RgbImage expected;
+            if (!expected.loadPPM(golden))
+            {
+                result.missingGolden = true;
+            }
+            else
+            {
+                RgbImage diffImage;
+                result.diff = compareImages(expected, image, &diffImage);
+                result.imagePassed = result.diff.differingFraction <= REGRESSION_MAX_DIFFERING_FRACTION;
+                if (!result.imagePassed && !result.diff.sizeMismatch)
+                    diffImage.savePPM(directory + "/" + v.name + ".diff.ppm");
+            }
+            if (!result.imagePassed)
+                image.savePPM(directory + "/" + v.name + ".actual.ppm");
+        }
+        results.push_back(result);
+
+        cpuMsSeries.clear();
+        gpuMsSeries.clear();
+        frame = 0;
+        viewpoint++;
+    }
+
+    // prints one line per viewpoint and returns true when every image and budget check passed
+    bool report(std::ostream& out) const
+    {
+        bool passed = true;
+        out << std::fixed << std::setprecision(3);
+        for (const Result& r : results)
+        {
+            bool cpuOk = r.cpuMs <= r.cpuBudgetMs;
+            bool gpuOk = r.gpuMs <= r.gpuBudgetMs;
+            bool ok = r.imagePassed && cpuOk && gpuOk;
+            passed = passed && ok;
+            out << (ok ? "PASS " : "FAIL ") << r.name
+                << "  cpu " << r.cpuMs << " ms (budget " << r.cpuBudgetMs << ", " << std::showpos << r.cpuMs - r.cpuBudgetMs << std::noshowpos << ")"
+                << "  gpu " << r.gpuMs << " ms (budget " << r.gpuBudgetMs << ", " << std::showpos << r.gpuMs - r.gpuBudgetMs << std::noshowpos << ")";
+            if (update)
+                out << "  golden " << (r.imagePassed ? "written" : "NOT written");
+            else if (r.missingGolden)
+                out << "  no golden image, run with --regress-update";
+            else if (r.diff.sizeMismatch)
+                out << "  image size differs from golden";
+            else
+                out << "  image " << r.diff.differing << " px differ (" << r.diff.differingFraction * 100.0 << "%, max dE " << r.diff.maxDeltaE << ")";
+            out << std::endl;
+        }
+        if (results.size() < (size_t)REGRESSION_VIEWPOINT_COUNT)
+        {
+            out << "FAIL only " << results.size() << " of " << REGRESSION_VIEWPOINT_COUNT << " viewpoints rendered" << std::endl;
+            passed = false;
+        }
+        out << (passed ? "regression passed" : "regression FAILED") << std::endl;
+        return passed;
+    }
+
+    void destroy()
+    {
+        query.reset();
+        running = false;
+    }
+
+private:
+    struct Result
+    {
+        std::string name;
+        double cpuMs = 0.0, gpuMs = 0.0;
+        float cpuBudgetMs = 0.0f, gpuBudgetMs = 0.0f;
+        bool imagePassed = false;
+        bool missingGolden = false;
+        ImageDiff diff;
+    };
+
+    std::string directory;
+    bool update = false;
+    bool running = false;
+    int viewpoint = 0;
+    int frame = 0;
+    GpuQuery query;
+    SampleSeries cpuMsSeries{ SampleSeries::ALL };
+    SampleSeries gpuMsSeries{ SampleSeries::ALL };
+    std::vector<Result> results;
+};
+
+#endif
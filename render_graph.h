@@ -0,0 +1,598 @@
+#ifndef render_graph_h
+#define render_graph_h
+
+#include <glad/glad.h>
+
+#include "frame_arena.h"
+#include "gpu_resources.h"
+#include "input.h"
+#include "stats.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// a resource of the current frame's graph, returned by RenderGraph::import and RenderGraph::createTexture
+typedef int RenderResource;
+
+// format and size of a transient texture; transients with equal descriptions can share memory. More than one sample
+// makes a GL_TEXTURE_2D_MULTISAMPLE
+struct TransientTextureDesc
+{
+    GLenum internalFormat;
+    int width;
+    int height;
+    int samples;
+
+    bool operator==(const TransientTextureDesc& other) const
+    {
+        return internalFormat == other.internalFormat && width == other.width && height == other.height && samples == other.samples;
+    }
+
+    size_t bytes() const;
+};
+
+inline size_t textureFormatBytes(GLenum internalFormat)
+{
+    switch (internalFormat)
+    {
+    case GL_R8:
+        return 1;
+    case GL_RG8:
+    case GL_R16F:
+        return 2;
+    case GL_RGBA16F:
+    case GL_RG32F:
+        return 8;
+    case GL_RGBA32F:
+        return 16;
+    default:    // GL_RGBA8, GL_R32UI, GL_R32F, GL_RG16F, GL_R11F_G11F_B10F, GL_DEPTH24_STENCIL8, ...
+        return 4;
+    }
+}
+
+inline size_t TransientTextureDesc::bytes() const
+{
+    return (size_t)width * height * (samples > 1 ? samples : 1) * textureFormatBytes(internalFormat);
+}
+
+class RenderGraph;
+
+// declares what a pass reads and writes; returned by RenderGraph::addPass
+class RenderPassBuilder
+{
+public:
+    RenderPassBuilder(RenderGraph& graph, int pass) : graph(graph), pass(pass) {}
+
+    // the resource as the passes declared before this one left it; the next pass declared to write it runs after
+    RenderPassBuilder& reads(RenderResource resource);
+    // the resource as every pass of the frame left it, wherever they are declared: for consumers declared before
+    // their producers, such as the post-processing set up ahead of the scene
+    RenderPassBuilder& readsFinal(RenderResource resource);
+    RenderPassBuilder& writes(RenderResource resource);
+    // the pass has effects outside the graph, e.g. a readback, and is never culled
+    RenderPassBuilder& sideEffect();
+
+private:
+    RenderGraph& graph;
+    int pass;
+};
+
+// The frame as passes that declare the resources they read and write, rebuilt every frame. execute() culls the passes
+// whose writes nothing needed reads, orders the rest and runs them. Writers of a resource keep their declaration
+// order; a pass that reads it runs after the writers declared before it and before the next one, so a write never
+// lands ahead of a read of the old contents, and a pass that reads it final runs after all of them. Resources are either imported, i.e.
+// owned by a subsystem or the default framebuffer, or transient textures that only live during the frame: those are
+// allocated from a pool at execution, and two transients whose first and last uses do not overlap share one texture
+// when their formats and sizes match. A transient's contents are undefined until a pass of the frame writes them.
+// Every pass is timed on the CPU and, with GL_TIMESTAMP queries read back without stalling, on the GPU; the GPU time
+// of whole frames is also kept per frame label, e.g. the anti-aliasing mode, to compare configurations.
+// The frame's passes, their closures and the scheduling scratch live in the frame arena, so building and executing
+// the graph makes no heap allocations; names are string literals the graph keeps pointers to.
+class RenderGraph
+{
+public:
+    void init()
+    {
+        for (GpuQuery& query : queries)
+            query.create("render graph", "pass timestamp");
+    }
+
+    // forgets the previous frame's passes and resources
+    void beginFrame(const std::string& label = "")
+    {
+        releasePasses();
+        // fresh containers: the previous ones' capacity is in arena memory that is about to be reused
+        passes = FrameVector<Pass>();
+        resources = FrameVector<Resource>();
+        order = FrameVector<int>();
+        frameLabel = label;
+    }
+
+    // a resource owned outside the graph; outputs are what the frame is for, e.g. the presented colour
+    RenderResource import(const char* name, bool output = false)
+    {
+        Resource resource;
+        resource.name = name;
+        resource.output = output;
+        resources.push_back(resource);
+        return (RenderResource)resources.size() - 1;
+    }
+
+    RenderResource createTexture(const char* name, const TransientTextureDesc& desc)
+    {
+        Resource resource;
+        resource.name = name;
+        resource.transient = true;
+        resource.desc = desc;
+        resources.push_back(resource);
+        return (RenderResource)resources.size() - 1;
+    }
+
+    // run is called once by execute() if the pass is live
+    template <typename Run>
+    RenderPassBuilder addPass(const char* name, Run run)
+    {
+        FrameAllocator<Run> allocator;
+        Pass pass;
+        pass.name = name;
+        pass.closure = new (allocator.allocate(1)) Run(std::move(run));
+        pass.run = [](void* closure) { (*(Run*)closure)(); };
+        pass.release = [](void* closure, FrameAllocator<char> from) {
+            ((Run*)closure)->~Run();
+            FrameAllocator<Run>(from).deallocate((Run*)closure, 1);
+        };
+        pass.allocator = allocator;
+        passes.push_back(std::move(pass));
+        return RenderPassBuilder(*this, (int)passes.size() - 1);
+    }
+
+    // the texture behind a transient, for the passes while they run
+    GLuint texture(RenderResource resource) const
+    {
+        int physical = resources[resource].physical;
+        return physical >= 0 ? pool[physical].texture.id() : 0;
+    }
+
+    // culls and orders the passes without running them; execute() starts with it
+    void compile()
+    {
+        cull();
+        schedule();
+    }
+
+    // calls visit(name) for the passes the last compile() kept, in the order they run
+    template <typename Visit>
+    void visitScheduledPasses(Visit visit) const
+    {
+        for (int p : order)
+            visit(passes[p].name);
+    }
+
+    void execute()
+    {
+        collectGpuTimes();
+        compile();
+        allocate();
+        // timestamp k is taken before the k-th pass, the last one after all of them
+        int slot = (int)(frame % QUERY_FRAMES);
+        std::vector<int>& timed = timedPasses[slot];
+        timed.clear();
+        timedLabels[slot] = frameLabel;
+        for (size_t k = 0; k < order.size(); k++)
+        {
+            Pass& pass = passes[order[k]];
+            int timing = timingOf(pass.name);
+            bool gpuTimed = timed.size() < MAX_TIMED_PASSES;
+            if (gpuTimed)
+            {
+                glQueryCounter(queries[slot * (MAX_TIMED_PASSES + 1) + timed.size()], GL_TIMESTAMP);
+                timed.push_back(timing);
+            }
+            uint64_t start = inputClockNow();
+            pass.run(pass.closure);
+            timings[timing].lastCpuMs = (double)(inputClockNow() - start) / 1.0e6;
+            timings[timing].cpuMs.add(timings[timing].lastCpuMs);
+        }
+        if (!timed.empty())
+            glQueryCounter(queries[slot * (MAX_TIMED_PASSES + 1) + timed.size()], GL_TIMESTAMP);
+        for (const Pass& pass : passes)
+        {
+            if (!pass.live)
+                timings[timingOf(pass.name)].culled++;
+        }
+        releaseUnused();
+        frame++;
+    }
+
+    // GPU times of the finished frames that had this label, NULL before the first
+    SampleSeries* frameGpuTimes(const std::string& label)
+    {
+        auto it = frameGpuMs.find(label);
+        return it != frameGpuMs.end() ? &it->second : NULL;
+    }
+
+    // calls visit(name, cpuMs, gpuMs) for the passes the last execute() ran, in order: the CPU time is that frame's,
+    // the GPU time the latest read back, a few frames older, or -1 before the first
+    template <typename Visit>
+    void visitExecutedPasses(Visit visit) const
+    {
+        for (int p : order)
+        {
+            const PassTiming& timing = timings[timingIndex.find(passes[p].name)->second];
+            visit(passes[p].name, timing.lastCpuMs, timing.lastGpuMs);
+        }
+    }
+
+    void report(std::ostream& out)
+    {
+        out << std::fixed << std::setprecision(2)
+            << "render graph: " << frame << " frames, transient textures peaked at " << peakRequested / 1048576.0
+            << " MiB requested in " << peakAllocated / 1048576.0 << " MiB allocated, aliasing saved "
+            << peakSaved / 1048576.0 << " MiB" << std::endl;
+        for (PassTiming& timing : timings)
+        {
+            out << "  " << timing.name << ": " << timing.cpuMs.count() << " runs, " << timing.culled << " culled" << std::endl;
+            timing.cpuMs.report(out, "    cpu");
+            if (timing.gpuMs.count())
+                timing.gpuMs.report(out, "    gpu");
+        }
+    }
+
+    void destroy()
+    {
+        releasePasses();
+        passes = FrameVector<Pass>();
+        for (GpuQuery& query : queries)
+            query.reset();
+        pool.clear();
+    }
+
+private:
+    friend class RenderPassBuilder;
+
+    struct Resource
+    {
+        const char* name = "";
+        bool transient = false;
+        bool output = false;
+        TransientTextureDesc desc = { 0, 0, 0, 0 };
+        int physical = -1;  // pool index while the frame executes, -1 when no live pass uses the transient
+    };
+
+    struct Pass
+    {
+        const char* name = "";
+        void* closure = NULL;
+        void (*run)(void* closure) = NULL;
+        void (*release)(void* closure, FrameAllocator<char> from) = NULL;
+        FrameAllocator<char> allocator;     // of the closure
+        FrameVector<RenderResource> reads;
+        FrameVector<RenderResource> finalReads;
+        FrameVector<RenderResource> writes;
+        bool sideEffect = false;
+        bool live = false;
+    };
+
+    struct PhysicalTexture
+    {
+        GpuTexture texture;
+        TransientTextureDesc desc;
+        int busyUntil = -1;             // last scheduled pass using it this frame
+        unsigned long long lastFrame = 0;
+    };
+
+    struct PassTiming
+    {
+        std::string name;
+        SampleSeries cpuMs;
+        SampleSeries gpuMs;
+        double lastCpuMs = 0.0;
+        double lastGpuMs = -1.0;
+        unsigned long long culled = 0;
+    };
+
+    static const int QUERY_FRAMES = 4;
+    static const size_t MAX_TIMED_PASSES = 16;
+    // pooled textures no frame used for this long are freed
+    static const unsigned long long RELEASE_FRAMES = 120;
+
+    FrameVector<Pass> passes;
+    FrameVector<Resource> resources;
+    FrameVector<int> order;
+    std::vector<PhysicalTexture> pool;
+    std::vector<PassTiming> timings;
+    std::map<std::string, int, std::less<>> timingIndex;
+    GpuQuery queries[QUERY_FRAMES * (MAX_TIMED_PASSES + 1)];
+    std::vector<int> timedPasses[QUERY_FRAMES];
+    std::string timedLabels[QUERY_FRAMES];
+    std::map<std::string, SampleSeries> frameGpuMs;
+    std::string frameLabel;
+    unsigned long long frame = 0;
+    unsigned long long gpuResolved = 0;
+    size_t peakRequested = 0;
+    size_t peakAllocated = 0;
+    size_t peakSaved = 0;
+    bool cycleReported = false;
+
+    void releasePasses()
+    {
+        for (Pass& pass : passes)
+        {
+            if (pass.closure)
+                pass.release(pass.closure, pass.allocator);
+            pass.closure = NULL;
+        }
+    }
+
+    int timingOf(const char* name)
+    {
+        auto it = timingIndex.find(name);
+        if (it != timingIndex.end())
+            return it->second;
+        PassTiming timing;
+        timing.name = name;
+        timings.push_back(timing);
+        timingIndex[name] = (int)timings.size() - 1;
+        return (int)timings.size() - 1;
+    }
+
+    // a pass is live if it has side effects or writes a resource an output or a live pass needs
+    void cull()
+    {
+        FrameVector<bool> needed(resources.size(), false);
+        for (size_t r = 0; r < resources.size(); r++)
+            needed[r] = resources[r].output;
+        for (Pass& pass : passes)
+            pass.live = false;
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (size_t p = passes.size(); p-- > 0;)
+            {
+                Pass& pass = passes[p];
+                if (pass.live)
+                    continue;
+                bool live = pass.sideEffect;
+                for (RenderResource r : pass.writes)
+                    live = live || needed[r];
+                if (!live)
+                    continue;
+                pass.live = true;
+                changed = true;
+                for (const FrameVector<RenderResource>* uses : { &pass.reads, &pass.finalReads })
+                {
+                    for (RenderResource r : *uses)
+                        needed[r] = true;
+                }
+            }
+        }
+    }
+
+    // topological order of the live passes, ties broken by declaration order
+    void schedule()
+    {
+        size_t count = passes.size();
+        FrameVector<FrameVector<int>> successors(count);
+        FrameVector<int> pending(count, 0);
+        auto before = [&](int first, int then) {
+            if (first == then)
+                return;
+            successors[first].push_back(then);
+            pending[then]++;
+        };
+        // in declaration order: the last writer of each resource, and the passes that read it since
+        FrameVector<int> lastWriter(resources.size(), -1);
+        FrameVector<FrameVector<int>> readers(resources.size());
+        for (size_t p = 0; p < count; p++)
+        {
+            if (!passes[p].live)
+                continue;
+            for (RenderResource r : passes[p].reads)
+            {
+                if (lastWriter[r] >= 0)
+                    before(lastWriter[r], (int)p);
+                readers[r].push_back((int)p);
+            }
+            for (RenderResource r : passes[p].writes)
+            {
+                if (lastWriter[r] >= 0)
+                    before(lastWriter[r], (int)p);
+                for (int reader : readers[r])
+                    before(reader, (int)p);
+                readers[r].clear();
+                lastWriter[r] = (int)p;
+            }
+        }
+        for (size_t p = 0; p < count; p++)
+        {
+            if (!passes[p].live)
+                continue;
+            for (RenderResource r : passes[p].finalReads)
+            {
+                for (size_t w = 0; w < count; w++)
+                {
+                    const FrameVector<RenderResource>& writes = passes[w].writes;
+                    if (passes[w].live && std::find(writes.begin(), writes.end(), r) != writes.end())
+                        before((int)w, (int)p);
+                }
+            }
+        }
+        order.clear();
+        FrameVector<bool> scheduled(count, false);
+        size_t live = 0;
+        for (size_t p = 0; p < count; p++)
+            live += passes[p].live ? 1 : 0;
+        while (order.size() < live)
+        {
+            int next = -1;
+            for (size_t p = 0; p < count && next < 0; p++)
+            {
+                if (passes[p].live && !scheduled[p] && pending[p] == 0)
+                    next = (int)p;
+            }
+            if (next < 0)
+                break;
+            scheduled[next] = true;
+            order.push_back(next);
+            for (int s : successors[next])
+                pending[s]--;
+        }
+        if (order.size() < live)
+        {
+            if (!cycleReported)
+                std::cout << "ERROR::RENDER_GRAPH:: the passes depend on each other in a cycle, running them in declaration order" << std::endl;
+            cycleReported = true;
+            order.clear();
+            for (size_t p = 0; p < count; p++)
+            {
+                if (passes[p].live)
+                    order.push_back((int)p);
+            }
+        }
+    }
+
+    // gives every used transient a pooled texture, reusing ones whose previous user has finished
+    void allocate()
+    {
+        FrameVector<int> first(resources.size(), -1), last(resources.size(), -1);
+        for (size_t k = 0; k < order.size(); k++)
+        {
+            const Pass& pass = passes[order[k]];
+            for (const FrameVector<RenderResource>* uses : { &pass.reads, &pass.finalReads, &pass.writes })
+            {
+                for (RenderResource r : *uses)
+                {
+                    if (first[r] < 0)
+                        first[r] = (int)k;
+                    last[r] = (int)k;
+                }
+            }
+        }
+        FrameVector<int> transients;
+        for (size_t r = 0; r < resources.size(); r++)
+        {
+            resources[r].physical = -1;
+            if (resources[r].transient && first[r] >= 0)
+                transients.push_back((int)r);
+        }
+        // by first use, then declaration; std::stable_sort would take a buffer from the heap
+        std::sort(transients.begin(), transients.end(), [&](int a, int b) { return first[a] != first[b] ? first[a] < first[b] : a < b; });
+        for (PhysicalTexture& physical : pool)
+            physical.busyUntil = -1;
+        size_t requested = 0, allocated = 0;
+        for (int r : transients)
+        {
+            Resource& resource = resources[r];
+            size_t bytes = resource.desc.bytes();
+            requested += bytes;
+            int chosen = -1;
+            for (size_t i = 0; i < pool.size() && chosen < 0; i++)
+            {
+                if (pool[i].desc == resource.desc && pool[i].busyUntil < first[r])
+                    chosen = (int)i;
+            }
+            if (chosen < 0)
+            {
+                PhysicalTexture physical;
+                physical.desc = resource.desc;
+                physical.texture.create("render graph", resource.name);
+                if (resource.desc.samples > 1)
+                {
+                    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, physical.texture);
+                    glTexStorage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, resource.desc.samples, resource.desc.internalFormat, resource.desc.width, resource.desc.height, GL_TRUE);
+                    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+                }
+                else
+                {
+                    glBindTexture(GL_TEXTURE_2D, physical.texture);
+                    glTexStorage2D(GL_TEXTURE_2D, 1, resource.desc.internalFormat, resource.desc.width, resource.desc.height);
+                    glBindTexture(GL_TEXTURE_2D, 0);
+                }
+                physical.texture.setBytes(bytes);
+                pool.push_back(std::move(physical));
+                chosen = (int)pool.size() - 1;
+            }
+            if (pool[chosen].busyUntil < 0)
+                allocated += bytes;
+            pool[chosen].busyUntil = last[r];
+            pool[chosen].lastFrame = frame;
+            resource.physical = chosen;
+        }
+        peakRequested = std::max(peakRequested, requested);
+        peakAllocated = std::max(peakAllocated, allocated);
+        peakSaved = std::max(peakSaved, requested - allocated);
+    }
+
+    void releaseUnused()
+    {
+        for (size_t i = pool.size(); i-- > 0;)
+        {
+            if (frame - pool[i].lastFrame > RELEASE_FRAMES)
+                pool.erase(pool.begin() + i);
+        }
+    }
+
+    // reads back the timestamps of finished frames without stalling
+    void collectGpuTimes()
+    {
+        while (gpuResolved < frame)
+        {
+            int slot = (int)(gpuResolved % QUERY_FRAMES);
+            const std::vector<int>& timed = timedPasses[slot];
+            if (!timed.empty())
+            {
+                GLuint end = queries[slot * (MAX_TIMED_PASSES + 1) + timed.size()];
+                GLint available = 0;
+                glGetQueryObjectiv(end, GL_QUERY_RESULT_AVAILABLE, &available);
+                // never let the ring wrap over unread queries
+                if (!available && frame - gpuResolved < QUERY_FRAMES)
+                    return;
+                GLuint64 first = 0;
+                glGetQueryObjectui64v(queries[slot * (MAX_TIMED_PASSES + 1)], GL_QUERY_RESULT, &first);
+                GLuint64 previous = first;
+                for (size_t k = 0; k < timed.size(); k++)
+                {
+                    GLuint64 next = 0;
+                    glGetQueryObjectui64v(queries[slot * (MAX_TIMED_PASSES + 1) + k + 1], GL_QUERY_RESULT, &next);
+                    timings[timed[k]].lastGpuMs = (double)(next - previous) / 1.0e6;
+                    timings[timed[k]].gpuMs.add(timings[timed[k]].lastGpuMs);
+                    previous = next;
+                }
+                frameGpuMs[timedLabels[slot]].add((double)(previous - first) / 1.0e6);
+            }
+            gpuResolved++;
+        }
+    }
+};
+
+inline RenderPassBuilder& RenderPassBuilder::reads(RenderResource resource)
+{
+    graph.passes[pass].reads.push_back(resource);
+    return *this;
+}
+
+inline RenderPassBuilder& RenderPassBuilder::readsFinal(RenderResource resource)
+{
+    graph.passes[pass].finalReads.push_back(resource);
+    return *this;
+}
+
+inline RenderPassBuilder& RenderPassBuilder::writes(RenderResource resource)
+{
+    graph.passes[pass].writes.push_back(resource);
+    return *this;
+}
+
+inline RenderPassBuilder& RenderPassBuilder::sideEffect()
+{
+    graph.passes[pass].sideEffect = true;
+    return *this;
+}
+
+#endif
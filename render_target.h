@@ -0,0 +1,73 @@
+#ifndef render_target_h
+#define render_target_h
+
+#include <glad/glad.h>
+
+#include "gpu_resources.h"
+
+#include <iostream>
+#include <vector>
+
+// Offscreen framebuffer with an RGBA8 colour and a 24-bit depth attachment, used when rendering without a
+// visible window (headless replay, regression tests)
+class RenderTarget
+{
+public:
+    GpuFramebuffer framebuffer;
+    GpuRenderbuffer color;
+    GpuRenderbuffer depth;
+    int width = 0;
+    int height = 0;
+
+    bool init(int w, int h)
+    {
+        width = w;
+        height = h;
+        framebuffer.create("targets", "offscreen");
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+        color.create("targets", "offscreen colour");
+        glBindRenderbuffer(GL_RENDERBUFFER, color);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        color.setBytes((size_t)width * height * 4);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+
+        depth.create("targets", "offscreen depth");
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        depth.setBytes((size_t)width * height * 4);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        if (!complete)
+            std::cout << "ERROR::FRAMEBUFFER:: offscreen target " << width << "x" << height << " is not complete" << std::endl;
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return complete;
+    }
+
+    void bind() const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, width, height);
+    }
+
+    // tightly packed RGB rows, bottom row first (OpenGL order)
+    void readPixels(std::vector<unsigned char>& rgb) const
+    {
+        rgb.resize((size_t)width * height * 3);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, rgb.data());
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    }
+
+    void destroy()
+    {
+        color.reset();
+        depth.reset();
+        framebuffer.reset();
+    }
+};
+
+#endif
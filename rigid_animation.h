@@ -0,0 +1,128 @@
+#ifndef rigid_animation_h
+#define rigid_animation_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "gpu_driven.h"
+#include "gpu_resources.h"
+#include "scene.h"
+#include "shader.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+// shader storage binding point of the parts read by animatedVertex.vs and animatedShadowDepth.vs
+const GLuint RIGID_PART_SSBO_BINDING = 9;
+
+// one instance of a rigidly rotating mesh: it turns around axis through pivot by phase + angularVelocity * time
+struct RigidPart
+{
+    glm::vec3 pivot;
+    glm::vec3 axis;             // normalized
+    float angularVelocity;      // radians per second
+    float phase;                // radians
+};
+
+// std430 layout of a part in the shaders
+struct GpuRigidPart
+{
+    glm::vec4 pivotPhase;
+    glm::vec4 axisVelocity;
+};
+
+// Instances of one baked mesh that spin on the GPU. The parts are uploaded once; each frame only the time uniform
+// changes and the vertex shader rotates every vertex around its instance's pivot, so the CPU cost does not grow with
+// the number of parts and all of them are drawn with one instanced call. The mesh is baked around its pivot, which
+// is the origin of its space.
+class RigidAnimation
+{
+public:
+    void setMesh(const MeshBuilder& baked)
+    {
+        mesh = baked;
+    }
+
+    void add(const RigidPart& part)
+    {
+        GpuRigidPart gpu;
+        gpu.pivotPhase = glm::vec4(part.pivot, part.phase);
+        gpu.axisVelocity = glm::vec4(part.axis, part.angularVelocity);
+        parts.push_back(gpu);
+    }
+
+    size_t count() const { return parts.size(); }
+
+    // creates the buffers and the vertex array on the current context; the CPU copies are released afterwards
+    void upload()
+    {
+        vbo.create("animation", "part vertices");
+        materialBuffer.create("animation", "part materials");
+        ebo.create("animation", "part indices");
+        partBuffer.create("animation", "parts");
+        vao.create("animation", "parts");
+        glBindVertexArray(vao);
+        vbo.data(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(float), mesh.vertices.data(), GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, BOX_VERTEX_STRIDE, (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, BOX_VERTEX_STRIDE, (void*)BOX_NORMAL_OFFSET);
+        glEnableVertexAttribArray(2);
+        materialBuffer.data(GL_ARRAY_BUFFER, mesh.materials.size() * sizeof(GLuint), mesh.materials.data(), GL_STATIC_DRAW);
+        glVertexAttribIPointer(MATERIAL_ATTRIBUTE, 1, GL_UNSIGNED_INT, 0, (void*)0);
+        glEnableVertexAttribArray(MATERIAL_ATTRIBUTE);
+        ebo.data(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(GLuint), mesh.indices.data(), GL_STATIC_DRAW);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        partBuffer.data(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(parts.size(), 1) * sizeof(GpuRigidPart), parts.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        indexCount = (GLsizei)mesh.indices.size();
+        partCount = (GLsizei)parts.size();
+        mesh = MeshBuilder();
+        std::vector<GpuRigidPart>().swap(parts);
+    }
+
+    // seconds of animation; the parts stand still while it does not advance
+    void setTime(float seconds) { time = seconds; }
+    float getTime() const { return time; }
+
+    // draws every part with a program built on animatedVertex.vs or animatedShadowDepth.vs; the program must be in use
+    void draw(const Shader& shader, RenderStats& stats) const
+    {
+        if (partCount == 0)
+            return;
+        shader.setFloat("animationTime", time);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RIGID_PART_SSBO_BINDING, partBuffer);
+        glBindVertexArray(vao);
+        glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0, partCount);
+        stats.submitted += partCount;
+        stats.drawCalls++;
+        stats.triangles += indexCount / 3 * partCount;
+    }
+
+    void report(std::ostream& out) const
+    {
+        out << "animated parts: " << partCount << " instances of " << indexCount / 3 << " triangles in one draw" << std::endl;
+    }
+
+    void destroy()
+    {
+        vao.reset();
+        vbo.reset();
+        materialBuffer.reset();
+        ebo.reset();
+        partBuffer.reset();
+        partCount = 0;
+    }
+
+private:
+    MeshBuilder mesh;
+    std::vector<GpuRigidPart> parts;
+    GpuVertexArray vao;
+    GpuBuffer vbo, materialBuffer, ebo, partBuffer;
+    GLsizei indexCount = 0;
+    GLsizei partCount = 0;
+    float time = 0.0f;
+};
+
+#endif
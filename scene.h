@@ -0,0 +1,136 @@
+#ifndef scene_h
+#define scene_h
+
+#include "shader.h"
+#include "frustum.h"
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+#include <vector>
+
+// every mesh in main.cpp is a box spanning [0, 0.5] on each axis before its model transform
+const glm::vec3 CUBE_MIN = glm::vec3(0.0f);
+const glm::vec3 CUBE_MAX = glm::vec3(0.5f);
+const GLsizei CUBE_INDEX_COUNT = 36;
+
+// vertex layout of the uploaded boxes: position, normal. Colour comes from the material table (materials.h).
+const int BOX_VERTEX_FLOATS = 6;
+const GLsizei BOX_VERTEX_STRIDE = BOX_VERTEX_FLOATS * sizeof(float);
+const unsigned int BOX_NORMAL_OFFSET = 3 * sizeof(float);
+
+// Faces of a box, numbered 2 * axis for the side at CUBE_MIN and 2 * axis + 1 for the side at CUBE_MAX. Baked ambient
+// occlusion (ambient_occlusion.h) gives every face its own grid of texels along the face's two other axes.
+const int BOX_FACE_COUNT = 6;
+
+// face of a box vertex from its outward normal in the lit layout
+inline int boxFace(const glm::vec3& normal)
+{
+	glm::vec3 a = glm::abs(normal);
+	int axis = a.x >= a.y && a.x >= a.z ? 0 : (a.y >= a.z ? 1 : 2);
+	return 2 * axis + (normal[axis] > 0.0f ? 1 : 0);
+}
+
+// the axes along which a face's texel coordinates run, in increasing order
+inline void boxFaceAxes(int face, int& u, int& v)
+{
+	int axis = face / 2;
+	u = axis == 0 ? 1 : 0;
+	v = axis == 2 ? 1 : 2;
+}
+
+// face << 2 | u << 1 | v of a vertex of a box in the lit layout, u and v being its corner of the face's texel grid;
+// vertexShader.vs computes the same for the shared box
+inline unsigned int boxFaceCorner(const float* litVertex)
+{
+	int face = boxFace(glm::vec3(litVertex[3], litVertex[4], litVertex[5]));
+	int u, v;
+	boxFaceAxes(face, u, v);
+	glm::vec3 center = (CUBE_MIN + CUBE_MAX) * 0.5f;
+	return (unsigned int)face << 2 | (litVertex[u] > center[u] ? 2u : 0u) | (litVertex[v] > center[v] ? 1u : 0u);
+}
+
+// world-space AABB of a transformed local AABB (Arvo's method)
+inline void transformBounds(const glm::mat4& model, const glm::vec3& localMin, const glm::vec3& localMax, glm::vec3& worldMin, glm::vec3& worldMax)
+{
+	worldMin = worldMax = glm::vec3(model[3]);
+	for (int column = 0; column < 3; column++) {
+		for (int row = 0; row < 3; row++) {
+			float a = model[column][row] * localMin[column];
+			float b = model[column][row] * localMax[column];
+			worldMin[row] += glm::min(a, b);
+			worldMax[row] += glm::max(a, b);
+		}
+	}
+}
+
+struct RenderStats {
+	unsigned int submitted;	// items considered for drawing
+	unsigned int culled;	// items rejected by the frustum
+	unsigned int drawCalls;
+	unsigned int triangles;
+
+	void reset() {
+		submitted = culled = drawCalls = triangles = 0;
+	}
+};
+
+struct DrawItem {
+	unsigned int vao;
+	unsigned int material;	// slot in the material table
+	GLsizei indexCount;
+	glm::mat4 model;
+	glm::vec3 boundsMin, boundsMax;	// world space
+	unsigned int occlusion = 0;	// 1 + offset of the box's baked ambient occlusion, 0 for none (ambient_occlusion.h)
+};
+
+// A flat list of draws that can be frustum culled before submission
+class DrawList {
+
+public:
+	std::vector<DrawItem> items;
+
+	void clear() {
+		items.clear();
+	}
+
+	void add(unsigned int vao, unsigned int material, const glm::mat4& model, GLsizei indexCount = CUBE_INDEX_COUNT) {
+		DrawItem item;
+		item.vao = vao;
+		item.material = material;
+		item.indexCount = indexCount;
+		item.model = model;
+		transformBounds(model, CUBE_MIN, CUBE_MAX, item.boundsMin, item.boundsMax);
+		items.push_back(item);
+	}
+
+	// appends the indices of the items that intersect the frustum grown by margin world units
+	void cull(const Frustum& frustum, float margin, std::vector<unsigned int>& visible, RenderStats& stats) const {
+		// room for every item, so a list kept across frames stops allocating however many become visible
+		visible.reserve(visible.size() + items.size());
+		for (unsigned int i = 0; i < items.size(); i++) {
+			stats.submitted++;
+			if (frustum.intersectsAABB(items[i].boundsMin, items[i].boundsMax, margin))
+				visible.push_back(i);
+			else
+				stats.culled++;
+		}
+	}
+
+	void draw(const Shader& shader, const std::vector<unsigned int>& visible, RenderStats& stats) const {
+		unsigned int boundVAO = 0;
+		for (unsigned int index : visible) {
+			const DrawItem& item = items[index];
+			shader.setMat4("model", item.model);
+			shader.setInt("materialIndex", (int)item.material);
+			shader.setInt("occlusionRecord", (int)item.occlusion);
+			if (item.vao != boundVAO) {
+				glBindVertexArray(item.vao);
+				boundVAO = item.vao;
+			}
+			glDrawElements(GL_TRIANGLES, item.indexCount, GL_UNSIGNED_INT, 0);
+			stats.drawCalls++;
+			stats.triangles += item.indexCount / 3;
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,273 @@
+#ifndef session_h
+#define session_h
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "camera.h"
+#include "input.h"
+#include "stats.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Binary camera session files. Layout (little-endian, no padding):
+//   header:  "CSES" | u32 version | f32 fixed delta | u32 flags | camera state | u32 frame count
+//   frame:   u64 ns since start | f32 delta | u32 held | u32 pressed | f32 mouse x, y | f32 scroll | camera state
+//   camera:  f32 position[3] | f32 orientation xyzw | f32 zoom | u8 mode
+// A frame is 65 bytes, so a ten minute session at 60 fps is about 2.3 MB. The frames run to the end of the file; the
+// count is patched in when the recording is closed and is only checked, so a recording that was killed still replays.
+
+const uint32_t SESSION_VERSION = 1;
+const size_t SESSION_FRAME_BYTES = 65;
+const uint32_t SESSION_FLAG_FAN_TURN = 1u << 0;
+const uint32_t SESSION_FLAG_ROTATE_AROUND = 1u << 1;
+
+struct SessionCameraState
+{
+    glm::vec3 position;
+    glm::quat orientation;
+    float zoom = ZOOM;
+    uint8_t mode = FREE_FLY;
+
+    static SessionCameraState capture(const Camera& camera)
+    {
+        SessionCameraState state;
+        state.position = camera.GetPosition();
+        state.orientation = camera.GetOrientation();
+        state.zoom = camera.GetZoom();
+        state.mode = (uint8_t)camera.GetMode();
+        return state;
+    }
+
+    void apply(Camera& camera) const
+    {
+        camera.SetMode((Camera_Mode)mode);
+        camera.SetPose(position, orientation);
+        camera.SetZoom(zoom);
+    }
+};
+
+struct SessionHeader
+{
+    float fixedDelta = 1.0f / 60.0f;
+    uint32_t flags = 0;
+    SessionCameraState camera;
+    uint32_t frameCount = 0;
+};
+
+struct SessionFrame
+{
+    uint64_t timestamp = 0;    // ns since the recording started
+    float deltaTime = 0.0f;    // live frame time, informational
+    FrameInput input;
+    SessionCameraState camera; // pose after the frame's input was applied
+};
+
+namespace session_io
+{
+    template <typename T>
+    inline void put(std::ostream& out, const T& value) { out.write((const char*)&value, sizeof(T)); }
+    template <typename T>
+    inline bool get(std::istream& in, T& value) { return (bool)in.read((char*)&value, sizeof(T)); }
+
+    inline void putCamera(std::ostream& out, const SessionCameraState& c)
+    {
+        put(out, c.position.x); put(out, c.position.y); put(out, c.position.z);
+        put(out, c.orientation.x); put(out, c.orientation.y); put(out, c.orientation.z); put(out, c.orientation.w);
+        put(out, c.zoom);
+        put(out, c.mode);
+    }
+
+    inline bool getCamera(std::istream& in, SessionCameraState& c)
+    {
+        return get(in, c.position.x) && get(in, c.position.y) && get(in, c.position.z)
+            && get(in, c.orientation.x) && get(in, c.orientation.y) && get(in, c.orientation.z) && get(in, c.orientation.w)
+            && get(in, c.zoom)
+            && get(in, c.mode);
+    }
+}
+
+// Writes one SessionFrame per rendered frame
+class SessionRecorder
+{
+public:
+    bool open(const std::string& path, const SessionHeader& header)
+    {
+        using namespace session_io;
+        file.open(path, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            std::cout << "ERROR::SESSION:: cannot write " << path << std::endl;
+            return false;
+        }
+        file.write("CSES", 4);
+        put(file, SESSION_VERSION);
+        put(file, header.fixedDelta);
+        put(file, header.flags);
+        putCamera(file, header.camera);
+        frameCountOffset = file.tellp();
+        put(file, (uint32_t)0);
+        frames = 0;
+        start = inputClockNow();
+        return true;
+    }
+
+    bool isOpen() const { return file.is_open(); }
+
+    void write(float deltaTime, const FrameInput& input, const Camera& camera)
+    {
+        using namespace session_io;
+        put(file, (uint64_t)(inputClockNow() - start));
+        put(file, deltaTime);
+        put(file, input.held);
+        put(file, input.pressed);
+        put(file, input.mouse.x);
+        put(file, input.mouse.y);
+        put(file, input.scroll);
+        putCamera(file, SessionCameraState::capture(camera));
+        frames++;
+        // about once a second, so a recording that is killed loses at most that
+        if (frames % 64 == 0)
+            file.flush();
+    }
+
+    // patches the frame count into the header
+    void close()
+    {
+        if (!file.is_open())
+            return;
+        file.seekp(frameCountOffset);
+        session_io::put(file, frames);
+        file.close();
+        std::cout << "recorded " << frames << " frames" << std::endl;
+    }
+
+private:
+    std::ofstream file;
+    std::streampos frameCountOffset;
+    uint32_t frames = 0;
+    uint64_t start = 0;
+};
+
+// Reads a whole session up front so playback never touches the disk
+class SessionPlayer
+{
+public:
+    SessionHeader header;
+    std::vector<SessionFrame> frames;
+
+    bool open(const std::string& path)
+    {
+        using namespace session_io;
+        std::ifstream file(path, std::ios::binary);
+        char magic[4] = {};
+        uint32_t version = 0;
+        if (!file || !file.read(magic, 4) || memcmp(magic, "CSES", 4) != 0 || !get(file, version) || version != SESSION_VERSION)
+        {
+            std::cout << "ERROR::SESSION:: " << path << " is not a version " << SESSION_VERSION << " session file" << std::endl;
+            return false;
+        }
+        if (!get(file, header.fixedDelta) || !get(file, header.flags) || !getCamera(file, header.camera) || !get(file, header.frameCount))
+        {
+            std::cout << "ERROR::SESSION:: " << path << " has a truncated header" << std::endl;
+            return false;
+        }
+        if (!(header.fixedDelta > 0.0f))
+        {
+            std::cout << "ERROR::SESSION:: " << path << " has a fixed delta of " << header.fixedDelta << std::endl;
+            return false;
+        }
+        // the file size bounds the frames, whatever the header claims
+        std::streampos first = file.tellg();
+        file.seekg(0, std::ios::end);
+        size_t available = (size_t)(file.tellg() - first) / SESSION_FRAME_BYTES;
+        file.seekg(first);
+        frames.clear();
+        frames.reserve(available);
+        for (size_t i = 0; i < available; i++)
+        {
+            SessionFrame f;
+            if (!get(file, f.timestamp) || !get(file, f.deltaTime) || !get(file, f.input.held) || !get(file, f.input.pressed)
+                || !get(file, f.input.mouse.x) || !get(file, f.input.mouse.y) || !get(file, f.input.scroll) || !getCamera(file, f.camera))
+                break;
+            frames.push_back(f);
+        }
+        if (header.frameCount == 0)
+            std::cout << "warning: " << path << " was not closed, replaying the " << frames.size() << " frames it holds" << std::endl;
+        else if (header.frameCount != frames.size())
+            std::cout << "warning: " << path << " should hold " << header.frameCount << " frames, replaying the " << frames.size() << " it does" << std::endl;
+        next = 0;
+        return true;
+    }
+
+    bool finished() const { return next >= frames.size(); }
+    const SessionFrame& advance() { return frames[next++]; }
+    size_t position() const { return next; }
+
+private:
+    size_t next = 0;
+};
+
+// Per-frame measurements along a replayed path. It keeps every frame, so the percentiles it reports are exact.
+class ReplayReport
+{
+public:
+    float maxDrift = 0.0f;  // largest distance between replayed and recorded camera position
+
+    void addFrame(double cpuMs, unsigned int draws, unsigned int culledItems, float drift)
+    {
+        maxDrift = glm::max(maxDrift, drift);
+        rows.push_back(Row{ cpuMs, draws, culledItems, drift });
+    }
+
+    // GPU times arrive a few frames late, so they are kept apart from the rows
+    void addGpuTime(double ms) { gpuMs.push_back(ms); }
+
+    void print(std::ostream& out) const
+    {
+        SampleSeries frameMs(SampleSeries::ALL), gpu(SampleSeries::ALL), drawCalls(SampleSeries::ALL), culled(SampleSeries::ALL);
+        for (const Row& row : rows)
+        {
+            frameMs.add(row.cpuMs);
+            drawCalls.add(row.draws);
+            culled.add(row.culled);
+        }
+        for (double ms : gpuMs)
+            gpu.add(ms);
+        out << "replay: " << rows.size() << " frames" << std::endl;
+        frameMs.report(out, "frame time");
+        gpu.report(out, "gpu time");
+        drawCalls.report(out, "draw calls", "per frame");
+        culled.report(out, "culled", "per frame");
+        out << "max camera drift from recording: " << maxDrift << std::endl;
+    }
+
+    bool writeCsv(const std::string& path) const
+    {
+        std::ofstream csv(path);
+        if (!csv)
+            return false;
+        csv << "frame,cpu_ms,draw_calls,culled,drift\n";
+        for (size_t i = 0; i < rows.size(); i++)
+            csv << i << "," << rows[i].cpuMs << "," << rows[i].draws << "," << rows[i].culled << "," << rows[i].drift << "\n";
+        return true;
+    }
+
+private:
+    struct Row
+    {
+        double cpuMs;
+        unsigned int draws;
+        unsigned int culled;
+        float drift;
+    };
+    std::vector<Row> rows;
+    std::vector<double> gpuMs;
+};
+
+#endif
@@ -11,71 +11,126 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include "gpu_resources.h"
+
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+// Owns its program: a Shader can be moved but not copied, and the program is deleted with it or by destroy().
 class Shader
 {
 public:
     unsigned int ID;
+    Shader() : ID(0) {}
+    Shader(Shader&&) = default;
+    Shader& operator=(Shader&&) = default;
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath)
     {
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
+        compile(readSource(vertexPath), readSource(fragmentPath), fragmentPath);
+    }
+    // constructor for a compute program
+    // ------------------------------------------------------------------------
+    explicit Shader(const char* computePath)
+    {
+        compileCompute(readSource(computePath), computePath);
+    }
+    // reads a whole shader file, empty when it cannot be read; touches no GL state, so it may run on any thread
+    // ------------------------------------------------------------------------
+    static std::string readSource(const char* path)
+    {
+        std::ifstream file;
         // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
         try
         {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
+            file.open(path);
+            std::stringstream stream;
+            stream << file.rdbuf();
+            file.close();
+            return stream.str();
         }
         catch (std::ifstream::failure& e)
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << path << " " << e.what() << std::endl;
         }
+        return std::string();
+    }
+    // builds the program from vertex and fragment source; needs a current context, which may be a shared one.
+    // name identifies the program in the GPU resource report. Returns false when a stage did not compile or the
+    // program did not link; the errors have been printed
+    // ------------------------------------------------------------------------
+    bool compile(const std::string& vertexCode, const std::string& fragmentCode, const std::string& name = "program")
+    {
+        return compile(vertexCode, std::string(), fragmentCode, name);
+    }
+    // as above with a geometry shader between the two stages; an empty geometryCode leaves it out
+    // ------------------------------------------------------------------------
+    bool compile(const std::string& vertexCode, const std::string& geometryCode, const std::string& fragmentCode, const std::string& name)
+    {
         const char* vShaderCode = vertexCode.c_str();
         const char* fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
+        unsigned int vertex, geometry = 0, fragment;
         // vertex shader
         vertex = glCreateShader(GL_VERTEX_SHADER);
         glShaderSource(vertex, 1, &vShaderCode, NULL);
         glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
+        bool compiled = checkCompileErrors(vertex, "VERTEX");
+        // geometry shader
+        if (!geometryCode.empty())
+        {
+            const char* gShaderCode = geometryCode.c_str();
+            geometry = glCreateShader(GL_GEOMETRY_SHADER);
+            glShaderSource(geometry, 1, &gShaderCode, NULL);
+            glCompileShader(geometry);
+            compiled = checkCompileErrors(geometry, "GEOMETRY") && compiled;
+        }
         // fragment Shader
         fragment = glCreateShader(GL_FRAGMENT_SHADER);
         glShaderSource(fragment, 1, &fShaderCode, NULL);
         glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
+        compiled = checkCompileErrors(fragment, "FRAGMENT") && compiled;
         // shader Program
-        ID = glCreateProgram();
+        program.create("programs", name);
+        ID = program;
         glAttachShader(ID, vertex);
+        if (geometry)
+            glAttachShader(ID, geometry);
         glAttachShader(ID, fragment);
         glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
+        bool linked = checkCompileErrors(ID, "PROGRAM");
         // delete the shaders as they're linked into our program now and no longer necessary
         glDeleteShader(vertex);
+        if (geometry)
+            glDeleteShader(geometry);
         glDeleteShader(fragment);
-
+        return compiled && linked;
+    }
+    // ------------------------------------------------------------------------
+    bool compileCompute(const std::string& computeCode, const std::string& name = "compute program")
+    {
+        const char* cShaderCode = computeCode.c_str();
+        unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+        glShaderSource(compute, 1, &cShaderCode, NULL);
+        glCompileShader(compute);
+        bool compiled = checkCompileErrors(compute, "COMPUTE");
+        program.create("programs", name);
+        ID = program;
+        glAttachShader(ID, compute);
+        glLinkProgram(ID);
+        bool linked = checkCompileErrors(ID, "PROGRAM");
+        glDeleteShader(compute);
+        return compiled && linked;
+    }
+    // deletes the program; the context must still be current
+    // ------------------------------------------------------------------------
+    void destroy()
+    {
+        program.reset();
+        ID = 0;
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -83,69 +138,94 @@ public:
     {
         glUseProgram(ID);
     }
-    // utility uniform functions
+    // utility uniform functions; the names are C strings, so a uniform set every frame builds no std::string
     // ------------------------------------------------------------------------
-    void setBool(const std::string& name, bool value) const
+    void setBool(const char* name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        glUniform1i(glGetUniformLocation(ID, name), (int)value);
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string& name, int value) const
+    void setInt(const char* name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1i(glGetUniformLocation(ID, name), value);
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string& name, float value) const
+    void setFloat(const char* name, float value) const
+    {
+        glUniform1f(glGetUniformLocation(ID, name), value);
+    }
+    // ------------------------------------------------------------------------
+    void setVec2(const char* name, const glm::vec2& value) const
+    {
+        glUniform2fv(glGetUniformLocation(ID, name), 1, &value[0]);
+    }
+    void setVec2(const char* name, float x, float y) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform2f(glGetUniformLocation(ID, name), x, y);
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string& name, const glm::vec2& value) const
+    void setVec3(const char* name, const glm::vec3& value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform3fv(glGetUniformLocation(ID, name), 1, &value[0]);
     }
-    void setVec2(const std::string& name, float x, float y) const
+    void setVec3(const char* name, float x, float y, float z) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        glUniform3f(glGetUniformLocation(ID, name), x, y, z);
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string& name, const glm::vec3& value) const
+    void setIVec3(const char* name, const glm::ivec3& value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform3i(glGetUniformLocation(ID, name), value.x, value.y, value.z);
     }
-    void setVec3(const std::string& name, float x, float y, float z) const
+    // ------------------------------------------------------------------------
+    void setVec4(const char* name, const glm::vec4& value) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        glUniform4fv(glGetUniformLocation(ID, name), 1, &value[0]);
+    }
+    void setVec4(const char* name, float x, float y, float z, float w) const
+    {
+        glUniform4f(glGetUniformLocation(ID, name), x, y, z, w);
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string& name, const glm::vec4& value) const
+    void setMat2(const char* name, const glm::mat2& mat) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniformMatrix2fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat[0][0]);
     }
-    void setVec4(const std::string& name, float x, float y, float z, float w) const
+    // ------------------------------------------------------------------------
+    void setMat3(const char* name, const glm::mat3& mat) const
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        glUniformMatrix3fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string& name, const glm::mat2& mat) const
+    void setMat4(const char* name, const glm::mat4& mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string& name, const glm::mat3& mat) const
+    // whole uniform arrays, by the name of the array
+    void setVec4Array(const char* name, const glm::vec4* values, int count) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniform4fv(glGetUniformLocation(ID, name), count, &values[0][0]);
     }
+    void setMat4Array(const char* name, const glm::mat4* mats, int count) const
+    {
+        glUniformMatrix4fv(glGetUniformLocation(ID, name), count, GL_FALSE, &mats[0][0][0]);
+    }
+
     // ------------------------------------------------------------------------
-    void setMat4(const std::string& name, const glm::mat4& mat) const
+    void setBlockBinding(const char* name, unsigned int binding) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        GLuint index = glGetUniformBlockIndex(ID, name);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
     }
 
 private:
-    // utility function for checking shader compilation/linking errors.
+    GpuProgram program;
+
+    // utility function for checking shader compilation/linking errors; true when there were none
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    bool checkCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
         GLchar infoLog[1024];
@@ -167,6 +247,7 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success != 0;
     }
 };
 #endif
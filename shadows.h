@@ -0,0 +1,232 @@
+#ifndef shadows_h
+#define shadows_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "frustum.h"
+#include "gpu_resources.h"
+#include "input.h"
+#include "lighting.h"
+#include "rigid_animation.h"
+#include "scene.h"
+#include "shader.h"
+#include "stats.h"
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// texture unit the shadow map array is bound to for the lighting pass
+const GLuint SHADOW_MAP_TEXTURE_UNIT = 0;
+
+// Shadow maps of the shadow casting spot lights, one layer of a depth texture array each. Static casters are rendered
+// into a cached array only when the lights or the static geometry change. Every frame in which the dynamic casters
+// moved, the cached depth is copied into the sampled array and the dynamic casters are drawn on top; when nothing
+// moved the pass is skipped entirely. Casters are culled against each light's frustum.
+class ShadowMaps
+{
+public:
+    static const int SIZE = 1024;
+
+    void init()
+    {
+        createArray(staticDepth, "static depth");
+        createArray(depth, "depth");
+        framebuffer.create("shadows", "shadow pass");
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // call when a static caster was added, removed or moved
+    void invalidateStatic() { staticDirty = true; }
+
+    // parts animated on the GPU, drawn with the dynamic casters by a program built on animatedShadowDepth.vs
+    void setAnimatedCasters(const RigidAnimation& animation, const Shader& depthShader)
+    {
+        animated = &animation;
+        animatedDepthShader = &depthShader;
+    }
+
+    // brings the shadow maps up to date; restores the draw framebuffer and viewport afterwards
+    void update(const Shader& depthShader, const ClusteredLighting& lighting, const DrawList& staticCasters, const DrawList& dynamicCasters)
+    {
+        uint64_t start = inputClockNow();
+        if (lighting.getLightsRevision() != lightsRevision)
+        {
+            setupLights(lighting.getLights());
+            lightsRevision = lighting.getLightsRevision();
+            staticDirty = true;
+        }
+        uint64_t dynamicHash = hashCasters(dynamicCasters);
+        if (animated)
+        {
+            // the parts only move while their time advances
+            float time = animated->getTime();
+            const unsigned char* bytes = (const unsigned char*)&time;
+            for (size_t i = 0; i < sizeof(time); i++)
+                dynamicHash = (dynamicHash ^ bytes[i]) * 1099511628211ull;
+        }
+        if (!staticDirty && dynamicHash == lastDynamicHash)
+        {
+            skippedFrames++;
+            return;
+        }
+        lastDynamicHash = dynamicHash;
+
+        GLint viewport[4];
+        GLint previousFramebuffer = 0;
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, SIZE, SIZE);
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(2.0f, 4.0f);
+        depthShader.use();
+        stats.reset();
+
+        if (staticDirty)
+        {
+            for (size_t layer = 0; layer < shadowLights.size(); layer++)
+                renderLayer(depthShader, staticDepth, (int)layer, staticCasters, true);
+            staticDirty = false;
+            staticRebuilds++;
+        }
+        for (size_t layer = 0; layer < shadowLights.size(); layer++)
+        {
+            glCopyImageSubData(staticDepth, GL_TEXTURE_2D_ARRAY, 0, 0, 0, (GLint)layer,
+                depth, GL_TEXTURE_2D_ARRAY, 0, 0, 0, (GLint)layer, SIZE, SIZE, 1);
+            renderLayer(depthShader, depth, (int)layer, dynamicCasters, false);
+        }
+        dynamicOverlays++;
+
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        updateMs.add((double)(inputClockNow() - start) / 1.0e6);
+    }
+
+    // binds the shadow maps and light matrices for the lighting pass; the program must be in use
+    void apply(const Shader& shader) const
+    {
+        glActiveTexture(GL_TEXTURE0 + SHADOW_MAP_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, depth);
+        shader.setInt("shadowMaps", SHADOW_MAP_TEXTURE_UNIT);
+        glm::mat4 matrices[MAX_SHADOW_LIGHTS];
+        for (size_t layer = 0; layer < shadowLights.size(); layer++)
+            matrices[layer] = shadowLights[layer].viewProjection;
+        if (!shadowLights.empty())
+            shader.setMat4Array("shadowMatrices", matrices, (int)shadowLights.size());
+    }
+
+    void report(std::ostream& out)
+    {
+        out << "shadows: " << shadowLights.size() << " maps, " << staticRebuilds << " static rebuilds, "
+            << dynamicOverlays << " dynamic overlays, " << skippedFrames << " frames skipped, "
+            << stats.drawCalls << " caster draws (" << stats.culled << " culled) in the last update" << std::endl;
+        updateMs.report(out, "shadow update");
+    }
+
+    void destroy()
+    {
+        framebuffer.reset();
+        staticDepth.reset();
+        depth.reset();
+    }
+
+private:
+    struct ShadowLight
+    {
+        glm::mat4 viewProjection;
+        Frustum frustum;
+    };
+
+    GpuTexture staticDepth;
+    GpuTexture depth;
+    GpuFramebuffer framebuffer;
+    std::vector<ShadowLight> shadowLights;
+    const RigidAnimation* animated = NULL;
+    const Shader* animatedDepthShader = NULL;
+    std::vector<unsigned int> visible;
+    unsigned int lightsRevision = ~0u;
+    uint64_t lastDynamicHash = 0;
+    bool staticDirty = true;
+    unsigned int staticRebuilds = 0;
+    unsigned int dynamicOverlays = 0;
+    unsigned int skippedFrames = 0;
+    RenderStats stats = {};
+    SampleSeries updateMs;
+
+    static void createArray(GpuTexture& texture, const char* name)
+    {
+        texture.create("shadows", name);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT24, SIZE, SIZE, MAX_SHADOW_LIGHTS);
+        // 24-bit depth is stored in 32 bits
+        texture.setBytes((size_t)SIZE * SIZE * MAX_SHADOW_LIGHTS * 4);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+
+    void setupLights(const std::vector<Light>& lights)
+    {
+        shadowLights.clear();
+        std::vector<int> layers = shadowLayers(lights);
+        for (size_t i = 0; i < lights.size(); i++)
+        {
+            if (layers[i] < 0)
+                continue;
+            const Light& l = lights[i];
+            glm::vec3 up = glm::abs(l.direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+            ShadowLight shadow;
+            shadow.viewProjection = glm::perspective(glm::radians(2.0f * l.outerAngle), 1.0f, 0.05f, l.range)
+                * glm::lookAt(l.position, l.position + l.direction, up);
+            shadow.frustum.extract(shadow.viewProjection);
+            shadowLights.push_back(shadow);
+        }
+    }
+
+    void renderLayer(const Shader& depthShader, GLuint texture, int layer, const DrawList& casters, bool isStatic)
+    {
+        const ShadowLight& light = shadowLights[layer];
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, layer);
+        if (isStatic)
+            glClear(GL_DEPTH_BUFFER_BIT);
+        visible.clear();
+        casters.cull(light.frustum, 0.0f, visible, stats);
+        depthShader.setMat4("lightViewProjection", light.viewProjection);
+        casters.draw(depthShader, visible, stats);
+        if (!isStatic && animated)
+        {
+            animatedDepthShader->use();
+            animatedDepthShader->setMat4("lightViewProjection", light.viewProjection);
+            animated->draw(*animatedDepthShader, stats);
+            depthShader.use();
+        }
+    }
+
+    // FNV-1a over the caster transforms: equal hashes mean the dynamic casters did not move
+    static uint64_t hashCasters(const DrawList& casters)
+    {
+        uint64_t hash = 1469598103934665603ull;
+        for (const DrawItem& item : casters.items)
+        {
+            const unsigned char* bytes = (const unsigned char*)&item.model;
+            for (size_t i = 0; i < sizeof(item.model); i++)
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+            hash = (hash ^ item.vao) * 1099511628211ull;
+        }
+        return hash;
+    }
+};
+
+#endif
@@ -0,0 +1,627 @@
+#ifndef softraster_h
+#define softraster_h
+
+#include <glm/glm.hpp>
+
+#include "frustum.h"
+#include "image.h"
+#include "input.h"
+#include "lighting.h"
+#include "materials.h"
+#include "scene.h"
+#include "stats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SOFTRASTER_SSE2 1
+#else
+#define SOFTRASTER_SSE2 0
+#endif
+
+// a mesh in the lit box layout of scene.h (position, normal); materials, when present, give each vertex its slot in
+// the material table as aMaterial does for baked meshes, otherwise the draw's material is used
+struct SoftMesh
+{
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<unsigned int> materials;
+};
+
+// Renders DrawLists on the CPU with the pipeline of vertexShader.vs and fragmentShader.fs: model and view-projection
+// transform, clipping, a LESS depth test and per-pixel lighting with the same lights and materials, without shadows.
+//
+// Triangles are set up in parallel in submission-ordered chunks and binned into TILE_SIZE screen tiles; the tiles are
+// then rasterised in parallel, each by one thread walking its bins in submission order. Coverage uses fixed-point
+// edge functions with a top-left rule, four pixels at a time with SSE2, and BLOCK_SIZE blocks are skipped when the
+// triangle's nearest depth is behind everything already in them. Only the nearest triangle's id is kept per pixel
+// and every pixel is shaded once at the end. No result depends on the thread count or on scheduling, so the image is
+// bit-identical between runs.
+class SoftwareRenderer
+{
+public:
+    static const int TILE_SIZE = 64;
+    static constexpr int BLOCK_SIZE = 8;
+    static const int SUBPIXEL_BITS = 4;
+    // clipping keeps vertices within this many half-viewports of the centre, so fixed-point products fit 64 bits
+    static constexpr float GUARD_BAND = 2.0f;
+
+    void init(int w, int h, int threads)
+    {
+        width = w;
+        height = h;
+        tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+        tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+        depth.assign((size_t)tilesX * tilesY * TILE_SIZE * TILE_SIZE, 1.0f);
+        ids.assign(depth.size(), NO_TRIANGLE);
+        blockDepth.assign((size_t)tilesX * tilesY * BLOCKS_PER_TILE, 1.0f);
+        workerCount = std::max(1, threads);
+        for (int i = 1; i < workerCount; i++)
+            workers.push_back(std::thread(&SoftwareRenderer::workerLoop, this));
+    }
+
+    int threadCount() const { return workerCount; }
+
+    // meshes are looked up by the vao of a draw item
+    void setMesh(unsigned int vao, const SoftMesh& mesh) { meshes[vao] = mesh; }
+    void setMaterials(const std::vector<Material>& table) { materials = table; }
+
+    void setLights(const std::vector<Light>& sceneLights, const glm::vec3& ambientLight)
+    {
+        lights = sceneLights;
+        ambient = ambientLight;
+    }
+
+    void setClearColor(const glm::vec3& color) { clearColor = color; }
+
+    // renders every item of lists into image, top row first like the PPM files of the regression tests
+    void render(const std::vector<const DrawList*>& lists, const glm::mat4& viewProjection, const glm::vec3& eye, RgbImage& image)
+    {
+        uint64_t start = inputClockNow();
+        this->viewProjection = viewProjection;
+        this->eye = eye;
+        Frustum frustum;
+        frustum.extract(viewProjection);
+        items.clear();
+        for (const DrawList* list : lists)
+        {
+            for (const DrawItem& item : list->items)
+            {
+                if (meshes.count(item.vao) && frustum.intersectsAABB(item.boundsMin, item.boundsMax))
+                    items.push_back(&item);
+            }
+        }
+
+        // setup and binning, in chunks of consecutive items so the bins keep submission order
+        int chunkCount = std::max(1, std::min((int)items.size(), std::min(workerCount * 4, MAX_CHUNKS)));
+        chunks.resize(chunkCount);
+        parallelFor(chunkCount, [this, chunkCount](int c) {
+            Chunk& chunk = chunks[c];
+            chunk.triangles.clear();
+            chunk.bins.resize((size_t)tilesX * tilesY);
+            for (std::vector<uint32_t>& bin : chunk.bins)
+                bin.clear();
+            size_t first = items.size() * c / chunkCount;
+            size_t last = items.size() * (c + 1) / chunkCount;
+            for (size_t i = first; i < last; i++)
+                setupItem(*items[i], chunk);
+        });
+        uint64_t binned = inputClockNow();
+
+        image.resize(width, height);
+        output = &image;
+        parallelFor(tilesX * tilesY, [this](int tile) { rasterTile(tile); });
+        uint64_t done = inputClockNow();
+
+        setupMs.add((double)(binned - start) / 1.0e6);
+        rasterMs.add((double)(done - binned) / 1.0e6);
+        triangleCount = 0;
+        for (const Chunk& chunk : chunks)
+            triangleCount += chunk.triangles.size();
+    }
+
+    void report(std::ostream& out)
+    {
+        out << std::fixed << std::setprecision(3) << "software renderer: " << width << "x" << height << " on " << workerCount
+            << " threads, " << triangleCount << " triangles, setup and binning median " << setupMs.percentile(50.0)
+            << " ms, raster and shading median " << rasterMs.percentile(50.0) << " ms"
+            << (SOFTRASTER_SSE2 ? " (sse2)" : " (scalar)") << std::endl;
+    }
+
+    void shutdown()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quitting = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+        workers.clear();
+    }
+
+private:
+    static constexpr uint32_t NO_TRIANGLE = 0xffffffffu;
+    static const int BLOCKS_PER_SIDE = TILE_SIZE / BLOCK_SIZE;
+    static const int BLOCKS_PER_TILE = BLOCKS_PER_SIDE * BLOCKS_PER_SIDE;
+    static const int SUBPIXEL = 1 << SUBPIXEL_BITS;
+    static constexpr int MAX_CHUNKS = 256;     // the chunk is the top byte of a pixel's triangle id
+
+    struct ClipVertex
+    {
+        glm::vec4 clip;
+        glm::vec3 world;
+        glm::vec3 normal;
+    };
+
+    // E(x, y) = a * x + b * y + c in subpixels is >= 0 inside, with the top-left rule folded into c
+    struct Edge
+    {
+        int64_t a, b, c;
+    };
+
+    struct Triangle
+    {
+        Edge edges[3];          // edge k is opposite vertex k
+        int64_t area;           // sum of the three edge functions anywhere
+        int minX, minY, maxX, maxY;     // covered pixels, inclusive
+        float z0, dzdx, dzdy;   // window depth at pixel (x, y) centre: z0 + dzdy * y + dzdx * x
+        float minZ;
+        glm::vec3 invW;
+        glm::vec3 world[3];     // divided by w
+        glm::vec3 normal[3];    // divided by w
+        unsigned int material;
+    };
+
+    struct Chunk
+    {
+        std::vector<Triangle> triangles;
+        std::vector<std::vector<uint32_t>> bins;    // per tile, indices into triangles
+    };
+
+    int width = 0, height = 0;
+    int tilesX = 0, tilesY = 0;
+    std::map<unsigned int, SoftMesh> meshes;
+    std::vector<Material> materials;
+    std::vector<Light> lights;
+    glm::vec3 ambient = glm::vec3(0.25f);
+    glm::vec3 clearColor = glm::vec3(0.2f, 0.3f, 0.3f);
+    glm::mat4 viewProjection;
+    glm::vec3 eye;
+
+    std::vector<const DrawItem*> items;
+    std::vector<Chunk> chunks;
+    std::vector<float> depth;           // tile-major, TILE_SIZE rows per tile
+    std::vector<uint32_t> ids;          // chunk index << 24 | triangle index
+    std::vector<float> blockDepth;      // farthest depth in each block
+    RgbImage* output = NULL;
+
+    SampleSeries setupMs{ SampleSeries::ALL }, rasterMs{ SampleSeries::ALL };
+    size_t triangleCount = 0;
+
+    // thread pool: parallelFor hands out indices to the workers and the calling thread
+    int workerCount = 1;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, finished;
+    std::function<void(int)> job;
+    int jobSize = 0;
+    std::atomic<int> nextIndex{0};
+    int busy = 0;
+    unsigned int generation = 0;
+    bool quitting = false;
+
+    void parallelFor(int count, const std::function<void(int)>& body)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = body;
+            jobSize = count;
+            nextIndex = 0;
+            busy = (int)workers.size();
+            generation++;
+        }
+        wake.notify_all();
+        for (int i = nextIndex++; i < count; i = nextIndex++)
+            body(i);
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this] { return busy == 0; });
+    }
+
+    void workerLoop()
+    {
+        unsigned int seen = 0;
+        for (;;)
+        {
+            std::function<void(int)> body;
+            int count;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this, seen] { return quitting || generation != seen; });
+                if (quitting)
+                    return;
+                seen = generation;
+                body = job;
+                count = jobSize;
+            }
+            for (int i = nextIndex++; i < count; i = nextIndex++)
+                body(i);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busy == 0)
+                finished.notify_one();
+        }
+    }
+
+    // vertex stage, clipping and triangle setup of one draw
+    void setupItem(const DrawItem& item, Chunk& chunk)
+    {
+        const SoftMesh& mesh = meshes.find(item.vao)->second;
+        glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(item.model)));
+        size_t vertexCount = mesh.vertices.size() / BOX_VERTEX_FLOATS;
+        std::vector<ClipVertex> transformed(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            const float* src = &mesh.vertices[v * BOX_VERTEX_FLOATS];
+            glm::vec4 world = item.model * glm::vec4(src[0], src[1], src[2], 1.0f);
+            transformed[v].world = glm::vec3(world);
+            transformed[v].clip = viewProjection * world;
+            transformed[v].normal = normalMatrix * glm::vec3(src[3], src[4], src[5]);
+        }
+        size_t indexCount = std::min(mesh.indices.size(), (size_t)item.indexCount);
+        for (size_t i = 0; i + 2 < indexCount; i += 3)
+        {
+            unsigned int last = mesh.indices[i + 2];
+            // the last vertex provokes the flat material, as in GL
+            unsigned int material = mesh.materials.empty() ? item.material : mesh.materials[last];
+            ClipVertex polygon[9] = { transformed[mesh.indices[i]], transformed[mesh.indices[i + 1]], transformed[last] };
+            int count = clip(polygon, 3);
+            for (int k = 1; k + 1 < count; k++)
+                setupTriangle(polygon[0], polygon[k], polygon[k + 1], material, chunk);
+        }
+    }
+
+    // Sutherland-Hodgman against near, far and the guard band; polygon has room for the worst case of nine vertices
+    static int clip(ClipVertex* polygon, int count)
+    {
+        for (int plane = 0; plane < 6 && count > 0; plane++)
+        {
+            ClipVertex input[9];
+            std::copy(polygon, polygon + count, input);
+            int outCount = 0;
+            for (int k = 0; k < count; k++)
+            {
+                const ClipVertex& a = input[k];
+                const ClipVertex& b = input[(k + 1) % count];
+                float da = distance(a.clip, plane), db = distance(b.clip, plane);
+                if (da >= 0.0f)
+                    polygon[outCount++] = a;
+                if ((da >= 0.0f) != (db >= 0.0f))
+                {
+                    float t = da / (da - db);
+                    ClipVertex& v = polygon[outCount++];
+                    v.clip = a.clip + (b.clip - a.clip) * t;
+                    v.world = a.world + (b.world - a.world) * t;
+                    v.normal = a.normal + (b.normal - a.normal) * t;
+                }
+            }
+            count = outCount;
+        }
+        return count;
+    }
+
+    static float distance(const glm::vec4& c, int plane)
+    {
+        switch (plane)
+        {
+        case 0: return c.w + c.z;
+        case 1: return c.w - c.z;
+        case 2: return GUARD_BAND * c.w + c.x;
+        case 3: return GUARD_BAND * c.w - c.x;
+        case 4: return GUARD_BAND * c.w + c.y;
+        default: return GUARD_BAND * c.w - c.y;
+        }
+    }
+
+    void setupTriangle(const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2, unsigned int material, Chunk& chunk)
+    {
+        const ClipVertex* v[3] = { &v0, &v1, &v2 };
+        int64_t x[3], y[3];
+        float z[3], invW[3];
+        for (int k = 0; k < 3; k++)
+        {
+            invW[k] = 1.0f / v[k]->clip.w;
+            x[k] = (int64_t)std::floor((v[k]->clip.x * invW[k] * 0.5f + 0.5f) * width * SUBPIXEL + 0.5f);
+            y[k] = (int64_t)std::floor((v[k]->clip.y * invW[k] * 0.5f + 0.5f) * height * SUBPIXEL + 0.5f);
+            z[k] = v[k]->clip.z * invW[k] * 0.5f + 0.5f;
+        }
+        int64_t area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+        if (area == 0)
+            return;
+        // no face culling, as in the GL pipeline: back faces are flipped to the positive orientation
+        int order[3] = { 0, 1, 2 };
+        if (area < 0)
+        {
+            std::swap(order[1], order[2]);
+            area = -area;
+        }
+
+        Triangle t;
+        t.area = area;
+        t.material = material;
+        for (int k = 0; k < 3; k++)
+        {
+            int a = order[(k + 1) % 3], b = order[(k + 2) % 3];
+            Edge& e = t.edges[k];
+            e.a = y[a] - y[b];
+            e.b = x[b] - x[a];
+            e.c = -(e.a * x[a] + e.b * y[a]);
+            // top-left rule: pixels exactly on an edge belong to the triangle on its left or top
+            int64_t dy = y[b] - y[a], dx = x[b] - x[a];
+            if (!(dy < 0 || (dy == 0 && dx < 0)))
+                e.c -= 1;
+            int o = order[k];
+            t.invW[k] = invW[o];
+            t.world[k] = v[o]->world * invW[o];
+            t.normal[k] = v[o]->normal * invW[o];
+        }
+
+        int64_t minX = std::min(x[0], std::min(x[1], x[2])), maxX = std::max(x[0], std::max(x[1], x[2]));
+        int64_t minY = std::min(y[0], std::min(y[1], y[2])), maxY = std::max(y[0], std::max(y[1], y[2]));
+        // pixel centres are at (i + 0.5) * SUBPIXEL
+        t.minX = std::max(0, (int)((minX - SUBPIXEL / 2 + SUBPIXEL - 1) >> SUBPIXEL_BITS));
+        t.minY = std::max(0, (int)((minY - SUBPIXEL / 2 + SUBPIXEL - 1) >> SUBPIXEL_BITS));
+        t.maxX = std::min(width - 1, (int)((maxX - SUBPIXEL / 2) >> SUBPIXEL_BITS));
+        t.maxY = std::min(height - 1, (int)((maxY - SUBPIXEL / 2) >> SUBPIXEL_BITS));
+        if (t.minX > t.maxX || t.minY > t.maxY)
+            return;
+
+        // depth plane in pixel units through the snapped vertices
+        float fx[3], fy[3], fz[3];
+        for (int k = 0; k < 3; k++)
+        {
+            fx[k] = (float)x[order[k]] / SUBPIXEL;
+            fy[k] = (float)y[order[k]] / SUBPIXEL;
+            fz[k] = z[order[k]];
+        }
+        float det = (float)area / (SUBPIXEL * SUBPIXEL);
+        t.dzdx = ((fz[1] - fz[0]) * (fy[2] - fy[0]) - (fz[2] - fz[0]) * (fy[1] - fy[0])) / det;
+        t.dzdy = ((fz[2] - fz[0]) * (fx[1] - fx[0]) - (fz[1] - fz[0]) * (fx[2] - fx[0])) / det;
+        t.z0 = fz[0] - t.dzdx * fx[0] - t.dzdy * fy[0];
+        t.minZ = std::min(fz[0], std::min(fz[1], fz[2]));
+
+        uint32_t index = (uint32_t)chunk.triangles.size();
+        chunk.triangles.push_back(t);
+        for (int ty = t.minY / TILE_SIZE; ty <= t.maxY / TILE_SIZE; ty++)
+        {
+            for (int tx = t.minX / TILE_SIZE; tx <= t.maxX / TILE_SIZE; tx++)
+                chunk.bins[ty * tilesX + tx].push_back(index);
+        }
+    }
+
+    static int64_t evaluate(const Edge& e, int x, int y)
+    {
+        return e.a * (x * SUBPIXEL + SUBPIXEL / 2) + e.b * (y * SUBPIXEL + SUBPIXEL / 2) + e.c;
+    }
+
+    void rasterTile(int tile)
+    {
+        int tileX = (tile % tilesX) * TILE_SIZE;
+        int tileY = (tile / tilesX) * TILE_SIZE;
+        float* tileDepth = &depth[(size_t)tile * TILE_SIZE * TILE_SIZE];
+        uint32_t* tileIds = &ids[(size_t)tile * TILE_SIZE * TILE_SIZE];
+        float* blocks = &blockDepth[(size_t)tile * BLOCKS_PER_TILE];
+        std::fill(tileDepth, tileDepth + TILE_SIZE * TILE_SIZE, 1.0f);
+        std::fill(tileIds, tileIds + TILE_SIZE * TILE_SIZE, NO_TRIANGLE);
+        std::fill(blocks, blocks + BLOCKS_PER_TILE, 1.0f);
+
+        for (size_t c = 0; c < chunks.size(); c++)
+        {
+            for (uint32_t index : chunks[c].bins[tile])
+                rasterTriangle(chunks[c].triangles[index], (uint32_t)c << 24 | index, tileX, tileY, tileDepth, tileIds, blocks);
+        }
+        shadeTile(tileX, tileY, tileIds);
+    }
+
+    void rasterTriangle(const Triangle& t, uint32_t id, int tileX, int tileY, float* tileDepth, uint32_t* tileIds, float* blocks)
+    {
+        int x0 = std::max(t.minX, tileX), x1 = std::min(t.maxX, std::min(tileX + TILE_SIZE, width) - 1);
+        int y0 = std::max(t.minY, tileY), y1 = std::min(t.maxY, std::min(tileY + TILE_SIZE, height) - 1);
+        for (int by = (y0 - tileY) / BLOCK_SIZE; by <= (y1 - tileY) / BLOCK_SIZE; by++)
+        {
+            for (int bx = (x0 - tileX) / BLOCK_SIZE; bx <= (x1 - tileX) / BLOCK_SIZE; bx++)
+            {
+                float& blockFar = blocks[by * BLOCKS_PER_SIDE + bx];
+                // hierarchical depth: nothing of the triangle can be nearer than what the block already holds
+                if (t.minZ >= blockFar)
+                    continue;
+                int px0 = tileX + bx * BLOCK_SIZE, py0 = tileY + by * BLOCK_SIZE;
+                if (outsideBlock(t, px0, py0))
+                    continue;
+                if (rasterBlock(t, id, px0, py0, tileX, tileY, tileDepth, tileIds))
+                {
+                    float farthest = 0.0f;
+                    for (int row = 0; row < BLOCK_SIZE; row++)
+                    {
+                        const float* d = &tileDepth[(py0 - tileY + row) * TILE_SIZE + px0 - tileX];
+                        for (int col = 0; col < BLOCK_SIZE; col++)
+                            farthest = std::max(farthest, d[col]);
+                    }
+                    blockFar = farthest;
+                }
+            }
+        }
+    }
+
+    // true when one edge has all four block corners outside
+    static bool outsideBlock(const Triangle& t, int px0, int py0)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            const Edge& e = t.edges[k];
+            int64_t corner = evaluate(e, e.a >= 0 ? px0 + BLOCK_SIZE - 1 : px0, e.b >= 0 ? py0 + BLOCK_SIZE - 1 : py0);
+            if (corner < 0)
+                return true;
+        }
+        return false;
+    }
+
+    // clamped so eight steps of at most 2^21 cannot change the sign
+    static int32_t narrow(int64_t e)
+    {
+        const int64_t limit = (int64_t)1 << 30;
+        return (int32_t)std::max(-limit, std::min(limit, e));
+    }
+
+    // depth test and id write of one block; returns whether any pixel was written
+    bool rasterBlock(const Triangle& t, uint32_t id, int px0, int py0, int tileX, int tileY, float* tileDepth, uint32_t* tileIds)
+    {
+        bool wrote = false;
+        int32_t step[3];
+        for (int k = 0; k < 3; k++)
+            step[k] = (int32_t)(t.edges[k].a * SUBPIXEL);
+        int columns = std::min(BLOCK_SIZE, width - px0);
+        int rows = std::min(BLOCK_SIZE, height - py0);
+        for (int row = 0; row < rows; row++)
+        {
+            int y = py0 + row;
+            int32_t e[3];
+            for (int k = 0; k < 3; k++)
+                e[k] = narrow(evaluate(t.edges[k], px0, y));
+            float zRow = t.z0 + t.dzdy * ((float)y + 0.5f);
+            float* d = &tileDepth[(y - tileY) * TILE_SIZE + px0 - tileX];
+            uint32_t* ids = &tileIds[(y - tileY) * TILE_SIZE + px0 - tileX];
+            int col = 0;
+#if SOFTRASTER_SSE2
+            const __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+            __m128i edge[3], edgeStep[3];
+            for (int k = 0; k < 3; k++)
+            {
+                edge[k] = _mm_add_epi32(_mm_set1_epi32(e[k]), _mm_setr_epi32(0, step[k], step[k] * 2, step[k] * 3));
+                edgeStep[k] = _mm_set1_epi32(step[k] * 4);
+            }
+            const __m128i idVector = _mm_set1_epi32((int)id);
+            for (; col + 4 <= columns; col += 4)
+            {
+                // inside when no edge function is negative
+                __m128i inside = _mm_cmpgt_epi32(_mm_or_si128(_mm_or_si128(edge[0], edge[1]), edge[2]), _mm_set1_epi32(-1));
+                __m128 x = _mm_add_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(px0 + col), lane)), _mm_set1_ps(0.5f));
+                __m128 z = _mm_add_ps(_mm_set1_ps(zRow), _mm_mul_ps(_mm_set1_ps(t.dzdx), x));
+                __m128 stored = _mm_loadu_ps(d + col);
+                __m128i pass = _mm_and_si128(inside, _mm_castps_si128(_mm_cmplt_ps(z, stored)));
+                if (_mm_movemask_epi8(pass))
+                {
+                    __m128 mask = _mm_castsi128_ps(pass);
+                    _mm_storeu_ps(d + col, _mm_or_ps(_mm_and_ps(mask, z), _mm_andnot_ps(mask, stored)));
+                    __m128i storedIds = _mm_loadu_si128((const __m128i*)(ids + col));
+                    _mm_storeu_si128((__m128i*)(ids + col), _mm_or_si128(_mm_and_si128(pass, idVector), _mm_andnot_si128(pass, storedIds)));
+                    wrote = true;
+                }
+                for (int k = 0; k < 3; k++)
+                    edge[k] = _mm_add_epi32(edge[k], edgeStep[k]);
+            }
+            for (int k = 0; k < 3; k++)
+                e[k] += step[k] * col;
+#endif
+            for (; col < columns; col++)
+            {
+                if ((e[0] | e[1] | e[2]) >= 0)
+                {
+                    float z = zRow + t.dzdx * ((float)(px0 + col) + 0.5f);
+                    if (z < d[col])
+                    {
+                        d[col] = z;
+                        ids[col] = id;
+                        wrote = true;
+                    }
+                }
+                for (int k = 0; k < 3; k++)
+                    e[k] += step[k];
+            }
+        }
+        return wrote;
+    }
+
+    void shadeTile(int tileX, int tileY, const uint32_t* tileIds)
+    {
+        unsigned char background[3];
+        toBytes(clearColor, background);
+        for (int y = tileY; y < std::min(tileY + TILE_SIZE, height); y++)
+        {
+            for (int x = tileX; x < std::min(tileX + TILE_SIZE, width); x++)
+            {
+                uint32_t id = tileIds[(y - tileY) * TILE_SIZE + x - tileX];
+                unsigned char* pixel = output->at(x, height - 1 - y);
+                if (id == NO_TRIANGLE)
+                {
+                    std::copy(background, background + 3, pixel);
+                    continue;
+                }
+                const Triangle& t = chunks[id >> 24].triangles[id & 0xffffff];
+                toBytes(shade(t, x, y), pixel);
+            }
+        }
+    }
+
+    // perspective-correct attributes from the exact edge functions, then the lighting of fragmentShader.fs
+    glm::vec3 shade(const Triangle& t, int x, int y) const
+    {
+        float b[3];
+        float weight = 0.0f;
+        for (int k = 0; k < 3; k++)
+        {
+            b[k] = (float)((double)evaluate(t.edges[k], x, y) / (double)t.area) * t.invW[k];
+            weight += b[k];
+        }
+        glm::vec3 worldPos = (t.world[0] * b[0] + t.world[1] * b[1] + t.world[2] * b[2]) / weight;
+        glm::vec3 N = glm::normalize(t.normal[0] * b[0] + t.normal[1] * b[1] + t.normal[2] * b[2]);
+        glm::vec3 V = glm::normalize(eye - worldPos);
+        const Material& surface = materials[std::min<size_t>(t.material, materials.size() - 1)];
+        glm::vec3 albedo = glm::vec3(surface.baseColor);
+        float roughness4 = std::pow(std::max(surface.roughness, 0.05f), 4.0f);
+        float shininess = 2.0f / roughness4 - 2.0f;
+        glm::vec3 lit = ambient * albedo;
+        for (const Light& light : lights)
+        {
+            glm::vec3 L = light.position - worldPos;
+            float lightDistance = glm::length(L);
+            if (lightDistance >= light.range)
+                continue;
+            L /= lightDistance;
+            float window = glm::clamp(1.0f - std::pow(lightDistance / light.range, 4.0f), 0.0f, 1.0f);
+            float attenuation = window * window / (lightDistance * lightDistance + 1.0f);
+            float cone = 1.0f;
+            if (light.type == SPOT_LIGHT)
+            {
+                float cosOuter = std::cos(glm::radians(light.outerAngle)), cosInner = std::cos(glm::radians(light.innerAngle));
+                float t = glm::clamp((glm::dot(-L, light.direction) - cosOuter) / (cosInner - cosOuter), 0.0f, 1.0f);
+                cone = t * t * (3.0f - 2.0f * t);
+            }
+            float diffuse = std::max(glm::dot(N, L), 0.0f);
+            float specular = diffuse > 0.0f ? std::pow(std::max(glm::dot(N, glm::normalize(L + V)), 0.0f), shininess) * surface.specular : 0.0f;
+            lit += light.color * light.intensity * (albedo * diffuse + specular) * attenuation * cone;
+        }
+        return lit;
+    }
+
+    // unorm conversion as the framebuffer does it
+    static void toBytes(const glm::vec3& color, unsigned char* rgb)
+    {
+        for (int c = 0; c < 3; c++)
+            rgb[c] = (unsigned char)(glm::clamp(color[c], 0.0f, 1.0f) * 255.0f + 0.5f);
+    }
+};
+
+#endif
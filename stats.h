@@ -0,0 +1,126 @@
+#ifndef stats_h
+#define stats_h
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+// Collects scalar samples (usually milliseconds) and reports their distribution. Live series are fed every frame of
+// sessions that run for days, so by default they keep bounded memory: count, mean, minimum and maximum are exact, and
+// percentiles come from a uniform reservoir of at most RESERVOIR samples (Vitter's algorithm R), exact until it fills
+// and an estimate after, which report() says. The reservoir is allocated by the first sample, so adding never
+// allocates after that. A series over a run of known length (a replay, a benchmark) is made with ALL and keeps every
+// sample, so its percentiles are always exact.
+class SampleSeries
+{
+public:
+    static constexpr size_t RESERVOIR = 2048;
+    static constexpr size_t ALL = SIZE_MAX;
+
+    SampleSeries() {}
+    explicit SampleSeries(size_t limit) : limit(limit) {}
+
+    void add(double value)
+    {
+        if (samples.capacity() < std::min(limit, RESERVOIR))
+            samples.reserve(std::min(limit, RESERVOIR));
+        seen++;
+        sum += value;
+        lowest = std::min(lowest, value);
+        highest = std::max(highest, value);
+        if (samples.size() < limit)
+        {
+            samples.push_back(value);
+            sorted = false;
+            return;
+        }
+        // keep the new sample with probability limit / seen, in place of a random one
+        uint64_t slot = nextRandom() % seen;
+        if (slot < limit)
+        {
+            samples[(size_t)slot] = value;
+            sorted = false;
+        }
+    }
+
+    void clear()
+    {
+        samples.clear();
+        sorted = true;
+        seen = 0;
+        sum = 0.0;
+        lowest = std::numeric_limits<double>::infinity();
+        highest = -std::numeric_limits<double>::infinity();
+    }
+
+    // every sample added, not only the ones kept
+    size_t count() const { return (size_t)seen; }
+
+    // false once the reservoir has dropped samples, when percentiles are estimates
+    bool exact() const { return seen == samples.size(); }
+
+    // nearest-rank percentile, p in [0, 100]
+    double percentile(double p)
+    {
+        if (samples.empty())
+            return 0.0;
+        sort();
+        size_t rank = (size_t)(p / 100.0 * (double)(samples.size() - 1) + 0.5);
+        return samples[std::min(rank, samples.size() - 1)];
+    }
+
+    double mean() const { return seen ? sum / (double)seen : 0.0; }
+
+    double min() const { return seen ? lowest : 0.0; }
+
+    double max() const { return seen ? highest : 0.0; }
+
+    void report(std::ostream& out, const std::string& name, const std::string& unit = "ms")
+    {
+        out << std::fixed << std::setprecision(3)
+            << name << ": n=" << count()
+            << " mean=" << mean()
+            << " p50=" << percentile(50.0)
+            << " p95=" << percentile(95.0)
+            << " p99=" << percentile(99.0)
+            << " max=" << max() << " " << unit;
+        if (!exact())
+            out << ", percentiles estimated from " << samples.size() << " samples";
+        out << std::endl;
+    }
+
+private:
+    size_t limit = RESERVOIR;
+    std::vector<double> samples;
+    bool sorted = true;
+    uint64_t seen = 0;
+    double sum = 0.0;
+    double lowest = std::numeric_limits<double>::infinity();
+    double highest = -std::numeric_limits<double>::infinity();
+    uint64_t random = 0x9e3779b97f4a7c15ull;
+
+    // xorshift64*, deterministic so that replays report the same percentiles
+    uint64_t nextRandom()
+    {
+        random ^= random >> 12;
+        random ^= random << 25;
+        random ^= random >> 27;
+        return random * 0x2545f4914f6cdd1dull;
+    }
+
+    void sort()
+    {
+        if (!sorted)
+        {
+            std::sort(samples.begin(), samples.end());
+            sorted = true;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,369 @@
+#ifndef streaming_h
+#define streaming_h
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "assets.h"
+#include "gpu_driven.h"
+#include "gpu_resources.h"
+#include "portals.h"
+#include "scene.h"
+#include "stats.h"
+
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// fills the static draws of one cell; runs on a worker thread, so it must not touch GL or shared state
+typedef std::function<void(int cell, DrawList& scene)> CellBuilder;
+
+// Streams the cells of a CellGraph in and out under CPU and GPU byte budgets. A streamed cell is built on a worker,
+// baked into one mesh (a CPU copy), uploaded on the upload context and drawn with a single call once resident. Cells
+// are requested when they are visible, or close to the camera or to where its velocity takes it within
+// PREFETCH_SECONDS; when a budget is exceeded the least recently needed cells are evicted, the GPU copy first and the
+// CPU copy after it. Nothing here waits: a visible cell that is not resident yet is simply not drawn, and the time
+// that happens is reported as stall time.
+class RoomStreamer
+{
+public:
+    static constexpr float PREFETCH_SECONDS = 1.5f;
+    static constexpr float LOAD_DISTANCE = 4.0f;    // cells nearer than this to the camera or its predicted position
+    static constexpr float MAX_SPEED = 20.0f;       // faster camera moves are jumps, not motion to extrapolate
+    static const int MAX_IN_FLIGHT = 2;
+
+    // cells below firstStreamed are built by the caller and stay in the CellGraph's own draw lists
+    void init(AssetPipeline& assets, CellGraph& building, CellBuilder builder, const float* boxVertices, const GLuint* boxIndices, int firstStreamed)
+    {
+        this->assets = &assets;
+        this->building = &building;
+        this->builder = builder;
+        this->boxVertices = boxVertices;
+        this->boxIndices = boxIndices;
+        this->firstStreamed = firstStreamed;
+        rooms = std::vector<Room>(building.cellCount());
+        for (size_t c = 0; c < rooms.size(); c++)
+        {
+            rooms[c].boundsMin = building.cell((int)c).boundsMin;
+            rooms[c].boundsMax = building.cell((int)c).boundsMax;
+        }
+    }
+
+    // 0 means unlimited
+    void setBudgets(size_t cpuBytes, size_t gpuBytes)
+    {
+        cpuBudget = cpuBytes;
+        gpuBudget = gpuBytes;
+    }
+
+    // call after CellGraph::cull: requests the cells the camera needs and evicts the ones it no longer does
+    void update(const glm::vec3& eye, float deltaTime)
+    {
+        frame++;
+        if (frame > 1 && deltaTime > 0.0f)
+        {
+            glm::vec3 step = (eye - lastEye) / deltaTime;
+            if (glm::length(step) < MAX_SPEED)
+                velocity = velocity + (step - velocity) * 0.2f;
+        }
+        lastEye = eye;
+        glm::vec3 predicted = eye + velocity * PREFETCH_SECONDS;
+
+        bool stalled = false;
+        candidates.clear();
+        for (int c = firstStreamed; c < (int)rooms.size(); c++)
+        {
+            Room& room = rooms[c];
+            bool visible = building->visibleFrustum(c) != NULL;
+            float distance = std::min(distanceTo(room, eye), distanceTo(room, predicted));
+            if (!visible && distance > LOAD_DISTANCE)
+                continue;
+            room.lastNeeded = frame;
+            if (visible && !room.resident)
+            {
+                stalled = true;
+                if (!room.missingSince)
+                    room.missingSince = inputClockNow();
+            }
+            if (!room.resident && !room.loading)
+                candidates.push_back({ visible ? -1.0f : distanceTo(room, predicted), c });
+        }
+        if (stalled)
+        {
+            stallFrames++;
+            stallMs += deltaTime * 1000.0;
+        }
+        // visible cells first, then the nearest to where the camera is heading
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.priority < b.priority; });
+        for (const Candidate& candidate : candidates)
+        {
+            if (inFlight >= MAX_IN_FLIGHT)
+                break;
+            load(candidate.cell);
+        }
+        evict();
+        residentSamples.add((double)residentCount);
+    }
+
+    // starts loading every cell, for runs that must be reproducible from the first frame; the first update() then
+    // evicts down to the budgets, keeping the cells it needs
+    void prefetchAll()
+    {
+        for (int c = firstStreamed; c < (int)rooms.size(); c++)
+        {
+            if (!rooms[c].loading && !rooms[c].resident)
+                load(c);
+        }
+    }
+
+    // draws the resident cells the portals let the camera see, with a program built on vertexShader.vs
+    void draw(const Shader& shader, RenderStats& stats) const
+    {
+        bool first = true;
+        for (int c = firstStreamed; c < (int)rooms.size(); c++)
+        {
+            const Room& room = rooms[c];
+            const Frustum* frustum = building->visibleFrustum(c);
+            if (!frustum || !room.resident)
+                continue;
+            stats.submitted++;
+            if (!frustum->intersectsAABB(room.meshMin, room.meshMax))
+            {
+                stats.culled++;
+                continue;
+            }
+            if (first)
+            {
+                // the baked vertices are in world space and carry their own materials
+                shader.setMat4("model", glm::mat4(1.0f));
+                shader.setInt("materialIndex", -1);
+                shader.setInt("occlusionRecord", -1);
+                first = false;
+            }
+            glBindVertexArray(room.vao);
+            glDrawElements(GL_TRIANGLES, room.indexCount, GL_UNSIGNED_INT, 0);
+            stats.drawCalls++;
+            stats.triangles += room.indexCount / 3;
+        }
+    }
+
+    void report(std::ostream& out)
+    {
+        out << std::fixed << std::setprecision(2) << "room streaming: " << residentCount << "/" << rooms.size() - firstStreamed
+            << " cells resident, cpu " << megabytes(cpuBytes) << " MB (peak " << megabytes(cpuPeak) << ")";
+        if (cpuBudget)
+            out << " of " << megabytes(cpuBudget);
+        out << ", gpu " << megabytes(gpuBytes) << " MB (peak " << megabytes(gpuPeak) << ")";
+        if (gpuBudget)
+            out << " of " << megabytes(gpuBudget);
+        out << std::endl << "  " << builds << " builds, " << uploads << " uploads, " << gpuEvictions << " gpu and "
+            << cpuEvictions << " cpu evictions, stalled " << stallFrames << " frames (" << stallMs << " ms)" << std::endl;
+        residentSamples.report(out, "resident cells", "per frame");
+        loadLatency.report(out, "visible to resident");
+    }
+
+    void destroy()
+    {
+        for (Room& room : rooms)
+            releaseGpu(room);
+    }
+
+private:
+    struct Room
+    {
+        glm::vec3 boundsMin, boundsMax;     // of the cell, for prefetching
+        glm::vec3 meshMin, meshMax;         // of the baked geometry, for culling
+        MeshBuilder mesh;                   // CPU copy while decoded
+        bool decoded = false;
+        bool resident = false;
+        bool loading = false;
+        size_t cpuBytes = 0;
+        size_t gpuBytes = 0;
+        GpuBuffer vbo, materialBuffer, occlusionBuffer, ebo;
+        GpuVertexArray vao;
+        GLsizei indexCount = 0;
+        unsigned int lastNeeded = 0;
+        uint64_t missingSince = 0;          // first frame it was visible without being resident
+    };
+
+    struct Candidate
+    {
+        float priority;
+        int cell;
+    };
+
+    AssetPipeline* assets = NULL;
+    CellGraph* building = NULL;
+    CellBuilder builder;
+    const float* boxVertices = NULL;
+    const GLuint* boxIndices = NULL;
+    int firstStreamed = 0;
+    std::vector<Room> rooms;
+    std::vector<Candidate> candidates;
+    AssetGroup group;
+    int inFlight = 0;
+    unsigned int frame = 0;
+    glm::vec3 lastEye = glm::vec3(0.0f);
+    glm::vec3 velocity = glm::vec3(0.0f);
+
+    size_t cpuBudget = 0, gpuBudget = 0;
+    size_t cpuBytes = 0, gpuBytes = 0;
+    size_t cpuPeak = 0, gpuPeak = 0;
+    int residentCount = 0;
+    unsigned int builds = 0, uploads = 0, gpuEvictions = 0, cpuEvictions = 0, stallFrames = 0;
+    double stallMs = 0.0;
+    SampleSeries residentSamples;
+    SampleSeries loadLatency;
+
+    static double megabytes(size_t bytes) { return (double)bytes / (1024.0 * 1024.0); }
+
+    static float distanceTo(const Room& room, const glm::vec3& p)
+    {
+        return glm::length(glm::max(glm::max(room.boundsMin - p, p - room.boundsMax), glm::vec3(0.0f)));
+    }
+
+    static size_t meshBytes(const MeshBuilder& mesh)
+    {
+        return mesh.vertices.size() * sizeof(float) + (mesh.materials.size() + mesh.occlusion.size() + mesh.indices.size()) * sizeof(GLuint);
+    }
+
+    void load(int c)
+    {
+        rooms[c].loading = true;
+        inFlight++;
+        loadRoom(c);
+    }
+
+    // builds the cell unless its CPU copy survived, uploads it and creates its vertex array on the main context
+    AssetTask loadRoom(int c)
+    {
+        Room& room = rooms[c];
+        assets->started(group);
+        if (!room.decoded)
+        {
+            co_await assets->onWorker();
+            DrawList scene;
+            builder(c, scene);
+            MeshBuilder mesh;
+            for (const DrawItem& item : scene.items)
+                mesh.addBox(boxVertices, boxIndices, item.model, item.material, item.occlusion);
+            co_await assets->onMainThread();
+            room.mesh = std::move(mesh);
+            room.meshMin = room.mesh.boundsMin;
+            room.meshMax = room.mesh.boundsMax;
+            room.cpuBytes = meshBytes(room.mesh);
+            room.decoded = true;
+            cpuBytes += room.cpuBytes;
+            cpuPeak = std::max(cpuPeak, cpuBytes);
+            builds++;
+        }
+        // the CPU copy cannot be evicted while loading is set, so the upload context may read it
+        co_await assets->onUploadContext();
+        room.vbo.create("rooms", "room vertices");
+        room.materialBuffer.create("rooms", "room materials");
+        room.occlusionBuffer.create("rooms", "room occlusion");
+        room.ebo.create("rooms", "room indices");
+        room.vbo.data(GL_ARRAY_BUFFER, room.mesh.vertices.size() * sizeof(float), room.mesh.vertices.data(), GL_STATIC_DRAW);
+        room.materialBuffer.data(GL_ARRAY_BUFFER, room.mesh.materials.size() * sizeof(GLuint), room.mesh.materials.data(), GL_STATIC_DRAW);
+        room.occlusionBuffer.data(GL_ARRAY_BUFFER, room.mesh.occlusion.size() * sizeof(GLuint), room.mesh.occlusion.data(), GL_STATIC_DRAW);
+        room.ebo.data(GL_COPY_WRITE_BUFFER, room.mesh.indices.size() * sizeof(GLuint), room.mesh.indices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        co_await assets->uploaded();
+        room.vao.create("rooms", "room");
+        glBindVertexArray(room.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, room.vbo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, room.ebo);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, BOX_VERTEX_STRIDE, (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, BOX_VERTEX_STRIDE, (void*)BOX_NORMAL_OFFSET);
+        glEnableVertexAttribArray(2);
+        glBindBuffer(GL_ARRAY_BUFFER, room.materialBuffer);
+        glVertexAttribIPointer(MATERIAL_ATTRIBUTE, 1, GL_UNSIGNED_INT, 0, (void*)0);
+        glEnableVertexAttribArray(MATERIAL_ATTRIBUTE);
+        glBindBuffer(GL_ARRAY_BUFFER, room.occlusionBuffer);
+        glVertexAttribIPointer(OCCLUSION_ATTRIBUTE, 1, GL_UNSIGNED_INT, 0, (void*)0);
+        glEnableVertexAttribArray(OCCLUSION_ATTRIBUTE);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        room.indexCount = (GLsizei)room.mesh.indices.size();
+        room.gpuBytes = room.cpuBytes;
+        room.resident = true;
+        room.loading = false;
+        gpuBytes += room.gpuBytes;
+        gpuPeak = std::max(gpuPeak, gpuBytes);
+        residentCount++;
+        uploads++;
+        if (room.missingSince)
+        {
+            loadLatency.add((double)(inputClockNow() - room.missingSince) / 1.0e6);
+            room.missingSince = 0;
+        }
+        inFlight--;
+        assets->completed(group);
+    }
+
+    void releaseGpu(Room& room)
+    {
+        room.vao.reset();
+        room.vbo.reset();
+        room.materialBuffer.reset();
+        room.occlusionBuffer.reset();
+        room.ebo.reset();
+        if (room.resident)
+        {
+            gpuBytes -= room.gpuBytes;
+            residentCount--;
+        }
+        room.resident = false;
+        room.gpuBytes = 0;
+    }
+
+    void releaseCpu(Room& room)
+    {
+        room.mesh = MeshBuilder();
+        cpuBytes -= room.cpuBytes;
+        room.cpuBytes = 0;
+        room.decoded = false;
+    }
+
+    // least recently needed cell that passes the filter and is not needed this frame, -1 if there is none
+    template <typename Filter>
+    int leastRecentlyNeeded(Filter filter) const
+    {
+        int oldest = -1;
+        for (int c = firstStreamed; c < (int)rooms.size(); c++)
+        {
+            const Room& room = rooms[c];
+            if (room.loading || room.lastNeeded == frame || !filter(room))
+                continue;
+            if (oldest < 0 || room.lastNeeded < rooms[oldest].lastNeeded)
+                oldest = c;
+        }
+        return oldest;
+    }
+
+    void evict()
+    {
+        while (gpuBudget && gpuBytes > gpuBudget)
+        {
+            int c = leastRecentlyNeeded([](const Room& room) { return room.resident; });
+            if (c < 0)
+                break;
+            releaseGpu(rooms[c]);
+            gpuEvictions++;
+        }
+        while (cpuBudget && cpuBytes > cpuBudget)
+        {
+            int c = leastRecentlyNeeded([](const Room& room) { return room.decoded; });
+            if (c < 0)
+                break;
+            releaseCpu(rooms[c]);
+            cpuEvictions++;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,60 @@
+#version 430 core
+// Temporal anti-aliasing. The scene is rendered with its projection jittered by a different sub-pixel offset every
+// frame and blended into a history that converges to the supersampled image. The history is reprojected from the
+// depth of the current frame and the camera of the previous one, and clamped to the colours around the pixel so that
+// what the reprojection cannot follow (the spinning fans, newly uncovered surfaces) does not leave trails.
+in vec2 texCoord;
+
+out vec4 FragColor;
+
+layout (std140) uniform CameraBlock
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    mat4 inverseViewProjection;
+    mat4 previousViewProjection;
+};
+
+uniform sampler2D currentColor;     // nearest
+uniform sampler2D currentDepth;     // nearest
+uniform sampler2D history;          // bilinear
+uniform bool historyValid;
+uniform vec2 texelSize;
+
+// share of the current frame in the blend; about the last ten frames contribute
+const float CURRENT_WEIGHT = 0.1f;
+
+void main()
+{
+    vec3 current = texture(currentColor, texCoord).rgb;
+    vec3 low = current;
+    vec3 high = current;
+    for (int y = -1; y <= 1; y++)
+    {
+        for (int x = -1; x <= 1; x++)
+        {
+            vec3 neighbour = texture(currentColor, texCoord + vec2(x, y) * texelSize).rgb;
+            low = min(low, neighbour);
+            high = max(high, neighbour);
+        }
+    }
+    if (!historyValid)
+    {
+        FragColor = vec4(current, 1.0f);
+        return;
+    }
+
+    float depth = texture(currentDepth, texCoord).r;
+    vec4 world = inverseViewProjection * vec4(texCoord * 2.0f - 1.0f, depth * 2.0f - 1.0f, 1.0f);
+    vec4 previous = previousViewProjection * vec4(world.xyz / world.w, 1.0f);
+    vec2 previousUV = previous.xy / previous.w * 0.5f + 0.5f;
+    if (any(lessThan(previousUV, vec2(0.0f))) || any(greaterThan(previousUV, vec2(1.0f))))
+    {
+        FragColor = vec4(current, 1.0f);
+        return;
+    }
+    vec3 past = clamp(texture(history, previousUV).rgb, low, high);
+    FragColor = vec4(mix(past, current, CURRENT_WEIGHT), 1.0f);
+}
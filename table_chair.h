@@ -2,17 +2,22 @@
 #define table_chair_h
 
 #include "shader.h"
+#include "materials.h"
+#include "scene.h"
+#include "frame_arena.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include <vector>
 
 class Table_Chair {
 
 public:
-	std::vector<glm::mat4> modelMatrices;
+	// scratch of local_rotation and append; in the frame arena when built during a frame
+	FrameVector<glm::mat4> modelMatrices;
 	float tox, toy, toz;
 	Table_Chair(float x = 0, float y = 0, float z = 0) {
 		tox = x;
@@ -34,8 +39,10 @@ public:
 		return model;
 	}
 
-	Shader local_rotation(Shader ourShader, unsigned int VAO, unsigned int VAO2, unsigned int VAO3, unsigned int VAO4, unsigned int VAO5, float angle = 0) {
+	// appends the desk and chair rotated by angle degrees around their common centre
+	void local_rotation(DrawList& list, unsigned int boxVAO, float angle = 0) {
 		glm::mat4 model;
+		modelMatrices.clear();
 		float rotateAngle_X = 0;
 		float rotateAngle_Y = 0;
 		float rotateAngle_Z = 0;
@@ -65,7 +72,9 @@ public:
 		modelMatrices.push_back(model);
 		model = transforamtion(0.475, .1, 1.175, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 0.8, -.6, 0.2);
 		modelMatrices.push_back(model);
-		unsigned int vertex_array[] = { VAO, VAO2, VAO2, VAO2, VAO2, VAO3, VAO3, VAO3, VAO3, VAO3, VAO4, VAO4, VAO5 };
+		unsigned int materials[] = { MATERIAL_TABLE_TOP, MATERIAL_TABLE_LEG, MATERIAL_TABLE_LEG, MATERIAL_TABLE_LEG, MATERIAL_TABLE_LEG,
+			MATERIAL_CHAIR_LEG, MATERIAL_CHAIR_LEG, MATERIAL_CHAIR_LEG, MATERIAL_CHAIR_LEG, MATERIAL_CHAIR_LEG,
+			MATERIAL_CHAIR_PILLAR, MATERIAL_CHAIR_PILLAR, MATERIAL_CHAIR_BACK };
 		glm::vec3 averagePosition(0.0f);
 		for (const glm::mat4& model : modelMatrices) {
 			averagePosition += glm::vec3(model[3]); 
@@ -84,98 +93,57 @@ public:
 		for (glm::mat4& model : modelMatrices) {
 
 			model = groupTransform * model;
-			ourShader.setMat4("model", model);
-			glBindVertexArray(vertex_array[i]);
-			glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+			list.add(boxVAO, materials[i], model);
 			i++;
 		}
-		return ourShader;
 	}
 
-	Shader ret_shader(Shader ourShader, unsigned int VAO, unsigned int VAO2, unsigned int VAO3, unsigned int VAO4, unsigned int VAO5) {
+	// appends the desk and chair at the current offset
+	void append(DrawList& list, unsigned int boxVAO) {
 		glm::mat4 model;
 		float rotateAngle_X = 0;
 		float rotateAngle_Y = 0;
 		float rotateAngle_Z = 0;
 		model = transforamtion(0, 0, 0, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 2.5, 0.2, 1.75);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAO);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+		list.add(boxVAO, MATERIAL_TABLE_TOP, model);
 		//Leg
 		model = transforamtion(0, 0, 0, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 0.2, -1.5, 0.2);
-		modelMatrices.push_back(model);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAO2);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+		list.add(boxVAO, MATERIAL_TABLE_LEG, model);
 		//Leg
 		model = transforamtion(1.15, 0, 0, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 0.2, -1.5, 0.2);
-		modelMatrices.push_back(model);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAO2);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+		list.add(boxVAO, MATERIAL_TABLE_LEG, model);
 		//Leg
 		model = transforamtion(1.15, 0, .75, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 0.2, -1.5, 0.2);
-		modelMatrices.push_back(model);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAO2);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+		list.add(boxVAO, MATERIAL_TABLE_LEG, model);
 		//Leg
 		model = transforamtion(0, 0, .75, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 0.2, -1.5, 0.2);
-		modelMatrices.push_back(model);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAO2);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+		list.add(boxVAO, MATERIAL_TABLE_LEG, model);
 
 		//chair_Top
 		model = transforamtion(0.4, -.35, .8, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 1, 0.1, 1);
-		modelMatrices.push_back(model);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAO3);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+		list.add(boxVAO, MATERIAL_CHAIR_LEG, model);
 		//c_Leg
 		model = transforamtion(0.4, -.35, .8, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 0.1, -.8, 0.1);
-		modelMatrices.push_back(model);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAO3);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+		list.add(boxVAO, MATERIAL_CHAIR_LEG, model);
 		//c_Leg
 		model = transforamtion(.85, -.35, .8, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 0.1, -.8, 0.1);
-		modelMatrices.push_back(model);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAO3);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+		list.add(boxVAO, MATERIAL_CHAIR_LEG, model);
 		//c_Leg
 		model = transforamtion(.85, -.35, 1.25, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 0.1, -.8, 0.1);
-		modelMatrices.push_back(model);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAO3);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+		list.add(boxVAO, MATERIAL_CHAIR_LEG, model);
 		//c_Leg
 		model = transforamtion(0.4, -.35, 1.25, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 0.1, -.8, 0.1);
-		modelMatrices.push_back(model);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAO3);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+		list.add(boxVAO, MATERIAL_CHAIR_LEG, model);
 		//c_P
 		model = transforamtion(0.75, -.3, 1.2, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 0.1, .3, 0.1);
-		modelMatrices.push_back(model);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAO4);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+		list.add(boxVAO, MATERIAL_CHAIR_PILLAR, model);
 		//c_P
 		model = transforamtion(0.525, -.3, 1.2, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 0.1, .3, 0.1);
-		modelMatrices.push_back(model);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAO4);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+		list.add(boxVAO, MATERIAL_CHAIR_PILLAR, model);
 		//c_B
 		model = transforamtion(0.475, .15, 1.175, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 0.8, -.6, 0.2);
-		modelMatrices.push_back(model);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAO5);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-		return ourShader;
-	} 
+		list.add(boxVAO, MATERIAL_CHAIR_BACK, model);
+	}
 };
 
 
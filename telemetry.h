@@ -0,0 +1,401 @@
+#ifndef telemetry_h
+#define telemetry_h
+
+#include "input.h"
+#include "stats.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Live numbers for monitoring, published into shared memory every frame (--telemetry <name>) and read by other
+// processes (--telemetry-watch, --telemetry-stats) without locks on either side. The mapping is a header followed by
+// a ring of TELEMETRY_SLOTS frames; every slot carries a sequence number the writer makes odd while it copies the
+// frame in and sets to 2 * (frame index + 1) when done, so a reader that sees the same even value before and after its
+// copy has a consistent frame, and anything else means the slot was being rewritten under it. The writer never waits
+// for readers: a reader more than a ring behind loses frames and counts them. The layout is fixed-size plain data;
+// readers check the magic, version and sizes before trusting it.
+const uint32_t TELEMETRY_MAGIC = 0x4d4c4554;    // "TELM"
+const uint32_t TELEMETRY_VERSION = 1;
+const uint32_t TELEMETRY_SLOTS = 256;           // about four seconds at 60 Hz
+const int TELEMETRY_MAX_PHASES = 16;
+const int TELEMETRY_NAME_CHARS = 24;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "telemetry needs address-free 64-bit atomics");
+
+// one render graph pass of the frame
+struct TelemetryPhase
+{
+    char name[TELEMETRY_NAME_CHARS];
+    float cpuMs;
+    float gpuMs;        // latest read back, a few frames older; -1 before the first
+};
+
+struct TelemetryFrame
+{
+    uint64_t frame;
+    uint64_t timeNs;            // start of the frame, steady clock of the writer
+    float frameMs;              // since the start of the previous frame
+    float cpuMs;                // from the start of the frame until its commands were submitted
+    float gpuMs;                // latest GPU frame time read back
+    float resolutionScale;      // of the dynamic resolution, 1 without it
+    uint32_t submitted;         // items considered for drawing
+    uint32_t culled;
+    uint32_t drawCalls;
+    uint32_t triangles;
+    uint64_t gpuBytes;          // GPU memory owned by the renderer
+    uint32_t phaseCount;
+    uint32_t padding;
+    TelemetryPhase phases[TELEMETRY_MAX_PHASES];
+};
+
+struct TelemetrySlot
+{
+    std::atomic<uint64_t> sequence;
+    TelemetryFrame frame;
+};
+
+struct TelemetryHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t frameBytes;
+    std::atomic<uint64_t> published;    // frames written so far; frame n lives in slot n % slotCount
+    std::atomic<uint32_t> writerAlive;
+    uint32_t padding;
+};
+
+struct TelemetryMapping
+{
+    TelemetryHeader header;
+    TelemetrySlot slots[TELEMETRY_SLOTS];
+};
+
+// a named shared memory mapping of one TelemetryMapping
+class TelemetrySharedMemory
+{
+public:
+    ~TelemetrySharedMemory() { close(); }
+
+    bool open(const std::string& name, bool create)
+    {
+        close();
+#ifdef _WIN32
+        std::string path = "Local\\" + name;
+        if (create)
+            handle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)sizeof(TelemetryMapping), path.c_str());
+        else
+            handle = OpenFileMappingA(FILE_MAP_READ, FALSE, path.c_str());
+        if (!handle)
+            return false;
+        mapping = (TelemetryMapping*)MapViewOfFile(handle, create ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, sizeof(TelemetryMapping));
+        if (!mapping)
+        {
+            close();
+            return false;
+        }
+#else
+        path = name[0] == '/' ? name : "/" + name;
+        int fd = create ? shm_open(path.c_str(), O_CREAT | O_RDWR, 0644) : shm_open(path.c_str(), O_RDONLY, 0);
+        if (fd < 0)
+            return false;
+        if (create && ftruncate(fd, (off_t)sizeof(TelemetryMapping)) != 0)
+        {
+            ::close(fd);
+            shm_unlink(path.c_str());
+            return false;
+        }
+        void* memory = mmap(NULL, sizeof(TelemetryMapping), create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (memory == MAP_FAILED)
+            return false;
+        mapping = (TelemetryMapping*)memory;
+        owner = create;
+#endif
+        return true;
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        if (mapping)
+            UnmapViewOfFile(mapping);
+        if (handle)
+            CloseHandle(handle);
+        handle = NULL;
+#else
+        if (mapping)
+            munmap(mapping, sizeof(TelemetryMapping));
+        // readers keep their mapping; the name goes so the next writer starts from a fresh ring
+        if (owner)
+            shm_unlink(path.c_str());
+        owner = false;
+#endif
+        mapping = NULL;
+    }
+
+    TelemetryMapping* get() const { return mapping; }
+
+private:
+    TelemetryMapping* mapping = NULL;
+#ifdef _WIN32
+    HANDLE handle = NULL;
+#else
+    std::string path;
+    bool owner = false;
+#endif
+};
+
+// the render loop's side: fill frame(), then publish() it
+class TelemetryPublisher
+{
+public:
+    bool open(const std::string& name)
+    {
+        if (!memory.open(name, true))
+        {
+            std::cout << "ERROR::TELEMETRY:: cannot create the shared memory " << name << std::endl;
+            return false;
+        }
+        TelemetryHeader& header = memory.get()->header;
+        header.writerAlive.store(0, std::memory_order_relaxed);
+        header.magic = TELEMETRY_MAGIC;
+        header.version = TELEMETRY_VERSION;
+        header.slotCount = TELEMETRY_SLOTS;
+        header.frameBytes = (uint32_t)sizeof(TelemetryFrame);
+        header.published.store(0, std::memory_order_relaxed);
+        for (TelemetrySlot& slot : memory.get()->slots)
+            slot.sequence.store(0, std::memory_order_relaxed);
+        header.writerAlive.store(1, std::memory_order_release);
+        return true;
+    }
+
+    bool isOpen() const { return memory.get() != NULL; }
+
+    // the record of the frame being measured; cleared by publish()
+    TelemetryFrame& frame() { return staging; }
+
+    void addPhase(const char* name, double cpuMs, double gpuMs)
+    {
+        if (staging.phaseCount >= TELEMETRY_MAX_PHASES)
+            return;
+        TelemetryPhase& phase = staging.phases[staging.phaseCount++];
+        strncpy(phase.name, name, TELEMETRY_NAME_CHARS - 1);
+        phase.name[TELEMETRY_NAME_CHARS - 1] = '\0';
+        phase.cpuMs = (float)cpuMs;
+        phase.gpuMs = (float)gpuMs;
+    }
+
+    void publish()
+    {
+        uint64_t start = inputClockNow();
+        TelemetryMapping* mapping = memory.get();
+        uint64_t n = mapping->header.published.load(std::memory_order_relaxed);
+        staging.frame = n;
+        staging.frameMs = lastTimeNs ? (float)((double)(staging.timeNs - lastTimeNs) / 1.0e6) : 0.0f;
+        lastTimeNs = staging.timeNs;
+        TelemetrySlot& slot = mapping->slots[n % TELEMETRY_SLOTS];
+        slot.sequence.store(2 * n + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&slot.frame, &staging, sizeof(TelemetryFrame));
+        slot.sequence.store(2 * n + 2, std::memory_order_release);
+        mapping->header.published.store(n + 1, std::memory_order_release);
+        staging = TelemetryFrame();
+        publishNs.add((double)(inputClockNow() - start));
+    }
+
+    void report(std::ostream& out)
+    {
+        if (!isOpen())
+            return;
+        out << "telemetry: " << memory.get()->header.published.load() << " frames published" << std::endl;
+        publishNs.report(out, "telemetry publish", "ns");
+    }
+
+    void close()
+    {
+        if (isOpen())
+            memory.get()->header.writerAlive.store(0, std::memory_order_release);
+        memory.close();
+    }
+
+private:
+    TelemetrySharedMemory memory;
+    TelemetryFrame staging = TelemetryFrame();
+    uint64_t lastTimeNs = 0;
+    SampleSeries publishNs;
+};
+
+// the monitoring side; polls the ring without ever blocking the writer
+class TelemetryReader
+{
+public:
+    bool open(const std::string& name)
+    {
+        if (!memory.open(name, false))
+        {
+            std::cout << "ERROR::TELEMETRY:: no shared memory " << name << "; is the renderer running with --telemetry " << name << "?" << std::endl;
+            return false;
+        }
+        const TelemetryHeader& header = memory.get()->header;
+        if (header.magic != TELEMETRY_MAGIC || header.version != TELEMETRY_VERSION || header.slotCount != TELEMETRY_SLOTS
+            || header.frameBytes != sizeof(TelemetryFrame))
+        {
+            std::cout << "ERROR::TELEMETRY:: " << name << " has an unknown layout (version " << header.version << ")" << std::endl;
+            memory.close();
+            return false;
+        }
+        // start at the newest frame rather than replaying the ring
+        next = header.published.load(std::memory_order_acquire);
+        return true;
+    }
+
+    bool writerAlive() const { return memory.get()->header.writerAlive.load(std::memory_order_acquire) != 0; }
+
+    // copies the next published frame; false when there is none yet
+    bool read(TelemetryFrame& out)
+    {
+        const TelemetryMapping* mapping = memory.get();
+        while (true)
+        {
+            uint64_t published = mapping->header.published.load(std::memory_order_acquire);
+            if (next >= published)
+                return false;
+            // frames the writer has lapped are gone
+            if (published - next > TELEMETRY_SLOTS)
+            {
+                dropped += published - TELEMETRY_SLOTS - next;
+                next = published - TELEMETRY_SLOTS;
+            }
+            const TelemetrySlot& slot = mapping->slots[next % TELEMETRY_SLOTS];
+            uint64_t expected = 2 * next + 2;
+            uint64_t before = slot.sequence.load(std::memory_order_acquire);
+            if (before == expected)
+            {
+                memcpy(&out, &slot.frame, sizeof(TelemetryFrame));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.sequence.load(std::memory_order_relaxed) == expected)
+                {
+                    next++;
+                    return true;
+                }
+            }
+            // rewritten while we looked: the frame is lost
+            dropped++;
+            next++;
+        }
+    }
+
+    uint64_t droppedFrames() const { return dropped; }
+
+private:
+    TelemetrySharedMemory memory;
+    uint64_t next = 0;
+    uint64_t dropped = 0;
+};
+
+// --telemetry-watch: one line per frame until the renderer exits
+inline int runTelemetryWatch(const std::string& name)
+{
+    TelemetryReader reader;
+    if (!reader.open(name))
+        return -1;
+    TelemetryFrame frame;
+    while (true)
+    {
+        bool any = false;
+        while (reader.read(frame))
+        {
+            any = true;
+            std::cout << std::fixed << std::setprecision(2) << "frame " << frame.frame << ": " << frame.frameMs
+                << " ms, cpu " << frame.cpuMs << " ms, gpu " << frame.gpuMs << " ms, scale " << frame.resolutionScale
+                << ", " << frame.drawCalls << " draws, " << frame.triangles << " triangles, " << frame.culled << " of "
+                << frame.submitted << " culled, " << frame.gpuBytes / 1048576.0 << " MiB";
+            for (uint32_t p = 0; p < frame.phaseCount; p++)
+                std::cout << " | " << frame.phases[p].name << " " << frame.phases[p].cpuMs << "/" << frame.phases[p].gpuMs;
+            std::cout << std::endl;
+        }
+        if (!any && !reader.writerAlive())
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::cout << reader.droppedFrames() << " frames dropped" << std::endl;
+    return 0;
+}
+
+// --telemetry-stats: the distribution of every number over a number of seconds, or until the renderer exits
+inline int runTelemetryStats(const std::string& name, double seconds)
+{
+    TelemetryReader reader;
+    if (!reader.open(name))
+        return -1;
+    SampleSeries frameMs, cpuMs, gpuMs, scale, drawCalls, triangles, culled, gpuMiB;
+    std::map<std::string, SampleSeries> phaseCpuMs, phaseGpuMs;
+    TelemetryFrame frame;
+    uint64_t until = inputClockNow() + (uint64_t)(seconds * 1.0e9);
+    while (inputClockNow() < until)
+    {
+        bool any = false;
+        while (reader.read(frame))
+        {
+            any = true;
+            if (frame.frameMs > 0.0f)
+                frameMs.add(frame.frameMs);
+            cpuMs.add(frame.cpuMs);
+            gpuMs.add(frame.gpuMs);
+            scale.add(frame.resolutionScale);
+            drawCalls.add(frame.drawCalls);
+            triangles.add(frame.triangles);
+            culled.add(frame.culled);
+            gpuMiB.add(frame.gpuBytes / 1048576.0);
+            for (uint32_t p = 0; p < frame.phaseCount; p++)
+            {
+                phaseCpuMs[frame.phases[p].name].add(frame.phases[p].cpuMs);
+                if (frame.phases[p].gpuMs >= 0.0f)
+                    phaseGpuMs[frame.phases[p].name].add(frame.phases[p].gpuMs);
+            }
+        }
+        if (!any && !reader.writerAlive())
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::cout << "telemetry " << name << ": " << cpuMs.count() << " frames, " << reader.droppedFrames() << " dropped" << std::endl;
+    frameMs.report(std::cout, "frame");
+    cpuMs.report(std::cout, "cpu");
+    gpuMs.report(std::cout, "gpu");
+    scale.report(std::cout, "resolution scale", "");
+    drawCalls.report(std::cout, "draw calls", "");
+    triangles.report(std::cout, "triangles", "");
+    culled.report(std::cout, "culled", "");
+    gpuMiB.report(std::cout, "gpu memory", "MiB");
+    for (auto& phase : phaseCpuMs)
+    {
+        phase.second.report(std::cout, "  " + phase.first + " cpu");
+        if (phaseGpuMs.count(phase.first))
+            phaseGpuMs[phase.first].report(std::cout, "  " + phase.first + " gpu");
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,103 @@
+// Scheduling checks for RenderGraph. They only compile the graph, so they need neither a window nor a GL context.
+
+#include "../render_graph.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+// the passes compile() kept, in the order they run
+static std::string scheduled(const RenderGraph& graph)
+{
+    std::string names;
+    graph.visitScheduledPasses([&](const char* name) {
+        names += names.empty() ? "" : " ";
+        names += name;
+    });
+    return names;
+}
+
+static void expectOrder(const char* test, RenderGraph& graph, const std::string& expected)
+{
+    graph.compile();
+    std::string actual = scheduled(graph);
+    if (actual != expected)
+    {
+        std::cout << "FAIL " << test << ": ran " << actual << ", expected " << expected << std::endl;
+        failures++;
+    }
+    else
+    {
+        std::cout << "PASS " << test << std::endl;
+    }
+}
+
+int main()
+{
+    RenderGraph graph;
+
+    // a pass that reads the old contents runs before the pass declared after it to overwrite them
+    graph.beginFrame();
+    {
+        RenderResource history = graph.import("history");
+        RenderResource blurred = graph.import("blurred", true);
+        RenderResource frame = graph.import("frame", true);
+        graph.addPass("blur history", [] {}).reads(history).writes(blurred);
+        graph.addPass("update history", [] {}).writes(history);
+        graph.addPass("present", [] {}).readsFinal(history).writes(frame);
+    }
+    expectOrder("reader then writer", graph, "blur history update history present");
+
+    // the same with a write before the reader: it reads the first write, then the second overwrites it
+    graph.beginFrame();
+    {
+        RenderResource colour = graph.import("colour");
+        RenderResource copy = graph.import("copy", true);
+        RenderResource frame = graph.import("frame", true);
+        graph.addPass("draw", [] {}).writes(colour);
+        graph.addPass("copy", [] {}).reads(colour).writes(copy);
+        graph.addPass("overlay", [] {}).writes(colour);
+        graph.addPass("present", [] {}).readsFinal(colour).writes(frame);
+    }
+    expectOrder("writer, reader, writer", graph, "draw copy overlay present");
+
+    // a reader that waits for a producer declared later still runs before the writer declared after it
+    graph.beginFrame();
+    {
+        RenderResource history = graph.import("history");
+        RenderResource colour = graph.import("colour");
+        RenderResource frame = graph.import("frame", true);
+        graph.addPass("resolve", [] {}).reads(history).readsFinal(colour).writes(frame);
+        graph.addPass("update history", [] {}).writes(history).sideEffect();
+        graph.addPass("scene", [] {}).writes(colour);
+    }
+    expectOrder("held back reader then writer", graph, "scene resolve update history");
+
+    // a consumer declared ahead of its producers runs after all of them
+    graph.beginFrame();
+    {
+        RenderResource frame = graph.import("frame", true);
+        RenderResource colour = graph.import("colour");
+        graph.addPass("post-process", [] {}).readsFinal(colour).writes(frame);
+        graph.addPass("clear", [] {}).writes(colour);
+        graph.addPass("scene", [] {}).writes(colour);
+    }
+    expectOrder("consumer declared first", graph, "clear scene post-process");
+
+    // a pass whose writes nothing reads is culled, and so are the passes only it needed
+    graph.beginFrame();
+    {
+        RenderResource frame = graph.import("frame", true);
+        RenderResource unused = graph.import("unused");
+        RenderResource input = graph.import("input");
+        graph.addPass("feed", [] {}).writes(input);
+        graph.addPass("debug view", [] {}).reads(input).writes(unused);
+        graph.addPass("scene", [] {}).writes(frame);
+    }
+    expectOrder("culling", graph, "scene");
+
+    graph.destroy();
+    return failures ? 1 : 0;
+}
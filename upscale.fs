@@ -0,0 +1,32 @@
+#version 430 core
+// Stretches the frame rendered at the dynamic resolution over the output. The bilinear tap softens the image by the
+// scale, so an unsharp mask over the four neighbouring texels brings back some contrast; the result is clamped to the
+// range of those texels so edges do not ring.
+in vec2 texCoord;
+
+out vec4 FragColor;
+
+uniform sampler2D frame;    // bilinear; the rendered part spans [0, uvScale]
+uniform vec2 uvScale;
+uniform vec2 texelSize;     // of frame
+uniform float sharpness;    // 0 for none, 1 for the full mask
+
+vec3 tap(vec2 uv)
+{
+    // half a texel inside the rendered part, so the filter never reads what lies beyond it
+    return texture(frame, clamp(uv, 0.5f * texelSize, uvScale - 0.5f * texelSize)).rgb;
+}
+
+void main()
+{
+    vec2 uv = texCoord * uvScale;
+    vec3 center = tap(uv);
+    vec3 north = tap(uv + vec2(0.0f, texelSize.y));
+    vec3 south = tap(uv - vec2(0.0f, texelSize.y));
+    vec3 east = tap(uv + vec2(texelSize.x, 0.0f));
+    vec3 west = tap(uv - vec2(texelSize.x, 0.0f));
+    vec3 low = min(center, min(min(north, south), min(east, west)));
+    vec3 high = max(center, max(max(north, south), max(east, west)));
+    vec3 sharpened = center + sharpness * (4.0f * center - north - south - east - west);
+    FragColor = vec4(clamp(sharpened, low, high), 1.0f);
+}
@@ -1,16 +1,52 @@
-#version 330 core
+#version 430 core
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aColor;
+layout (location = 1) in uint aMaterial;    // baked meshes only, see materialIndex
+layout (location = 2) in vec3 aNormal;
+layout (location = 4) in uint aOcclusion;   // baked meshes only, see occlusionRecord
 
-out vec4 color;
+// explicit locations so multiview.gs can sit between this stage and fragmentShader.fs
+layout (location = 0) flat out uint material;
+layout (location = 1) out vec3 worldPos;
+layout (location = 2) out vec3 normal;
+layout (location = 3) flat out uint occlusionFace;  // (1 + record offset) << 3 | face, 0 for none
+layout (location = 4) out vec2 occlusionUV;         // position on the face's texel grid
 
+layout (std140) uniform CameraBlock
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+};
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform int materialIndex;  // slot in the material table, see materials.h; -1 takes aMaterial of a baked mesh
+// 1 + offset of the box's baked ambient occlusion, 0 for none; -1 takes aOcclusion of a baked mesh, see ambient_occlusion.h
+uniform int occlusionRecord;
+
+// the depth pre-pass and the shading pass must produce identical depths for GL_EQUAL
+invariant gl_Position;
+
+// face << 2 | corner of a vertex of the shared box, which spans [0, 0.5], as boxFaceCorner() in scene.h
+uint boxFaceCorner(vec3 position, vec3 boxNormal)
+{
+    vec3 a = abs(boxNormal);
+    int axis = a.x >= a.y && a.x >= a.z ? 0 : (a.y >= a.z ? 1 : 2);
+    uint face = uint(2 * axis + (boxNormal[axis] > 0.0f ? 1 : 0));
+    int u = axis == 0 ? 1 : 0;
+    int v = axis == 2 ? 1 : 2;
+    return face << 2 | (position[u] > 0.25f ? 2u : 0u) | (position[v] > 0.25f ? 1u : 0u);
+}
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0f);
-    color = vec4(aColor, 1.0f);
+    vec4 world = model * vec4(aPos, 1.0f);
+    gl_Position = viewProjection * world;
+    worldPos = world.xyz;
+    // the boxes are scaled non-uniformly, so normals need the inverse transpose
+    normal = mat3(transpose(inverse(model))) * aNormal;
+    material = materialIndex >= 0 ? uint(materialIndex) : aMaterial;
+    uint occlusion = occlusionRecord > 0 ? uint(occlusionRecord) << 5 | boxFaceCorner(aPos, aNormal) : (occlusionRecord < 0 ? aOcclusion : 0u);
+    occlusionFace = occlusion >> 2;
+    occlusionUV = vec2(float((occlusion >> 1) & 1u), float(occlusion & 1u));
 }